@@ -5,6 +5,7 @@
 #include "bench.h"
 
 #include <iostream>
+#include <vector>
 #include <sys/time.h>
 
 using namespace benchmark;
@@ -22,18 +23,51 @@ BenchRunner::BenchRunner(std::string name, BenchFunction func)
     benchmarks.insert(std::make_pair(name, func));
 }
 
+static void PrintCSV(const std::vector<Result>& results)
+{
+    std::cout << "Benchmark" << "," << "count" << "," << "min" << "," << "max" << "," << "average" << ","
+              << "ns_per_op" << "," << "ops_per_s" << "\n";
+    for (const Result& r : results) {
+        std::cout << r.name << "," << r.count << "," << r.minTime << "," << r.maxTime << "," << r.average << ","
+                  << r.average * 1e9 << "," << 1.0 / r.average << "\n";
+    }
+}
+
+static void PrintJSON(const std::vector<Result>& results)
+{
+    // Benchmark names are C++ identifiers, so they need no escaping
+    std::cout << "[\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        std::cout << "  {\"name\": \"" << r.name << "\", \"count\": " << r.count
+                  << ", \"min\": " << r.minTime << ", \"max\": " << r.maxTime << ", \"average\": " << r.average
+                  << ", \"ns_per_op\": " << r.average * 1e9 << ", \"ops_per_s\": " << 1.0 / r.average << "}"
+                  << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    std::cout << "]\n";
+}
+
 void
-BenchRunner::RunAll(double elapsedTimeForOne)
+BenchRunner::RunAll(OutputFormat format, const std::string& filter, double elapsedTimeForOne)
 {
-    std::cout << "Benchmark" << "," << "count" << "," << "min" << "," << "max" << "," << "average" << "\n";
+    std::vector<Result> results;
 
     for (std::map<std::string,BenchFunction>::iterator it = benchmarks.begin();
          it != benchmarks.end(); ++it) {
+        if (it->first.find(filter) == std::string::npos)
+            continue;
 
-        State state(it->first, elapsedTimeForOne);
+        Result result;
+        State state(it->first, elapsedTimeForOne, &result);
         BenchFunction& func = it->second;
         func(state);
+        results.push_back(result);
     }
+
+    if (format == FORMAT_JSON)
+        PrintJSON(results);
+    else
+        PrintCSV(results);
 }
 
 bool State::KeepRunning()
@@ -62,9 +96,12 @@ bool State::KeepRunning()
 
     --count;
 
-    // Output results
-    double average = (now-beginTime)/count;
-    std::cout << name << "," << count << "," << minTime << "," << maxTime << "," << average << "\n";
+    // Record results
+    result->name = name;
+    result->count = count;
+    result->minTime = minTime;
+    result->maxTime = maxTime;
+    result->average = (now-beginTime)/count;
 
     return false;
 }
@@ -5,8 +5,10 @@
 #ifndef BITCOIN_BENCH_BENCH_H
 #define BITCOIN_BENCH_BENCH_H
 
+#include <limits>
 #include <map>
 #include <string>
+#include <stdint.h>
 
 #include <boost/function.hpp>
 #include <boost/preprocessor/cat.hpp>
@@ -36,6 +38,13 @@ BENCHMARK(CODE_TO_TIME);
  
 namespace benchmark {
 
+    /** Timings of one benchmark, in seconds per iteration */
+    struct Result {
+        std::string name;
+        int64_t count;
+        double minTime, maxTime, average;
+    };
+
     class State {
         std::string name;
         double maxElapsed;
@@ -43,8 +52,9 @@ namespace benchmark {
         double lastTime, minTime, maxTime;
         int64_t count;
         int64_t timeCheckCount;
+        Result* result;
     public:
-        State(std::string _name, double _maxElapsed) : name(_name), maxElapsed(_maxElapsed), count(0) {
+        State(std::string _name, double _maxElapsed, Result* _result) : name(_name), maxElapsed(_maxElapsed), count(0), result(_result) {
             minTime = std::numeric_limits<double>::max();
             maxTime = std::numeric_limits<double>::min();
             timeCheckCount = 1;
@@ -54,6 +64,12 @@ namespace benchmark {
 
     typedef boost::function<void(State&)> BenchFunction;
 
+    /** Machine-readable formats the results can be printed in */
+    enum OutputFormat {
+        FORMAT_CSV,
+        FORMAT_JSON
+    };
+
     class BenchRunner
     {
         static std::map<std::string, BenchFunction> benchmarks;
@@ -61,7 +77,8 @@ namespace benchmark {
     public:
         BenchRunner(std::string name, BenchFunction func);
 
-        static void RunAll(double elapsedTimeForOne=1.0);
+        /** Run every benchmark whose name contains filter, and print the results to stdout */
+        static void RunAll(OutputFormat format=FORMAT_CSV, const std::string& filter="", double elapsedTimeForOne=1.0);
     };
 }
 
@@ -4,18 +4,45 @@
 
 #include "bench.h"
 
+#include "crypto/sha256.h"
 #include "key.h"
+#include "script/sigcache.h"
 #include "validation.h"
 #include "util.h"
 
+#include <iostream>
+
 int
 main(int argc, char** argv)
 {
+    ParseParameters(argc, argv);
+
+    if (mapArgs.count("-?") || mapArgs.count("-h") || mapArgs.count("-help")) {
+        std::cout << "Usage: bench_mano [options]\n\n"
+                  << "  -format=<csv|json>  Output format of the results (default: csv)\n"
+                  << "  -filter=<string>    Only run benchmarks whose name contains <string>\n"
+                  << "  -time=<seconds>     Time spent on each benchmark (default: 1)\n";
+        return 0;
+    }
+
+    std::string strFormat = GetArg("-format", "csv");
+    benchmark::OutputFormat format;
+    if (strFormat == "csv") {
+        format = benchmark::FORMAT_CSV;
+    } else if (strFormat == "json") {
+        format = benchmark::FORMAT_JSON;
+    } else {
+        std::cerr << "Error: unknown output format '" << strFormat << "'\n";
+        return 1;
+    }
+
+    SHA256AutoDetect();
     ECC_Start();
     SetupEnvironment();
     fPrintToDebugLog = false; // don't want to write to debug.log file
+    InitSignatureCache();
 
-    benchmark::BenchRunner::RunAll();
+    benchmark::BenchRunner::RunAll(format, GetArg("-filter", ""), atof(GetArg("-time", "1").c_str()));
 
     ECC_Stop();
 }
@@ -0,0 +1,161 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "checkqueue.h"
+#include "hash.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+// Check queue throughput as seen while connecting a block: the master adds
+// the checks of one transaction at a time and then joins the workers until
+// everything is done. Each check hashes a few blocks to stand in for script
+// verification. The work-stealing CCheckQueue is compared against the
+// single-mutex queue it replaced, kept here as LegacyCheckQueue.
+
+static const int CHECKS_PER_BLOCK = 4000;
+static const int CHECKS_PER_TX = 2;
+static const unsigned int CHECK_BATCH_SIZE = 128;
+
+struct BenchCheck
+{
+    uint256 hash;
+    bool operator()()
+    {
+        for (int i = 0; i < 4; i++)
+            hash = Hash(hash.begin(), hash.end());
+        return true;
+    }
+    void swap(BenchCheck& check) { std::swap(hash, check.hash); }
+};
+
+/** The check queue before work stealing: one shared stack under one mutex. */
+template <typename T>
+class LegacyCheckQueue
+{
+private:
+    boost::mutex mutex;
+    boost::condition_variable condWorker;
+    boost::condition_variable condMaster;
+    std::vector<T> queue;
+    int nIdle;
+    int nTotal;
+    bool fAllOk;
+    unsigned int nTodo;
+    unsigned int nBatchSize;
+
+    bool Loop(bool fMaster = false)
+    {
+        boost::condition_variable& cond = fMaster ? condMaster : condWorker;
+        std::vector<T> vChecks;
+        vChecks.reserve(nBatchSize);
+        unsigned int nNow = 0;
+        bool fOk = true;
+        do {
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                if (nNow) {
+                    fAllOk &= fOk;
+                    nTodo -= nNow;
+                    if (nTodo == 0 && !fMaster)
+                        condMaster.notify_one();
+                } else {
+                    nTotal++;
+                }
+                while (queue.empty()) {
+                    if (fMaster && nTodo == 0) {
+                        nTotal--;
+                        bool fRet = fAllOk;
+                        fAllOk = true;
+                        return fRet;
+                    }
+                    nIdle++;
+                    cond.wait(lock);
+                    nIdle--;
+                }
+                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
+                vChecks.resize(nNow);
+                for (unsigned int i = 0; i < nNow; i++) {
+                    vChecks[i].swap(queue.back());
+                    queue.pop_back();
+                }
+                fOk = fAllOk;
+            }
+            BOOST_FOREACH (T& check, vChecks)
+                if (fOk)
+                    fOk = check();
+            vChecks.clear();
+        } while (true);
+    }
+
+public:
+    LegacyCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), nBatchSize(nBatchSizeIn) {}
+
+    void Thread() { Loop(); }
+
+    bool Wait() { return Loop(true); }
+
+    void Add(std::vector<T>& vChecks)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        BOOST_FOREACH (T& check, vChecks) {
+            queue.push_back(T());
+            check.swap(queue.back());
+        }
+        nTodo += vChecks.size();
+        if (vChecks.size() == 1)
+            condWorker.notify_one();
+        else if (vChecks.size() > 1)
+            condWorker.notify_all();
+    }
+};
+
+template <typename Queue>
+static void RunQueue(Queue* queue)
+{
+    queue->Thread();
+}
+
+template <typename Queue>
+static void CheckQueueThroughput(benchmark::State& state, int nThreads)
+{
+    Queue queue(CHECK_BATCH_SIZE);
+    // The master is one of the nThreads
+    boost::thread_group threads;
+    for (int i = 0; i < nThreads - 1; i++)
+        threads.create_thread(boost::bind(&RunQueue<Queue>, &queue));
+    while (state.KeepRunning()) {
+        for (int i = 0; i < CHECKS_PER_BLOCK; i += CHECKS_PER_TX) {
+            std::vector<BenchCheck> vChecks(CHECKS_PER_TX);
+            queue.Add(vChecks);
+        }
+        assert(queue.Wait());
+    }
+    threads.interrupt_all();
+    threads.join_all();
+}
+
+static void CheckQueue_Legacy_2(benchmark::State& state) { CheckQueueThroughput<LegacyCheckQueue<BenchCheck> >(state, 2); }
+static void CheckQueue_Legacy_4(benchmark::State& state) { CheckQueueThroughput<LegacyCheckQueue<BenchCheck> >(state, 4); }
+static void CheckQueue_Legacy_8(benchmark::State& state) { CheckQueueThroughput<LegacyCheckQueue<BenchCheck> >(state, 8); }
+static void CheckQueue_Legacy_16(benchmark::State& state) { CheckQueueThroughput<LegacyCheckQueue<BenchCheck> >(state, 16); }
+static void CheckQueue_Legacy_32(benchmark::State& state) { CheckQueueThroughput<LegacyCheckQueue<BenchCheck> >(state, 32); }
+static void CheckQueue_Stealing_2(benchmark::State& state) { CheckQueueThroughput<CCheckQueue<BenchCheck> >(state, 2); }
+static void CheckQueue_Stealing_4(benchmark::State& state) { CheckQueueThroughput<CCheckQueue<BenchCheck> >(state, 4); }
+static void CheckQueue_Stealing_8(benchmark::State& state) { CheckQueueThroughput<CCheckQueue<BenchCheck> >(state, 8); }
+static void CheckQueue_Stealing_16(benchmark::State& state) { CheckQueueThroughput<CCheckQueue<BenchCheck> >(state, 16); }
+static void CheckQueue_Stealing_32(benchmark::State& state) { CheckQueueThroughput<CCheckQueue<BenchCheck> >(state, 32); }
+
+BENCHMARK(CheckQueue_Legacy_2);
+BENCHMARK(CheckQueue_Legacy_4);
+BENCHMARK(CheckQueue_Legacy_8);
+BENCHMARK(CheckQueue_Legacy_16);
+BENCHMARK(CheckQueue_Legacy_32);
+BENCHMARK(CheckQueue_Stealing_2);
+BENCHMARK(CheckQueue_Stealing_4);
+BENCHMARK(CheckQueue_Stealing_8);
+BENCHMARK(CheckQueue_Stealing_16);
+BENCHMARK(CheckQueue_Stealing_32);
@@ -0,0 +1,60 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "consensus/merkle.h"
+#include "crypto/sha256.h"
+#include "hash.h"
+#include "random.h"
+#include "uint256.h"
+
+#include <vector>
+
+// Double SHA256 at the sizes that matter for consensus: 64 bytes (merkle tree
+// nodes), 80 bytes (a block header) and 1MB (a large block's transactions).
+
+static void SHA256D(benchmark::State& state, size_t size)
+{
+    std::vector<unsigned char> in(size, 0);
+    uint256 hash;
+    while (state.KeepRunning()) {
+        CHash256().Write(in.data(), in.size()).Finalize(hash.begin());
+        in[0] = hash.begin()[0];
+    }
+}
+
+static void SHA256D_64b(benchmark::State& state) { SHA256D(state, 64); }
+static void SHA256D_80b(benchmark::State& state) { SHA256D(state, 80); }
+static void SHA256D_1MB(benchmark::State& state) { SHA256D(state, 1000 * 1000); }
+
+// 1024 independent 64-byte inputs through the batched, SIMD-dispatched path
+static void SHA256D64_1024(benchmark::State& state)
+{
+    std::vector<unsigned char> in(64 * 1024, 0);
+    std::vector<unsigned char> out(32 * 1024);
+    while (state.KeepRunning()) {
+        SHA256D64(out.data(), in.data(), 1024);
+        in[0] = out[0];
+    }
+}
+
+// Merkle root of a block with 1000 transactions
+static void MerkleRoot(benchmark::State& state)
+{
+    std::vector<uint256> leaves(1000);
+    for (size_t i = 0; i < leaves.size(); i++)
+        leaves[i] = GetRandHash();
+    while (state.KeepRunning()) {
+        bool mutated = false;
+        uint256 root = ComputeMerkleRoot(leaves, &mutated);
+        leaves[0] = root;
+    }
+}
+
+BENCHMARK(SHA256D_64b);
+BENCHMARK(SHA256D_80b);
+BENCHMARK(SHA256D_1MB);
+BENCHMARK(SHA256D64_1024);
+BENCHMARK(MerkleRoot);
@@ -0,0 +1,106 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "crypto/Lyra2Z/Lyra2Z.h"
+#include "pow.h"
+#include "primitives/block.h"
+
+#include <vector>
+
+// Proof-of-work path: Lyra2Z itself, the header hash built on it, and the
+// checks done with the result. Every iteration uses a fresh nonce, so the
+// memoized header hash never short-circuits the work being measured.
+
+static void Lyra2Z_Hash(benchmark::State& state)
+{
+    CBlockHeader header = Params(CBaseChainParams::MAIN).GenesisBlock().GetBlockHeader();
+    uint256 hash;
+    while (state.KeepRunning()) {
+        lyra2z_hash((const char*)&header.nVersion, (char*)hash.begin());
+        header.nNonce++;
+    }
+}
+
+static void Lyra2Z_HashCtx(benchmark::State& state)
+{
+    CBlockHeader header = Params(CBaseChainParams::MAIN).GenesisBlock().GetBlockHeader();
+    lyra2z_ctx ctx;
+    lyra2z_ctx_init(&ctx);
+    uint256 hash;
+    while (state.KeepRunning()) {
+        lyra2z_hash_ctx(&ctx, (const char*)&header.nVersion, (char*)hash.begin());
+        header.nNonce++;
+    }
+}
+
+// One iteration hashes 8 consecutive nonces, as the internal miner does
+static void Lyra2Z_HashNonces8(benchmark::State& state)
+{
+    CBlockHeader header = Params(CBaseChainParams::MAIN).GenesisBlock().GetBlockHeader();
+    lyra2z_ctx ctx;
+    lyra2z_ctx_init(&ctx);
+    lyra2z_midstate midstate;
+    lyra2z_midstate_init(&midstate, (const char*)&header.nVersion);
+    char hashes[8 * 32];
+    uint32_t nNonce = 0;
+    while (state.KeepRunning()) {
+        lyra2z_hash_nonces(&ctx, &midstate, nNonce, 8, hashes);
+        nNonce += 8;
+    }
+}
+
+static void BlockHeader_GetHash(benchmark::State& state)
+{
+    CBlockHeader header = Params(CBaseChainParams::MAIN).GenesisBlock().GetBlockHeader();
+    while (state.KeepRunning()) {
+        header.GetHash();
+        header.nNonce++;
+    }
+}
+
+static void BlockHeader_GetHashMemoized(benchmark::State& state)
+{
+    CBlockHeader header = Params(CBaseChainParams::MAIN).GenesisBlock().GetBlockHeader();
+    header.GetHash();
+    while (state.KeepRunning()) {
+        header.GetHash();
+    }
+}
+
+static void Pow_CheckProofOfWork(benchmark::State& state)
+{
+    const CChainParams& params = Params(CBaseChainParams::MAIN);
+    const CBlock& genesis = params.GenesisBlock();
+    const uint256 hash = genesis.GetHash();
+    while (state.KeepRunning()) {
+        CheckProofOfWork(hash, genesis.nBits, params.GetConsensus());
+    }
+}
+
+static void Pow_DarkGravityWave(benchmark::State& state)
+{
+    const Consensus::Params& consensus = Params(CBaseChainParams::MAIN).GetConsensus();
+    std::vector<CBlockIndex> blocks(100);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        blocks[i].pprev = i ? &blocks[i - 1] : NULL;
+        blocks[i].nHeight = i;
+        blocks[i].nTime = 1500000000 + i * consensus.nPowTargetSpacing + (i % 7) * 13;
+        blocks[i].nBits = 0x1e0ffff0 - (i % 5);
+    }
+    while (state.KeepRunning()) {
+        GetNextWorkRequired(&blocks.back(), NULL, consensus);
+    }
+}
+
+BENCHMARK(Lyra2Z_Hash);
+BENCHMARK(Lyra2Z_HashCtx);
+BENCHMARK(Lyra2Z_HashNonces8);
+BENCHMARK(BlockHeader_GetHash);
+BENCHMARK(BlockHeader_GetHashMemoized);
+BENCHMARK(Pow_CheckProofOfWork);
+BENCHMARK(Pow_DarkGravityWave);
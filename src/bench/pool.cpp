@@ -0,0 +1,48 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "coins.h"
+#include "random.h"
+
+// Filling a coins cache and flushing it into an empty view, with the pool
+// allocated CCoinsMap (CoinsCache_FillFlush) against the same map using the
+// default allocator (StdUnorderedMap_FillClear). One iteration is
+// COINS_PER_FLUSH insertions and the teardown of the whole map.
+
+static const int COINS_PER_FLUSH = 100000;
+
+static std::vector<COutPoint> RandomOutpoints()
+{
+    std::vector<COutPoint> outpoints(COINS_PER_FLUSH);
+    for (int i = 0; i < COINS_PER_FLUSH; i++)
+        outpoints[i] = COutPoint(GetRandHash(), i % 4);
+    return outpoints;
+}
+
+static void CoinsCache_FillFlush(benchmark::State& state)
+{
+    const std::vector<COutPoint> outpoints = RandomOutpoints();
+    CCoinsView root;
+    CCoinsViewCache cache(&root);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < COINS_PER_FLUSH; i++)
+            cache.AddCoin(outpoints[i], Coin(CTxOut(i, CScript()), 1, false), false);
+        cache.Flush();
+    }
+}
+
+static void StdUnorderedMap_FillClear(benchmark::State& state)
+{
+    const std::vector<COutPoint> outpoints = RandomOutpoints();
+    while (state.KeepRunning()) {
+        std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> map;
+        for (int i = 0; i < COINS_PER_FLUSH; i++)
+            map.emplace(std::piecewise_construct, std::forward_as_tuple(outpoints[i]), std::forward_as_tuple(Coin(CTxOut(i, CScript()), 1, false)));
+    }
+}
+
+BENCHMARK(CoinsCache_FillFlush);
+BENCHMARK(StdUnorderedMap_FillClear);
@@ -0,0 +1,85 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "hash.h"
+#include "key.h"
+#include "primitives/transaction.h"
+#include "pubkey.h"
+#include "script/sigcache.h"
+#include "utilstrencodings.h"
+
+#include <boost/thread.hpp>
+
+// Signature cache contention, as seen by -par script check threads while
+// connecting a block: every thread verifies signatures that are already in the
+// cache (and marks them erasable, as block validation does). One iteration is
+// SIGCACHE_LOOKUPS cache hits on each of nThreads threads, so with perfect
+// scaling the time per iteration stays flat as threads are added.
+
+static const int SIGCACHE_ENTRIES = 1024;
+static const int SIGCACHE_LOOKUPS = 16384;
+
+struct CachedSignature
+{
+    CPubKey pubkey;
+    std::vector<unsigned char> vchSig;
+    uint256 hash;
+};
+
+static const std::vector<CachedSignature>& GetCachedSignatures()
+{
+    static std::vector<CachedSignature> sigs;
+    if (sigs.empty()) {
+        CTransaction txDummy;
+        CKey key;
+        key.MakeNewKey(true);
+        sigs.resize(SIGCACHE_ENTRIES);
+        for (int i = 0; i < SIGCACHE_ENTRIES; i++) {
+            sigs[i].pubkey = key.GetPubKey();
+            sigs[i].hash = Hash(BEGIN(i), END(i));
+            key.Sign(sigs[i].hash, sigs[i].vchSig);
+            // Verify once with storing enabled to get it into the cache
+            CachingTransactionSignatureChecker(&txDummy, 0, true).VerifySignature(sigs[i].vchSig, sigs[i].pubkey, sigs[i].hash);
+        }
+    }
+    return sigs;
+}
+
+static void LookupSignatures(const std::vector<CachedSignature>* sigs, int nOffset)
+{
+    CTransaction txDummy;
+    CachingTransactionSignatureChecker checker(&txDummy, 0, false);
+    for (int i = 0; i < SIGCACHE_LOOKUPS; i++) {
+        const CachedSignature& sig = (*sigs)[(nOffset + i) % SIGCACHE_ENTRIES];
+        checker.VerifySignature(sig.vchSig, sig.pubkey, sig.hash);
+    }
+}
+
+static void SigCacheContention(benchmark::State& state, int nThreads)
+{
+    ECCVerifyHandle verifyHandle;
+    const std::vector<CachedSignature>& sigs = GetCachedSignatures();
+    while (state.KeepRunning()) {
+        boost::thread_group threads;
+        for (int i = 0; i < nThreads; i++)
+            threads.create_thread(boost::bind(&LookupSignatures, &sigs, i * (SIGCACHE_ENTRIES / nThreads)));
+        threads.join_all();
+    }
+}
+
+static void SigCache_Contention_1(benchmark::State& state) { SigCacheContention(state, 1); }
+static void SigCache_Contention_2(benchmark::State& state) { SigCacheContention(state, 2); }
+static void SigCache_Contention_4(benchmark::State& state) { SigCacheContention(state, 4); }
+static void SigCache_Contention_8(benchmark::State& state) { SigCacheContention(state, 8); }
+static void SigCache_Contention_16(benchmark::State& state) { SigCacheContention(state, 16); }
+static void SigCache_Contention_32(benchmark::State& state) { SigCacheContention(state, 32); }
+
+BENCHMARK(SigCache_Contention_1);
+BENCHMARK(SigCache_Contention_2);
+BENCHMARK(SigCache_Contention_4);
+BENCHMARK(SigCache_Contention_8);
+BENCHMARK(SigCache_Contention_16);
+BENCHMARK(SigCache_Contention_32);
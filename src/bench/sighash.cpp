@@ -0,0 +1,56 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "primitives/transaction.h"
+#include "pubkey.h"
+#include "random.h"
+#include "script/interpreter.h"
+#include "script/standard.h"
+
+// Legacy SIGHASH_ALL signature hashes of every input of a 200-input
+// transaction (the size of a large PrivateSend mix or payout consolidation),
+// reserializing the transaction for each input versus starting from
+// PrecomputedTransactionData.
+
+static CMutableTransaction LargeTransaction(int nInputs)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(nInputs);
+    for (int i = 0; i < nInputs; i++) {
+        tx.vin[i].prevout = COutPoint(GetRandHash(), i);
+        tx.vin[i].scriptSig = CScript() << std::vector<unsigned char>(72) << std::vector<unsigned char>(33);
+    }
+    tx.vout.resize(nInputs);
+    for (int i = 0; i < nInputs; i++) {
+        tx.vout[i].nValue = 100000;
+        tx.vout[i].scriptPubKey = GetScriptForDestination(CKeyID(uint160(std::vector<unsigned char>(20, i))));
+    }
+    return tx;
+}
+
+static void SignatureHash_200Inputs(benchmark::State& state)
+{
+    CTransaction tx(LargeTransaction(200));
+    CScript scriptCode = tx.vout[0].scriptPubKey;
+    while (state.KeepRunning()) {
+        for (unsigned int i = 0; i < tx.vin.size(); i++)
+            SignatureHash(scriptCode, tx, i, SIGHASH_ALL);
+    }
+}
+
+static void SignatureHash_200Inputs_Precomputed(benchmark::State& state)
+{
+    CTransaction tx(LargeTransaction(200));
+    CScript scriptCode = tx.vout[0].scriptPubKey;
+    while (state.KeepRunning()) {
+        PrecomputedTransactionData txdata(tx);
+        for (unsigned int i = 0; i < tx.vin.size(); i++)
+            SignatureHash(scriptCode, tx, i, SIGHASH_ALL, &txdata);
+    }
+}
+
+BENCHMARK(SignatureHash_200Inputs);
+BENCHMARK(SignatureHash_200Inputs_Precomputed);
@@ -0,0 +1,256 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+
+#include "coins.h"
+#include "crypto/common.h"
+#include "hash.h"
+#include "primitives/block.h"
+#include "script/script.h"
+#include "streams.h"
+#include "undo.h"
+#include "version.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+/// Parameters of the basic filter, as in BIP 158
+static const uint8_t BASIC_FILTER_P = 19;
+static const uint32_t BASIC_FILTER_M = 784931;
+
+static const std::string strBasicFilterName = "basic";
+static const std::string strUnknownFilterName = "";
+
+/** Map x uniformly into [0, n), as the high 64 bits of the 128-bit product x * n */
+static uint64_t MapIntoRange(uint64_t x, uint64_t n)
+{
+#ifdef __SIZEOF_INT128__
+    return ((unsigned __int128)x * (unsigned __int128)n) >> 64;
+#else
+    uint64_t x_hi = x >> 32, x_lo = x & 0xFFFFFFFF;
+    uint64_t n_hi = n >> 32, n_lo = n & 0xFFFFFFFF;
+    uint64_t ac = x_hi * n_hi;
+    uint64_t ad = x_hi * n_lo;
+    uint64_t bc = x_lo * n_hi;
+    uint64_t bd = x_lo * n_lo;
+    uint64_t mid34 = (bd >> 32) + (bc & 0xFFFFFFFF) + (ad & 0xFFFFFFFF);
+    return ac + (bc >> 32) + (ad >> 32) + (mid34 >> 32);
+#endif
+}
+
+template<typename OStream>
+static void GolombRiceEncode(CBitStreamWriter<OStream>& bitwriter, uint8_t nP, uint64_t x)
+{
+    // The quotient is written in unary, as that many 1 bits followed by a 0
+    uint64_t q = x >> nP;
+    while (q > 0) {
+        int nBits = q <= 64 ? (int)q : 64;
+        bitwriter.Write(~0ULL, nBits);
+        q -= nBits;
+    }
+    bitwriter.Write(0, 1);
+
+    // The remainder is written in its lowest nP bits
+    bitwriter.Write(x, nP);
+}
+
+template<typename IStream>
+static uint64_t GolombRiceDecode(CBitStreamReader<IStream>& bitreader, uint8_t nP)
+{
+    uint64_t q = 0;
+    while (bitreader.Read(1) == 1)
+        q++;
+    uint64_t r = bitreader.Read(nP);
+    return (q << nP) + r;
+}
+
+CGCSFilter::CGCSFilter(const Params& paramsIn) :
+    params(paramsIn), nN(0), nF(0), vchEncoded(1, 0)
+{
+}
+
+CGCSFilter::CGCSFilter(const Params& paramsIn, const std::vector<unsigned char>& vchEncodedIn) :
+    params(paramsIn), vchEncoded(vchEncodedIn)
+{
+    CMemoryReader stream(vchEncoded.data(), vchEncoded.data() + vchEncoded.size(), SER_NETWORK, PROTOCOL_VERSION);
+
+    uint64_t nElements = ReadCompactSize(stream);
+    if (nElements > std::numeric_limits<uint32_t>::max())
+        throw std::ios_base::failure("N must be < 2^32");
+    nN = nElements;
+    nF = (uint64_t)nN * params.nM;
+
+    // Decode all elements to check that the filter is well formed
+    CBitStreamReader<CMemoryReader> bitreader(stream);
+    for (uint64_t i = 0; i < nN; i++)
+        GolombRiceDecode(bitreader, params.nP);
+    if (!stream.empty())
+        throw std::ios_base::failure("encoded filter contains excess data");
+}
+
+CGCSFilter::CGCSFilter(const Params& paramsIn, const ElementSet& elements) :
+    params(paramsIn)
+{
+    size_t nElements = elements.size();
+    if (nElements > std::numeric_limits<uint32_t>::max())
+        throw std::invalid_argument("N must be < 2^32");
+    nN = nElements;
+    nF = (uint64_t)nN * params.nM;
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(stream, nN);
+    {
+        CBitStreamWriter<CDataStream> bitwriter(stream);
+        uint64_t nLastValue = 0;
+        std::vector<uint64_t> vHashes = BuildHashedSet(elements);
+        for (std::vector<uint64_t>::const_iterator it = vHashes.begin(); it != vHashes.end(); it++) {
+            GolombRiceEncode(bitwriter, params.nP, *it - nLastValue);
+            nLastValue = *it;
+        }
+    }
+    vchEncoded.assign(stream.begin(), stream.end());
+}
+
+uint64_t CGCSFilter::HashToRange(const Element& element) const
+{
+    uint64_t nHash = CSipHasher(params.k0, params.k1).Write(element.data(), element.size()).Finalize();
+    return MapIntoRange(nHash, nF);
+}
+
+std::vector<uint64_t> CGCSFilter::BuildHashedSet(const ElementSet& elements) const
+{
+    std::vector<uint64_t> vHashes;
+    vHashes.reserve(elements.size());
+    for (ElementSet::const_iterator it = elements.begin(); it != elements.end(); it++)
+        vHashes.push_back(HashToRange(*it));
+    std::sort(vHashes.begin(), vHashes.end());
+    return vHashes;
+}
+
+bool CGCSFilter::MatchInternal(const uint64_t* pHashes, size_t nHashes) const
+{
+    CMemoryReader stream(vchEncoded.data(), vchEncoded.data() + vchEncoded.size(), SER_NETWORK, PROTOCOL_VERSION);
+
+    // The element count was checked when the filter was made
+    ReadCompactSize(stream);
+
+    // Walk the sorted queries and the sorted filter values side by side
+    CBitStreamReader<CMemoryReader> bitreader(stream);
+    uint64_t nValue = 0;
+    size_t nHashIndex = 0;
+    for (uint32_t i = 0; i < nN; i++) {
+        nValue += GolombRiceDecode(bitreader, params.nP);
+
+        while (true) {
+            if (nHashIndex == nHashes)
+                return false;
+            if (pHashes[nHashIndex] == nValue)
+                return true;
+            if (pHashes[nHashIndex] > nValue)
+                break;
+            nHashIndex++;
+        }
+    }
+    return false;
+}
+
+bool CGCSFilter::Match(const Element& element) const
+{
+    uint64_t nQuery = HashToRange(element);
+    return MatchInternal(&nQuery, 1);
+}
+
+bool CGCSFilter::MatchAny(const ElementSet& elements) const
+{
+    const std::vector<uint64_t> vQueries = BuildHashedSet(elements);
+    return !vQueries.empty() && MatchInternal(vQueries.data(), vQueries.size());
+}
+
+const std::string& BlockFilterTypeName(BlockFilterType filterType)
+{
+    switch (filterType) {
+    case BLOCK_FILTER_BASIC:
+        return strBasicFilterName;
+    default:
+        return strUnknownFilterName;
+    }
+}
+
+BlockFilterType BlockFilterTypeByName(const std::string& strName)
+{
+    if (strName == strBasicFilterName)
+        return BLOCK_FILTER_BASIC;
+    return BLOCK_FILTER_INVALID;
+}
+
+static CGCSFilter::ElementSet BasicFilterElements(const CBlock& block, const CBlockUndo& blockUndo)
+{
+    CGCSFilter::ElementSet elements;
+
+    for (std::vector<CTransaction>::const_iterator tx = block.vtx.begin(); tx != block.vtx.end(); tx++) {
+        for (std::vector<CTxOut>::const_iterator out = tx->vout.begin(); out != tx->vout.end(); out++) {
+            const CScript& script = out->scriptPubKey;
+            if (script.empty() || script[0] == OP_RETURN)
+                continue;
+            elements.insert(CGCSFilter::Element(script.begin(), script.end()));
+        }
+    }
+
+    for (std::vector<CTxUndo>::const_iterator txundo = blockUndo.vtxundo.begin(); txundo != blockUndo.vtxundo.end(); txundo++) {
+        for (std::vector<Coin>::const_iterator prevout = txundo->vprevout.begin(); prevout != txundo->vprevout.end(); prevout++) {
+            const CScript& script = prevout->out.scriptPubKey;
+            if (script.empty())
+                continue;
+            elements.insert(CGCSFilter::Element(script.begin(), script.end()));
+        }
+    }
+
+    return elements;
+}
+
+CBlockFilter::CBlockFilter(BlockFilterType filterTypeIn, const uint256& hashBlockIn, const std::vector<unsigned char>& vchFilter) :
+    filterType(filterTypeIn), hashBlock(hashBlockIn)
+{
+    CGCSFilter::Params params;
+    if (!BuildParams(params))
+        throw std::invalid_argument("unknown filter type");
+    filter = CGCSFilter(params, vchFilter);
+}
+
+CBlockFilter::CBlockFilter(BlockFilterType filterTypeIn, const CBlock& block, const CBlockUndo& blockUndo) :
+    filterType(filterTypeIn), hashBlock(block.GetHash())
+{
+    CGCSFilter::Params params;
+    if (!BuildParams(params))
+        throw std::invalid_argument("unknown filter type");
+    filter = CGCSFilter(params, BasicFilterElements(block, blockUndo));
+}
+
+bool CBlockFilter::BuildParams(CGCSFilter::Params& params) const
+{
+    switch (filterType) {
+    case BLOCK_FILTER_BASIC:
+        // The filter is keyed by the first 16 bytes of the block hash
+        params.k0 = ReadLE64(hashBlock.begin());
+        params.k1 = ReadLE64(hashBlock.begin() + 8);
+        params.nP = BASIC_FILTER_P;
+        params.nM = BASIC_FILTER_M;
+        return true;
+    default:
+        return false;
+    }
+}
+
+uint256 CBlockFilter::GetHash() const
+{
+    const std::vector<unsigned char>& vchFilter = GetEncodedFilter();
+    return Hash(vchFilter.begin(), vchFilter.end());
+}
+
+uint256 CBlockFilter::ComputeHeader(const uint256& prevHeader) const
+{
+    const uint256 hashFilter = GetHash();
+    return Hash(hashFilter.begin(), hashFilter.end(), prevHeader.begin(), prevHeader.end());
+}
@@ -0,0 +1,143 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILTER_H
+#define BITCOIN_BLOCKFILTER_H
+
+#include "serialize.h"
+#include "uint256.h"
+
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class CBlock;
+class CBlockUndo;
+
+/**
+ * Golomb-coded set (BIP 158): a compact probabilistic set of byte strings.
+ * Every element is hashed into [0, N * M), and the sorted hashes are stored
+ * as Golomb-Rice coded differences with parameter P. An element that is not
+ * in the set matches with a probability of about 1 / M.
+ */
+class CGCSFilter
+{
+public:
+    typedef std::vector<unsigned char> Element;
+    typedef std::set<Element> ElementSet;
+
+    struct Params
+    {
+        uint64_t k0; //!< SipHash key
+        uint64_t k1;
+        uint8_t nP;  //!< Golomb-Rice coding parameter
+        uint32_t nM; //!< Inverse false positive rate
+
+        Params(uint64_t k0In = 0, uint64_t k1In = 0, uint8_t nPIn = 0, uint32_t nMIn = 1) :
+            k0(k0In), k1(k1In), nP(nPIn), nM(nMIn) {}
+    };
+
+private:
+    Params params;
+    uint32_t nN; //!< Number of elements
+    uint64_t nF; //!< Range of the element hashes
+    std::vector<unsigned char> vchEncoded;
+
+    uint64_t HashToRange(const Element& element) const;
+    std::vector<uint64_t> BuildHashedSet(const ElementSet& elements) const;
+    bool MatchInternal(const uint64_t* pHashes, size_t nHashes) const;
+
+public:
+    explicit CGCSFilter(const Params& paramsIn = Params());
+
+    /** Take an encoded filter; throws std::ios_base::failure if it is malformed */
+    CGCSFilter(const Params& paramsIn, const std::vector<unsigned char>& vchEncodedIn);
+
+    CGCSFilter(const Params& paramsIn, const ElementSet& elements);
+
+    uint32_t GetN() const { return nN; }
+    const Params& GetParams() const { return params; }
+    const std::vector<unsigned char>& GetEncoded() const { return vchEncoded; }
+
+    /** Whether the element may be in the set */
+    bool Match(const Element& element) const;
+
+    /** Whether any of the elements may be in the set, in a single pass over the filter */
+    bool MatchAny(const ElementSet& elements) const;
+};
+
+enum BlockFilterType
+{
+    BLOCK_FILTER_BASIC = 0,
+    BLOCK_FILTER_INVALID = 255,
+};
+
+/** Name of a filter type for RPC and REST, or an empty string if unknown */
+const std::string& BlockFilterTypeName(BlockFilterType filterType);
+
+/** Filter type by name, BLOCK_FILTER_INVALID if unknown */
+BlockFilterType BlockFilterTypeByName(const std::string& strName);
+
+/**
+ * The filter of a block. The basic filter holds every output script of the
+ * block and the script of every output it spends, except empty and
+ * OP_RETURN scripts, so that a wallet can skip blocks that pay none of its
+ * scripts and spend none of its coins.
+ */
+class CBlockFilter
+{
+private:
+    BlockFilterType filterType;
+    uint256 hashBlock;
+    CGCSFilter filter;
+
+    bool BuildParams(CGCSFilter::Params& params) const;
+
+public:
+    CBlockFilter() : filterType(BLOCK_FILTER_INVALID) {}
+
+    /** Take an encoded filter; throws std::ios_base::failure if it is malformed */
+    CBlockFilter(BlockFilterType filterTypeIn, const uint256& hashBlockIn, const std::vector<unsigned char>& vchFilter);
+
+    /** Compute the filter of a block from the block and its undo data */
+    CBlockFilter(BlockFilterType filterTypeIn, const CBlock& block, const CBlockUndo& blockUndo);
+
+    BlockFilterType GetFilterType() const { return filterType; }
+    const uint256& GetBlockHash() const { return hashBlock; }
+    const CGCSFilter& GetFilter() const { return filter; }
+    const std::vector<unsigned char>& GetEncodedFilter() const { return filter.GetEncoded(); }
+
+    /** Hash of the encoded filter */
+    uint256 GetHash() const;
+
+    /** Filter header, committing to this filter and the headers of all filters before it */
+    uint256 ComputeHeader(const uint256& prevHeader) const;
+
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        ser_writedata8(s, filterType);
+        ::Serialize(s, hashBlock, nType, nVersion);
+        ::Serialize(s, filter.GetEncoded(), nType, nVersion);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        std::vector<unsigned char> vchFilter;
+        filterType = (BlockFilterType)ser_readdata8(s);
+        ::Unserialize(s, hashBlock, nType, nVersion);
+        ::Unserialize(s, vchFilter, nType, nVersion);
+
+        CGCSFilter::Params params;
+        if (!BuildParams(params))
+            throw std::ios_base::failure("unknown filter type");
+        filter = CGCSFilter(params, vchFilter);
+    }
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 1 + ::GetSerializeSize(hashBlock, nType, nVersion) + ::GetSerializeSize(filter.GetEncoded(), nType, nVersion);
+    }
+};
+
+#endif // BITCOIN_BLOCKFILTER_H
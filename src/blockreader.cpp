@@ -0,0 +1,122 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockreader.h"
+
+#include "crypto/common.h"
+#include "util.h"
+#include "validation.h"
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CBlockFileMapping::~CBlockFileMapping()
+{
+#ifndef WIN32
+    munmap((void*)pdata, nSize);
+#endif
+}
+
+CBlockFileReader::CBlockFileReader(unsigned int nMaxFilesIn) : nMaxFiles(std::max(nMaxFilesIn, 1U)), nUseCounter(0) {}
+
+CBlockFileReader::CMappedFile* CBlockFileReader::MapFile(int nFile)
+{
+    AssertLockHeld(cs);
+    mapFiles.erase(nFile);
+#ifdef WIN32
+    return NULL;
+#else
+    boost::filesystem::path path = GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk");
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1) {
+        LogPrintf("%s: cannot open %s\n", __func__, path.string());
+        return NULL;
+    }
+    struct stat st;
+    void* pdata = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        pdata = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (pdata == MAP_FAILED) {
+        LogPrintf("%s: cannot map %s\n", __func__, path.string());
+        return NULL;
+    }
+    madvise(pdata, st.st_size, MADV_RANDOM);
+
+    if (mapFiles.size() >= nMaxFiles) {
+        std::map<int, CMappedFile>::iterator itOldest = mapFiles.begin();
+        for (std::map<int, CMappedFile>::iterator it = mapFiles.begin(); it != mapFiles.end(); ++it) {
+            if (it->second.nLastUse < itOldest->second.nLastUse)
+                itOldest = it;
+        }
+        mapFiles.erase(itOldest);
+    }
+    CMappedFile& file = mapFiles[nFile];
+    file.mapping = std::make_shared<const CBlockFileMapping>((const unsigned char*)pdata, st.st_size);
+    file.nNextPos = 0;
+    file.nReadAheadEnd = 0;
+    return &file;
+#endif
+}
+
+void CBlockFileReader::ReadAhead(CMappedFile& file, size_t nPos)
+{
+#ifndef WIN32
+    // Ask for the next chunk while half of the previous one is still ahead
+    if (nPos + BLOCK_READAHEAD_SIZE / 2 < file.nReadAheadEnd)
+        return;
+    static const size_t nPageSize = sysconf(_SC_PAGESIZE);
+    size_t nStart = std::max(nPos, file.nReadAheadEnd) / nPageSize * nPageSize;
+    size_t nEnd = std::min(nPos + BLOCK_READAHEAD_SIZE, file.mapping->nSize);
+    if (nStart < nEnd)
+        madvise((void*)(file.mapping->pdata + nStart), nEnd - nStart, MADV_WILLNEED);
+    file.nReadAheadEnd = nEnd;
+#endif
+}
+
+//! Get the size of the block at nPos, if it ends inside the mapping
+static bool GetBlockSize(const CBlockFileMapping& mapping, unsigned int nPos, unsigned int& nSize)
+{
+    if (mapping.nSize < nPos)
+        return false;
+    nSize = ReadLE32(mapping.pdata + nPos - 4);
+    return (uint64_t)nPos + nSize <= mapping.nSize;
+}
+
+bool CBlockFileReader::ReadBlock(const CDiskBlockPos& pos, CBlockSpan& span)
+{
+    if (pos.IsNull() || pos.nPos < 8)
+        return error("%s: invalid position %s", __func__, pos.ToString());
+
+    LOCK(cs);
+    std::map<int, CMappedFile>::iterator it = mapFiles.find(pos.nFile);
+    CMappedFile* file = it == mapFiles.end() ? NULL : &it->second;
+    unsigned int nSize = 0;
+    // The block may have been appended since the file was mapped
+    if (file == NULL || !GetBlockSize(*file->mapping, pos.nPos, nSize)) {
+        file = MapFile(pos.nFile);
+        if (file == NULL)
+            return error("%s: cannot map the block file of %s", __func__, pos.ToString());
+        if (!GetBlockSize(*file->mapping, pos.nPos, nSize))
+            return error("%s: block at %s is beyond the end of its file", __func__, pos.ToString());
+    }
+
+    // Blocks are stored back to back, each after its message start and size
+    file->nLastUse = ++nUseCounter;
+    if (file->nNextPos != 0 && pos.nPos >= file->nNextPos && pos.nPos - file->nNextPos <= 8)
+        ReadAhead(*file, pos.nPos + nSize);
+    file->nNextPos = pos.nPos + nSize;
+    span = CBlockSpan(file->mapping, file->mapping->pdata + pos.nPos, nSize);
+    return true;
+}
+
+void CBlockFileReader::CloseFile(int nFile)
+{
+    LOCK(cs);
+    mapFiles.erase(nFile);
+}
@@ -0,0 +1,95 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKREADER_H
+#define BITCOIN_BLOCKREADER_H
+
+#include "chain.h"
+#include "sync.h"
+
+#include <map>
+#include <memory>
+#include <stdint.h>
+
+/** Default for -blockmmap */
+static const bool DEFAULT_BLOCK_MMAP = false;
+/** Number of block files kept mapped at the same time */
+static const unsigned int MAX_MAPPED_BLOCK_FILES = 32;
+/** How far ahead of a sequential reader block data is requested from disk */
+static const unsigned int BLOCK_READAHEAD_SIZE = 0x1000000; // 16 MiB
+
+/** A read-only memory mapping of a whole block file */
+class CBlockFileMapping
+{
+private:
+    CBlockFileMapping(const CBlockFileMapping&);
+    CBlockFileMapping& operator=(const CBlockFileMapping&);
+
+public:
+    const unsigned char* const pdata;
+    const size_t nSize;
+
+    CBlockFileMapping(const unsigned char* pdataIn, size_t nSizeIn) : pdata(pdataIn), nSize(nSizeIn) {}
+    ~CBlockFileMapping();
+};
+
+/** The serialized bytes of a block in a mapped block file, which stays mapped while this is held */
+class CBlockSpan
+{
+private:
+    std::shared_ptr<const CBlockFileMapping> mapping;
+    const unsigned char* pbegin;
+    size_t nSize;
+
+public:
+    CBlockSpan() : pbegin(NULL), nSize(0) {}
+    CBlockSpan(const std::shared_ptr<const CBlockFileMapping>& mappingIn, const unsigned char* pbeginIn, size_t nSizeIn) :
+        mapping(mappingIn), pbegin(pbeginIn), nSize(nSizeIn) {}
+
+    const unsigned char* begin() const { return pbegin; }
+    const unsigned char* end() const { return pbegin + nSize; }
+    size_t size() const { return nSize; }
+    bool empty() const { return nSize == 0; }
+};
+
+/**
+ * Reads blocks straight from memory-mapped block files (blk?????.dat).
+ * Mappings are cached and reused, evicting the least recently used file,
+ * so a read costs no open, seek or read system calls. Files are mapped for
+ * random access, which keeps single transaction lookups from faulting in
+ * their neighbourhood; once the reads of a file move forward through it, as
+ * in rescans and reindexing, the data ahead of them is requested early.
+ */
+class CBlockFileReader
+{
+private:
+    struct CMappedFile
+    {
+        std::shared_ptr<const CBlockFileMapping> mapping;
+        uint64_t nLastUse;
+        //! End of the last block read, to recognize sequential reads
+        unsigned int nNextPos;
+        //! End of the range requested ahead of a sequential reader
+        size_t nReadAheadEnd;
+    };
+
+    CCriticalSection cs;
+    std::map<int, CMappedFile> mapFiles;
+    unsigned int nMaxFiles;
+    uint64_t nUseCounter;
+
+    //! Map the current contents of a block file, replacing any older mapping of it
+    CMappedFile* MapFile(int nFile);
+    void ReadAhead(CMappedFile& file, size_t nPos);
+
+public:
+    CBlockFileReader(unsigned int nMaxFilesIn = MAX_MAPPED_BLOCK_FILES);
+
+    //! Get the serialized block at pos, as written by WriteBlockToDisk
+    bool ReadBlock(const CDiskBlockPos& pos, CBlockSpan& span);
+    //! Drop the mapping of a block file, before it is truncated or deleted
+    void CloseFile(int nFile);
+};
+
+#endif // BITCOIN_BLOCKREADER_H
@@ -375,6 +375,12 @@ public:
             0,
             0
         };
+
+        // UTXO snapshot of the chain that utxosnapshot_tests builds: 15 blocks
+        // at a fixed mock time, all paying to OP_TRUE
+        mapAssumeutxo[uint256S("0x24ab35430ffefd095f93b42e47863c31a8e82425ccfd768460e6591bdf1b197a")] =
+            {15, uint256S("0x1d1cb87b0f4255e497e08b04536ec468f2fc70062b984396f4c235eed05a43e1"), 16};
+
         // Regtest MANO addresses start with 'y'
         base58Prefixes[PUBKEY_ADDRESS] = std::vector<unsigned char>(1,111);
         // Regtest MANO script addresses start with '8' or '9'
@@ -32,6 +32,17 @@ struct CCheckpointData {
     double fTransactionsPerDay;
 };
 
+/** Expected contents of a UTXO snapshot taken at a given block */
+struct CAssumeutxoData {
+    int nHeight;
+    //! hash_serialized of gettxoutsetinfo at that block
+    uint256 hashSerialized;
+    //! Number of transactions in the chain up to and including that block
+    unsigned int nChainTx;
+};
+
+typedef std::map<uint256, CAssumeutxoData> MapAssumeutxo;
+
 /**
  * CChainParams defines various tweakable parameters of a given instance of the
  * MANO system. There are three: the main network on which people trade goods
@@ -78,6 +89,8 @@ public:
     int ExtCoinType() const { return nExtCoinType; }
     const std::vector<SeedSpec6>& FixedSeeds() const { return vFixedSeeds; }
     const CCheckpointData& Checkpoints() const { return checkpointData; }
+    /** UTXO snapshots that may be loaded, by block hash */
+    const MapAssumeutxo& Assumeutxo() const { return mapAssumeutxo; }
     int PoolMaxTransactions() const { return nPoolMaxTransactions; }
     int FulfilledRequestExpireTime() const { return nFulfilledRequestExpireTime; }
     std::string SporkPubKey() const { return strSporkPubKey; }
@@ -104,6 +117,7 @@ protected:
     bool fMineBlocksOnDemand;
     bool fTestnetToBeDeprecatedFieldRPC;
     CCheckpointData checkpointData;
+    MapAssumeutxo mapAssumeutxo;
     int nPoolMaxTransactions;
     int nFulfilledRequestExpireTime;
     std::string strSporkPubKey;
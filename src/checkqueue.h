@@ -1,4 +1,5 @@
 // Copyright (c) 2012-2015 The Bitcoin Core developers
+// Copyright (c) 2018 The MANO Coin Core developers
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
@@ -6,6 +7,10 @@
 #define BITCOIN_CHECKQUEUE_H
 
 #include <algorithm>
+#include <assert.h>
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <vector>
 
 #include <boost/foreach.hpp>
@@ -16,21 +21,47 @@
 template <typename T>
 class CCheckQueueControl;
 
-/** 
+/**
  * Queue for verifications that have to be performed.
   * The verifications are represented by a type T, which must provide an
-  * operator(), returning a bool.
+  * operator(), returning a bool, a default constructor and swap().
   *
   * One thread (the master) is assumed to push batches of verifications
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Nothing in here is specific to one kind of check, so any verification
+  * that can be split into independent closures (scripts, header hashes,
+  * signatures of network messages) can get its own queue and threads.
+  *
+  * Work is spread over one deque per worker (the master has its own), so
+  * that workers mostly take jobs from their own deque under their own
+  * lock. A worker whose deque is empty steals half of another one's.
+  * Batches adapt to the remaining work: a worker takes half of its deque
+  * (at most nBatchSize), so batches shrink as the deques drain and the
+  * last jobs remain available for stealing by idle workers.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
+    //! Jobs waiting to be picked up by one worker, taken from the back by
+    //! their owner and from the front by thieves
+    struct WorkerQueue
+    {
+        boost::mutex mutex;
+        std::deque<T> jobs;
+    };
+
+    //! Upper bound on the number of workers (including the master) with their own deque
+    static const int MAX_WORKERS = 64;
+
+    //! Deques of all workers; slot 0 belongs to the master. Allocated up
+    //! front so that registering a worker never moves them.
+    std::vector<std::unique_ptr<WorkerQueue> > queues;
+
+    //! Mutex protecting fQuit and the waits on the condition variables
     boost::mutex mutex;
 
     //! Worker threads block on this when out of work
@@ -39,25 +70,21 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
+    //! Number of worker threads that registered a deque (not counting the master)
+    std::atomic<int> nWorkers;
 
-    //! The number of workers (including the master) that are idle.
-    int nIdle;
-
-    //! The total number of workers (including the master).
-    int nTotal;
+    //! Bumped by every Add(), so workers notice new work between scanning and sleeping
+    std::atomic<unsigned int> nGeneration;
 
     //! The temporary evaluation result.
-    bool fAllOk;
+    std::atomic<bool> fAllOk;
 
     /**
      * Number of verifications that haven't completed yet.
      * This includes elements that are no longer queued, but still in the
      * worker's own batches.
      */
-    unsigned int nTodo;
+    std::atomic<unsigned int> nTodo;
 
     //! Whether we're shutting down.
     bool fQuit;
@@ -65,70 +92,105 @@ private:
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    //! Deque the next Add() starts distributing at, so that small additions rotate over the workers
+    unsigned int nNextQueue;
+
+    /** Move a batch of jobs from the worker's own deque into vChecks; returns false if it is empty. */
+    bool TakeOwn(int nSelf, std::vector<T>& vChecks)
+    {
+        WorkerQueue& own = *queues[nSelf];
+        boost::unique_lock<boost::mutex> lock(own.mutex);
+        if (own.jobs.empty())
+            return false;
+        unsigned int nNow = std::max(1U, std::min(nBatchSize, (unsigned int)own.jobs.size() / 2));
+        vChecks.resize(nNow);
+        for (unsigned int i = 0; i < nNow; i++) {
+            vChecks[i].swap(own.jobs.back());
+            own.jobs.pop_back();
+        }
+        return true;
+    }
+
+    /** Move half of the first non-empty other deque into the worker's own one; returns false if all are empty. */
+    bool Steal(int nSelf, int nSlots)
+    {
+        std::deque<T> stolen;
+        for (int i = 1; i < nSlots && stolen.empty(); i++) {
+            WorkerQueue& victim = *queues[(nSelf + i) % nSlots];
+            boost::unique_lock<boost::mutex> lock(victim.mutex);
+            size_t nSteal = (victim.jobs.size() + 1) / 2;
+            for (size_t j = 0; j < nSteal; j++) {
+                stolen.push_back(T());
+                stolen.back().swap(victim.jobs.front());
+                victim.jobs.pop_front();
+            }
+        }
+        if (stolen.empty())
+            return false;
+        WorkerQueue& own = *queues[nSelf];
+        boost::unique_lock<boost::mutex> lock(own.mutex);
+        BOOST_FOREACH (T& check, stolen) {
+            own.jobs.push_back(T());
+            own.jobs.back().swap(check);
+        }
+        return true;
+    }
+
     /** Internal function that does bulk of the verification work. */
     bool Loop(bool fMaster = false)
     {
         boost::condition_variable& cond = fMaster ? condMaster : condWorker;
+        // Workers beyond MAX_WORKERS share deques, which is correct, just slower
+        int nSelf = fMaster ? 0 : 1 + nWorkers++ % (MAX_WORKERS - 1);
         std::vector<T> vChecks;
         vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
         do {
-            {
-                boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master it can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
-                }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if ((fMaster || fQuit) && nTodo == 0) {
-                        nTotal--;
-                        bool fRet = fAllOk;
-                        // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
-                        // return the current status
-                        return fRet;
-                    }
-                    nIdle++;
-                    cond.wait(lock); // wait
-                    nIdle--;
-                }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
+            unsigned int nGenerationSeen = nGeneration.load();
+            int nSlots = std::min(nWorkers.load() + 1, MAX_WORKERS);
+            if (TakeOwn(nSelf, vChecks) || (Steal(nSelf, nSlots) && TakeOwn(nSelf, vChecks))) {
+                // Once a check failed the rest only needs to be drained
+                bool fOk = fAllOk.load();
+                BOOST_FOREACH (T& check, vChecks)
+                    if (fOk)
+                        fOk = check();
+                if (!fOk)
+                    fAllOk = false;
+                unsigned int nNow = vChecks.size();
+                vChecks.clear();
+                if (nTodo.fetch_sub(nNow) == nNow && !fMaster) {
+                    // We processed the last element; inform the master it can exit and return the result
+                    boost::unique_lock<boost::mutex> lock(mutex);
+                    condMaster.notify_one();
                 }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
+                continue;
             }
-            // execute work
-            BOOST_FOREACH (T& check, vChecks)
-                if (fOk)
-                    fOk = check();
-            vChecks.clear();
+
+            // No work anywhere: finish, or sleep until more is added
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if ((fMaster || fQuit) && nTodo == 0) {
+                bool fRet = fAllOk;
+                // reset the status for new work later
+                if (fMaster)
+                    fAllOk = true;
+                // return the current status
+                return fRet;
+            }
+            if (nGeneration.load() != nGenerationSeen)
+                continue;
+            // The master may also find nothing to do while other workers
+            // finish their batches; it is woken up by the last one.
+            cond.wait(lock); // wait
         } while (true);
     }
 
 public:
     //! Create a new check queue
-    CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), fQuit(false), nBatchSize(nBatchSizeIn) {}
+    CCheckQueue(unsigned int nBatchSizeIn) : nWorkers(0), nGeneration(0), fAllOk(true), nTodo(0), fQuit(false), nBatchSize(nBatchSizeIn), nNextQueue(0)
+    {
+        queues.reserve(MAX_WORKERS);
+        for (int i = 0; i < MAX_WORKERS; i++)
+            queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+    }
 
     //! Worker thread
     void Thread()
@@ -145,15 +207,30 @@ public:
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        BOOST_FOREACH (T& check, vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
-        }
+        if (vChecks.empty())
+            return;
+        // Count the jobs before they become visible, so that no worker can
+        // see nTodo drop to zero while some of them are still queued
         nTodo += vChecks.size();
+
+        int nSlots = std::min(nWorkers.load() + 1, MAX_WORKERS);
+        // Hand out contiguous chunks, one per deque, starting where the
+        // previous call left off
+        unsigned int nChunk = (vChecks.size() + nSlots - 1) / nSlots;
+        for (unsigned int nStart = 0; nStart < vChecks.size(); nStart += nChunk) {
+            WorkerQueue& target = *queues[nNextQueue++ % nSlots];
+            boost::unique_lock<boost::mutex> lock(target.mutex);
+            for (unsigned int i = nStart; i < std::min<size_t>(nStart + nChunk, vChecks.size()); i++) {
+                target.jobs.push_back(T());
+                vChecks[i].swap(target.jobs.back());
+            }
+        }
+
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nGeneration++;
         if (vChecks.size() == 1)
             condWorker.notify_one();
-        else if (vChecks.size() > 1)
+        else
             condWorker.notify_all();
     }
 
@@ -161,15 +238,15 @@ public:
     {
     }
 
+    //! Whether no verifications are pending (workers may still be scanning empty deques)
     bool IsIdle()
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        return (nTotal == nIdle && nTodo == 0 && fAllOk == true);
+        return (nTodo == 0 && fAllOk == true);
     }
 
 };
 
-/** 
+/**
  * RAII-style controller object for a CCheckQueue that guarantees the passed
  * queue is finished before continuing.
  */
@@ -21,6 +21,16 @@ bool CCoinsView::HaveCoin(const COutPoint &outpoint) const
     return GetCoin(outpoint, coin);
 }
 
+bool CCoinsView::BatchWriteKeep(const CCoinsMap &mapCoins, const uint256 &hashBlock)
+{
+    CCoinsMapMemoryResource resource;
+    CCoinsMap mapCopy(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), &resource);
+    mapCopy.reserve(mapCoins.size());
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); ++it)
+        mapCopy.insert(*it);
+    return BatchWrite(mapCopy, hashBlock);
+}
+
 CCoinsViewBacked::CCoinsViewBacked(CCoinsView *viewIn) : base(viewIn) { }
 bool CCoinsViewBacked::GetCoin(const COutPoint &outpoint, Coin &coin) const { return base->GetCoin(outpoint, coin); }
 bool CCoinsViewBacked::HaveCoin(const COutPoint &outpoint) const { return base->HaveCoin(outpoint); }
@@ -32,7 +42,7 @@ size_t CCoinsViewBacked::EstimateSize() const { return base->EstimateSize(); }
 
 SaltedOutpointHasher::SaltedOutpointHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
-CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), cachedCoinsUsage(0) {}
+CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), cacheCoins(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), &cacheCoinsMemoryResource), cachedCoinsUsage(0) {}
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
     return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage;
@@ -202,9 +212,74 @@ bool CCoinsViewCache::Flush() {
     bool fOk = base->BatchWrite(cacheCoins, hashBlock);
     cacheCoins.clear();
     cachedCoinsUsage = 0;
+    ReallocateCache();
     return fOk;
 }
 
+void CCoinsViewCache::TakeChanges(CCoinsMap& mapOut, size_t nKeepUsage)
+{
+    // Modified entries are recognized by being in mapOut below
+    assert(mapOut.empty());
+    // Node and bucket overhead per entry, on top of the coins' own usage
+    size_t nEntryUsage = cacheCoins.empty() ? 0 : memusage::DynamicUsage(cacheCoins) / cacheCoins.size();
+    size_t nModifiedUsage = 0, nModified = 0;
+    size_t nCleanUsage = 0, nClean = 0;
+    for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end(); ) {
+        if (!(it->second.flags & CCoinsCacheEntry::DIRTY)) {
+            nCleanUsage += it->second.coin.DynamicMemoryUsage();
+            nClean++;
+            ++it;
+            continue;
+        }
+        if (it->second.coin.IsSpent()) {
+            cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+            mapOut.emplace(it->first, std::move(it->second));
+            cacheCoins.erase(it++);
+            continue;
+        }
+        mapOut.emplace(it->first, it->second);
+        // The base has it once mapOut is written
+        it->second.flags = 0;
+        nModifiedUsage += it->second.coin.DynamicMemoryUsage();
+        nModified++;
+        ++it;
+    }
+
+    bool fKeepModified = nModifiedUsage + nModified * nEntryUsage <= nKeepUsage;
+    bool fKeepClean = fKeepModified && nModifiedUsage + nCleanUsage + (nModified + nClean) * nEntryUsage <= nKeepUsage;
+    if (fKeepClean)
+        return;
+
+    // Rebuild the cache around the entries that are kept, so that the memory
+    // of the dropped ones is returned instead of held for reuse
+    std::vector<std::pair<COutPoint, Coin> > vKept;
+    if (fKeepModified) {
+        vKept.reserve(nModified);
+        for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end(); ++it) {
+            if (mapOut.count(it->first))
+                vKept.push_back(std::make_pair(it->first, std::move(it->second.coin)));
+        }
+    }
+    cacheCoins.clear();
+    cachedCoinsUsage = 0;
+    ReallocateCache();
+    for (size_t i = 0; i < vKept.size(); i++) {
+        CCoinsMap::iterator it = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(vKept[i].first), std::forward_as_tuple(std::move(vKept[i].second))).first;
+        cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
+    }
+}
+
+void CCoinsViewCache::ReallocateCache()
+{
+    // Destroying the map before its memory resource is safe, as the map
+    // only needs the resource while it still holds nodes.
+    assert(cacheCoins.empty());
+    cacheCoins.~CCoinsMap();
+    cacheCoinsMemoryResource.~CCoinsMapMemoryResource();
+    ::new (&cacheCoinsMemoryResource) CCoinsMapMemoryResource();
+    ::new (&cacheCoins) CCoinsMap(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), &cacheCoinsMemoryResource);
+}
+
 void CCoinsViewCache::Uncache(const COutPoint& hash)
 {
     CCoinsMap::iterator it = cacheCoins.find(hash);
@@ -11,6 +11,7 @@
 #include "hash.h"
 #include "memusage.h"
 #include "serialize.h"
+#include "support/allocators/pool.h"
 #include "uint256.h"
 
 #include <assert.h>
@@ -119,7 +120,22 @@ struct CCoinsCacheEntry
     explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+/**
+ * The coins cache allocates its nodes from a pool, avoiding a malloc (and its
+ * overhead) per coin and making DynamicMemoryUsage() exact. The node layout of
+ * std::unordered_map is implementation defined; it adds a next pointer and
+ * sometimes the cached hash to the value, so allowing 4 extra pointers covers
+ * the nodes of all common implementations.
+ */
+typedef PoolResource<sizeof(std::pair<const COutPoint, CCoinsCacheEntry>) + sizeof(void*) * 4, alignof(void*)> CCoinsMapMemoryResource;
+typedef std::unordered_map<COutPoint,
+                           CCoinsCacheEntry,
+                           SaltedOutpointHasher,
+                           std::equal_to<COutPoint>,
+                           PoolAllocator<std::pair<const COutPoint, CCoinsCacheEntry>,
+                                         sizeof(std::pair<const COutPoint, CCoinsCacheEntry>) + sizeof(void*) * 4,
+                                         alignof(void*)> >
+    CCoinsMap;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -162,6 +178,10 @@ public:
     //! The passed mapCoins can be modified.
     virtual bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
 
+    //! Do the same bulk modification without modifying mapCoins, so that other
+    //! threads can keep reading it. Views that consume the map write a copy of it.
+    virtual bool BatchWriteKeep(const CCoinsMap &mapCoins, const uint256 &hashBlock);
+
     //! Get a cursor to iterate over the whole state
     virtual CCoinsViewCursor *Cursor() const;
 
@@ -200,6 +220,8 @@ protected:
      * declared as "const".  
      */
     mutable uint256 hashBlock;
+    //! Memory for the nodes of cacheCoins, released in one go after a flush
+    mutable CCoinsMapMemoryResource cacheCoinsMemoryResource;
     mutable CCoinsMap cacheCoins;
 
     /* Cached dynamic memory usage for the inner Coin objects. */
@@ -257,6 +279,20 @@ public:
      */
     bool Flush();
 
+    /**
+     * Move the modifications applied to this cache into mapOut, as Flush()
+     * would write them to the base, but keep coins cached where possible:
+     * unspent coins that were modified stay as unmodified entries, then the
+     * entries that were already unmodified, as long as all of them fit in
+     * nKeepUsage bytes (in that order; if the modified ones alone do not fit,
+     * nothing is kept). Spent entries are dropped.
+     *
+     * mapOut must be empty. Afterwards the cache is only consistent with a
+     * base that has received mapOut, so until it is written the caller must
+     * make sure that reads from the base see it.
+     */
+    void TakeChanges(CCoinsMap& mapOut, size_t nKeepUsage);
+
     /**
      * Removes the UTXO with the given outpoint from the cache, if it is
      * not modified.
@@ -289,6 +325,12 @@ public:
      */
     double GetPriority(const CTransaction &tx, int nHeight, CAmount &inChainInputValue) const;
 
+    /**
+     * Replace the (empty) cache with a new one, returning the memory of the
+     * old one to the system instead of keeping it for reuse.
+     */
+    void ReallocateCache();
+
 private:
     CCoinsMap::iterator FetchCoin(const COutPoint &outpoint) const;
 
@@ -0,0 +1,184 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coinsprefetch.h"
+
+#include "clientversion.h"
+#include "primitives/block.h"
+#include "streams.h"
+#include "util.h"
+#include "validation.h"
+
+#include <algorithm>
+#include <set>
+
+#include <boost/foreach.hpp>
+#include <boost/thread.hpp>
+
+//! Number of recently queued blocks remembered to skip duplicates (ActivateBestChainStep looks 32 ahead)
+static const size_t PREFETCH_RECENT_BLOCKS = 64;
+
+/** Collect the outpoints spent by the block at pos that it does not create itself. */
+static bool ReadBlockInputs(const CDiskBlockPos& pos, std::vector<COutPoint>& outpoints)
+{
+    CBlock block;
+    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return false;
+    try {
+        filein >> block;
+    } catch (const std::exception&) {
+        // Not fatal here: ConnectTip reads the block again and reports the error
+        return false;
+    }
+
+    std::set<uint256> setBlockTxids;
+    BOOST_FOREACH(const CTransaction& tx, block.vtx)
+        setBlockTxids.insert(tx.GetHash());
+    BOOST_FOREACH(const CTransaction& tx, block.vtx) {
+        if (tx.IsCoinBase())
+            continue;
+        BOOST_FOREACH(const CTxIn& txin, tx.vin) {
+            if (!setBlockTxids.count(txin.prevout.hash))
+                outpoints.push_back(txin.prevout);
+        }
+    }
+    return true;
+}
+
+CCoinsViewPrefetch::CCoinsViewPrefetch(CCoinsView* viewIn) : CCoinsViewBacked(viewIn), nGeneration(0), nWorkers(0) {}
+
+bool CCoinsViewPrefetch::GetCoin(const COutPoint& outpoint, Coin& coin) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        std::unordered_map<COutPoint, Coin, SaltedOutpointHasher>::iterator it = mapStaged.find(outpoint);
+        if (it != mapStaged.end()) {
+            // The cache above keeps it from now on
+            coin = std::move(it->second);
+            mapStaged.erase(it);
+            return true;
+        }
+    }
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewPrefetch::HaveCoin(const COutPoint& outpoint) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (mapStaged.count(outpoint))
+            return true;
+    }
+    return base->HaveCoin(outpoint);
+}
+
+void CCoinsViewPrefetch::Invalidate()
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    nGeneration++;
+    mapStaged.clear();
+}
+
+bool CCoinsViewPrefetch::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
+{
+    // Lookups that overlap with the write may see either state, so drop
+    // everything read before it ends
+    Invalidate();
+    bool fOk = base->BatchWrite(mapCoins, hashBlock);
+    Invalidate();
+    return fOk;
+}
+
+bool CCoinsViewPrefetch::BatchWriteKeep(const CCoinsMap& mapCoins, const uint256& hashBlock)
+{
+    Invalidate();
+    bool fOk = base->BatchWriteKeep(mapCoins, hashBlock);
+    Invalidate();
+    return fOk;
+}
+
+void CCoinsViewPrefetch::QueueCoins(const std::vector<COutPoint>& outpoints)
+{
+    // Batches go in front of any queued blocks, so the inputs of the next
+    // block are loaded before the block after it is read
+    for (size_t nEnd = outpoints.size(); nEnd > 0; ) {
+        size_t nStart = nEnd > PREFETCH_BATCH_SIZE ? nEnd - PREFETCH_BATCH_SIZE : 0;
+        queue.push_front(PrefetchJob());
+        queue.front().outpoints.assign(outpoints.begin() + nStart, outpoints.begin() + nEnd);
+        nEnd = nStart;
+    }
+    cond.notify_all();
+}
+
+void CCoinsViewPrefetch::PrefetchBlock(const CDiskBlockPos& pos)
+{
+    if (nWorkers == 0 || pos.IsNull())
+        return;
+    boost::unique_lock<boost::mutex> lock(cs);
+    if (std::find(recentBlocks.begin(), recentBlocks.end(), pos) != recentBlocks.end())
+        return;
+    recentBlocks.push_back(pos);
+    if (recentBlocks.size() > PREFETCH_RECENT_BLOCKS)
+        recentBlocks.pop_front();
+    queue.push_back(PrefetchJob());
+    queue.back().pos = pos;
+    cond.notify_one();
+}
+
+void CCoinsViewPrefetch::PrefetchCoins(const std::vector<COutPoint>& outpoints)
+{
+    if (nWorkers == 0 || outpoints.empty())
+        return;
+    boost::unique_lock<boost::mutex> lock(cs);
+    QueueCoins(outpoints);
+}
+
+size_t CCoinsViewPrefetch::GetStagedCount() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    return mapStaged.size();
+}
+
+void CCoinsViewPrefetch::ThreadPrefetch()
+{
+    RenameThread("mano-prefetch");
+    nWorkers++;
+    while (true) {
+        boost::this_thread::interruption_point();
+
+        PrefetchJob job;
+        unsigned int nGenerationSeen;
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            while (queue.empty())
+                cond.wait(lock);
+            job = std::move(queue.front());
+            queue.pop_front();
+            nGenerationSeen = nGeneration;
+        }
+
+        if (!job.pos.IsNull()) {
+            std::vector<COutPoint> outpoints;
+            if (ReadBlockInputs(job.pos, outpoints)) {
+                boost::unique_lock<boost::mutex> lock(cs);
+                QueueCoins(outpoints);
+            }
+            continue;
+        }
+
+        std::vector<std::pair<COutPoint, Coin> > vFound;
+        BOOST_FOREACH(const COutPoint& outpoint, job.outpoints) {
+            Coin coin;
+            if (base->GetCoin(outpoint, coin) && !coin.IsSpent())
+                vFound.push_back(std::make_pair(outpoint, std::move(coin)));
+        }
+
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (nGeneration != nGenerationSeen)
+            continue;
+        for (size_t i = 0; i < vFound.size() && mapStaged.size() < MAX_PREFETCH_COINS; i++)
+            mapStaged.emplace(vFound[i].first, std::move(vFound[i].second));
+    }
+}
@@ -0,0 +1,92 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_COINSPREFETCH_H
+#define BITCOIN_COINSPREFETCH_H
+
+#include "chain.h"
+#include "coins.h"
+
+#include <atomic>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+//! -prefetchcoins default (number of threads)
+static const int DEFAULT_PREFETCH_THREADS = 4;
+//! Maximum number of prefetch threads
+static const int MAX_PREFETCH_THREADS = 16;
+//! Maximum number of loaded coins waiting to be picked up
+static const size_t MAX_PREFETCH_COINS = 100000;
+//! Number of coins looked up per job, so that the lookups of one block spread over all threads
+static const size_t PREFETCH_BATCH_SIZE = 16;
+
+/**
+ * CCoinsView that loads the coins spent by blocks that are about to be
+ * connected from its base (the coins database) on background threads, so
+ * that ConnectBlock finds them in memory instead of waiting for one disk read
+ * per input.
+ *
+ * It sits between pcoinsTip and the database. Loaded coins are kept in a
+ * staging map and handed out (once) by GetCoin. The staging map only ever
+ * holds what the base returned, so it is correct as long as the base does not
+ * change: every BatchWrite through this view discards it, along with any
+ * lookup that was in flight while the write happened. Writes that bypass this
+ * view (as during startup) must not run while prefetching.
+ */
+class CCoinsViewPrefetch : public CCoinsViewBacked
+{
+private:
+    struct PrefetchJob
+    {
+        //! Block to read the inputs of, or null for a batch of outpoints
+        CDiskBlockPos pos;
+        std::vector<COutPoint> outpoints;
+    };
+
+    mutable boost::mutex cs;
+    boost::condition_variable cond;
+    std::deque<PrefetchJob> queue;
+    //! Blocks that were queued recently, so that they are not read twice
+    std::deque<CDiskBlockPos> recentBlocks;
+    mutable std::unordered_map<COutPoint, Coin, SaltedOutpointHasher> mapStaged;
+    //! Bumped before and after every write to the base
+    unsigned int nGeneration;
+    std::atomic<int> nWorkers;
+
+    void Invalidate();
+    //! Queue lookups of outpoints in batches (cs must be held)
+    void QueueCoins(const std::vector<COutPoint>& outpoints);
+
+public:
+    CCoinsViewPrefetch(CCoinsView* viewIn);
+
+    bool GetCoin(const COutPoint& outpoint, Coin& coin) const override;
+    bool HaveCoin(const COutPoint& outpoint) const override;
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock) override;
+    bool BatchWriteKeep(const CCoinsMap& mapCoins, const uint256& hashBlock) override;
+
+    /**
+     * Queue loading the coins spent by the block stored at pos, except those
+     * it creates itself. Does nothing if no prefetch thread is running.
+     */
+    void PrefetchBlock(const CDiskBlockPos& pos);
+
+    /** Queue loading the given coins. Does nothing if no prefetch thread is running. */
+    void PrefetchCoins(const std::vector<COutPoint>& outpoints);
+
+    //! Whether a prefetch thread is running (otherwise nothing is queued)
+    bool IsActive() const { return nWorkers > 0; }
+
+    //! Number of loaded coins that were not picked up yet
+    size_t GetStagedCount() const;
+
+    //! Prefetch thread, runs until interrupted
+    void ThreadPrefetch();
+};
+
+#endif // BITCOIN_COINSPREFETCH_H
@@ -0,0 +1,124 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coinstats.h"
+
+#include "serialize.h"
+#include "streams.h"
+#include "util.h"
+#include "version.h"
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp> // boost::this_thread::interruption_point
+
+//! Rough per-output size of the set, independent of the database encoding
+static uint64_t GetBogoSize(const CScript& scriptPubKey)
+{
+    return 32 /* txid */ +
+           4 /* vout index */ +
+           4 /* height + coinbase */ +
+           8 /* amount */ +
+           2 /* scriptPubKey len */ +
+           scriptPubKey.size() /* scriptPubKey */;
+}
+
+static void SerializeCoin(CDataStream& ss, const COutPoint& outpoint, const Coin& coin)
+{
+    ss << outpoint;
+    ss << (uint32_t)(coin.nHeight * 2 + coin.fCoinBase);
+    ss << coin.out;
+}
+
+void CUTXOCommitment::AddCoin(const COutPoint& outpoint, const Coin& coin)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    SerializeCoin(ss, outpoint, coin);
+    muhash.Insert((const unsigned char*)ss.data(), ss.size());
+    nTransactionOutputs++;
+    nBogoSize += GetBogoSize(coin.out.scriptPubKey);
+    nTotalAmount += coin.out.nValue;
+}
+
+void CUTXOCommitment::RemoveCoin(const COutPoint& outpoint, const Coin& coin)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    SerializeCoin(ss, outpoint, coin);
+    muhash.Remove((const unsigned char*)ss.data(), ss.size());
+    nTransactionOutputs--;
+    nBogoSize -= GetBogoSize(coin.out.scriptPubKey);
+    nTotalAmount -= coin.out.nValue;
+}
+
+void CUTXOCommitment::GetStats(CCoinsStats& stats) const
+{
+    stats.nTransactionOutputs = nTransactionOutputs;
+    stats.nBogoSize = nBogoSize;
+    stats.nTotalAmount = nTotalAmount;
+    muhash.Finalize(stats.hashMuHash);
+}
+
+CCoinsStatsBuilder::CCoinsStatsBuilder(CCoinsStats& statsIn, const uint256& hashBlock) : stats(statsIn), ss(SER_GETHASH, PROTOCOL_VERSION)
+{
+    stats.hashBlock = hashBlock;
+    ss << hashBlock;
+}
+
+void CCoinsStatsBuilder::ApplyOutputs()
+{
+    assert(!outputs.empty());
+    ss << hashPrev;
+    ss << VARINT(outputs.begin()->second.nHeight * 2 + outputs.begin()->second.fCoinBase);
+    stats.nTransactions++;
+    for (const auto& output : outputs) {
+        ss << VARINT(output.first + 1);
+        ss << *(const CScriptBase*)(&output.second.out.scriptPubKey);
+        ss << VARINT(output.second.out.nValue);
+        stats.nTransactionOutputs++;
+        stats.nBogoSize += GetBogoSize(output.second.out.scriptPubKey);
+        stats.nTotalAmount += output.second.out.nValue;
+    }
+    ss << VARINT(0);
+    outputs.clear();
+}
+
+void CCoinsStatsBuilder::Add(const COutPoint& outpoint, const Coin& coin)
+{
+    if (!outputs.empty() && outpoint.hash != hashPrev)
+        ApplyOutputs();
+    hashPrev = outpoint.hash;
+    outputs[outpoint.n] = coin;
+}
+
+void CCoinsStatsBuilder::Finalize()
+{
+    if (!outputs.empty())
+        ApplyOutputs();
+    stats.hashSerialized = ss.GetHash();
+}
+
+bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats, bool fMuHash)
+{
+    boost::scoped_ptr<CCoinsViewCursor> pcursor(view->Cursor());
+    CUTXOCommitment commitment;
+
+    CCoinsStatsBuilder builder(stats, pcursor->GetBestBlock());
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        COutPoint key;
+        Coin coin;
+        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
+            builder.Add(key, coin);
+            if (fMuHash)
+                commitment.AddCoin(key, coin);
+        } else {
+            return error("%s: unable to read value", __func__);
+        }
+        pcursor->Next();
+    }
+    builder.Finalize();
+    if (fMuHash)
+        commitment.muhash.Finalize(stats.hashMuHash);
+    stats.nDiskSize = view->EstimateSize();
+    return true;
+}
@@ -0,0 +1,90 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_COINSTATS_H
+#define BITCOIN_COINSTATS_H
+
+#include "amount.h"
+#include "coins.h"
+#include "crypto/muhash.h"
+#include "hash.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <map>
+#include <stdint.h>
+
+/** Statistics about the unspent transaction output set */
+struct CCoinsStats
+{
+    int nHeight;
+    uint256 hashBlock;
+    uint64_t nTransactions;
+    uint64_t nTransactionOutputs;
+    uint256 hashSerialized;
+    uint64_t nDiskSize;
+    uint64_t nBogoSize;
+    uint256 hashMuHash;
+    CAmount nTotalAmount;
+
+    CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nDiskSize(0), nBogoSize(0), nTotalAmount(0) {}
+};
+
+/**
+ * Rolling commitment to the unspent transaction output set. Unlike
+ * hashSerialized it does not depend on the order coins are added in, so it
+ * can be carried forward block by block by adding created and removing spent
+ * outputs instead of rescanning the whole set.
+ */
+struct CUTXOCommitment
+{
+    MuHash3072 muhash;
+    uint64_t nTransactionOutputs;
+    uint64_t nBogoSize;
+    CAmount nTotalAmount;
+
+    CUTXOCommitment() : nTransactionOutputs(0), nBogoSize(0), nTotalAmount(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(muhash);
+        READWRITE(nTransactionOutputs);
+        READWRITE(nBogoSize);
+        READWRITE(nTotalAmount);
+    }
+
+    void AddCoin(const COutPoint& outpoint, const Coin& coin);
+    void RemoveCoin(const COutPoint& outpoint, const Coin& coin);
+    //! Fill in the totals and the finalized hash of stats
+    void GetStats(CCoinsStats& stats) const;
+};
+
+/**
+ * Computes CCoinsStats (other than nHeight and nDiskSize) from coins that are
+ * added in database order, i.e. with all outputs of a transaction in a row.
+ */
+class CCoinsStatsBuilder
+{
+private:
+    CCoinsStats& stats;
+    CHashWriter ss;
+    uint256 hashPrev;
+    std::map<uint32_t, Coin> outputs;
+
+    void ApplyOutputs();
+
+public:
+    CCoinsStatsBuilder(CCoinsStats& statsIn, const uint256& hashBlock);
+
+    void Add(const COutPoint& outpoint, const Coin& coin);
+    //! Set stats.hashSerialized once all coins have been added
+    void Finalize();
+};
+
+//! Calculate statistics about the unspent transaction output set (except for nHeight)
+bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats, bool fMuHash = false);
+
+#endif // BITCOIN_COINSTATS_H
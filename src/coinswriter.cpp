@@ -0,0 +1,150 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coinswriter.h"
+
+#include "memusage.h"
+#include "util.h"
+#include "utiltime.h"
+
+CCoinsViewWriter::CCoinsViewWriter(CCoinsView* viewIn, const boost::function<void()>& fnWriteFailedIn) :
+    CCoinsViewBacked(viewIn), fWriting(false), nWritingUsage(0), fnWriteFailed(fnWriteFailedIn), fLastWriteOk(true), nLastWriteTime(0) {}
+
+CCoinsViewWriter::~CCoinsViewWriter()
+{
+    WaitForWrite();
+}
+
+bool CCoinsViewWriter::GetCoin(const COutPoint& outpoint, Coin& coin) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (fWriting) {
+            CCoinsMap::const_iterator it = mapWriting->find(outpoint);
+            if (it != mapWriting->end()) {
+                coin = it->second.coin;
+                return !coin.IsSpent();
+            }
+        }
+    }
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewWriter::HaveCoin(const COutPoint& outpoint) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (fWriting) {
+            CCoinsMap::const_iterator it = mapWriting->find(outpoint);
+            if (it != mapWriting->end())
+                return !it->second.coin.IsSpent();
+        }
+    }
+    return base->HaveCoin(outpoint);
+}
+
+uint256 CCoinsViewWriter::GetBestBlock() const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (fWriting && !hashBlockWriting.IsNull())
+            return hashBlockWriting;
+    }
+    return base->GetBestBlock();
+}
+
+bool CCoinsViewWriter::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
+{
+    // Writes must reach the base in order
+    if (!WaitForWrite())
+        return false;
+    return base->BatchWrite(mapCoins, hashBlock);
+}
+
+bool CCoinsViewWriter::WriteAsync(CCoinsViewCache& cache, size_t nKeepUsage)
+{
+    if (!WaitForWrite())
+        return false;
+    std::unique_ptr<CCoinsMapMemoryResource> resource(new CCoinsMapMemoryResource());
+    std::unique_ptr<CCoinsMap> map(new CCoinsMap(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), resource.get()));
+    cache.TakeChanges(*map, nKeepUsage);
+    size_t nUsage = memusage::DynamicUsage(*map);
+    for (CCoinsMap::const_iterator it = map->begin(); it != map->end(); ++it)
+        nUsage += it->second.coin.DynamicMemoryUsage();
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        resourceWriting = std::move(resource);
+        mapWriting = std::move(map);
+        hashBlockWriting = cache.GetBestBlock();
+        fWriting = true;
+        nWritingUsage = nUsage;
+    }
+    threadWrite = boost::thread(&CCoinsViewWriter::ThreadWrite, this);
+    return true;
+}
+
+void CCoinsViewWriter::ThreadWrite()
+{
+    RenameThread("mano-coinswrite");
+    int64_t nStart = GetTimeMicros();
+
+    // mapWriting has to keep answering lookups until the write is done, so
+    // the base writes it without consuming it. It is not modified until
+    // then, so it can be read unlocked.
+    bool fOk = false;
+    try {
+        fOk = base->BatchWriteKeep(*mapWriting, hashBlockWriting);
+    } catch (const std::exception& e) {
+        LogPrintf("%s: %s\n", __func__, e.what());
+    }
+
+    int64_t nTime = GetTimeMicros() - nStart;
+    LogPrint("bench", "  - Background coins write: %.2fms (%u entries)\n", nTime * 0.001, (unsigned int)mapWriting->size());
+
+    if (!fOk) {
+        // The base may still have the coins spent in the batch, so keep it
+        LogPrintf("%s: failed to write to coin database\n", __func__);
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            fLastWriteOk = false;
+            nLastWriteTime = nTime;
+        }
+        if (fnWriteFailed)
+            fnWriteFailed();
+        return;
+    }
+
+    boost::unique_lock<boost::mutex> lock(cs);
+    nLastWriteTime = nTime;
+    fWriting = false;
+    nWritingUsage = 0;
+    mapWriting.reset();
+    resourceWriting.reset();
+}
+
+bool CCoinsViewWriter::WaitForWrite()
+{
+    if (threadWrite.joinable())
+        threadWrite.join();
+    boost::unique_lock<boost::mutex> lock(cs);
+    return fLastWriteOk;
+}
+
+bool CCoinsViewWriter::IsWriting() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    return fWriting;
+}
+
+size_t CCoinsViewWriter::DynamicMemoryUsage() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    return nWritingUsage;
+}
+
+int64_t CCoinsViewWriter::GetLastWriteTime() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    return nLastWriteTime;
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_COINSWRITER_H
+#define BITCOIN_COINSWRITER_H
+
+#include "coins.h"
+
+#include <memory>
+
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+//! -backgroundflush default
+static const bool DEFAULT_BACKGROUND_FLUSH = true;
+
+/**
+ * CCoinsView that writes batches of changes to its base (the coins
+ * database) on a background thread, so that validation can continue while a
+ * flush is written.
+ *
+ * While a batch is being written, lookups of coins in it are answered from
+ * the batch, so the views above see the state after the write. Only one
+ * batch is written at a time: starting another one, or writing through
+ * BatchWrite(), waits for the current one first.
+ *
+ * A batch that failed to be written is kept and keeps answering lookups, as
+ * the base still holds the state before it; every later write fails. The
+ * node has to shut down then, which fnWriteFailed is called for right away.
+ */
+class CCoinsViewWriter : public CCoinsViewBacked
+{
+private:
+    //! Protects mapWriting, hashBlockWriting and fWriting against lookups from other threads
+    mutable boost::mutex cs;
+    std::unique_ptr<CCoinsMapMemoryResource> resourceWriting;
+    std::unique_ptr<CCoinsMap> mapWriting;
+    uint256 hashBlockWriting;
+    bool fWriting;
+    //! Memory held by mapWriting (protected by cs)
+    size_t nWritingUsage;
+
+    boost::thread threadWrite;
+    boost::function<void()> fnWriteFailed;
+    //! Result of the last background write (protected by cs)
+    bool fLastWriteOk;
+    //! Duration of the last background write in microseconds (protected by cs)
+    int64_t nLastWriteTime;
+
+    void ThreadWrite();
+
+public:
+    CCoinsViewWriter(CCoinsView* viewIn, const boost::function<void()>& fnWriteFailedIn = boost::function<void()>());
+    ~CCoinsViewWriter();
+
+    bool GetCoin(const COutPoint& outpoint, Coin& coin) const override;
+    bool HaveCoin(const COutPoint& outpoint) const override;
+    uint256 GetBestBlock() const override;
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock) override;
+
+    /**
+     * Start writing the changes in cache (see CCoinsViewCache::TakeChanges,
+     * which keeps up to nKeepUsage bytes of coins cached) in the background.
+     * cache must be a view on top of this one. Waits for the previous write,
+     * and returns false without taking anything if that failed.
+     */
+    bool WriteAsync(CCoinsViewCache& cache, size_t nKeepUsage);
+
+    //! Wait for the background write (if any) to finish; returns whether it succeeded
+    bool WaitForWrite();
+
+    //! Whether a background write is in progress, or failed and its batch is kept
+    bool IsWriting() const;
+
+    //! Memory held by the batch being written, which counts against the coins cache limit
+    size_t DynamicMemoryUsage() const;
+
+    //! Duration of the last finished background write in microseconds
+    int64_t GetLastWriteTime() const;
+};
+
+#endif // BITCOIN_COINSWRITER_H
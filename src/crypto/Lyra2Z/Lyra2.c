@@ -24,6 +24,49 @@
 #include "Lyra2.h"
 #include "Sponge.h"
 
+/**
+ * Writes pad(pwd || salt || basil) with the 10*1 padding to out, where the
+ * "basil" is every integer parameter in the order they are provided.
+ *
+ * @return The number of BLOCK_LEN_BLAKE2_SAFE_BYTES blocks written
+ */
+static uint64_t padInput(byte *out, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols) {
+    //First, we clean enough blocks for the password, salt, basil and padding
+    uint64_t nBlocksInput = ((saltlen + pwdlen + 6 * sizeof (uint64_t)) / BLOCK_LEN_BLAKE2_SAFE_BYTES) + 1;
+    byte *ptrByte = out;
+    memset(ptrByte, 0, nBlocksInput * BLOCK_LEN_BLAKE2_SAFE_BYTES);
+
+    //Prepends the password
+    memcpy(ptrByte, pwd, pwdlen);
+    ptrByte += pwdlen;
+
+    //Concatenates the salt
+    memcpy(ptrByte, salt, saltlen);
+    ptrByte += saltlen;
+
+    //Concatenates the basil: every integer passed as parameter, in the order they are provided by the interface
+    memcpy(ptrByte, &kLen, sizeof (uint64_t));
+    ptrByte += sizeof (uint64_t);
+    memcpy(ptrByte, &pwdlen, sizeof (uint64_t));
+    ptrByte += sizeof (uint64_t);
+    memcpy(ptrByte, &saltlen, sizeof (uint64_t));
+    ptrByte += sizeof (uint64_t);
+    memcpy(ptrByte, &timeCost, sizeof (uint64_t));
+    ptrByte += sizeof (uint64_t);
+    memcpy(ptrByte, &nRows, sizeof (uint64_t));
+    ptrByte += sizeof (uint64_t);
+    memcpy(ptrByte, &nCols, sizeof (uint64_t));
+    ptrByte += sizeof (uint64_t);
+
+    //Now comes the padding
+    *ptrByte = 0x80; //first byte of padding: right after the password
+    ptrByte = out; //resets the pointer to the start of the buffer
+    ptrByte += nBlocksInput * BLOCK_LEN_BLAKE2_SAFE_BYTES - 1; //sets the pointer to the correct position: end of incomplete block
+    *ptrByte ^= 0x01; //last byte of padding: at the end of the last incomplete block
+
+    return nBlocksInput;
+}
+
 /**
  * Executes Lyra2 based on the G function from Blake2b. This version supports salts and passwords
  * whose combined length is smaller than the size of the memory matrix, (i.e., (nRows x nCols x b) bits,
@@ -45,6 +88,44 @@
  */
 int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols) {
 
+    //Tries to allocate enough space for the whole memory matrix
+    const int64_t i = (int64_t) nRows * (int64_t) (BLOCK_LEN_INT64 * nCols * 8);
+    uint64_t *wholeMatrix = malloc(i);
+    if (wholeMatrix == NULL) {
+      return -1;
+    }
+
+    LYRA2_matrix(wholeMatrix, K, kLen, pwd, pwdlen, salt, saltlen, timeCost, nRows, nCols);
+
+    //Wiping out the memory matrix before freeing it
+    memset(wholeMatrix, 0, i);
+    free(wholeMatrix);
+
+    return 0;
+}
+
+/**
+ * Executes Lyra2 over a memory matrix supplied by the caller, so that repeated
+ * invocations (e.g. one per block header) do not allocate. The matrix does not
+ * need to be zeroed: every row is fully written before it is read.
+ *
+ * @param wholeMatrix Memory matrix of at least nRows x nCols x BLOCK_LEN_INT64 words
+ *
+ * All other parameters are the same as for LYRA2().
+ *
+ * @return 0 (the key is always generated)
+ */
+int LYRA2_matrix(uint64_t *wholeMatrix, void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols) {
+    return LYRA2_matrix_impl(spongeBestImpl(), wholeMatrix, K, kLen, pwd, pwdlen, salt, saltlen, timeCost, nRows, nCols);
+}
+
+/**
+ * Same as LYRA2_matrix(), with an explicit choice of sponge implementation.
+ *
+ * @param sponge The sponge implementation to run the row operations with
+ */
+int LYRA2_matrix_impl(const sponge_impl *sponge, uint64_t *wholeMatrix, void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols) {
+
     //============================= Basic variables ============================//
     int64_t row = 2; //index of row to be processed
     int64_t prev = 1; //index of prev (last row ever computed/modified)
@@ -56,77 +137,21 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
     int64_t i; //auxiliary iteration counter
     //==========================================================================/
 
-    //========== Initializing the Memory Matrix and pointers to it =============//
-    //Tries to allocate enough space for the whole memory matrix
-
-
+    //================ Pointers to the rows of the Memory Matrix ===============//
     const int64_t ROW_LEN_INT64 = BLOCK_LEN_INT64 * nCols;
-    const int64_t ROW_LEN_BYTES = ROW_LEN_INT64 * 8;
-
-    i = (int64_t) ((int64_t) nRows * (int64_t) ROW_LEN_BYTES);
-    uint64_t *wholeMatrix = malloc(i);
-    if (wholeMatrix == NULL) {
-      return -1;
-    }
-    memset(wholeMatrix, 0, i);
-
-    //Allocates pointers to each row of the matrix
-    uint64_t **memMatrix = malloc(nRows * sizeof (uint64_t*));
-    if (memMatrix == NULL) {
-      return -1;
-    }
-    //Places the pointers in the correct positions
-    uint64_t *ptrWord = wholeMatrix;
-    for (i = 0; i < nRows; i++) {
-      memMatrix[i] = ptrWord;
-      ptrWord += ROW_LEN_INT64;
-    }
+#define MEM_ROW(r) (wholeMatrix + (r) * ROW_LEN_INT64)
+    uint64_t *ptrWord;
     //==========================================================================/
 
     //============= Getting the password + salt + basil padded with 10*1 ===============//
     //OBS.:The memory matrix will temporarily hold the password: not for saving memory,
     //but this ensures that the password copied locally will be overwritten as soon as possible
-
-    //First, we clean enough blocks for the password, salt, basil and padding
-    uint64_t nBlocksInput = ((saltlen + pwdlen + 6 * sizeof (uint64_t)) / BLOCK_LEN_BLAKE2_SAFE_BYTES) + 1;
-    byte *ptrByte = (byte*) wholeMatrix;
-    memset(ptrByte, 0, nBlocksInput * BLOCK_LEN_BLAKE2_SAFE_BYTES);
-
-    //Prepends the password
-    memcpy(ptrByte, pwd, pwdlen);
-    ptrByte += pwdlen;
-
-    //Concatenates the salt
-    memcpy(ptrByte, salt, saltlen);
-    ptrByte += saltlen;
-
-    //Concatenates the basil: every integer passed as parameter, in the order they are provided by the interface
-    memcpy(ptrByte, &kLen, sizeof (uint64_t));
-    ptrByte += sizeof (uint64_t);
-    memcpy(ptrByte, &pwdlen, sizeof (uint64_t));
-    ptrByte += sizeof (uint64_t);
-    memcpy(ptrByte, &saltlen, sizeof (uint64_t));
-    ptrByte += sizeof (uint64_t);
-    memcpy(ptrByte, &timeCost, sizeof (uint64_t));
-    ptrByte += sizeof (uint64_t);
-    memcpy(ptrByte, &nRows, sizeof (uint64_t));
-    ptrByte += sizeof (uint64_t);
-    memcpy(ptrByte, &nCols, sizeof (uint64_t));
-    ptrByte += sizeof (uint64_t);
-
-    //Now comes the padding
-    *ptrByte = 0x80; //first byte of padding: right after the password
-    ptrByte = (byte*) wholeMatrix; //resets the pointer to the start of the memory matrix
-    ptrByte += nBlocksInput * BLOCK_LEN_BLAKE2_SAFE_BYTES - 1; //sets the pointer to the correct position: end of incomplete block
-    *ptrByte ^= 0x01; //last byte of padding: at the end of the last incomplete block
+    uint64_t nBlocksInput = padInput((byte*) wholeMatrix, kLen, pwd, pwdlen, salt, saltlen, timeCost, nRows, nCols);
     //==========================================================================/
 
     //======================= Initializing the Sponge State ====================//
     //Sponge state: 16 uint64_t, BLOCK_LEN_INT64 words of them for the bitrate (b) and the remainder for the capacity (c)
-    uint64_t *state = malloc(16 * sizeof (uint64_t));
-    if (state == NULL) {
-      return -1;
-    }
+    uint64_t state[16] ALIGN;
     initState(state);
     //==========================================================================/
 
@@ -134,17 +159,17 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
     //Absorbing salt, password and basil: this is the only place in which the block length is hard-coded to 512 bits
     ptrWord = wholeMatrix;
     for (i = 0; i < nBlocksInput; i++) {
-      absorbBlockBlake2Safe(state, ptrWord); //absorbs each block of pad(pwd || salt || basil)
+      sponge->absorbBlockBlake2Safe(state, ptrWord); //absorbs each block of pad(pwd || salt || basil)
       ptrWord += BLOCK_LEN_BLAKE2_SAFE_INT64; //goes to next block of pad(pwd || salt || basil)
     }
 
     //Initializes M[0] and M[1]
-    reducedSqueezeRow0(state, memMatrix[0], nCols); //The locally copied password is most likely overwritten here
-    reducedDuplexRow1(state, memMatrix[0], memMatrix[1], nCols);
+    sponge->reducedSqueezeRow0(state, MEM_ROW(0), nCols); //The locally copied password is most likely overwritten here
+    sponge->reducedDuplexRow1(state, MEM_ROW(0), MEM_ROW(1), nCols);
 
     do {
       //M[row] = rand; //M[row*] = M[row*] XOR rotW(rand)
-      reducedDuplexRowSetup(state, memMatrix[prev], memMatrix[rowa], memMatrix[row], nCols);
+      sponge->reducedDuplexRowSetup(state, MEM_ROW(prev), MEM_ROW(rowa), MEM_ROW(row), nCols);
 
 
       //updates the value of row* (deterministically picked during Setup))
@@ -177,7 +202,7 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
         //------------------------------------------------------------------------------------------
 
         //Performs a reduced-round duplexing operation over M[row*] XOR M[prev], updating both M[row*] and M[row]
-        reducedDuplexRow(state, memMatrix[prev], memMatrix[rowa], memMatrix[row], nCols);
+        sponge->reducedDuplexRow(state, MEM_ROW(prev), MEM_ROW(rowa), MEM_ROW(row), nCols);
 
         //update prev: it now points to the last row ever computed
         prev = row;
@@ -194,21 +219,144 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
 
     //============================ Wrap-up Phase ===============================//
     //Absorbs the last block of the memory matrix
-    absorbBlock(state, memMatrix[rowa]);
+    sponge->absorbBlock(state, MEM_ROW(rowa));
 
     //Squeezes the key
     squeeze(state, K, kLen);
     //==========================================================================/
+#undef MEM_ROW
 
-    //========================= Freeing the memory =============================//
-    free(memMatrix);
-    free(wholeMatrix);
-
-    //Wiping out the sponge's internal state before freeing it
+    //Wiping out the sponge's internal state
     memset(state, 0, 16 * sizeof (uint64_t));
-    free(state);
+
+    return 0;
+}
+
+/**
+ * Executes two independent instances of Lyra2 side by side, with the
+ * two-lane sponge operations of sponge. Both instances must use the same
+ * parameter sizes: the rows they visit only differ in the Wandering phase,
+ * where row* is picked from each lane's own state.
+ *
+ * The sponge states and the matrix rows of both lanes are interleaved in
+ * chunks of LYRA2_X2_CHUNK words (lane 0's chunk first), so wholeMatrix must
+ * hold twice the words needed by LYRA2_matrix().
+ *
+ * @param K0, K1 The derived keys of lane 0 and lane 1
+ * @param pwd0, pwd1 The passwords of lane 0 and lane 1
+ * @param salt0, salt1 The salts of lane 0 and lane 1
+ *
+ * All other parameters are the same as for LYRA2_matrix().
+ *
+ * @return 0 (the keys are always generated)
+ */
+int LYRA2_matrix_x2(const sponge_x2_impl *sponge, uint64_t *wholeMatrix, void *K0, void *K1, uint64_t kLen, const void *pwd0, const void *pwd1, uint64_t pwdlen, const void *salt0, const void *salt1, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols) {
+
+    //============================= Basic variables ============================//
+    int64_t row = 2; //index of row to be processed
+    int64_t prev = 1; //index of prev (last row ever computed/modified)
+    int64_t rowa = 0; //index of row* during Setup, where it is the same for both lanes
+    int64_t rowa0 = 0, rowa1 = 0; //index of row* of each lane while Wandering
+    int64_t tau; //Time Loop iterator
+    int64_t step = 1; //Visitation step (used during Setup and Wandering phases)
+    int64_t window = 2; //Visitation window (used to define which rows can be revisited during Setup)
+    int64_t gap = 1; //Modifier to the step, assuming the values 1 or -1
+    int64_t i, j; //auxiliary iteration counters
     //==========================================================================/
 
+    //================ Pointers to the rows of the Memory Matrix ===============//
+    const int64_t ROW_LEN_INT64 = 2 * BLOCK_LEN_INT64 * nCols;
+#define MEM_ROW(r) (wholeMatrix + (r) * ROW_LEN_INT64)
+    uint64_t *ptrWord;
+    //==========================================================================/
+
+    //============= Getting the password + salt + basil padded with 10*1 ===============//
+    //Both padded inputs are built past the interleaved input blocks at the start of
+    //the matrix, so all of them are overwritten when the rows are initialized
+    uint64_t nBlocksInput = ((saltlen + pwdlen + 6 * sizeof (uint64_t)) / BLOCK_LEN_BLAKE2_SAFE_BYTES) + 1;
+    uint64_t *input0 = wholeMatrix + 2 * nBlocksInput * BLOCK_LEN_BLAKE2_SAFE_INT64;
+    uint64_t *input1 = input0 + nBlocksInput * BLOCK_LEN_BLAKE2_SAFE_INT64;
+    padInput((byte*) input0, kLen, pwd0, pwdlen, salt0, saltlen, timeCost, nRows, nCols);
+    padInput((byte*) input1, kLen, pwd1, pwdlen, salt1, saltlen, timeCost, nRows, nCols);
+    ptrWord = wholeMatrix;
+    for (i = 0; i < nBlocksInput * BLOCK_LEN_BLAKE2_SAFE_INT64; i += LYRA2_X2_CHUNK) {
+      for (j = 0; j < LYRA2_X2_CHUNK; j++)
+        *ptrWord++ = input0[i + j];
+      for (j = 0; j < LYRA2_X2_CHUNK; j++)
+        *ptrWord++ = input1[i + j];
+    }
+    //==========================================================================/
+
+    //======================= Initializing the Sponge State ====================//
+    uint64_t state[32] ALIGN;
+    uint64_t laneState[16] ALIGN;
+    initState(laneState);
+    for (i = 0; i < 16; i += LYRA2_X2_CHUNK) {
+      memcpy(state + 2 * i, laneState + i, LYRA2_X2_CHUNK * sizeof (uint64_t));
+      memcpy(state + 2 * i + LYRA2_X2_CHUNK, laneState + i, LYRA2_X2_CHUNK * sizeof (uint64_t));
+    }
+    //==========================================================================/
+
+    //================================ Setup Phase =============================//
+    ptrWord = wholeMatrix;
+    for (i = 0; i < nBlocksInput; i++) {
+      sponge->absorbBlockBlake2Safe(state, ptrWord);
+      ptrWord += 2 * BLOCK_LEN_BLAKE2_SAFE_INT64;
+    }
+
+    sponge->reducedSqueezeRow0(state, MEM_ROW(0), nCols);
+    sponge->reducedDuplexRow1(state, MEM_ROW(0), MEM_ROW(1), nCols);
+
+    do {
+      sponge->reducedDuplexRowSetup(state, MEM_ROW(prev), MEM_ROW(rowa), MEM_ROW(row), nCols);
+
+      rowa = (rowa + step) & (window - 1);
+      prev = row;
+      row++;
+
+      if (rowa == 0) {
+        step = window + gap;
+        window *= 2;
+        gap = -gap;
+      }
+
+    } while (row < nRows);
+    //==========================================================================/
+
+    //============================ Wandering Phase =============================//
+    row = 0;
+    for (tau = 1; tau <= timeCost; tau++) {
+        step = (tau % 2 == 0) ? -1 : nRows / 2 - 1;
+        do {
+        rowa0 = ((uint64_t) (state[0])) % nRows;
+        rowa1 = ((uint64_t) (state[LYRA2_X2_CHUNK])) % nRows;
+
+        sponge->reducedDuplexRow(state, MEM_ROW(prev), MEM_ROW(rowa0), MEM_ROW(rowa1), MEM_ROW(row), nCols);
+
+        prev = row;
+        row = (row + step) % nRows;
+
+      } while (row != 0);
+    }
+    //==========================================================================/
+
+    //============================ Wrap-up Phase ===============================//
+    sponge->absorbBlock(state, MEM_ROW(rowa0), MEM_ROW(rowa1));
+
+    //Squeezes each lane's key from its deinterleaved state
+    for (i = 0; i < 16; i += LYRA2_X2_CHUNK)
+      memcpy(laneState + i, state + 2 * i, LYRA2_X2_CHUNK * sizeof (uint64_t));
+    squeeze(laneState, K0, kLen);
+    for (i = 0; i < 16; i += LYRA2_X2_CHUNK)
+      memcpy(laneState + i, state + 2 * i + LYRA2_X2_CHUNK, LYRA2_X2_CHUNK * sizeof (uint64_t));
+    squeeze(laneState, K1, kLen);
+    //==========================================================================/
+#undef MEM_ROW
+
+    //Wiping out the sponges' internal states
+    memset(state, 0, 32 * sizeof (uint64_t));
+    memset(laneState, 0, 16 * sizeof (uint64_t));
+
     return 0;
 }
 
@@ -41,7 +41,55 @@ typedef unsigned char byte;
 extern "C" {
 #endif
 
+    /**
+     * A set of sponge operations used by Lyra2. All implementations are
+     * bit-exact with each other; they only differ in the instructions used.
+     */
+    typedef struct sponge_impl {
+        const char *name;
+        int (*supported)(void);
+        void (*absorbBlockBlake2Safe)(uint64_t *state, const uint64_t *in);
+        void (*absorbBlock)(uint64_t *state, const uint64_t *in);
+        void (*reducedSqueezeRow0)(uint64_t* state, uint64_t* rowOut, uint64_t nCols);
+        void (*reducedDuplexRow1)(uint64_t *state, uint64_t *rowIn, uint64_t *rowOut, uint64_t nCols);
+        void (*reducedDuplexRowSetup)(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, uint64_t nCols);
+        void (*reducedDuplexRow)(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, uint64_t nCols);
+    } sponge_impl;
+
+    /** Returns the n-th implementation (0 is the portable scalar one), or NULL past the last */
+    const sponge_impl* spongeImpl(int n);
+    /** Returns the fastest implementation supported by the running CPU */
+    const sponge_impl* spongeBestImpl(void);
+
+    /** Words of each lane per chunk in the interleaved layout of the two-lane operations */
+    #define LYRA2_X2_CHUNK 4
+
+    /**
+     * Sponge operations running two independent Lyra2 instances ("lanes") at
+     * once. The states and matrix rows of both lanes are interleaved in chunks
+     * of LYRA2_X2_CHUNK words, lane 0 first, so that a single wide register
+     * holds the same words of both lanes. Row pointers point at interleaved
+     * rows; row* is the only row that may differ between the lanes, hence the
+     * separate pointers where it is used in the Wandering and Wrap-up phases.
+     */
+    typedef struct sponge_x2_impl {
+        const char *name;
+        int (*supported)(void);
+        void (*absorbBlockBlake2Safe)(uint64_t *state, const uint64_t *in);
+        void (*absorbBlock)(uint64_t *state, const uint64_t *in0, const uint64_t *in1);
+        void (*reducedSqueezeRow0)(uint64_t* state, uint64_t* rowOut, uint64_t nCols);
+        void (*reducedDuplexRow1)(uint64_t *state, uint64_t *rowIn, uint64_t *rowOut, uint64_t nCols);
+        void (*reducedDuplexRowSetup)(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, uint64_t nCols);
+        void (*reducedDuplexRow)(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut0, uint64_t *rowInOut1, uint64_t *rowOut, uint64_t nCols);
+    } sponge_x2_impl;
+
+    /** Returns the two-lane implementation if the running CPU supports one, NULL otherwise */
+    const sponge_x2_impl* spongeX2Impl(void);
+
     int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols);
+    int LYRA2_matrix(uint64_t *wholeMatrix, void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols);
+    int LYRA2_matrix_impl(const sponge_impl *sponge, uint64_t *wholeMatrix, void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols);
+    int LYRA2_matrix_x2(const sponge_x2_impl *sponge, uint64_t *wholeMatrix, void *K0, void *K1, uint64_t kLen, const void *pwd0, const void *pwd1, uint64_t pwdlen, const void *salt0, const void *salt1, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols);
 
 #ifdef __cplusplus
 }
@@ -35,7 +35,14 @@
 #include "sph_blake.h"
 #include "Lyra2.h"
 
-void lyra2z_hash(const char* input, char* output)
+void lyra2z_ctx_init(lyra2z_ctx* ctx)
+{
+    uintptr_t p = (uintptr_t)ctx->buf;
+    p = (p + LYRA2Z_MATRIX_ALIGN - 1) & ~(uintptr_t)(LYRA2Z_MATRIX_ALIGN - 1);
+    ctx->matrix = (uint64_t*)p;
+}
+
+void lyra2z_hash_ctx(lyra2z_ctx* ctx, const char* input, char* output)
 {
     sph_blake256_context     ctx_blake;
 
@@ -43,10 +50,61 @@ void lyra2z_hash(const char* input, char* output)
 
     sph_blake256_init(&ctx_blake);
     sph_blake256 (&ctx_blake, input, 80);
-    sph_blake256_close (&ctx_blake, hashA);	
-	
-	LYRA2(hashB, 32, hashA, 32, hashA, 32, 8, 8, 8);
-	
-	memcpy(output, hashB, 32);
+    sph_blake256_close (&ctx_blake, hashA);
+
+    LYRA2_matrix(ctx->matrix, hashB, 32, hashA, 32, hashA, 32, LYRA2Z_TIMECOST, LYRA2Z_NROWS, LYRA2Z_NCOLS);
+
+    memcpy(output, hashB, 32);
+}
+
+void lyra2z_hash(const char* input, char* output)
+{
+    lyra2z_ctx ctx;
+
+    lyra2z_ctx_init(&ctx);
+    lyra2z_hash_ctx(&ctx, input, output);
 }
 
+void lyra2z_midstate_init(lyra2z_midstate* midstate, const char* input)
+{
+    sph_blake256_init(&midstate->blake);
+    sph_blake256(&midstate->blake, input, 64);
+    memcpy(midstate->tail, input + 64, sizeof(midstate->tail));
+}
+
+static void lyra2z_midstate_close(const lyra2z_midstate* midstate, uint32_t nonce, uint32_t hash[8])
+{
+    sph_blake256_context ctx_blake = midstate->blake;
+    unsigned char nonceBytes[4];
+
+    /* The nonce is serialized little endian, like every header field */
+    nonceBytes[0] = nonce;
+    nonceBytes[1] = nonce >> 8;
+    nonceBytes[2] = nonce >> 16;
+    nonceBytes[3] = nonce >> 24;
+    sph_blake256(&ctx_blake, midstate->tail, sizeof(midstate->tail));
+    sph_blake256(&ctx_blake, nonceBytes, sizeof(nonceBytes));
+    sph_blake256_close(&ctx_blake, hash);
+}
+
+void lyra2z_hash_nonces(lyra2z_ctx* ctx, const lyra2z_midstate* midstate, uint32_t nonce, unsigned int count, char* output)
+{
+    const sponge_x2_impl* x2 = spongeX2Impl();
+    uint32_t hashA[LYRA2Z_LANES][8];
+    unsigned int i = 0;
+
+    if (x2) {
+        for (; i + 2 <= count; i += 2) {
+            lyra2z_midstate_close(midstate, nonce + i, hashA[0]);
+            lyra2z_midstate_close(midstate, nonce + i + 1, hashA[1]);
+            LYRA2_matrix_x2(x2, ctx->matrix, output + i * 32, output + (i + 1) * 32, 32,
+                            hashA[0], hashA[1], 32, hashA[0], hashA[1], 32,
+                            LYRA2Z_TIMECOST, LYRA2Z_NROWS, LYRA2Z_NCOLS);
+        }
+    }
+    for (; i < count; i++) {
+        lyra2z_midstate_close(midstate, nonce + i, hashA[0]);
+        LYRA2_matrix(ctx->matrix, output + i * 32, 32, hashA[0], 32, hashA[0], 32,
+                     LYRA2Z_TIMECOST, LYRA2Z_NROWS, LYRA2Z_NCOLS);
+    }
+}
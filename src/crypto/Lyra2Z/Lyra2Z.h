@@ -1,12 +1,61 @@
 #ifndef LYRA2RE_H
 #define LYRA2RE_H
 
+#include <stdint.h>
+#include "Lyra2.h"
+#include "sph_blake.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Lyra2Z parameters: timeCost = 8, nRows = 8, nCols = 8 */
+#define LYRA2Z_TIMECOST 8
+#define LYRA2Z_NROWS 8
+#define LYRA2Z_NCOLS 8
+#define LYRA2Z_MATRIX_INT64 (LYRA2Z_NROWS * LYRA2Z_NCOLS * BLOCK_LEN_INT64)
+
+/* Number of inputs hashed side by side by lyra2z_hash_nonces() when the CPU allows it */
+#define LYRA2Z_LANES 2
+
+/* Cache line alignment of the memory matrix */
+#define LYRA2Z_MATRIX_ALIGN 64
+
+/**
+ * Reusable Lyra2Z working memory. Initialize once with lyra2z_ctx_init() and
+ * pass to lyra2z_hash_ctx() for every hash; a context must not be shared
+ * between threads, and must not be copied after initialization (matrix
+ * points into buf). The matrix has room for LYRA2Z_LANES interleaved lanes.
+ */
+typedef struct {
+    uint64_t *matrix;
+    uint64_t buf[LYRA2Z_LANES * LYRA2Z_MATRIX_INT64 + LYRA2Z_MATRIX_ALIGN / sizeof(uint64_t)];
+} lyra2z_ctx;
+
+/**
+ * Blake256 state after the first 64 bytes of an 80-byte block header, which
+ * do not change while the miner scans nonces, plus the 12 header bytes that
+ * precede the nonce.
+ */
+typedef struct {
+    sph_blake256_context blake;
+    unsigned char tail[12];
+} lyra2z_midstate;
+
+void lyra2z_ctx_init(lyra2z_ctx* ctx);
+void lyra2z_hash_ctx(lyra2z_ctx* ctx, const char* input, char* output);
+
 void lyra2z_hash(const char* input, char* output);
 
+/** Prepares a midstate for the 80-byte header at input; its nonce is ignored */
+void lyra2z_midstate_init(lyra2z_midstate* midstate, const char* input);
+/**
+ * Hashes count headers that only differ in their nonce, from nonce to
+ * nonce + count - 1, writing count consecutive 32-byte hashes to output.
+ * Pairs of nonces go through the two-lane sponge when the CPU supports it.
+ */
+void lyra2z_hash_nonces(lyra2z_ctx* ctx, const lyra2z_midstate* midstate, uint32_t nonce, unsigned int count, char* output);
+
 #ifdef __cplusplus
 }
 #endif
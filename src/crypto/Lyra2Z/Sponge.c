@@ -730,6 +730,80 @@ inline void reducedDuplexRowd(uint64_t *state, uint64_t *rowIn, uint64_t *rowInO
 }
 */
 
+static int scalarSupported(void) {
+    return 1;
+}
+
+static const sponge_impl sponge_scalar = {
+    "scalar",
+    scalarSupported,
+    absorbBlockBlake2Safe,
+    absorbBlock,
+    reducedSqueezeRow0,
+    reducedDuplexRow1,
+    reducedDuplexRowSetup,
+    reducedDuplexRow
+};
+
+const sponge_impl* spongeImpl(int n) {
+    if (n == 0)
+        return &sponge_scalar;
+#ifdef SPONGE_X86
+    return spongeImplX86(n - 1);
+#else
+    return NULL;
+#endif
+}
+
+/**
+ * Implementations are listed from slowest to fastest, so the last one the
+ * CPU supports wins. The CPU only has to be inspected once, so the choice is
+ * cached. Threads racing on the first call all pick the same implementation,
+ * so it does not matter which of their stores lands.
+ */
+static const sponge_impl* spongeDetectBestImpl(void) {
+    const sponge_impl* best = &sponge_scalar;
+    const sponge_impl* impl;
+    int n;
+    for (n = 1; (impl = spongeImpl(n)) != NULL; n++) {
+        if (impl->supported())
+            best = impl;
+    }
+    return best;
+}
+
+static const sponge_impl* spongeBestCached = NULL;
+
+const sponge_impl* spongeBestImpl(void) {
+    const sponge_impl* best = __atomic_load_n(&spongeBestCached, __ATOMIC_ACQUIRE);
+    if (best == NULL) {
+        best = spongeDetectBestImpl();
+        __atomic_store_n(&spongeBestCached, best, __ATOMIC_RELEASE);
+    }
+    return best;
+}
+
+static const sponge_x2_impl* spongeDetectX2Impl(void) {
+#ifdef SPONGE_X86
+    const sponge_x2_impl* impl = spongeX2ImplX86();
+    if (impl->supported())
+        return impl;
+#endif
+    return NULL;
+}
+
+/** Cached like spongeBestImpl(); zero until detected, as the answer itself may be NULL */
+static const sponge_x2_impl* spongeX2Cached = NULL;
+static int spongeX2Detected = 0;
+
+const sponge_x2_impl* spongeX2Impl(void) {
+    if (!__atomic_load_n(&spongeX2Detected, __ATOMIC_ACQUIRE)) {
+        __atomic_store_n(&spongeX2Cached, spongeDetectX2Impl(), __ATOMIC_RELAXED);
+        __atomic_store_n(&spongeX2Detected, 1, __ATOMIC_RELEASE);
+    }
+    return __atomic_load_n(&spongeX2Cached, __ATOMIC_RELAXED);
+}
+
 /**
  Prints an array of unsigned chars
  */
@@ -23,6 +23,7 @@
 #define SPONGE_H_
 
 #include <stdint.h>
+#include "Lyra2.h"
 
 #if defined(__GNUC__)
 #define ALIGN __attribute__ ((aligned(32)))
@@ -92,6 +93,17 @@ void reducedDuplexRow(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint
 //---- Misc
 void printArray(unsigned char *array, unsigned int size, char *name);
 
+//---- Implementations
+/* Vectorized x86 implementations need per-function target attributes */
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SPONGE_X86 1
+#endif
+
+#ifdef SPONGE_X86
+const sponge_impl* spongeImplX86(int n);
+const sponge_x2_impl* spongeX2ImplX86(void);
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
 
@@ -0,0 +1,163 @@
+/**
+ * Vectorized sponge row operations for Lyra2, written once against a small
+ * set of vector primitives and instantiated for each instruction set by
+ * Sponge_x86.c. Every function here is bit-exact with its scalar
+ * counterpart in Sponge.c.
+ *
+ * Before inclusion the following must be defined:
+ *   SPONGE_SUFFIX          suffix appended to every function name
+ *   SPONGE_TARGET          function attribute enabling the instruction set
+ *   VEC                    vector type
+ *   VEC_STATE              number of vectors in the 16-word sponge state
+ *   VEC_BLOCK              number of vectors in a BLOCK_LEN_INT64 block
+ *   VEC_LOAD/VEC_STORE     unaligned load and store
+ *   VEC_XOR/VEC_ADD        wordwise XOR and 64-bit addition
+ *   VEC_ROUND(v)           one round of Blake2b's compression function over v[VEC_STATE]
+ *   VEC_ROTW(out, in)      out[] = in[] rotated left by one 64-bit word (the rotW of Lyra2)
+ *
+ * This file is in the public domain, like the rest of the Lyra2 sources.
+ */
+
+#define SPONGE_CAT2(a, b) a##_##b
+#define SPONGE_CAT(a, b) SPONGE_CAT2(a, b)
+#define SPONGE_FN(name) SPONGE_CAT(name, SPONGE_SUFFIX)
+
+#define VEC_WORDS (16 / VEC_STATE)
+
+static SPONGE_TARGET void SPONGE_FN(absorbBlockBlake2Safe)(uint64_t *state, const uint64_t *in) {
+    VEC v[VEC_STATE];
+    int i;
+    for (i = 0; i < VEC_STATE; i++)
+        v[i] = VEC_LOAD(state + i * VEC_WORDS);
+    for (i = 0; i < BLOCK_LEN_BLAKE2_SAFE_INT64 / VEC_WORDS; i++)
+        v[i] = VEC_XOR(v[i], VEC_LOAD(in + i * VEC_WORDS));
+    for (i = 0; i < 12; i++)
+        VEC_ROUND(v);
+    for (i = 0; i < VEC_STATE; i++)
+        VEC_STORE(state + i * VEC_WORDS, v[i]);
+}
+
+static SPONGE_TARGET void SPONGE_FN(absorbBlock)(uint64_t *state, const uint64_t *in) {
+    VEC v[VEC_STATE];
+    int i;
+    for (i = 0; i < VEC_STATE; i++)
+        v[i] = VEC_LOAD(state + i * VEC_WORDS);
+    for (i = 0; i < VEC_BLOCK; i++)
+        v[i] = VEC_XOR(v[i], VEC_LOAD(in + i * VEC_WORDS));
+    for (i = 0; i < 12; i++)
+        VEC_ROUND(v);
+    for (i = 0; i < VEC_STATE; i++)
+        VEC_STORE(state + i * VEC_WORDS, v[i]);
+}
+
+static SPONGE_TARGET void SPONGE_FN(reducedSqueezeRow0)(uint64_t *state, uint64_t *rowOut, uint64_t nCols) {
+    uint64_t *ptrWord = rowOut + (nCols - 1) * BLOCK_LEN_INT64;
+    VEC v[VEC_STATE];
+    uint64_t col;
+    int i;
+    for (i = 0; i < VEC_STATE; i++)
+        v[i] = VEC_LOAD(state + i * VEC_WORDS);
+    for (col = 0; col < nCols; col++) {
+        for (i = 0; i < VEC_BLOCK; i++)
+            VEC_STORE(ptrWord + i * VEC_WORDS, v[i]);
+        ptrWord -= BLOCK_LEN_INT64;
+        VEC_ROUND(v);
+    }
+    for (i = 0; i < VEC_STATE; i++)
+        VEC_STORE(state + i * VEC_WORDS, v[i]);
+}
+
+static SPONGE_TARGET void SPONGE_FN(reducedDuplexRow1)(uint64_t *state, uint64_t *rowIn, uint64_t *rowOut, uint64_t nCols) {
+    uint64_t *ptrWordIn = rowIn;
+    uint64_t *ptrWordOut = rowOut + (nCols - 1) * BLOCK_LEN_INT64;
+    VEC v[VEC_STATE], in[VEC_BLOCK];
+    uint64_t col;
+    int i;
+    for (i = 0; i < VEC_STATE; i++)
+        v[i] = VEC_LOAD(state + i * VEC_WORDS);
+    for (col = 0; col < nCols; col++) {
+        for (i = 0; i < VEC_BLOCK; i++) {
+            in[i] = VEC_LOAD(ptrWordIn + i * VEC_WORDS);
+            v[i] = VEC_XOR(v[i], in[i]);
+        }
+        VEC_ROUND(v);
+        for (i = 0; i < VEC_BLOCK; i++)
+            VEC_STORE(ptrWordOut + i * VEC_WORDS, VEC_XOR(in[i], v[i]));
+        ptrWordIn += BLOCK_LEN_INT64;
+        ptrWordOut -= BLOCK_LEN_INT64;
+    }
+    for (i = 0; i < VEC_STATE; i++)
+        VEC_STORE(state + i * VEC_WORDS, v[i]);
+}
+
+static SPONGE_TARGET void SPONGE_FN(reducedDuplexRowSetup)(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, uint64_t nCols) {
+    uint64_t *ptrWordIn = rowIn;
+    uint64_t *ptrWordInOut = rowInOut;
+    uint64_t *ptrWordOut = rowOut + (nCols - 1) * BLOCK_LEN_INT64;
+    VEC v[VEC_STATE], in[VEC_BLOCK], rot[VEC_BLOCK];
+    uint64_t col;
+    int i;
+    for (i = 0; i < VEC_STATE; i++)
+        v[i] = VEC_LOAD(state + i * VEC_WORDS);
+    for (col = 0; col < nCols; col++) {
+        for (i = 0; i < VEC_BLOCK; i++) {
+            in[i] = VEC_LOAD(ptrWordIn + i * VEC_WORDS);
+            v[i] = VEC_XOR(v[i], VEC_ADD(in[i], VEC_LOAD(ptrWordInOut + i * VEC_WORDS)));
+        }
+        VEC_ROUND(v);
+        for (i = 0; i < VEC_BLOCK; i++)
+            VEC_STORE(ptrWordOut + i * VEC_WORDS, VEC_XOR(in[i], v[i]));
+        VEC_ROTW(rot, v);
+        for (i = 0; i < VEC_BLOCK; i++)
+            VEC_STORE(ptrWordInOut + i * VEC_WORDS, VEC_XOR(VEC_LOAD(ptrWordInOut + i * VEC_WORDS), rot[i]));
+        ptrWordInOut += BLOCK_LEN_INT64;
+        ptrWordIn += BLOCK_LEN_INT64;
+        ptrWordOut -= BLOCK_LEN_INT64;
+    }
+    for (i = 0; i < VEC_STATE; i++)
+        VEC_STORE(state + i * VEC_WORDS, v[i]);
+}
+
+static SPONGE_TARGET void SPONGE_FN(reducedDuplexRow)(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, uint64_t nCols) {
+    uint64_t *ptrWordInOut = rowInOut;
+    uint64_t *ptrWordIn = rowIn;
+    uint64_t *ptrWordOut = rowOut;
+    VEC v[VEC_STATE], rot[VEC_BLOCK];
+    uint64_t col;
+    int i;
+    for (i = 0; i < VEC_STATE; i++)
+        v[i] = VEC_LOAD(state + i * VEC_WORDS);
+    for (col = 0; col < nCols; col++) {
+        for (i = 0; i < VEC_BLOCK; i++)
+            v[i] = VEC_XOR(v[i], VEC_ADD(VEC_LOAD(ptrWordIn + i * VEC_WORDS), VEC_LOAD(ptrWordInOut + i * VEC_WORDS)));
+        VEC_ROUND(v);
+        // rowOut may be the same row as rowInOut during the Wandering phase, so
+        // rowInOut is re-read after rowOut has been written, as in the scalar code
+        for (i = 0; i < VEC_BLOCK; i++)
+            VEC_STORE(ptrWordOut + i * VEC_WORDS, VEC_XOR(VEC_LOAD(ptrWordOut + i * VEC_WORDS), v[i]));
+        VEC_ROTW(rot, v);
+        for (i = 0; i < VEC_BLOCK; i++)
+            VEC_STORE(ptrWordInOut + i * VEC_WORDS, VEC_XOR(VEC_LOAD(ptrWordInOut + i * VEC_WORDS), rot[i]));
+        ptrWordOut += BLOCK_LEN_INT64;
+        ptrWordInOut += BLOCK_LEN_INT64;
+        ptrWordIn += BLOCK_LEN_INT64;
+    }
+    for (i = 0; i < VEC_STATE; i++)
+        VEC_STORE(state + i * VEC_WORDS, v[i]);
+}
+
+static const sponge_impl SPONGE_CAT(sponge, SPONGE_SUFFIX) = {
+    SPONGE_NAME,
+    SPONGE_FN(supported),
+    SPONGE_FN(absorbBlockBlake2Safe),
+    SPONGE_FN(absorbBlock),
+    SPONGE_FN(reducedSqueezeRow0),
+    SPONGE_FN(reducedDuplexRow1),
+    SPONGE_FN(reducedDuplexRowSetup),
+    SPONGE_FN(reducedDuplexRow)
+};
+
+#undef VEC_WORDS
+#undef SPONGE_FN
+#undef SPONGE_CAT
+#undef SPONGE_CAT2
@@ -0,0 +1,414 @@
+/**
+ * SSE2, SSSE3, AVX2 and AVX-512 implementations of the Lyra2 sponge row
+ * operations, plus a two-lane AVX-512 variant hashing two inputs at once.
+ * Each instruction set is enabled per function through the target
+ * attribute, so this file builds without any -m flags; the implementation
+ * actually used is chosen at runtime by spongeBestImpl()
+ * from what the CPU reports through cpuid.
+ *
+ * This software is hereby placed in the public domain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS ''AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stddef.h>
+#include "Sponge.h"
+#include "Lyra2.h"
+
+#ifdef SPONGE_X86
+
+#include <immintrin.h>
+
+//=========================== 128-bit state layout ===========================//
+// v[i] holds words 2i and 2i+1 of the sponge state, i.e. the rows of Blake2b's
+// 4x4 state matrix are (v[0], v[1]), (v[2], v[3]), (v[4], v[5]) and (v[6], v[7])
+
+#define LOAD_128(p) _mm_loadu_si128((const __m128i*)(p))
+#define STORE_128(p, x) _mm_storeu_si128((__m128i*)(p), (x))
+
+#define ROT32_128(x) _mm_shuffle_epi32((x), _MM_SHUFFLE(2, 3, 0, 1))
+#define ROT63_128(x) _mm_or_si128(_mm_srli_epi64((x), 63), _mm_add_epi64((x), (x)))
+#define ROTR_128(x, c) _mm_or_si128(_mm_srli_epi64((x), (c)), _mm_slli_epi64((x), 64 - (c)))
+
+#define HALF_G_128(v, rotA, rotB) \
+    v[0] = _mm_add_epi64(v[0], v[2]); v[1] = _mm_add_epi64(v[1], v[3]); \
+    v[6] = rotA(_mm_xor_si128(v[6], v[0])); v[7] = rotA(_mm_xor_si128(v[7], v[1])); \
+    v[4] = _mm_add_epi64(v[4], v[6]); v[5] = _mm_add_epi64(v[5], v[7]); \
+    v[2] = rotB(_mm_xor_si128(v[2], v[4])); v[3] = rotB(_mm_xor_si128(v[3], v[5]));
+
+#define DIAGONALIZE_128(v) do { \
+    __m128i t0 = v[6], t1 = v[2]; \
+    v[6] = v[4]; v[4] = v[5]; v[5] = v[6]; \
+    v[6] = _mm_unpackhi_epi64(v[7], _mm_unpacklo_epi64(t0, t0)); \
+    v[7] = _mm_unpackhi_epi64(t0, _mm_unpacklo_epi64(v[7], v[7])); \
+    v[2] = _mm_unpackhi_epi64(v[2], _mm_unpacklo_epi64(v[3], v[3])); \
+    v[3] = _mm_unpackhi_epi64(v[3], _mm_unpacklo_epi64(t1, t1)); \
+} while (0)
+
+#define UNDIAGONALIZE_128(v) do { \
+    __m128i t0 = v[4], t1; \
+    v[4] = v[5]; v[5] = t0; \
+    t0 = v[2]; t1 = v[6]; \
+    v[2] = _mm_unpackhi_epi64(v[3], _mm_unpacklo_epi64(v[2], v[2])); \
+    v[3] = _mm_unpackhi_epi64(t0, _mm_unpacklo_epi64(v[3], v[3])); \
+    v[6] = _mm_unpackhi_epi64(v[6], _mm_unpacklo_epi64(v[7], v[7])); \
+    v[7] = _mm_unpackhi_epi64(v[7], _mm_unpacklo_epi64(t1, t1)); \
+} while (0)
+
+#define ROUND_128(v, rot24, rot16) do { \
+    HALF_G_128(v, ROT32_128, rot24); \
+    HALF_G_128(v, rot16, ROT63_128); \
+    DIAGONALIZE_128(v); \
+    HALF_G_128(v, ROT32_128, rot24); \
+    HALF_G_128(v, rot16, ROT63_128); \
+    UNDIAGONALIZE_128(v); \
+} while (0)
+
+// out = (s11, s0), (s1, s2), ..., (s9, s10)
+#define ROTW_128(out, v) do { \
+    int j_; \
+    for (j_ = 0; j_ < 6; j_++) \
+        out[j_] = _mm_castpd_si128(_mm_shuffle_pd(_mm_castsi128_pd(v[(j_ + 5) % 6]), _mm_castsi128_pd(v[j_]), 1)); \
+} while (0)
+
+//============================ 256-bit state layout ==========================//
+// v[i] holds row i of Blake2b's 4x4 state matrix (words 4i to 4i+3)
+
+#define LOAD_256(p) _mm256_loadu_si256((const __m256i*)(p))
+#define STORE_256(p, x) _mm256_storeu_si256((__m256i*)(p), (x))
+
+#define HALF_G_256(v, rotA, rotB) \
+    v[0] = _mm256_add_epi64(v[0], v[1]); \
+    v[3] = rotA(_mm256_xor_si256(v[3], v[0])); \
+    v[2] = _mm256_add_epi64(v[2], v[3]); \
+    v[1] = rotB(_mm256_xor_si256(v[1], v[2]));
+
+#define ROUND_256(v, rot32, rot24, rot16, rot63) do { \
+    HALF_G_256(v, rot32, rot24); \
+    HALF_G_256(v, rot16, rot63); \
+    v[1] = _mm256_permute4x64_epi64(v[1], _MM_SHUFFLE(0, 3, 2, 1)); \
+    v[2] = _mm256_permute4x64_epi64(v[2], _MM_SHUFFLE(1, 0, 3, 2)); \
+    v[3] = _mm256_permute4x64_epi64(v[3], _MM_SHUFFLE(2, 1, 0, 3)); \
+    HALF_G_256(v, rot32, rot24); \
+    HALF_G_256(v, rot16, rot63); \
+    v[1] = _mm256_permute4x64_epi64(v[1], _MM_SHUFFLE(2, 1, 0, 3)); \
+    v[2] = _mm256_permute4x64_epi64(v[2], _MM_SHUFFLE(1, 0, 3, 2)); \
+    v[3] = _mm256_permute4x64_epi64(v[3], _MM_SHUFFLE(0, 3, 2, 1)); \
+} while (0)
+
+// out = (s11, s0, s1, s2), (s3, s4, s5, s6), (s7, s8, s9, s10)
+#define ROTW_256(out, v) do { \
+    __m256i t0 = _mm256_permute4x64_epi64(v[0], _MM_SHUFFLE(2, 1, 0, 3)); \
+    __m256i t1 = _mm256_permute4x64_epi64(v[1], _MM_SHUFFLE(2, 1, 0, 3)); \
+    __m256i t2 = _mm256_permute4x64_epi64(v[2], _MM_SHUFFLE(2, 1, 0, 3)); \
+    out[0] = _mm256_blend_epi32(t0, t2, 0x03); \
+    out[1] = _mm256_blend_epi32(t1, t0, 0x03); \
+    out[2] = _mm256_blend_epi32(t2, t1, 0x03); \
+} while (0)
+
+#define ROT32_AVX2(x) _mm256_shuffle_epi32((x), _MM_SHUFFLE(2, 3, 0, 1))
+#define ROT24_AVX2(x) _mm256_shuffle_epi8((x), _mm256_setr_epi8( \
+    3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10, \
+    3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10))
+#define ROT16_AVX2(x) _mm256_shuffle_epi8((x), _mm256_setr_epi8( \
+    2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9, \
+    2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9))
+#define ROT63_AVX2(x) _mm256_or_si256(_mm256_srli_epi64((x), 63), _mm256_add_epi64((x), (x)))
+
+#define ROT32_AVX512(x) _mm256_ror_epi64((x), 32)
+#define ROT24_AVX512(x) _mm256_ror_epi64((x), 24)
+#define ROT16_AVX512(x) _mm256_ror_epi64((x), 16)
+#define ROT63_AVX512(x) _mm256_ror_epi64((x), 63)
+
+//=============================== SSE2 =======================================//
+static int supported_sse2(void) { return __builtin_cpu_supports("sse2"); }
+
+#define SPONGE_NAME "sse2"
+#define SPONGE_SUFFIX sse2
+#define SPONGE_TARGET __attribute__((target("sse2")))
+#define VEC __m128i
+#define VEC_STATE 8
+#define VEC_BLOCK 6
+#define VEC_LOAD LOAD_128
+#define VEC_STORE STORE_128
+#define VEC_XOR _mm_xor_si128
+#define VEC_ADD _mm_add_epi64
+#define ROT24_SSE2(x) ROTR_128(x, 24)
+#define ROT16_SSE2(x) ROTR_128(x, 16)
+#define VEC_ROUND(v) ROUND_128(v, ROT24_SSE2, ROT16_SSE2)
+#define VEC_ROTW ROTW_128
+#include "Sponge_simd.h"
+#undef SPONGE_NAME
+#undef SPONGE_SUFFIX
+#undef SPONGE_TARGET
+#undef VEC_ROUND
+
+//=============================== SSSE3 ======================================//
+static int supported_ssse3(void) { return __builtin_cpu_supports("ssse3"); }
+
+#define SPONGE_NAME "ssse3"
+#define SPONGE_SUFFIX ssse3
+#define SPONGE_TARGET __attribute__((target("ssse3")))
+#define ROT24_SSSE3(x) _mm_shuffle_epi8((x), _mm_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10))
+#define ROT16_SSSE3(x) _mm_shuffle_epi8((x), _mm_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9))
+#define VEC_ROUND(v) ROUND_128(v, ROT24_SSSE3, ROT16_SSSE3)
+#include "Sponge_simd.h"
+#undef SPONGE_NAME
+#undef SPONGE_SUFFIX
+#undef SPONGE_TARGET
+#undef VEC
+#undef VEC_STATE
+#undef VEC_BLOCK
+#undef VEC_LOAD
+#undef VEC_STORE
+#undef VEC_XOR
+#undef VEC_ADD
+#undef VEC_ROUND
+#undef VEC_ROTW
+
+//=============================== AVX2 =======================================//
+static int supported_avx2(void) { return __builtin_cpu_supports("avx2"); }
+
+#define SPONGE_NAME "avx2"
+#define SPONGE_SUFFIX avx2
+#define SPONGE_TARGET __attribute__((target("avx2")))
+#define VEC __m256i
+#define VEC_STATE 4
+#define VEC_BLOCK 3
+#define VEC_LOAD LOAD_256
+#define VEC_STORE STORE_256
+#define VEC_XOR _mm256_xor_si256
+#define VEC_ADD _mm256_add_epi64
+#define VEC_ROUND(v) ROUND_256(v, ROT32_AVX2, ROT24_AVX2, ROT16_AVX2, ROT63_AVX2)
+#define VEC_ROTW ROTW_256
+#include "Sponge_simd.h"
+#undef SPONGE_NAME
+#undef SPONGE_SUFFIX
+#undef SPONGE_TARGET
+#undef VEC_ROUND
+
+//============================ AVX-512 (VL) ==================================//
+// Same layout as AVX2, with the native 64-bit rotate of AVX-512VL
+static int supported_avx512(void) { return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl"); }
+
+#define SPONGE_NAME "avx512"
+#define SPONGE_SUFFIX avx512
+#define SPONGE_TARGET __attribute__((target("avx2,avx512f,avx512vl")))
+#define VEC_ROUND(v) ROUND_256(v, ROT32_AVX512, ROT24_AVX512, ROT16_AVX512, ROT63_AVX512)
+#include "Sponge_simd.h"
+
+/** x86 implementations, from slowest to fastest */
+static const sponge_impl* const x86Impls[] = {
+    &sponge_sse2,
+    &sponge_ssse3,
+    &sponge_avx2,
+    &sponge_avx512
+};
+
+const sponge_impl* spongeImplX86(int n) {
+    if (n < 0 || n >= (int)(sizeof(x86Impls) / sizeof(x86Impls[0])))
+        return NULL;
+    return x86Impls[n];
+}
+
+//===================== AVX-512, two lanes per register ======================//
+// Two independent sponges, interleaved as described for sponge_x2_impl: v[i]
+// holds row i of lane 0's Blake2b state matrix in its low 256 bits and row i
+// of lane 1's in its high 256 bits. The 256-bit layout above thus maps onto
+// 512-bit instructions one to one, as vpermq and vprorq permute and rotate
+// within each 256-bit half.
+
+#define X2_TARGET __attribute__((target("avx2,avx512f")))
+#define X2_BLOCK (2 * BLOCK_LEN_INT64)
+
+#define LOAD_512(p) _mm512_loadu_si512((const void*)(p))
+#define STORE_512(p, x) _mm512_storeu_si512((void*)(p), (x))
+// Low half from lane 0's chunk at p0, high half from lane 1's chunk at p1
+#define LOAD_512_X2(p0, p1) _mm512_mask_loadu_epi64(_mm512_maskz_loadu_epi64(0x0F, (p0)), 0xF0, (p1))
+#define STORE_512_X2(p0, p1, x) do { \
+    __m512i x_ = (x); \
+    _mm512_mask_storeu_epi64((p0), 0x0F, x_); \
+    _mm512_mask_storeu_epi64((p1), 0xF0, x_); \
+} while (0)
+
+#define HALF_G_512(v, c1, c2) \
+    v[0] = _mm512_add_epi64(v[0], v[1]); \
+    v[3] = _mm512_ror_epi64(_mm512_xor_si512(v[3], v[0]), c1); \
+    v[2] = _mm512_add_epi64(v[2], v[3]); \
+    v[1] = _mm512_ror_epi64(_mm512_xor_si512(v[1], v[2]), c2);
+
+#define ROUND_512(v) do { \
+    HALF_G_512(v, 32, 24); \
+    HALF_G_512(v, 16, 63); \
+    v[1] = _mm512_permutex_epi64(v[1], _MM_SHUFFLE(0, 3, 2, 1)); \
+    v[2] = _mm512_permutex_epi64(v[2], _MM_SHUFFLE(1, 0, 3, 2)); \
+    v[3] = _mm512_permutex_epi64(v[3], _MM_SHUFFLE(2, 1, 0, 3)); \
+    HALF_G_512(v, 32, 24); \
+    HALF_G_512(v, 16, 63); \
+    v[1] = _mm512_permutex_epi64(v[1], _MM_SHUFFLE(2, 1, 0, 3)); \
+    v[2] = _mm512_permutex_epi64(v[2], _MM_SHUFFLE(1, 0, 3, 2)); \
+    v[3] = _mm512_permutex_epi64(v[3], _MM_SHUFFLE(0, 3, 2, 1)); \
+} while (0)
+
+// Same as ROTW_256, in each half
+#define ROTW_512(out, v) do { \
+    __m512i t0 = _mm512_permutex_epi64(v[0], _MM_SHUFFLE(2, 1, 0, 3)); \
+    __m512i t1 = _mm512_permutex_epi64(v[1], _MM_SHUFFLE(2, 1, 0, 3)); \
+    __m512i t2 = _mm512_permutex_epi64(v[2], _MM_SHUFFLE(2, 1, 0, 3)); \
+    out[0] = _mm512_mask_blend_epi64(0x11, t0, t2); \
+    out[1] = _mm512_mask_blend_epi64(0x11, t1, t0); \
+    out[2] = _mm512_mask_blend_epi64(0x11, t2, t1); \
+} while (0)
+
+// The state is kept in four named registers rather than an array indexed in
+// loops, which compilers tend to keep on the stack
+#define X2_LOAD_STATE(s) \
+    __m512i v[4]; \
+    v[0] = LOAD_512((s)); v[1] = LOAD_512((s) + 8); v[2] = LOAD_512((s) + 16); v[3] = LOAD_512((s) + 24)
+#define X2_STORE_STATE(s) \
+    STORE_512((s), v[0]); STORE_512((s) + 8, v[1]); STORE_512((s) + 16, v[2]); STORE_512((s) + 24, v[3])
+
+static int supported_avx512x2(void) { return __builtin_cpu_supports("avx512f"); }
+
+static X2_TARGET void absorbBlockBlake2Safe_avx512x2(uint64_t *state, const uint64_t *in) {
+    int i;
+    X2_LOAD_STATE(state);
+    v[0] = _mm512_xor_si512(v[0], LOAD_512(in));
+    v[1] = _mm512_xor_si512(v[1], LOAD_512(in + 8));
+    for (i = 0; i < 12; i++)
+        ROUND_512(v);
+    X2_STORE_STATE(state);
+}
+
+static X2_TARGET void absorbBlock_avx512x2(uint64_t *state, const uint64_t *in0, const uint64_t *in1) {
+    int i;
+    X2_LOAD_STATE(state);
+    v[0] = _mm512_xor_si512(v[0], LOAD_512_X2(in0, in1));
+    v[1] = _mm512_xor_si512(v[1], LOAD_512_X2(in0 + 8, in1 + 8));
+    v[2] = _mm512_xor_si512(v[2], LOAD_512_X2(in0 + 16, in1 + 16));
+    for (i = 0; i < 12; i++)
+        ROUND_512(v);
+    X2_STORE_STATE(state);
+}
+
+static X2_TARGET void reducedSqueezeRow0_avx512x2(uint64_t *state, uint64_t *rowOut, uint64_t nCols) {
+    uint64_t *ptrWord = rowOut + (nCols - 1) * X2_BLOCK;
+    uint64_t col;
+    X2_LOAD_STATE(state);
+    for (col = 0; col < nCols; col++) {
+        STORE_512(ptrWord, v[0]);
+        STORE_512(ptrWord + 8, v[1]);
+        STORE_512(ptrWord + 16, v[2]);
+        ptrWord -= X2_BLOCK;
+        ROUND_512(v);
+    }
+    X2_STORE_STATE(state);
+}
+
+static X2_TARGET void reducedDuplexRow1_avx512x2(uint64_t *state, uint64_t *rowIn, uint64_t *rowOut, uint64_t nCols) {
+    uint64_t *ptrWordIn = rowIn;
+    uint64_t *ptrWordOut = rowOut + (nCols - 1) * X2_BLOCK;
+    __m512i in0, in1, in2;
+    uint64_t col;
+    X2_LOAD_STATE(state);
+    for (col = 0; col < nCols; col++) {
+        in0 = LOAD_512(ptrWordIn);
+        in1 = LOAD_512(ptrWordIn + 8);
+        in2 = LOAD_512(ptrWordIn + 16);
+        v[0] = _mm512_xor_si512(v[0], in0);
+        v[1] = _mm512_xor_si512(v[1], in1);
+        v[2] = _mm512_xor_si512(v[2], in2);
+        ROUND_512(v);
+        STORE_512(ptrWordOut, _mm512_xor_si512(in0, v[0]));
+        STORE_512(ptrWordOut + 8, _mm512_xor_si512(in1, v[1]));
+        STORE_512(ptrWordOut + 16, _mm512_xor_si512(in2, v[2]));
+        ptrWordIn += X2_BLOCK;
+        ptrWordOut -= X2_BLOCK;
+    }
+    X2_STORE_STATE(state);
+}
+
+static X2_TARGET void reducedDuplexRowSetup_avx512x2(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, uint64_t nCols) {
+    uint64_t *ptrWordIn = rowIn;
+    uint64_t *ptrWordInOut = rowInOut;
+    uint64_t *ptrWordOut = rowOut + (nCols - 1) * X2_BLOCK;
+    __m512i in0, in1, in2, rot[3];
+    uint64_t col;
+    X2_LOAD_STATE(state);
+    for (col = 0; col < nCols; col++) {
+        in0 = LOAD_512(ptrWordIn);
+        in1 = LOAD_512(ptrWordIn + 8);
+        in2 = LOAD_512(ptrWordIn + 16);
+        v[0] = _mm512_xor_si512(v[0], _mm512_add_epi64(in0, LOAD_512(ptrWordInOut)));
+        v[1] = _mm512_xor_si512(v[1], _mm512_add_epi64(in1, LOAD_512(ptrWordInOut + 8)));
+        v[2] = _mm512_xor_si512(v[2], _mm512_add_epi64(in2, LOAD_512(ptrWordInOut + 16)));
+        ROUND_512(v);
+        STORE_512(ptrWordOut, _mm512_xor_si512(in0, v[0]));
+        STORE_512(ptrWordOut + 8, _mm512_xor_si512(in1, v[1]));
+        STORE_512(ptrWordOut + 16, _mm512_xor_si512(in2, v[2]));
+        ROTW_512(rot, v);
+        STORE_512(ptrWordInOut, _mm512_xor_si512(LOAD_512(ptrWordInOut), rot[0]));
+        STORE_512(ptrWordInOut + 8, _mm512_xor_si512(LOAD_512(ptrWordInOut + 8), rot[1]));
+        STORE_512(ptrWordInOut + 16, _mm512_xor_si512(LOAD_512(ptrWordInOut + 16), rot[2]));
+        ptrWordInOut += X2_BLOCK;
+        ptrWordIn += X2_BLOCK;
+        ptrWordOut -= X2_BLOCK;
+    }
+    X2_STORE_STATE(state);
+}
+
+static X2_TARGET void reducedDuplexRow_avx512x2(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut0, uint64_t *rowInOut1, uint64_t *rowOut, uint64_t nCols) {
+    uint64_t *ptrWordInOut0 = rowInOut0;
+    uint64_t *ptrWordInOut1 = rowInOut1;
+    uint64_t *ptrWordIn = rowIn;
+    uint64_t *ptrWordOut = rowOut;
+    __m512i rot[3];
+    uint64_t col;
+    X2_LOAD_STATE(state);
+    for (col = 0; col < nCols; col++) {
+        v[0] = _mm512_xor_si512(v[0], _mm512_add_epi64(LOAD_512(ptrWordIn), LOAD_512_X2(ptrWordInOut0, ptrWordInOut1)));
+        v[1] = _mm512_xor_si512(v[1], _mm512_add_epi64(LOAD_512(ptrWordIn + 8), LOAD_512_X2(ptrWordInOut0 + 8, ptrWordInOut1 + 8)));
+        v[2] = _mm512_xor_si512(v[2], _mm512_add_epi64(LOAD_512(ptrWordIn + 16), LOAD_512_X2(ptrWordInOut0 + 16, ptrWordInOut1 + 16)));
+        ROUND_512(v);
+        // rowOut may be the same row as either lane's rowInOut, so rowInOut is
+        // re-read after rowOut has been written, as in the single lane code
+        STORE_512(ptrWordOut, _mm512_xor_si512(LOAD_512(ptrWordOut), v[0]));
+        STORE_512(ptrWordOut + 8, _mm512_xor_si512(LOAD_512(ptrWordOut + 8), v[1]));
+        STORE_512(ptrWordOut + 16, _mm512_xor_si512(LOAD_512(ptrWordOut + 16), v[2]));
+        ROTW_512(rot, v);
+        STORE_512_X2(ptrWordInOut0, ptrWordInOut1, _mm512_xor_si512(LOAD_512_X2(ptrWordInOut0, ptrWordInOut1), rot[0]));
+        STORE_512_X2(ptrWordInOut0 + 8, ptrWordInOut1 + 8, _mm512_xor_si512(LOAD_512_X2(ptrWordInOut0 + 8, ptrWordInOut1 + 8), rot[1]));
+        STORE_512_X2(ptrWordInOut0 + 16, ptrWordInOut1 + 16, _mm512_xor_si512(LOAD_512_X2(ptrWordInOut0 + 16, ptrWordInOut1 + 16), rot[2]));
+        ptrWordOut += X2_BLOCK;
+        ptrWordInOut0 += X2_BLOCK;
+        ptrWordInOut1 += X2_BLOCK;
+        ptrWordIn += X2_BLOCK;
+    }
+    X2_STORE_STATE(state);
+}
+
+static const sponge_x2_impl sponge_avx512x2 = {
+    "avx512x2",
+    supported_avx512x2,
+    absorbBlockBlake2Safe_avx512x2,
+    absorbBlock_avx512x2,
+    reducedSqueezeRow0_avx512x2,
+    reducedDuplexRow1_avx512x2,
+    reducedDuplexRowSetup_avx512x2,
+    reducedDuplexRow_avx512x2
+};
+
+const sponge_x2_impl* spongeX2ImplX86(void) {
+    return &sponge_avx512x2;
+}
+
+#endif // SPONGE_X86
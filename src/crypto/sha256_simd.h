@@ -0,0 +1,122 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Multi-lane double SHA-256 of 64-byte inputs, written once against a small set
+// of vector primitives and instantiated for each instruction set by
+// sha256_x86.cpp. Lane i of every vector belongs to the i-th input.
+//
+// Before inclusion the following must be defined:
+//   SHA256_NS             namespace the functions are placed in
+//   SHA256_TARGET         function attribute enabling the instruction set
+//   SHA256_D64_NAME       name of the resulting TransformD64 function
+//   VEC                   vector type of LANES 32-bit words
+//   LANES                 number of inputs hashed at once
+//   VEC_LOADU/VEC_STOREU  unaligned load and store of LANES words
+//   VEC_SET1(x)           vector with x in every lane
+//   VEC_ADD/VEC_XOR/VEC_AND/VEC_OR  wordwise operations
+//   VEC_SHR(x, n)/VEC_SHL(x, n)     wordwise shifts
+
+namespace SHA256_NS
+{
+namespace
+{
+SHA256_TARGET inline VEC Rotr(VEC x, int n) { return VEC_OR(VEC_SHR(x, n), VEC_SHL(x, 32 - n)); }
+SHA256_TARGET inline VEC Ch(VEC x, VEC y, VEC z) { return VEC_XOR(z, VEC_AND(x, VEC_XOR(y, z))); }
+SHA256_TARGET inline VEC Maj(VEC x, VEC y, VEC z) { return VEC_OR(VEC_AND(x, y), VEC_AND(z, VEC_OR(x, y))); }
+SHA256_TARGET inline VEC Sigma0(VEC x) { return VEC_XOR(VEC_XOR(Rotr(x, 2), Rotr(x, 13)), Rotr(x, 22)); }
+SHA256_TARGET inline VEC Sigma1(VEC x) { return VEC_XOR(VEC_XOR(Rotr(x, 6), Rotr(x, 11)), Rotr(x, 25)); }
+SHA256_TARGET inline VEC sigma0(VEC x) { return VEC_XOR(VEC_XOR(Rotr(x, 7), Rotr(x, 18)), VEC_SHR(x, 3)); }
+SHA256_TARGET inline VEC sigma1(VEC x) { return VEC_XOR(VEC_XOR(Rotr(x, 17), Rotr(x, 19)), VEC_SHR(x, 10)); }
+
+SHA256_TARGET inline void Initialize(VEC* s)
+{
+    s[0] = VEC_SET1(0x6a09e667ul);
+    s[1] = VEC_SET1(0xbb67ae85ul);
+    s[2] = VEC_SET1(0x3c6ef372ul);
+    s[3] = VEC_SET1(0xa54ff53aul);
+    s[4] = VEC_SET1(0x510e527ful);
+    s[5] = VEC_SET1(0x9b05688cul);
+    s[6] = VEC_SET1(0x1f83d9abul);
+    s[7] = VEC_SET1(0x5be0cd19ul);
+}
+
+/** One SHA-256 transformation of the message words w, which are overwritten by the message schedule. */
+SHA256_TARGET void Transform(VEC* s, VEC* w)
+{
+    static const uint32_t K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+    VEC a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int i = 0; i < 64; i++) {
+        if (i >= 16)
+            w[i & 15] = VEC_ADD(VEC_ADD(w[i & 15], sigma0(w[(i + 1) & 15])), VEC_ADD(w[(i + 9) & 15], sigma1(w[(i + 14) & 15])));
+        VEC t1 = VEC_ADD(VEC_ADD(VEC_ADD(h, Sigma1(e)), VEC_ADD(Ch(e, f, g), VEC_SET1(K[i]))), w[i & 15]);
+        VEC t2 = VEC_ADD(Sigma0(a), Maj(a, b, c));
+        h = g;
+        g = f;
+        f = e;
+        e = VEC_ADD(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = VEC_ADD(t1, t2);
+    }
+    s[0] = VEC_ADD(s[0], a);
+    s[1] = VEC_ADD(s[1], b);
+    s[2] = VEC_ADD(s[2], c);
+    s[3] = VEC_ADD(s[3], d);
+    s[4] = VEC_ADD(s[4], e);
+    s[5] = VEC_ADD(s[5], f);
+    s[6] = VEC_ADD(s[6], g);
+    s[7] = VEC_ADD(s[7], h);
+}
+
+} // namespace
+
+/** Double SHA-256 of LANES consecutive 64-byte inputs, writing LANES consecutive 32-byte hashes. */
+SHA256_TARGET void SHA256_D64_NAME(unsigned char* out, const unsigned char* in)
+{
+    uint32_t words[LANES];
+    VEC s[8], w[16];
+    int i, l;
+
+    // First hash: the 64-byte input, followed by a padding block holding only its length
+    for (i = 0; i < 16; i++) {
+        for (l = 0; l < LANES; l++)
+            words[l] = ReadBE32(in + 64 * l + 4 * i);
+        w[i] = VEC_LOADU(words);
+    }
+    Initialize(s);
+    Transform(s, w);
+    for (i = 0; i < 16; i++)
+        w[i] = VEC_SET1(0);
+    w[0] = VEC_SET1(0x80000000ul);
+    w[15] = VEC_SET1(512);
+    Transform(s, w);
+
+    // Second hash: the 32-byte intermediate hash and its padding
+    for (i = 0; i < 8; i++)
+        w[i] = s[i];
+    for (i = 8; i < 16; i++)
+        w[i] = VEC_SET1(0);
+    w[8] = VEC_SET1(0x80000000ul);
+    w[15] = VEC_SET1(256);
+    Initialize(s);
+    Transform(s, w);
+
+    for (i = 0; i < 8; i++) {
+        VEC_STOREU(words, s[i]);
+        for (l = 0; l < LANES; l++)
+            WriteBE32(out + 32 * l + 4 * i, words[l]);
+    }
+}
+
+} // namespace SHA256_NS
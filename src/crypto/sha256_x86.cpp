@@ -0,0 +1,187 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// SHA-256 implementations using SSE4.1 (4 inputs at once), AVX2 (8 inputs at
+// once) and the SHA extensions. Each instruction set is enabled per function
+// through the target attribute, so this file builds without any -m flags;
+// SHA256AutoDetect() picks what the running CPU supports.
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "crypto/common.h"
+
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+//=============================== SSE4.1 =====================================//
+
+#define SHA256_NS sha256_sse41
+#define SHA256_TARGET __attribute__((target("sse4.1")))
+#define SHA256_D64_NAME TransformD64_4way
+#define VEC __m128i
+#define LANES 4
+#define VEC_LOADU(p) _mm_loadu_si128((const __m128i*)(p))
+#define VEC_STOREU(p, x) _mm_storeu_si128((__m128i*)(p), (x))
+#define VEC_SET1(x) _mm_set1_epi32(x)
+#define VEC_ADD _mm_add_epi32
+#define VEC_XOR _mm_xor_si128
+#define VEC_AND _mm_and_si128
+#define VEC_OR _mm_or_si128
+#define VEC_SHR _mm_srli_epi32
+#define VEC_SHL _mm_slli_epi32
+#include "crypto/sha256_simd.h"
+#undef SHA256_NS
+#undef SHA256_TARGET
+#undef SHA256_D64_NAME
+#undef VEC
+#undef LANES
+#undef VEC_LOADU
+#undef VEC_STOREU
+#undef VEC_SET1
+#undef VEC_ADD
+#undef VEC_XOR
+#undef VEC_AND
+#undef VEC_OR
+#undef VEC_SHR
+#undef VEC_SHL
+
+//================================ AVX2 ======================================//
+
+#define SHA256_NS sha256_avx2
+#define SHA256_TARGET __attribute__((target("avx2")))
+#define SHA256_D64_NAME TransformD64_8way
+#define VEC __m256i
+#define LANES 8
+#define VEC_LOADU(p) _mm256_loadu_si256((const __m256i*)(p))
+#define VEC_STOREU(p, x) _mm256_storeu_si256((__m256i*)(p), (x))
+#define VEC_SET1(x) _mm256_set1_epi32(x)
+#define VEC_ADD _mm256_add_epi32
+#define VEC_XOR _mm256_xor_si256
+#define VEC_AND _mm256_and_si256
+#define VEC_OR _mm256_or_si256
+#define VEC_SHR _mm256_srli_epi32
+#define VEC_SHL _mm256_slli_epi32
+#include "crypto/sha256_simd.h"
+
+//============================ SHA extensions ================================//
+
+namespace sha256_shani
+{
+
+bool Supported()
+{
+    unsigned int eax, ebx, ecx, edx;
+    // SHA extensions (leaf 7, EBX bit 29), and SSE4.1 (leaf 1, ECX bit 19) for the shuffles
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & (1 << 19)))
+        return false;
+    if (__get_cpuid_max(0, NULL) < 7)
+        return false;
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ebx >> 29) & 1;
+}
+
+namespace
+{
+const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+} // namespace
+
+// Four rounds with the message words in msg and round constants K[i..i+3]
+#define QUAD_ROUND(msg, i) do { \
+    __m128i m_ = _mm_add_epi32((msg), _mm_loadu_si128((const __m128i*)(K + (i)))); \
+    cdgh = _mm_sha256rnds2_epu32(cdgh, abef, m_); \
+    abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(m_, 0x0E)); \
+} while (0)
+
+// Message schedule: next = next + (cur:prev >> 32 bits), then sha256msg2 with cur
+#define SCHEDULE2(next, cur, prev) \
+    next = _mm_sha256msg2_epu32(_mm_add_epi32(next, _mm_alignr_epi8(cur, prev, 4)), cur)
+#define SCHEDULE1(prev, cur) prev = _mm_sha256msg1_epu32(prev, cur)
+
+__attribute__((target("sse4.1,sha")))
+void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks)
+{
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i abef, cdgh, abefSave, cdghSave, m0, m1, m2, m3, tmp;
+
+    // The SHA instructions want the state as (A, B, E, F) and (C, D, G, H)
+    tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)s), 0xB1);
+    cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(s + 4)), 0x1B);
+    abef = _mm_alignr_epi8(tmp, cdgh, 8);
+    cdgh = _mm_blend_epi16(cdgh, tmp, 0xF0);
+
+    while (blocks--) {
+        abefSave = abef;
+        cdghSave = cdgh;
+
+        m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)chunk), bswap);
+        QUAD_ROUND(m0, 0);
+        m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(chunk + 16)), bswap);
+        QUAD_ROUND(m1, 4);
+        SCHEDULE1(m0, m1);
+        m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(chunk + 32)), bswap);
+        QUAD_ROUND(m2, 8);
+        SCHEDULE1(m1, m2);
+        m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(chunk + 48)), bswap);
+        QUAD_ROUND(m3, 12);
+        SCHEDULE2(m0, m3, m2);
+        SCHEDULE1(m2, m3);
+        QUAD_ROUND(m0, 16);
+        SCHEDULE2(m1, m0, m3);
+        SCHEDULE1(m3, m0);
+        QUAD_ROUND(m1, 20);
+        SCHEDULE2(m2, m1, m0);
+        SCHEDULE1(m0, m1);
+        QUAD_ROUND(m2, 24);
+        SCHEDULE2(m3, m2, m1);
+        SCHEDULE1(m1, m2);
+        QUAD_ROUND(m3, 28);
+        SCHEDULE2(m0, m3, m2);
+        SCHEDULE1(m2, m3);
+        QUAD_ROUND(m0, 32);
+        SCHEDULE2(m1, m0, m3);
+        SCHEDULE1(m3, m0);
+        QUAD_ROUND(m1, 36);
+        SCHEDULE2(m2, m1, m0);
+        SCHEDULE1(m0, m1);
+        QUAD_ROUND(m2, 40);
+        SCHEDULE2(m3, m2, m1);
+        SCHEDULE1(m1, m2);
+        QUAD_ROUND(m3, 44);
+        SCHEDULE2(m0, m3, m2);
+        SCHEDULE1(m2, m3);
+        QUAD_ROUND(m0, 48);
+        SCHEDULE2(m1, m0, m3);
+        SCHEDULE1(m3, m0);
+        QUAD_ROUND(m1, 52);
+        SCHEDULE2(m2, m1, m0);
+        QUAD_ROUND(m2, 56);
+        SCHEDULE2(m3, m2, m1);
+        QUAD_ROUND(m3, 60);
+
+        abef = _mm_add_epi32(abef, abefSave);
+        cdgh = _mm_add_epi32(cdgh, cdghSave);
+        chunk += 64;
+    }
+
+    // Back to (A, B, C, D) and (E, F, G, H)
+    tmp = _mm_shuffle_epi32(abef, 0x1B);
+    cdgh = _mm_shuffle_epi32(cdgh, 0xB1);
+    _mm_storeu_si128((__m128i*)s, _mm_blend_epi16(tmp, cdgh, 0xF0));
+    _mm_storeu_si128((__m128i*)(s + 4), _mm_alignr_epi8(cdgh, tmp, 8));
+}
+
+} // namespace sha256_shani
+
+#endif
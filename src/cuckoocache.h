@@ -0,0 +1,228 @@
+// Copyright (c) 2016 Jeremy Rubin
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CUCKOOCACHE_H
+#define BITCOIN_CUCKOOCACHE_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Fixed-size cache with cuckoo hashing, for sets of small elements that are
+ * looked up far more often than they are inserted (like the signature cache).
+ *
+ * Every element has 8 candidate slots, picked by the 8 hash functions of Hash
+ * (an operator()<n>() for n in 0..7). The table never allocates after setup().
+ *
+ * Eviction uses two kinds of flags per slot:
+ * - collection flags, marking slots that may be overwritten. They are atomic,
+ *   so contains(e, true) can mark an entry as erasable while only holding a
+ *   shared lock.
+ * - epoch flags, marking slots written in the current generation. Once a
+ *   generation fills up, all entries from the previous one become erasable.
+ *
+ * Concurrency: contains() may run concurrently with other contains() calls;
+ * insert() and setup() require exclusive access.
+ */
+namespace CuckooCache
+{
+
+/** Array of bits, each of which can be set and unset atomically. */
+class bit_packed_atomic_flags
+{
+    std::unique_ptr<std::atomic<uint8_t>[]> mem;
+
+public:
+    bit_packed_atomic_flags() = delete;
+
+    /** All bits start out set. */
+    explicit bit_packed_atomic_flags(uint32_t size)
+    {
+        size = (size + 7) / 8;
+        mem.reset(new std::atomic<uint8_t>[size]);
+        for (uint32_t i = 0; i < size; ++i)
+            mem[i].store(0xFF);
+    }
+
+    /** Reallocate for b bits, all set. Not thread safe. */
+    void setup(uint32_t b)
+    {
+        bit_packed_atomic_flags d(b);
+        std::swap(mem, d.mem);
+    }
+
+    void bit_set(uint32_t s)
+    {
+        mem[s >> 3].fetch_or(1 << (s & 7), std::memory_order_relaxed);
+    }
+
+    void bit_unset(uint32_t s)
+    {
+        mem[s >> 3].fetch_and(~(1 << (s & 7)), std::memory_order_relaxed);
+    }
+
+    bool bit_is_set(uint32_t s) const
+    {
+        return (1 << (s & 7)) & mem[s >> 3].load(std::memory_order_relaxed);
+    }
+};
+
+template <typename Element, typename Hash>
+class cache
+{
+private:
+    std::vector<Element> table;
+    uint32_t size;
+    //! Set when a slot may be overwritten
+    mutable bit_packed_atomic_flags collection_flags;
+    //! Set when a slot was written during the current generation
+    std::vector<bool> epoch_flags;
+    //! Inserts left before epoch_check() scans the table again
+    uint32_t epoch_heuristic_counter;
+    //! Number of live entries in the current generation that starts a new one
+    uint32_t epoch_size;
+    //! Maximum number of displacements per insert
+    uint8_t depth_limit;
+    const Hash hash_function;
+
+    /** Map each of the 8 hashes of e onto [0, size) with a multiply-shift instead of a modulo. */
+    std::array<uint32_t, 8> compute_hashes(const Element& e) const
+    {
+        return {{(uint32_t)((hash_function.template operator()<0>(e) * (uint64_t)size) >> 32),
+                 (uint32_t)((hash_function.template operator()<1>(e) * (uint64_t)size) >> 32),
+                 (uint32_t)((hash_function.template operator()<2>(e) * (uint64_t)size) >> 32),
+                 (uint32_t)((hash_function.template operator()<3>(e) * (uint64_t)size) >> 32),
+                 (uint32_t)((hash_function.template operator()<4>(e) * (uint64_t)size) >> 32),
+                 (uint32_t)((hash_function.template operator()<5>(e) * (uint64_t)size) >> 32),
+                 (uint32_t)((hash_function.template operator()<6>(e) * (uint64_t)size) >> 32),
+                 (uint32_t)((hash_function.template operator()<7>(e) * (uint64_t)size) >> 32)}};
+    }
+
+    static uint32_t invalid() { return ~(uint32_t)0; }
+
+    void allow_erase(uint32_t n) const { collection_flags.bit_set(n); }
+    void please_keep(uint32_t n) const { collection_flags.bit_unset(n); }
+
+    /**
+     * Start a new generation once the current one holds epoch_size live
+     * entries, making everything from the previous generation erasable. The
+     * full scan is amortized by only repeating it after enough inserts that
+     * the threshold could have been reached.
+     */
+    void epoch_check()
+    {
+        if (epoch_heuristic_counter != 0) {
+            --epoch_heuristic_counter;
+            return;
+        }
+        uint32_t epoch_unused_count = 0;
+        for (uint32_t i = 0; i < size; ++i)
+            epoch_unused_count += epoch_flags[i] && !collection_flags.bit_is_set(i);
+        if (epoch_unused_count >= epoch_size) {
+            for (uint32_t i = 0; i < size; ++i) {
+                if (epoch_flags[i])
+                    epoch_flags[i] = false;
+                else
+                    allow_erase(i);
+            }
+            epoch_heuristic_counter = epoch_size;
+        } else {
+            epoch_heuristic_counter = std::max(1u, std::max(epoch_size / 16, epoch_size - std::min(epoch_size, epoch_unused_count)));
+        }
+    }
+
+public:
+    /** Starts out with the smallest table, so that it can be used before setup() */
+    cache() : table(), size(), collection_flags(0), epoch_flags(),
+              epoch_heuristic_counter(), epoch_size(), depth_limit(0), hash_function()
+    {
+        setup(2);
+    }
+
+    /** Allocate room for new_size elements (at least 2), discarding the current contents. Returns the size used. */
+    uint32_t setup(uint32_t new_size)
+    {
+        size = std::max<uint32_t>(2, new_size);
+        depth_limit = static_cast<uint8_t>(std::log2(static_cast<float>(size)));
+        table.assign(size, Element());
+        collection_flags.setup(size);
+        epoch_flags.assign(size, false);
+        // A generation is closed once it fills 45% of the table
+        epoch_size = std::max((uint32_t)1, (45 * size) / 100);
+        epoch_heuristic_counter = epoch_size;
+        return size;
+    }
+
+    /** setup() with as many elements as fit in the given number of bytes. */
+    uint32_t setup_bytes(size_t bytes)
+    {
+        return setup(bytes / sizeof(Element));
+    }
+
+    /**
+     * Insert e, displacing existing entries along their alternative slots if
+     * all 8 candidates are taken. After depth_limit displacements the element
+     * in hand is dropped, which is the least recently inserted one of the
+     * chain more often than not.
+     */
+    void insert(Element e)
+    {
+        epoch_check();
+        uint32_t last_loc = invalid();
+        bool last_epoch = true;
+        std::array<uint32_t, 8> locs = compute_hashes(e);
+        // Refresh the entry if it is already present
+        for (uint32_t loc : locs) {
+            if (table[loc] == e) {
+                please_keep(loc);
+                epoch_flags[loc] = last_epoch;
+                return;
+            }
+        }
+        for (uint8_t depth = 0; depth < depth_limit; ++depth) {
+            // Take any slot that may be overwritten
+            for (uint32_t loc : locs) {
+                if (!collection_flags.bit_is_set(loc))
+                    continue;
+                table[loc] = std::move(e);
+                please_keep(loc);
+                epoch_flags[loc] = last_epoch;
+                return;
+            }
+            // Otherwise swap with the entry in the slot after the one we last
+            // came from, and continue with the displaced entry
+            last_loc = locs[(1 + (std::find(locs.begin(), locs.end(), last_loc) - locs.begin())) & 7];
+            std::swap(table[last_loc], e);
+            bool epoch = last_epoch;
+            last_epoch = epoch_flags[last_loc];
+            epoch_flags[last_loc] = epoch;
+            locs = compute_hashes(e);
+        }
+    }
+
+    /** Whether e is present. With erase set, a hit is marked as erasable (but stays readable until overwritten). */
+    bool contains(const Element& e, const bool erase) const
+    {
+        std::array<uint32_t, 8> locs = compute_hashes(e);
+        for (uint32_t loc : locs) {
+            if (table[loc] == e) {
+                if (erase)
+                    allow_erase(loc);
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+} // namespace CuckooCache
+
+#endif // BITCOIN_CUCKOOCACHE_H
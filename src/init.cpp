@@ -12,15 +12,19 @@
 #include "init.h"
 
 #include "addrman.h"
+#include "blockreader.h"
 #include "amount.h"
 #include "base58.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
+#include "coinsprefetch.h"
+#include "coinswriter.h"
 #include "compat/sanity.h"
 #include "consensus/validation.h"
 #include "httpserver.h"
 #include "httprpc.h"
+#include "crypto/sha256.h"
 #include "key.h"
 #include "validation.h"
 #include "miner.h"
@@ -37,6 +41,7 @@
 #include "txmempool.h"
 #include "torcontrol.h"
 #include "ui_interface.h"
+#include "utxosnapshot.h"
 #include "util.h"
 #include "utilmoneystr.h"
 #include "utilstrencodings.h"
@@ -192,8 +197,18 @@ public:
         }
     }
     // Writes do not need similar protection, as failure to write is handled by the caller.
+    bool BatchWriteKeep(const CCoinsMap &mapCoins, const uint256 &hashBlock) override {
+        return base->BatchWriteKeep(mapCoins, hashBlock);
+    }
 };
 
+//! Called from the coins writer thread when it failed to write a flush to the database
+static void CoinsWriteFailed()
+{
+    uiInterface.ThreadSafeMessageBox(_("Error writing to database, shutting down."), "", CClientUIInterface::MSG_ERROR);
+    StartShutdown();
+}
+
 static CCoinsViewErrorCatcher *pcoinscatcher = NULL;
 static boost::scoped_ptr<ECCVerifyHandle> globalVerifyHandle;
 
@@ -270,12 +285,18 @@ void PrepareShutdown()
         }
         delete pcoinsTip;
         pcoinsTip = NULL;
+        delete pcoinswriter;
+        pcoinswriter = NULL;
+        delete pcoinsprefetch;
+        pcoinsprefetch = NULL;
         delete pcoinscatcher;
         pcoinscatcher = NULL;
         delete pcoinsdbview;
         pcoinsdbview = NULL;
         delete pblocktree;
         pblocktree = NULL;
+        delete pblockreader;
+        pblockreader = NULL;
     }
 #ifdef ENABLE_WALLET
     if (pwalletMain)
@@ -395,6 +416,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-version", _("Print version and exit"));
     strUsage += HelpMessageOpt("-alerts", strprintf(_("Receive and display P2P network alerts (default: %u)"), DEFAULT_ALERTS));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)"));
+    strUsage += HelpMessageOpt("-backgroundflush", strprintf(_("Write the chainstate to disk in the background while validation continues, keeping recently used coins cached (default: %u)"), DEFAULT_BACKGROUND_FLUSH));
+    strUsage += HelpMessageOpt("-blockmmap", strprintf(_("Read stored blocks through memory-mapped block files, serving them to peers without parsing (default: %u)"), DEFAULT_BLOCK_MMAP));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
     if (showDebug)
         strUsage += HelpMessageOpt("-blocksonly", strprintf(_("Whether to operate in a blocks only mode (default: %u)"), DEFAULT_BLOCKSONLY));
@@ -409,6 +432,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file on startup"));
+    strUsage += HelpMessageOpt("-loadtxoutset=<file>", _("Replace the chainstate with a UTXO snapshot on startup, if it matches a known snapshot and the active chain is below it (see dumptxoutset; requires -txindex=0)"));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
     strUsage += HelpMessageOpt("-maxmempool=<n>", strprintf(_("Keep the transaction memory pool below <n> megabytes (default: %u)"), DEFAULT_MAX_MEMPOOL_SIZE));
     strUsage += HelpMessageOpt("-mempoolexpiry=<n>", strprintf(_("Do not keep transactions in the mempool longer than <n> hours (default: %u)"), DEFAULT_MEMPOOL_EXPIRY));
@@ -417,6 +441,8 @@ std::string HelpMessage(HelpMessageMode mode)
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), BITCOIN_PID_FILENAME));
 #endif
+    strUsage += HelpMessageOpt("-prefetchcoins=<n>", strprintf(_("Set the number of threads loading the inputs of blocks ahead of their validation during initial sync (0 to %d, 0 = disable, default: %d)"),
+        MAX_PREFETCH_THREADS, DEFAULT_PREFETCH_THREADS));
     strUsage += HelpMessageOpt("-prune=<n>", strprintf(_("Reduce storage requirements by pruning (deleting) old blocks. This mode is incompatible with -txindex and -rescan. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, >%u = target size in MiB to use for block files)"), MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024));
@@ -430,6 +456,9 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-addressindex", strprintf(_("Maintain a full address index, used to query for the balance, txids and unspent outputs for addresses (default: %u)"), DEFAULT_ADDRESSINDEX));
     strUsage += HelpMessageOpt("-timestampindex", strprintf(_("Maintain a timestamp index for block hashes, used to query blocks hashes by a range of timestamps (default: %u)"), DEFAULT_TIMESTAMPINDEX));
     strUsage += HelpMessageOpt("-spentindex", strprintf(_("Maintain a full spent index, used to query the spending txid and input index for an outpoint (default: %u)"), DEFAULT_SPENTINDEX));
+    strUsage += HelpMessageOpt("-blockfilterindex", strprintf(_("Maintain a compact filter of the scripts in every block, used by wallet rescans to skip blocks (such rescans do not find bare multisig outputs) and by the getblockfilter rpc call (default: %u)"), DEFAULT_BLOCKFILTERINDEX));
+    strUsage += HelpMessageOpt("-addressindex, -spentindex, -timestampindex, -blockfilterindex", _("When enabled on an existing database, these indexes are built in the background while the node runs"));
+    strUsage += HelpMessageOpt("-coinstatsindex", strprintf(_("Maintain a per-block UTXO set commitment and totals, used by gettxoutsetinfo \"muhash\" (default: %u)"), DEFAULT_COINSTATSINDEX));
 
     strUsage += HelpMessageGroup(_("Connection options:"));
     strUsage += HelpMessageOpt("-addnode=<ip>", _("Add a node to connect to and attempt to keep the connection open"));
@@ -451,6 +480,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
     strUsage += HelpMessageOpt("-permitbaremultisig", strprintf(_("Relay non-P2SH multisig (default: %u)"), DEFAULT_PERMIT_BAREMULTISIG));
     strUsage += HelpMessageOpt("-peerbloomfilters", strprintf(_("Support filtering of blocks and transaction with bloom filters (default: %u)"), 1));
+    strUsage += HelpMessageOpt("-peerblockfilters", strprintf(_("Serve compact block filters to peers per BIP 157, requires -blockfilterindex (default: %u)"), DEFAULT_PEERBLOCKFILTERS));
     if (showDebug)
         strUsage += HelpMessageOpt("-enforcenodebloom", strprintf("Enforce minimum protocol version to limit use of bloom filters (default: %u)", 0));
     strUsage += HelpMessageOpt("-port=<port>", strprintf(_("Listen for connections on <port> (default: %u or testnet: %u)"), Params(CBaseChainParams::MAIN).GetDefaultPort(), Params(CBaseChainParams::TESTNET).GetDefaultPort()));
@@ -529,6 +559,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-checkblocks=<n>", strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"), DEFAULT_CHECKBLOCKS));
         strUsage += HelpMessageOpt("-checklevel=<n>", strprintf(_("How thorough the block verification of -checkblocks is (0-4, default: %u)"), DEFAULT_CHECKLEVEL));
         strUsage += HelpMessageOpt("-checkblockindex", strprintf("Do a full consistency check for mapBlockIndex, setBlockIndexCandidates, chainActive and mapBlocksUnlinked occasionally. Also sets -checkmempool (default: %u)", Params(CBaseChainParams::MAIN).DefaultConsistencyChecks()));
+        strUsage += HelpMessageOpt("-checkblockreadpow", strprintf("Recheck the proof of work of every block read from disk instead of comparing its header with the block index (default: %u)", DEFAULT_CHECK_BLOCK_READ_POW));
         strUsage += HelpMessageOpt("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u)", Params(CBaseChainParams::MAIN).DefaultConsistencyChecks()));
         strUsage += HelpMessageOpt("-checkpoints", strprintf("Disable expensive verification for known chain history (default: %u)", DEFAULT_CHECKPOINTS_ENABLED));
 #ifdef ENABLE_WALLET
@@ -567,7 +598,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-mocktime=<n>", "Replace actual time with <n> seconds since epoch (default: 0)");
         strUsage += HelpMessageOpt("-limitfreerelay=<n>", strprintf("Continuously rate-limit free transactions to <n>*1000 bytes per minute (default: %u)", DEFAULT_LIMITFREERELAY));
         strUsage += HelpMessageOpt("-relaypriority", strprintf("Require high priority for relaying free or low-fee transactions (default: %u)", DEFAULT_RELAYPRIORITY));
-        strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf("Limit size of signature cache to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf("Limit sum of signature cache and script execution cache sizes to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE));
     }
     strUsage += HelpMessageOpt("-minrelaytxfee=<amt>", strprintf(_("Fees (in %s/kB) smaller than this are considered zero fee for relaying, mining and transaction creation (default: %s)"),
         CURRENCY_UNIT, FormatMoney(DEFAULT_MIN_RELAY_TX_FEE)));
@@ -773,6 +804,21 @@ void ThreadImport(std::vector<boost::filesystem::path> vImportFiles)
         }
     }
 
+    // -loadtxoutset=
+    if (mapArgs.count("-loadtxoutset")) {
+        CSnapshotMetadata metadata;
+        std::string strError;
+        if (!LoadSnapshotChainstate(chainparams, GetArg("-loadtxoutset", ""), metadata, strError)) {
+            InitError(strprintf(_("Failed to load UTXO snapshot: %s"), strError));
+            StartShutdown();
+            return;
+        }
+        // Blocks below the snapshot are never downloaded, so they cannot be served.
+        // If the node is not started yet, this is done on the start instead.
+        if (g_connman)
+            g_connman->RemoveLocalServices(NODE_NETWORK);
+    }
+
     // scan for better chains in the block chain database, that are not yet connected in the active best chain
     CValidationState state;
     if (!ActivateBestChain(state, chainparams)) {
@@ -1078,6 +1124,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     }
     fCheckBlockIndex = GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled = GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
+    fCheckBlockReadPoW = GetBoolArg("-checkblockreadpow", DEFAULT_CHECK_BLOCK_READ_POW);
 
     hashAssumeValid = uint256S(GetArg("-assumevalid", chainparams.GetConsensus().defaultAssumeValid.GetHex()));
     if (!hashAssumeValid.IsNull())
@@ -1212,6 +1259,12 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     if (GetBoolArg("-peerbloomfilters", true))
         nLocalServices = ServiceFlags(nLocalServices | NODE_BLOOM);
 
+    if (GetBoolArg("-peerblockfilters", DEFAULT_PEERBLOCKFILTERS)) {
+        if (!GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX))
+            return InitError(_("Cannot set -peerblockfilters without -blockfilterindex."));
+        nLocalServices = ServiceFlags(nLocalServices | NODE_COMPACT_FILTERS);
+    }
+
     fEnableReplacement = GetBoolArg("-mempoolreplacement", DEFAULT_ENABLE_REPLACEMENT);
     if ((!fEnableReplacement) && mapArgs.count("-mempoolreplacement")) {
         // Minimal effort at forwards compatibility
@@ -1226,6 +1279,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     // Initialize fast PRNG
     seed_insecure_rand(false);
 
+    // Pick the fastest SHA256 implementation the CPU supports
+    std::string sha256_algo = SHA256AutoDetect();
+
     // Initialize elliptic curve code
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1271,16 +1327,22 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 #endif
     if (!fLogTimestamps)
         LogPrintf("Startup time: %s\n", DateTimeStrFormat("%Y-%m-%d %H:%M:%S", GetTime()));
+    LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
     LogPrintf("Default data directory %s\n", GetDefaultDataDir().string());
     LogPrintf("Using data directory %s\n", strDataDir);
     LogPrintf("Using config file %s\n", GetConfigFile().string());
     LogPrintf("Using at most %i connections (%i file descriptors available)\n", nMaxConnections, nFD);
     std::ostringstream strErrors;
 
+    InitSignatureCache();
+    InitScriptExecutionCache();
+
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
-        for (int i=0; i<nScriptCheckThreads-1; i++)
+        for (int i=0; i<nScriptCheckThreads-1; i++) {
             threadGroup.create_thread(&ThreadScriptCheck);
+            threadGroup.create_thread(&ThreadHeaderHashCheck);
+        }
     }
 
     if (mapArgs.count("-sporkkey")) // spork priv key
@@ -1542,6 +1604,15 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set (plus up to %.1fMiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
 
+    if (GetBoolArg("-blockmmap", DEFAULT_BLOCK_MMAP)) {
+#ifdef WIN32
+        InitWarning(_("Memory-mapped block files are not supported on this platform, ignoring -blockmmap"));
+#else
+        pblockreader = new CBlockFileReader();
+        LogPrintf("* Reading blocks through memory-mapped block files\n");
+#endif
+    }
+
     bool fLoaded = false;
     while (!fLoaded && !fRequestShutdown) {
         bool fReset = fReindex;
@@ -1554,6 +1625,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             try {
                 UnloadBlockIndex();
                 delete pcoinsTip;
+                delete pcoinswriter;
+                delete pcoinsprefetch;
                 delete pcoinsdbview;
                 delete pcoinscatcher;
                 delete pblocktree;
@@ -1561,7 +1634,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                 pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex);
                 pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex || fReindexChainState);
                 pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
-                pcoinsTip = new CCoinsViewCache(pcoinscatcher);
+                pcoinsprefetch = new CCoinsViewPrefetch(pcoinscatcher);
+                pcoinswriter = new CCoinsViewWriter(pcoinsprefetch, CoinsWriteFailed);
+                pcoinsTip = new CCoinsViewCache(pcoinswriter);
 
                 if (fReindex) {
                     pblocktree->WriteReindexing(true);
@@ -1582,6 +1657,13 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                     break;
                 }
 
+                bool fLoadingSnapshot = false;
+                pblocktree->ReadFlag("loadingsnapshot", fLoadingSnapshot);
+                if (fLoadingSnapshot) {
+                    strLoadError = _("Loading a UTXO snapshot was interrupted, you need to rebuild the database using -reindex");
+                    break;
+                }
+
                 // If the loaded chain has a wrong genesis, bail out immediately
                 // (we're likely using a testnet datadir, or the other way around).
                 if (!mapBlockIndex.empty() && mapBlockIndex.count(chainparams.GetConsensus().hashGenesisBlock) == 0)
@@ -1599,6 +1681,10 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                     break;
                 }
 
+                // Indexes enabled on an existing database are built in the background
+                if (!LoadIndexBuildState(strLoadError))
+                    break;
+
                 // Check for changed -prune state.  What we are concerned about is a user who has pruned blocks
                 // in the past, but is now trying to run unpruned.
                 if (fHavePruned && !fPruneMode) {
@@ -1667,6 +1753,11 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     }
     LogPrintf(" block index %15dms\n", GetTimeMillis() - nStart);
 
+    int nPrefetchThreads = std::max(0, std::min((int)GetArg("-prefetchcoins", DEFAULT_PREFETCH_THREADS), MAX_PREFETCH_THREADS));
+    LogPrintf("Using %d threads for coin prefetching\n", nPrefetchThreads);
+    for (int i = 0; i < nPrefetchThreads; i++)
+        threadGroup.create_thread(boost::bind(&CCoinsViewPrefetch::ThreadPrefetch, pcoinsprefetch));
+
     boost::filesystem::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
     CAutoFile est_filein(fopen(est_path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
     // Allowed to fail as this file IS missing on first startup.
@@ -1885,6 +1976,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             vImportFiles.push_back(strFile);
     }
     threadGroup.create_thread(boost::bind(&ThreadImport, vImportFiles));
+    if (IsIndexBuilding(INDEX_BUILD_ADDRESS | INDEX_BUILD_SPENT | INDEX_BUILD_TIMESTAMP | INDEX_BUILD_BLOCKFILTER))
+        threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "indexbuild", &ThreadBuildIndexes));
     if (chainActive.Tip() == NULL) {
         LogPrintf("Waiting for genesis block to be imported...\n");
         while (!fRequestShutdown && chainActive.Tip() == NULL)
@@ -2072,6 +2165,16 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     if (!connman.Start(scheduler, strNodeError, connOptions))
         return InitError(strNodeError);
 
+    // A chainstate loaded from a UTXO snapshot, on an earlier run or by the
+    // import thread before the start, lacks the blocks below it
+    {
+        LOCK(cs_main);
+        if (GetSnapshotBase()) {
+            LogPrintf("Unsetting NODE_NETWORK on UTXO snapshot chainstate\n");
+            connman.RemoveLocalServices(NODE_NETWORK);
+        }
+    }
+
     // Generate coins in the background
     GenerateBitcoins(GetBoolArg("-gen", DEFAULT_GENERATE), GetArg("-genproclimit", DEFAULT_GENERATE_THREADS), chainparams, connman);
 
@@ -5,6 +5,8 @@
 #ifndef BITCOIN_MEMUSAGE_H
 #define BITCOIN_MEMUSAGE_H
 
+#include "support/allocators/pool.h"
+
 #include <stdlib.h>
 
 #include <map>
@@ -141,6 +143,16 @@ static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z>& m)
     return MallocUsage(sizeof(unordered_node<std::pair<const X, Y> >)) * m.size() + MallocUsage(sizeof(void*) * m.bucket_count());
 }
 
+template<typename X, typename Y, typename Z, typename P, size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES>
+static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z, P, PoolAllocator<std::pair<const X, Y>, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> >& m)
+{
+    // Nodes live in the pool's chunks, which are counted whole (used or not).
+    // The chunk pointers are kept in a std::list of 3-pointer nodes.
+    const PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>* resource = m.get_allocator().resource();
+    size_t usage_chunks = (MallocUsage(resource->ChunkSizeBytes()) + MallocUsage(sizeof(void*) * 3)) * resource->NumAllocatedChunks();
+    return usage_chunks + MallocUsage(sizeof(void*) * m.bucket_count());
+}
+
 }
 
 #endif // BITCOIN_MEMUSAGE_H
@@ -312,6 +312,7 @@ CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& s
         pblock->nBits          = GetNextWorkRequired(pindexPrev, pblock, chainparams.GetConsensus());
         pblock->nNonce         = 0;
         pblocktemplate->vTxSigOps[0] = GetLegacySigOpCount(pblock->vtx[0]);
+        pblocktemplate->vCoinbaseMerkleBranch = BlockMerkleBranch(*pblock, 0);
 
         CValidationState state;
         if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
@@ -322,7 +323,7 @@ CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& s
     return pblocktemplate.release();
 }
 
-void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
+static void UpdateExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
 {
     // Update nExtraNonce
     static uint256 hashPrevBlock;
@@ -338,9 +339,22 @@ void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned
     assert(txCoinbase.vin[0].scriptSig.size() <= 100);
 
     pblock->vtx[0] = txCoinbase;
+}
+
+void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
+{
+    UpdateExtraNonce(pblock, pindexPrev, nExtraNonce);
     pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
 }
 
+void IncrementExtraNonce(CBlockTemplate* pblocktemplate, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
+{
+    CBlock* pblock = &pblocktemplate->block;
+    UpdateExtraNonce(pblock, pindexPrev, nExtraNonce);
+    // Only the coinbase changed, so its branch is still valid
+    pblock->hashMerkleRoot = ComputeMerkleRootFromBranch(pblock->vtx[0].GetHash(), pblocktemplate->vCoinbaseMerkleBranch, 0);
+}
+
 
 static bool ProcessBlockFound(const CBlock* pblock, const CChainParams& chainparams)
 {
@@ -364,6 +378,10 @@ static bool ProcessBlockFound(const CBlock* pblock, const CChainParams& chainpar
     return true;
 }
 
+// Nonces hashed per lyra2z_hash_nonces() call; must divide 256 so that the
+// search loop below still stops at every multiple of 256
+static const unsigned int MINER_NONCE_BATCH = 8;
+
 // ***TODO*** that part changed in bitcoin, we are using a mix with old one here for now
 void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman)
 {
@@ -373,6 +391,10 @@ void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman)
 
     unsigned int nExtraNonce = 0;
 
+    // Lyra2Z memory matrix reused for every nonce this thread tries
+    lyra2z_ctx ctx;
+    lyra2z_ctx_init(&ctx);
+
     boost::shared_ptr<CReserveScript> coinbaseScript;
     GetMainSignals().ScriptForMining(coinbaseScript);
 
@@ -410,7 +432,7 @@ void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman)
                 return;
             }
             CBlock *pblock = &pblocktemplate->block;
-            IncrementExtraNonce(pblock, pindexPrev, nExtraNonce);
+            IncrementExtraNonce(pblocktemplate.get(), pindexPrev, nExtraNonce);
 
             LogPrintf("MANOMiner -- Running miner with %u transactions in block (%u bytes)\n", pblock->vtx.size(),
                 ::GetSerializeSize(*pblock, SER_NETWORK, PROTOCOL_VERSION));
@@ -424,13 +446,26 @@ void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman)
             {
                 unsigned int nHashesDone = 0;
 
+                // Everything but the nonce is fixed until the next time update
+                lyra2z_midstate midstate;
+                lyra2z_midstate_init(&midstate, BEGIN(pblock->nVersion));
+
                 uint256 thash;
+                char hashes[MINER_NONCE_BATCH * 32];
                 while (true)
                 {
-                    lyra2z_hash(BEGIN(pblock->nVersion), BEGIN(thash));
-                    if (UintToArith256(thash) <= hashTarget)
+                    lyra2z_hash_nonces(&ctx, &midstate, pblock->nNonce, MINER_NONCE_BATCH, hashes);
+                    int nFound = -1;
+                    for (unsigned int i = 0; i < MINER_NONCE_BATCH && nFound < 0; i++) {
+                        memcpy(thash.begin(), hashes + i * 32, 32);
+                        if (UintToArith256(thash) <= hashTarget)
+                            nFound = i;
+                    }
+                    if (nFound >= 0)
                     {
                         // Found a solution
+                        pblock->nNonce += nFound;
+                        pblock->SetCachedHash(thash);
                         SetThreadPriority(THREAD_PRIORITY_NORMAL);
                         LogPrintf("MANOMiner:\n  proof-of-work found\n  hash: %s\n  target: %s\n", thash.GetHex(), hashTarget.GetHex());
                         ProcessBlockFound(pblock, chainparams);
@@ -444,8 +479,8 @@ void static BitcoinMiner(const CChainParams& chainparams, CConnman& connman)
 
                         break;
                     }
-                    pblock->nNonce += 1;
-                    nHashesDone += 1;
+                    pblock->nNonce += MINER_NONCE_BATCH;
+                    nHashesDone += MINER_NONCE_BATCH;
                     if ((pblock->nNonce & 0xFF) == 0)
                         break;
                 }
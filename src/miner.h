@@ -28,6 +28,9 @@ struct CBlockTemplate
     CBlock block;
     std::vector<CAmount> vTxFees;
     std::vector<int64_t> vTxSigOps;
+    // Merkle branch of the coinbase (leaf 0), so the root can be recomputed
+    // with log2(n) hashes when only the coinbase changes
+    std::vector<uint256> vCoinbaseMerkleBranch;
 };
 
 /** Run the miner threads */
@@ -36,6 +39,8 @@ void GenerateBitcoins(bool fGenerate, int nThreads, const CChainParams& chainpar
 CBlockTemplate* CreateNewBlock(const CChainParams& chainparams, const CScript& scriptPubKeyIn);
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
+/** Modify the extranonce in a block template, using its coinbase merkle branch to update the merkle root */
+void IncrementExtraNonce(CBlockTemplate* pblocktemplate, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
 
 #endif // BITCOIN_MINER_H
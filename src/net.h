@@ -357,6 +357,8 @@ public:
     void AddWhitelistedRange(const CSubNet &subnet);
 
     ServiceFlags GetLocalServices() const;
+    //! Stop offering services, to peers that connect from now on
+    void RemoveLocalServices(ServiceFlags services);
 
     //!set the max outbound target in bytes
     void SetMaxOutboundTarget(uint64_t limit);
@@ -477,7 +479,7 @@ private:
     std::atomic<NodeId> nLastNodeId;
 
     /** Services this instance offers */
-    ServiceFlags nLocalServices;
+    std::atomic<ServiceFlags> nLocalServices;
 
     /** Services this instance cares about */
     ServiceFlags nRelevantServices;
@@ -8,6 +8,8 @@
 #include "alert.h"
 #include "addrman.h"
 #include "arith_uint256.h"
+#include "blockfilter.h"
+#include "blockreader.h"
 #include "chainparams.h"
 #include "consensus/validation.h"
 #include "hash.h"
@@ -50,6 +52,13 @@ using namespace std;
 
 int64_t nTimeBestReceived = 0; // Used only to inform the wallet of when we last received a block
 
+/** Maximum number of compact filters that may be requested with one getcfilters. See BIP 157. */
+static const uint32_t MAX_GETCFILTERS_SIZE = 1000;
+/** Maximum number of filter hashes that may be requested with one getcfheaders. See BIP 157. */
+static const uint32_t MAX_GETCFHEADERS_SIZE = 2000;
+/** Interval between compact filter checkpoints. See BIP 157. */
+static const int CFCHECKPT_INTERVAL = 1000;
+
 struct COrphanTx {
     CTransaction tx;
     NodeId fromPeer;
@@ -841,10 +850,14 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 // it's available before trying to send.
                 if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
                     // Send block from disk
+                    CBlockSpan span;
                     CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
+                    if (inv.type == MSG_BLOCK && ReadRawBlockFromDisk(span, (*mi).second)) {
+                        // Pass the stored bytes on as they are, without parsing the block
+                        connman.PushMessage(pfrom, NetMsgType::BLOCK, CFlatData((void*)span.begin(), (void*)span.end()));
+                    } else if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
                         assert(!"cannot load block from disk");
-                    if (inv.type == MSG_BLOCK)
+                    else if (inv.type == MSG_BLOCK)
                         connman.PushMessage(pfrom, NetMsgType::BLOCK, block);
                     else // MSG_FILTERED_BLOCK)
                     {
@@ -1074,6 +1087,39 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
     }
 }
 
+/**
+ * Validate a getcfilters, getcfheaders or getcfcheckpt request and find its
+ * stop block. Peers asking for a filter type we do not serve, or for more
+ * than nMaxHeightDiff blocks, are disconnected. Requests for blocks outside
+ * the active chain are ignored. Block index entries are never freed, so the
+ * filters can be read after cs_main is released.
+ */
+static bool PrepareBlockFilterRequest(CNode* pfrom, uint8_t nFilterType, uint32_t nStartHeight, const uint256& hashStop,
+                                      uint32_t nMaxHeightDiff, const CBlockIndex*& pindexStop)
+{
+    if (nFilterType != BLOCK_FILTER_BASIC || !(pfrom->GetLocalServices() & NODE_COMPACT_FILTERS)) {
+        LogPrint("net", "peer %d requested unsupported block filter type: %d\n", pfrom->id, nFilterType);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    LOCK(cs_main);
+    BlockMap::iterator mi = mapBlockIndex.find(hashStop);
+    if (mi == mapBlockIndex.end() || !chainActive.Contains(mi->second)) {
+        LogPrint("net", "peer %d requested block filters up to a block outside the active chain: %s\n", pfrom->id, hashStop.ToString());
+        return false;
+    }
+    pindexStop = mi->second;
+
+    uint32_t nStopHeight = pindexStop->nHeight;
+    if (nStartHeight > nStopHeight || nStopHeight - nStartHeight >= nMaxHeightDiff) {
+        LogPrint("net", "peer %d sent invalid getcf* range: start height %d, stop height %d\n", pfrom->id, nStartHeight, nStopHeight);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    return true;
+}
+
 bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv, int64_t nTimeReceived, CConnman& connman, std::atomic<bool>& interruptMsgProc)
 {
     const CChainParams& chainparams = Params();
@@ -1478,8 +1524,9 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             }
             // If pruning, don't inv blocks unless we have on disk and are likely to still have
             // for some reasonable time window (1 hour) that block relay might require.
+            // Blocks below a UTXO snapshot were never on disk.
             const int nPrunedBlocksLikelyToHave = MIN_BLOCKS_TO_KEEP - 3600 / chainparams.GetConsensus().nPowTargetSpacing;
-            if (fPruneMode && (!(pindex->nStatus & BLOCK_HAVE_DATA) || pindex->nHeight <= chainActive.Tip()->nHeight - nPrunedBlocksLikelyToHave))
+            if (!(pindex->nStatus & BLOCK_HAVE_DATA) || (fPruneMode && pindex->nHeight <= chainActive.Tip()->nHeight - nPrunedBlocksLikelyToHave))
             {
                 LogPrint("net", " getblocks stopping, pruned or too old block at %d %s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
                 break;
@@ -1546,6 +1593,82 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
     }
 
 
+    else if (strCommand == NetMsgType::GETCFILTERS)
+    {
+        uint8_t nFilterType;
+        uint32_t nStartHeight;
+        uint256 hashStop;
+        vRecv >> nFilterType >> nStartHeight >> hashStop;
+
+        const CBlockIndex* pindexStop;
+        if (!PrepareBlockFilterRequest(pfrom, nFilterType, nStartHeight, hashStop, MAX_GETCFILTERS_SIZE, pindexStop))
+            return true;
+
+        // Filters are sent one per message, stopping at the first block the index does not have yet
+        for (int nHeight = (int)nStartHeight; nHeight <= pindexStop->nHeight; nHeight++) {
+            CBlockFilter filter;
+            uint256 header;
+            if (!GetBlockFilter(pindexStop->GetAncestor(nHeight), filter, header)) {
+                LogPrint("net", "block filter at height %d not available for peer=%d\n", nHeight, pfrom->id);
+                break;
+            }
+            connman.PushMessage(pfrom, NetMsgType::CFILTER, nFilterType, filter.GetBlockHash(), filter.GetEncodedFilter());
+        }
+    }
+
+
+    else if (strCommand == NetMsgType::GETCFHEADERS)
+    {
+        uint8_t nFilterType;
+        uint32_t nStartHeight;
+        uint256 hashStop;
+        vRecv >> nFilterType >> nStartHeight >> hashStop;
+
+        const CBlockIndex* pindexStop;
+        if (!PrepareBlockFilterRequest(pfrom, nFilterType, nStartHeight, hashStop, MAX_GETCFHEADERS_SIZE, pindexStop))
+            return true;
+
+        // The peer gets the header before the range and the filter hashes to compute the headers in it
+        uint256 prevHeader, header, filterHash;
+        if (nStartHeight > 0 && !GetBlockFilterHeader(pindexStop->GetAncestor(nStartHeight - 1), prevHeader, filterHash)) {
+            LogPrint("net", "block filter header at height %d not available for peer=%d\n", nStartHeight - 1, pfrom->id);
+            return true;
+        }
+        vector<uint256> vFilterHashes;
+        for (int nHeight = (int)nStartHeight; nHeight <= pindexStop->nHeight; nHeight++) {
+            if (!GetBlockFilterHeader(pindexStop->GetAncestor(nHeight), header, filterHash)) {
+                LogPrint("net", "block filter header at height %d not available for peer=%d\n", nHeight, pfrom->id);
+                return true;
+            }
+            vFilterHashes.push_back(filterHash);
+        }
+        connman.PushMessage(pfrom, NetMsgType::CFHEADERS, nFilterType, hashStop, prevHeader, vFilterHashes);
+    }
+
+
+    else if (strCommand == NetMsgType::GETCFCHECKPT)
+    {
+        uint8_t nFilterType;
+        uint256 hashStop;
+        vRecv >> nFilterType >> hashStop;
+
+        const CBlockIndex* pindexStop;
+        if (!PrepareBlockFilterRequest(pfrom, nFilterType, 0, hashStop, std::numeric_limits<uint32_t>::max(), pindexStop))
+            return true;
+
+        vector<uint256> vHeaders;
+        for (int nHeight = CFCHECKPT_INTERVAL; nHeight <= pindexStop->nHeight; nHeight += CFCHECKPT_INTERVAL) {
+            uint256 header, filterHash;
+            if (!GetBlockFilterHeader(pindexStop->GetAncestor(nHeight), header, filterHash)) {
+                LogPrint("net", "block filter header at height %d not available for peer=%d\n", nHeight, pfrom->id);
+                return true;
+            }
+            vHeaders.push_back(header);
+        }
+        connman.PushMessage(pfrom, NetMsgType::CFCHECKPT, nFilterType, hashStop, vHeaders);
+    }
+
+
     else if (strCommand == NetMsgType::TX || strCommand == NetMsgType::DSTX || strCommand == NetMsgType::TXLOCKREQUEST)
     {
         // Stop processing the transaction early if
@@ -1780,6 +1903,9 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
         }
 
+        // Lyra2Z is expensive; hash the whole batch in parallel before taking cs_main.
+        PrecomputeHeaderHashes(headers);
+
         CBlockIndex *pindexLast = NULL;
         {
         LOCK(cs_main);
@@ -13,14 +13,76 @@
 #include "crypto/Lyra2Z/Lyra2Z.h"
 #include "crypto/Lyra2Z/Lyra2.h"
 
+#include <string.h>
+
+#include <boost/thread/tss.hpp>
+
+/** Per-thread Lyra2Z memory matrix, so that header hashing never allocates. */
+static boost::thread_specific_ptr<lyra2z_ctx> lyra2zContext;
+
+static lyra2z_ctx* GetLyra2ZContext()
+{
+    lyra2z_ctx* ctx = lyra2zContext.get();
+    if (ctx == NULL) {
+        ctx = new lyra2z_ctx;
+        lyra2z_ctx_init(ctx);
+        lyra2zContext.reset(ctx);
+    }
+    return ctx;
+}
+
+CBlockHeader& CBlockHeader::operator=(const CBlockHeader& other)
+{
+    if (this == &other)
+        return *this;
+
+    nVersion = other.nVersion;
+    hashPrevBlock = other.hashPrevBlock;
+    hashMerkleRoot = other.hashMerkleRoot;
+    nTime = other.nTime;
+    nBits = other.nBits;
+    nNonce = other.nNonce;
+
+    // Carry the memoized hash along if it is still the hash of the fields
+    if (other.nHashCacheState.load(std::memory_order_acquire) == HASH_CACHE_READY &&
+        memcmp(other.cachedHeader, &other.nVersion, HEADER_SIZE) == 0) {
+        cachedHash = other.cachedHash;
+        memcpy(cachedHeader, other.cachedHeader, HEADER_SIZE);
+        nHashCacheState.store(HASH_CACHE_READY, std::memory_order_relaxed);
+    } else {
+        nHashCacheState.store(HASH_CACHE_EMPTY, std::memory_order_relaxed);
+    }
+    return *this;
+}
 
 uint256 CBlockHeader::GetHash() const
 {
-    uint256 thash;
+    // The header fields are laid out contiguously, exactly as serialized
+    const unsigned char* header = (const unsigned char*)&nVersion;
+    if (nHashCacheState.load(std::memory_order_acquire) == HASH_CACHE_READY &&
+        memcmp(cachedHeader, header, HEADER_SIZE) == 0)
+        return cachedHash;
+
+    uint256 hash;
+    lyra2z_hash_ctx(GetLyra2ZContext(), (const char*)header, BEGIN(hash));
 
-    lyra2z_hash(BEGIN(nVersion), BEGIN(thash));
+    // Only the first thread to get here fills in the memo, which is then
+    // left alone so that other threads may read it without a lock
+    int nExpected = HASH_CACHE_EMPTY;
+    if (nHashCacheState.compare_exchange_strong(nExpected, HASH_CACHE_WRITING, std::memory_order_acquire)) {
+        cachedHash = hash;
+        memcpy(cachedHeader, header, HEADER_SIZE);
+        nHashCacheState.store(HASH_CACHE_READY, std::memory_order_release);
+    }
+
+    return hash;
+}
 
-    return thash;
+void CBlockHeader::SetCachedHash(const uint256& hash)
+{
+    cachedHash = hash;
+    memcpy(cachedHeader, &nVersion, HEADER_SIZE);
+    nHashCacheState.store(HASH_CACHE_READY, std::memory_order_relaxed);
 }
 
 std::string CBlock::ToString() const
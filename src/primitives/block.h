@@ -10,6 +10,8 @@
 #include "serialize.h"
 #include "uint256.h"
 
+#include <atomic>
+
 /** Nodes collect new transactions into a block, hash them into a hash tree,
  * and scan through nonce values to make the block's hash satisfy proof-of-work
  * requirements.  When they solve the proof-of-work, they broadcast the block
@@ -28,11 +30,32 @@ public:
     uint32_t nBits;
     uint32_t nNonce;
 
+    /** Size of the serialized header, which is also the input of the proof-of-work hash */
+    static const size_t HEADER_SIZE = 80;
+
+private:
+    enum { HASH_CACHE_EMPTY, HASH_CACHE_WRITING, HASH_CACHE_READY };
+
+    // memory only: the memoized hash and the header it was computed over. Once
+    // nHashCacheState is HASH_CACHE_READY they only change in non-const methods,
+    // so concurrent GetHash() calls can read them after an acquire load.
+    mutable uint256 cachedHash;
+    mutable unsigned char cachedHeader[HEADER_SIZE];
+    mutable std::atomic<int> nHashCacheState;
+
+public:
     CBlockHeader()
     {
         SetNull();
     }
 
+    CBlockHeader(const CBlockHeader& other)
+    {
+        *this = other;
+    }
+
+    CBlockHeader& operator=(const CBlockHeader& other);
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
@@ -44,6 +67,8 @@ public:
         READWRITE(nTime);
         READWRITE(nBits);
         READWRITE(nNonce);
+        if (ser_action.ForRead())
+            nHashCacheState.store(HASH_CACHE_EMPTY, std::memory_order_relaxed);
     }
 
     void SetNull()
@@ -54,6 +79,7 @@ public:
         nTime = 0;
         nBits = 0;
         nNonce = 0;
+        nHashCacheState.store(HASH_CACHE_EMPTY, std::memory_order_relaxed);
     }
 
     bool IsNull() const
@@ -61,8 +87,22 @@ public:
         return (nBits == 0);
     }
 
+    /**
+     * Lyra2Z hash of the header. The first result is memoized together with a
+     * copy of the header fields it was computed over, and may be read by other
+     * threads hashing the same object. The fields are public and may be changed
+     * freely: a change is detected on the next call, which then recomputes the
+     * hash. Such a hash is only memoized again after a non-const operation
+     * (assignment, deserialization, SetNull() or SetCachedHash()).
+     */
     uint256 GetHash() const;
 
+    /**
+     * Record hash as the hash of the current header fields, for callers that
+     * already computed it by other means (e.g. the miner's nonce loop).
+     */
+    void SetCachedHash(const uint256& hash);
+
     int64_t GetBlockTime() const
     {
         return (int64_t)nTime;
@@ -111,14 +151,8 @@ public:
 
     CBlockHeader GetBlockHeader() const
     {
-        CBlockHeader block;
-        block.nVersion       = nVersion;
-        block.hashPrevBlock  = hashPrevBlock;
-        block.hashMerkleRoot = hashMerkleRoot;
-        block.nTime          = nTime;
-        block.nBits          = nBits;
-        block.nNonce         = nNonce;
-        return block;
+        // Copies the memoized hash along with the header fields
+        return *this;
     }
 
     std::string ToString() const;
@@ -218,6 +218,39 @@ extern const char *REJECT;
  * @see https://bitcoin.org/en/developer-reference#sendheaders
  */
 extern const char *SENDHEADERS;
+/**
+ * getcfilters requests the compact filters of a range of blocks.
+ * Only available with service bit NODE_COMPACT_FILTERS as described by BIP157.
+ */
+extern const char *GETCFILTERS;
+/**
+ * cfilter is a response to a getcfilters request containing a single
+ * compact filter.
+ */
+extern const char *CFILTER;
+/**
+ * getcfheaders requests the compact filter hashes of a range of blocks,
+ * from which the filter headers can be computed.
+ * Only available with service bit NODE_COMPACT_FILTERS as described by BIP157.
+ */
+extern const char *GETCFHEADERS;
+/**
+ * cfheaders is a response to a getcfheaders request containing a filter
+ * header and a vector of filter hashes for each subsequent block in the
+ * requested range.
+ */
+extern const char *CFHEADERS;
+/**
+ * getcfcheckpt requests evenly spaced compact filter headers, enabling
+ * parallelized download and validation of the headers between them.
+ * Only available with service bit NODE_COMPACT_FILTERS as described by BIP157.
+ */
+extern const char *GETCFCHECKPT;
+/**
+ * cfcheckpt is a response to a getcfcheckpt request containing a vector of
+ * evenly spaced filter headers for blocks on the requested chain.
+ */
+extern const char *CFCHECKPT;
 
 // MANO message types
 // NOTE: do NOT declare non-implmented here, we don't want them to be exposed to the outside
@@ -265,6 +298,9 @@ enum ServiceFlags : uint64_t {
     // MANO Core nodes used to support this by default, without advertising this bit,
     // but no longer do as of protocol version 70201 (= NO_BLOOM_VERSION)
     NODE_BLOOM = (1 << 2),
+    // NODE_COMPACT_FILTERS means the node will service basic block filter
+    // requests. See BIP157 and BIP158 for details on how this is implemented.
+    NODE_COMPACT_FILTERS = (1 << 6),
 
     // Bits 24-31 are reserved for temporary experiments. Just pick a bit that
     // isn't getting used, or one not being used much, and notify the
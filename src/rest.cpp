@@ -3,6 +3,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "blockfilter.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "primitives/block.h"
@@ -203,6 +204,81 @@ static bool rest_headers(HTTPRequest* req,
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+static bool rest_blockfilter(HTTPRequest* req,
+                             const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    vector<string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Use /rest/blockfilter/<filtertype>/<hash>.<ext>.");
+
+    if (BlockFilterTypeByName(path[0]) != BLOCK_FILTER_BASIC)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Unknown filtertype: " + path[0]);
+
+    uint256 hash;
+    if (!ParseHashStr(path[1], hash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + path[1]);
+
+    if (!fBlockFilterIndex)
+        return RESTERR(req, HTTP_NOT_FOUND, "Block filters are not available, restart with -blockfilterindex");
+
+    const CBlockIndex* pblockindex;
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(hash);
+        if (it == mapBlockIndex.end())
+            return RESTERR(req, HTTP_NOT_FOUND, path[1] + " not found");
+        pblockindex = it->second;
+    }
+
+    CBlockFilter filter;
+    uint256 filterHeader;
+    if (!GetBlockFilter(pblockindex, filter, filterHeader))
+        return RESTERR(req, HTTP_NOT_FOUND, "Filter of " + path[1] + " not found");
+
+    // The binary and hex formats are the filter as in the cfilter message
+    CDataStream ssFilter(SER_NETWORK, PROTOCOL_VERSION);
+    ssFilter << filter;
+
+    switch (rf) {
+    case RF_BINARY: {
+        string binaryFilter = ssFilter.str();
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, binaryFilter);
+        return true;
+    }
+
+    case RF_HEX: {
+        string strHex = HexStr(ssFilter.begin(), ssFilter.end()) + "\n";
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, strHex);
+        return true;
+    }
+
+    case RF_JSON: {
+        UniValue objFilter(UniValue::VOBJ);
+        objFilter.push_back(Pair("filter", HexStr(filter.GetEncodedFilter())));
+        objFilter.push_back(Pair("header", filterHeader.GetHex()));
+        string strJSON = objFilter.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
 static bool rest_block(HTTPRequest* req,
                        const std::string& strURIPart,
                        bool showTxDetails)
@@ -587,6 +663,77 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+/**
+ * Serve a page of an address index query through its RPC:
+ * /rest/<query>/<count>/<address>[,<address>...][/<cursor>].json
+ */
+static bool rest_address(HTTPRequest* req, const std::string& strURIPart, rpcfn_type rpcfn, const std::string& strQuery)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    vector<string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() < 2 || path.size() > 3)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Use /rest/" + strQuery + "/<count>/<address>[,<address>...][/<cursor>].json");
+
+    int32_t nCount;
+    if (!ParseInt32(path[0], &nCount))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid count: " + path[0]);
+
+    vector<string> vAddresses;
+    boost::split(vAddresses, path[1], boost::is_any_of(","));
+    UniValue addresses(UniValue::VARR);
+    BOOST_FOREACH(const std::string& strAddress, vAddresses)
+        addresses.push_back(strAddress);
+
+    UniValue query(UniValue::VOBJ);
+    query.push_back(Pair("addresses", addresses));
+    query.push_back(Pair("limit", nCount));
+    if (path.size() == 3)
+        query.push_back(Pair("cursor", path[2]));
+
+    switch (rf) {
+    case RF_JSON: {
+        UniValue rpcParams(UniValue::VARR);
+        rpcParams.push_back(query);
+        UniValue page;
+        try {
+            page = rpcfn(rpcParams, false);
+        } catch (const UniValue& objError) {
+            return RESTERR(req, HTTP_BAD_REQUEST, find_value(objError, "message").get_str());
+        }
+        string strJSON = page.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
+static bool rest_address_txids(HTTPRequest* req, const std::string& strURIPart)
+{
+    return rest_address(req, strURIPart, getaddresstxids, "addresstxids");
+}
+
+static bool rest_address_deltas(HTTPRequest* req, const std::string& strURIPart)
+{
+    return rest_address(req, strURIPart, getaddressdeltas, "addressdeltas");
+}
+
+static bool rest_address_utxos(HTTPRequest* req, const std::string& strURIPart)
+{
+    return rest_address(req, strURIPart, getaddressutxos, "addressutxos");
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -598,7 +745,11 @@ static const struct {
       {"/rest/mempool/info", rest_mempool_info},
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
+      {"/rest/blockfilter/", rest_blockfilter},
       {"/rest/getutxos", rest_getutxos},
+      {"/rest/addresstxids/", rest_address_txids},
+      {"/rest/addressdeltas/", rest_address_deltas},
+      {"/rest/addressutxos/", rest_address_utxos},
 };
 
 bool StartREST()
@@ -6,12 +6,15 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "amount.h"
+#include "blockfilter.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "coins.h"
+#include "coinstats.h"
 #include "consensus/validation.h"
 #include "validation.h"
+#include "net.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
 #include "rpc/server.h"
@@ -21,12 +24,14 @@
 #include "txmempool.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "utxosnapshot.h"
 #include "hash.h"
 
 #include <stdint.h>
 
 #include <univalue.h>
 
+#include <boost/filesystem/operations.hpp>
 #include <boost/thread/thread.hpp> // boost::thread::interrupt
 
 using namespace std;
@@ -297,6 +302,9 @@ UniValue getblockhashes(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getblockhashes", "1231614698, 1231024505")
         );
 
+    if (IsIndexBuilding(INDEX_BUILD_TIMESTAMP))
+        throw JSONRPCError(RPC_IN_WARMUP, "The timestamp index is still being built, see indexbuild in getblockchaininfo");
+
     unsigned int high = params[0].get_int();
     unsigned int low = params[1].get_int();
     std::vector<uint256> blockHashes;
@@ -396,6 +404,61 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
     return blockheaderToJSON(pblockindex);
 }
 
+UniValue getblockfilter(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 2)
+        throw runtime_error(
+            "getblockfilter \"hash\" ( \"filtertype\" )\n"
+            "\nReturns the BIP 158 compact filter of block 'hash' and its filter header.\n"
+            "Requires -blockfilterindex.\n"
+            "\nArguments:\n"
+            "1. \"hash\"          (string, required) The block hash\n"
+            "2. \"filtertype\"    (string, optional, default=\"basic\") The type of the filter\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"filter\" : \"xxxx\",   (string) The hex-encoded filter data\n"
+            "  \"header\" : \"xxxx\"    (string) The hex-encoded filter header\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\" \"basic\"")
+            + HelpExampleRpc("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\", \"basic\"")
+        );
+
+    uint256 hash(uint256S(params[0].get_str()));
+
+    std::string strFilterType = "basic";
+    if (params.size() > 1)
+        strFilterType = params[1].get_str();
+
+    if (BlockFilterTypeByName(strFilterType) != BLOCK_FILTER_BASIC)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown filtertype");
+
+    if (!fBlockFilterIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Block filters are not available, restart with -blockfilterindex");
+
+    const CBlockIndex* pblockindex;
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator mi = mapBlockIndex.find(hash);
+        if (mi == mapBlockIndex.end())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        pblockindex = mi->second;
+    }
+
+    CBlockFilter filter;
+    uint256 filterHeader;
+    if (!GetBlockFilter(pblockindex, filter, filterHeader)) {
+        if (IsIndexBuilding(INDEX_BUILD_BLOCKFILTER))
+            throw JSONRPCError(RPC_IN_WARMUP, "The block filter index is still being built, see indexbuild in getblockchaininfo");
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Filter not found, the block may never have been connected");
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("filter", HexStr(filter.GetEncodedFilter())));
+    result.push_back(Pair("header", filterHeader.GetHex()));
+    return result;
+}
+
 UniValue getblockheaders(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 1 || params.size() > 3)
@@ -555,111 +618,192 @@ UniValue getblock(const UniValue& params, bool fHelp)
     return blockToJSON(block, pblockindex);
 }
 
-struct CCoinsStats
-{
-    int nHeight;
-    uint256 hashBlock;
-    uint64_t nTransactions;
-    uint64_t nTransactionOutputs;
-    uint256 hashSerialized;
-    uint64_t nDiskSize;
-    CAmount nTotalAmount;
-
-    CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nTotalAmount(0) {}
-};
-
-static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
-{
-    assert(!outputs.empty());
-    ss << hash;
-    ss << VARINT(outputs.begin()->second.nHeight * 2 + outputs.begin()->second.fCoinBase);
-    stats.nTransactions++;
-    for (const auto output : outputs) {
-        ss << VARINT(output.first + 1);
-        ss << *(const CScriptBase*)(&output.second.out.scriptPubKey);
-        ss << VARINT(output.second.out.nValue);
-        stats.nTransactionOutputs++;
-        stats.nTotalAmount += output.second.out.nValue;
-    }
-    ss << VARINT(0);
-}
-
-//! Calculate statistics about the unspent transaction output set
-static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
-{
-    boost::scoped_ptr<CCoinsViewCursor> pcursor(view->Cursor());
-
-    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-    stats.hashBlock = pcursor->GetBestBlock();
-    {
-        LOCK(cs_main);
-        stats.nHeight = mapBlockIndex.find(stats.hashBlock)->second->nHeight;
-    }
-    ss << stats.hashBlock;
-    uint256 prevkey;
-    std::map<uint32_t, Coin> outputs;
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        COutPoint key;
-        Coin coin;
-        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
-            if (!outputs.empty() && key.hash != prevkey) {
-                ApplyStats(stats, ss, prevkey, outputs);
-                outputs.clear();
-            }
-            prevkey = key.hash;
-            outputs[key.n] = std::move(coin);
-        } else {
-            return error("%s: unable to read value", __func__);
-        }
-        pcursor->Next();
-    }
-    if (!outputs.empty()) {
-        ApplyStats(stats, ss, prevkey, outputs);
-    }
-    stats.hashSerialized = ss.GetHash();
-    stats.nDiskSize = view->EstimateSize();
-    return true;
-}
-
 UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 0)
+    if (fHelp || params.size() > 2)
         throw runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( \"hash_type\" hash_or_height )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "Note this call may take some time, unless \"muhash\" is served from -coinstatsindex.\n"
+            "\nArguments:\n"
+            "1. \"hash_type\"      (string, optional, default=\"hash_serialized_2\") the set hash to compute, \"hash_serialized_2\" or \"muhash\"\n"
+            "2. hash_or_height     (string or numeric, optional) a block hash or height of the active chain to report on instead of the tip;\n"
+            "                      requires \"muhash\" and -coinstatsindex\n"
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
-            "  \"transactions\": n,      (numeric) The number of transactions\n"
+            "  \"transactions\": n,      (numeric) The number of transactions, not reported from -coinstatsindex\n"
             "  \"txouts\": n,            (numeric) The number of output transactions\n"
-            "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
-            "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk\n"
+            "  \"bogosize\": n,          (numeric) A database-independent metric for UTXO set size\n"
+            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash, only for \"hash_serialized_2\"\n"
+            "  \"muhash\": \"hash\",      (string) The MuHash3072 set hash, only for \"muhash\"\n"
+            "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk, not reported from -coinstatsindex\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "\"muhash\" 1000")
             + HelpExampleRpc("gettxoutsetinfo", "")
+            + HelpExampleRpc("gettxoutsetinfo", "\"muhash\", 1000")
         );
 
-    UniValue ret(UniValue::VOBJ);
+    bool fMuHash = false;
+    if (params.size() > 0 && !params[0].isNull()) {
+        std::string strHashType = params[0].get_str();
+        if (strHashType == "muhash")
+            fMuHash = true;
+        else if (strHashType != "hash_serialized_2")
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown hash_type " + strHashType);
+    }
 
+    UniValue ret(UniValue::VOBJ);
     CCoinsStats stats;
+
+    // The index answers for any indexed block without scanning the set
+    if (fMuHash && fCoinStatsIndex) {
+        {
+            LOCK(cs_main);
+            CBlockIndex* pindex = chainActive.Tip();
+            if (params.size() > 1 && !params[1].isNull()) {
+                std::string strHashOrHeight = params[1].isNum() ? params[1].getValStr() : params[1].get_str();
+                if (!strHashOrHeight.empty() && strHashOrHeight.find_first_not_of("0123456789") == std::string::npos) {
+                    int nHeight = atoi(strHashOrHeight);
+                    if (nHeight > chainActive.Height())
+                        throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+                    pindex = chainActive[nHeight];
+                } else {
+                    BlockMap::iterator mi = mapBlockIndex.find(ParseHashV(params[1], "hash_or_height"));
+                    if (mi == mapBlockIndex.end())
+                        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+                    pindex = mi->second;
+                }
+            }
+            stats.nHeight = pindex->nHeight;
+            stats.hashBlock = pindex->GetBlockHash();
+        }
+        CUTXOCommitment commitment;
+        if (!pblocktree->ReadCoinStatsIndex(stats.hashBlock, commitment))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Block is not in the coin stats index");
+        commitment.GetStats(stats);
+
+        ret.push_back(Pair("height", (int64_t)stats.nHeight));
+        ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
+        ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
+        ret.push_back(Pair("bogosize", (int64_t)stats.nBogoSize));
+        ret.push_back(Pair("muhash", stats.hashMuHash.GetHex()));
+        ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
+        return ret;
+    }
+    if (params.size() > 1 && !params[1].isNull())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Querying a specific block requires \"muhash\" and -coinstatsindex");
+
     FlushStateToDisk();
-    if (GetUTXOStats(pcoinsdbview, stats)) {
+    if (GetUTXOStats(pcoinsdbview, stats, fMuHash)) {
+        {
+            LOCK(cs_main);
+            stats.nHeight = mapBlockIndex.find(stats.hashBlock)->second->nHeight;
+        }
         ret.push_back(Pair("height", (int64_t)stats.nHeight));
         ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
         ret.push_back(Pair("transactions", (int64_t)stats.nTransactions));
         ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
-        ret.push_back(Pair("hash_serialized_2", stats.hashSerialized.GetHex()));
+        ret.push_back(Pair("bogosize", (int64_t)stats.nBogoSize));
+        if (fMuHash)
+            ret.push_back(Pair("muhash", stats.hashMuHash.GetHex()));
+        else
+            ret.push_back(Pair("hash_serialized_2", stats.hashSerialized.GetHex()));
         ret.push_back(Pair("disk_size", stats.nDiskSize));
         ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
     }
     return ret;
 }
 
+UniValue dumptxoutset(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrite the unspent transaction output set at the current tip to a snapshot file, which loadtxoutset can load.\n"
+            "Note this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"path\"   (string, required) the file to write, relative to the data directory unless absolute; it must not exist\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_written\": n,         (numeric) the number of coins written\n"
+            "  \"base_hash\": \"hash\",       (string) the hash of the block the snapshot was taken at\n"
+            "  \"base_height\": n,           (numeric) the height of that block\n"
+            "  \"hash_serialized_2\": \"hash\", (string) the serialized hash of the set, as in gettxoutsetinfo\n"
+            "  \"path\": \"path\"             (string) the absolute path of the file\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+        );
+
+    boost::filesystem::path path = boost::filesystem::absolute(params[0].get_str(), GetDataDir());
+
+    FlushStateToDisk();
+    CSnapshotMetadata metadata;
+    CCoinsStats stats;
+    std::string strError;
+    if (!DumpUTXOSnapshot(pcoinsdbview, path, metadata, stats, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("coins_written", (int64_t)metadata.nCoinsCount));
+    ret.push_back(Pair("base_hash", metadata.hashBlock.GetHex()));
+    {
+        LOCK(cs_main);
+        ret.push_back(Pair("base_height", mapBlockIndex.find(metadata.hashBlock)->second->nHeight));
+    }
+    ret.push_back(Pair("hash_serialized_2", stats.hashSerialized.GetHex()));
+    ret.push_back(Pair("path", path.string()));
+    return ret;
+}
+
+UniValue loadtxoutset(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "loadtxoutset \"path\"\n"
+            "\nReplace the chainstate with a snapshot written by dumptxoutset and continue syncing from the block it was taken at.\n"
+            "The snapshot must match one that is known to this version, the header of its block must be known and the\n"
+            "active chain must be below it. Blocks below the snapshot are not downloaded or validated, so the node serves\n"
+            "no blocks below it either, and indexes that need every block (-txindex, -addressindex, ...) must be disabled.\n"
+            "Note this call may take some time, during which the node does not process blocks.\n"
+            "\nArguments:\n"
+            "1. \"path\"   (string, required) the snapshot file, relative to the data directory unless absolute\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_loaded\": n,          (numeric) the number of coins loaded\n"
+            "  \"base_hash\": \"hash\"        (string) the hash of the block the snapshot was taken at, now the tip\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("loadtxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("loadtxoutset", "\"utxo.dat\"")
+        );
+
+    boost::filesystem::path path = boost::filesystem::absolute(params[0].get_str(), GetDataDir());
+
+    CSnapshotMetadata metadata;
+    std::string strError;
+    if (!LoadSnapshotChainstate(Params(), path, metadata, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    if (g_connman)
+        g_connman->RemoveLocalServices(NODE_NETWORK);
+
+    CValidationState state;
+    ActivateBestChain(state, Params(), NULL);
+    if (!state.IsValid())
+        throw JSONRPCError(RPC_DATABASE_ERROR, state.GetRejectReason());
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("coins_loaded", (int64_t)metadata.nCoinsCount));
+    ret.push_back(Pair("base_hash", metadata.hashBlock.GetHex()));
+    return ret;
+}
+
 UniValue gettxout(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 2 || params.size() > 3)
@@ -830,6 +974,19 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
             "  \"chainwork\": \"xxxx\"     (string) total amount of work in active chain, in hexadecimal\n"
             "  \"pruned\": xx,             (boolean) if the blocks are subject to pruning\n"
             "  \"pruneheight\": xxxxxx,    (numeric) heighest block available\n"
+            "  \"indexbuild\": {           (object, only while building) indexes being built in the background\n"
+            "     \"indexes\": [...],       (array) names of the indexes being built\n"
+            "     \"height\": xxxxxx,       (numeric) the last block they cover\n"
+            "     \"progress\": xxxx,       (numeric) fraction of the active chain covered [0..1]\n"
+            "  },\n"
+            "  \"chainstateflush\": {      (object) timing of chainstate flushes since startup\n"
+            "     \"flushes\": xx,          (numeric) number of flushes\n"
+            "     \"background\": xx,       (boolean) if the last flush was written in the background\n"
+            "     \"in_progress\": xx,      (boolean) if a background flush is being written now\n"
+            "     \"last_duration_ms\": xx, (numeric) time the last finished flush took to write\n"
+            "     \"last_stall_ms\": xx,    (numeric) time validation waited for the last flush\n"
+            "     \"total_stall_ms\": xx,   (numeric) time validation waited for all flushes\n"
+            "  },\n"
             "  \"softforks\": [            (array) status of softforks in progress\n"
             "     {\n"
             "        \"id\": \"xxxx\",        (string) name of softfork\n"
@@ -888,6 +1045,35 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
 
         obj.push_back(Pair("pruneheight",        block->nHeight));
     }
+
+    int nIndexesBuilding, nIndexBuildHeight;
+    GetIndexBuildProgress(nIndexesBuilding, nIndexBuildHeight);
+    if (nIndexesBuilding) {
+        UniValue indexes(UniValue::VARR);
+        if (nIndexesBuilding & INDEX_BUILD_ADDRESS)
+            indexes.push_back("addressindex");
+        if (nIndexesBuilding & INDEX_BUILD_SPENT)
+            indexes.push_back("spentindex");
+        if (nIndexesBuilding & INDEX_BUILD_TIMESTAMP)
+            indexes.push_back("timestampindex");
+        if (nIndexesBuilding & INDEX_BUILD_BLOCKFILTER)
+            indexes.push_back("blockfilterindex");
+        UniValue build(UniValue::VOBJ);
+        build.push_back(Pair("indexes",  indexes));
+        build.push_back(Pair("height",   nIndexBuildHeight));
+        build.push_back(Pair("progress", (double)(nIndexBuildHeight + 1) / (chainActive.Height() + 1)));
+        obj.push_back(Pair("indexbuild", build));
+    }
+
+    CChainstateFlushStats flushStats = GetChainstateFlushStats();
+    UniValue flush(UniValue::VOBJ);
+    flush.push_back(Pair("flushes",          flushStats.nFlushes));
+    flush.push_back(Pair("background",       flushStats.fBackground));
+    flush.push_back(Pair("in_progress",      flushStats.fInProgress));
+    flush.push_back(Pair("last_duration_ms", flushStats.nLastDuration / 1000));
+    flush.push_back(Pair("last_stall_ms",    flushStats.nLastStall / 1000));
+    flush.push_back(Pair("total_stall_ms",   flushStats.nTotalStall / 1000));
+    obj.push_back(Pair("chainstateflush",    flush));
     return obj;
 }
 
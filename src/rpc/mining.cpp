@@ -172,13 +172,17 @@ UniValue generate(const UniValue& params, bool fHelp)
         CBlock *pblock = &pblocktemplate->block;
         {
             LOCK(cs_main);
-            IncrementExtraNonce(pblock, chainActive.Tip(), nExtraNonce);
+            IncrementExtraNonce(pblocktemplate.get(), chainActive.Tip(), nExtraNonce);
         }
-        while (!CheckProofOfWork(pblock->GetHash(), pblock->nBits, Params().GetConsensus())) {
+        uint256 hash;
+        while (!CheckProofOfWork(hash = pblock->GetHash(), pblock->nBits, Params().GetConsensus())) {
             // Yes, there is a chance every nonce could fail to satisfy the -regtest
             // target -- 1 in 2^(2^32). That ain't gonna happen.
             ++pblock->nNonce;
         }
+        // The header was hashed before the nonce search, so memoize the hash
+        // found here for the validation that follows
+        pblock->SetCachedHash(hash);
         if (!ProcessNewBlock(Params(), pblock, true, NULL, NULL))
             throw JSONRPCError(RPC_INTERNAL_ERROR, "ProcessNewBlock, block not accepted");
         ++nHeight;
@@ -388,6 +392,10 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
             "      \"flags\" : \"flags\"            (string) \n"
             "  },\n"
             "  \"coinbasevalue\" : n,               (numeric) maximum allowable input to coinbase transaction, including the generation award and transaction fees (in nodes)\n"
+            "  \"coinbasebranch\" : [                (array) merkle branch of the coinbase transaction, from the leaves up, so the merkle root can be recomputed after changing only the coinbase\n"
+            "      \"xxxx\"                          (string) hash encoded in little-endian hexadecimal\n"
+            "      ,...\n"
+            "  ],\n"
             "  \"coinbasetxn\" : { ... },           (json object) information for coinbase transaction\n"
             "  \"target\" : \"xxxx\",               (string) The hash target\n"
             "  \"mintime\" : xxx,                   (numeric) The minimum timestamp appropriate for next block time in seconds since epoch (Jan 1 1970 GMT)\n"
@@ -704,6 +712,11 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
     result.push_back(Pair("transactions", transactions));
     result.push_back(Pair("coinbaseaux", aux));
     result.push_back(Pair("coinbasevalue", (int64_t)pblock->vtx[0].GetValueOut()));
+    UniValue coinbaseBranch(UniValue::VARR);
+    BOOST_FOREACH(const uint256& hash, pblocktemplate->vCoinbaseMerkleBranch) {
+        coinbaseBranch.push_back(hash.GetHex());
+    }
+    result.push_back(Pair("coinbasebranch", coinbaseBranch));
     result.push_back(Pair("longpollid", chainActive.Tip()->GetBlockHash().GetHex() + i64tostr(nTransactionsUpdatedLast)));
     result.push_back(Pair("target", hashTarget.GetHex()));
     result.push_back(Pair("mintime", (int64_t)pindexPrev->GetMedianTimePast()+1));
@@ -616,6 +616,87 @@ bool getAddressesFromParams(const UniValue& params, std::vector<std::pair<uint16
     return true;
 }
 
+/** Page size used when a cursor is given without a limit */
+static const int DEFAULT_ADDRESS_PAGE_SIZE = 1000;
+static const int MAX_ADDRESS_PAGE_SIZE = 100000;
+
+/**
+ * Read the optional "cursor" and "limit" fields of an address query. Returns
+ * whether the query asked for a page; fAfter is set if it continues a
+ * previous one, from the key in after.
+ */
+template<typename K>
+bool getAddressPageFromParams(const UniValue& params, K& after, bool& fAfter, size_t& nLimit)
+{
+    fAfter = false;
+    nLimit = 0;
+    if (!params[0].isObject())
+        return false;
+
+    UniValue cursorValue = find_value(params[0].get_obj(), "cursor");
+    UniValue limitValue = find_value(params[0].get_obj(), "limit");
+    if (cursorValue.isNull() && limitValue.isNull())
+        return false;
+
+    if (!cursorValue.isNull() && !(cursorValue.isStr() && cursorValue.get_str().empty())) {
+        if (!cursorValue.isStr() || !IsHex(cursorValue.get_str()))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+        std::vector<unsigned char> vch = ParseHex(cursorValue.get_str());
+        CDataStream ssKey(vch, SER_DISK, CLIENT_VERSION);
+        try {
+            ssKey >> after;
+        } catch (const std::exception&) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+        }
+        if (!ssKey.empty())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+        fAfter = true;
+    }
+
+    int limit = DEFAULT_ADDRESS_PAGE_SIZE;
+    if (!limitValue.isNull()) {
+        limit = limitValue.get_int();
+        if (limit < 1 || limit > MAX_ADDRESS_PAGE_SIZE)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("limit must be between 1 and %d", MAX_ADDRESS_PAGE_SIZE));
+    }
+    nLimit = limit;
+    return true;
+}
+
+/** Wrap one page of results with the cursor of the next page, or null after the last page */
+template<typename K>
+UniValue addressPageToJSON(const UniValue& results, bool fMore, const K& last)
+{
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("results", results));
+    if (fMore) {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey << last;
+        result.push_back(Pair("next", HexStr(ssKey.begin(), ssKey.end())));
+    } else {
+        result.push_back(Pair("next", NullUniValue));
+    }
+    return result;
+}
+
+static const std::string strAddressPageArgs =
+    "  \"cursor\" (string, optional) Continue after the \"next\" value of a previous page\n" +
+    strprintf("  \"limit\" (number, optional) The maximum number of results per page (default: %d)\n", DEFAULT_ADDRESS_PAGE_SIZE);
+
+static const std::string strAddressPageResult =
+    "\nWith \"cursor\" or \"limit\" the results are returned one page at a time:\n"
+    "{\n"
+    "  \"results\"  (array) The results as above\n"
+    "  \"next\"  (string) The cursor of the next page, or null after the last page\n"
+    "}\n";
+
+/** Refuse queries while an index enabled on an existing database is still being built */
+static void EnsureIndexBuilt(int nIndex, const std::string& strName)
+{
+    if (IsIndexBuilding(nIndex))
+        throw JSONRPCError(RPC_IN_WARMUP, strName + " is still being built, see indexbuild in getblockchaininfo");
+}
+
 bool heightSort(std::pair<CAddressUnspentKey, CAddressUnspentValue> a,
                 std::pair<CAddressUnspentKey, CAddressUnspentValue> b) {
     return a.second.blockHeight < b.second.blockHeight;
@@ -710,6 +791,7 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
             "      \"address\"  (string) The base58check encoded address\n"
             "      ,...\n"
             "    ]\n"
+            + strAddressPageArgs +
             "}\n"
             "\nResult\n"
             "[\n"
@@ -722,26 +804,35 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
             "    \"height\"  (number) The block height\n"
             "  }\n"
             "]\n"
+            "\nOutputs are ordered by height, or by txid and output index when paginated.\n"
+            + strAddressPageResult +
             "\nExamples:\n"
             + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"MwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
             + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"MwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
+    EnsureIndexBuilt(INDEX_BUILD_ADDRESS, "The address index");
+
     std::vector<std::pair<uint160, int> > addresses;
 
     if (!getAddressesFromParams(params, addresses)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    CAddressUnspentKey after;
+    bool fAfter;
+    size_t nLimit;
+    bool fPaged = getAddressPageFromParams(params, after, fAfter, nLimit);
+
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    bool fMore;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
+    if (!GetAddressUnspentPage(addresses, fAfter ? &after : NULL, nLimit, unspentOutputs, fMore)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
     }
 
-    std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+    if (!fPaged)
+        std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
 
     UniValue result(UniValue::VARR);
 
@@ -761,6 +852,9 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
         result.push_back(output);
     }
 
+    if (fPaged)
+        return addressPageToJSON(result, fMore, unspentOutputs.empty() ? after : unspentOutputs.back().first);
+
     return result;
 }
 
@@ -779,6 +873,7 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            + strAddressPageArgs +
             "}\n"
             "\nResult:\n"
             "[\n"
@@ -791,11 +886,14 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
             "    \"address\"  (string) The base58check encoded address\n"
             "  }\n"
             "]\n"
+            + strAddressPageResult +
             "\nExamples:\n"
             + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"MwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
             + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"MwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
+    EnsureIndexBuilt(INDEX_BUILD_ADDRESS, "The address index");
+
 
     UniValue startValue = find_value(params[0].get_obj(), "start");
     UniValue endValue = find_value(params[0].get_obj(), "end");
@@ -817,18 +915,18 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    CAddressIndexKey after;
+    bool fAfter;
+    size_t nLimit;
+    bool fPaged = getAddressPageFromParams(params, after, fAfter, nLimit);
+
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    bool fMore;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
+    if (!(start > 0 && end > 0))
+        start = end = 0;
+    if (!GetAddressIndexPage(addresses, fAfter ? &after : NULL, start, end, nLimit, false, addressIndex, fMore)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
     }
 
     UniValue result(UniValue::VARR);
@@ -849,6 +947,9 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
         result.push_back(delta);
     }
 
+    if (fPaged)
+        return addressPageToJSON(result, fMore, addressIndex.empty() ? after : addressIndex.back().first);
+
     return result;
 }
 
@@ -870,39 +971,39 @@ UniValue getaddressbalance(const UniValue& params, bool fHelp)
             "{\n"
             "  \"balance\"  (string) The current balance in nodes\n"
             "  \"received\"  (string) The total number of nodes received (including change)\n"
+            "  \"txcount\"  (number) The number of transactions involving each address, summed over the addresses\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressbalance", "'{\"addresses\": [\"MwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
             + HelpExampleRpc("getaddressbalance", "{\"addresses\": [\"MwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
+    EnsureIndexBuilt(INDEX_BUILD_ADDRESS, "The address index");
+
     std::vector<std::pair<uint160, int> > addresses;
 
     if (!getAddressesFromParams(params, addresses)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
-    }
-
     CAmount balance = 0;
     CAmount received = 0;
+    uint64_t txCount = 0;
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
+    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        CAddressBalanceValue value;
+        if (!GetAddressBalance((*it).first, (*it).second, value)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
-        balance += it->second;
+        balance += value.balance;
+        received += value.received;
+        txCount += value.txCount;
     }
 
     UniValue result(UniValue::VOBJ);
     result.push_back(Pair("balance", balance));
     result.push_back(Pair("received", received));
+    result.push_back(Pair("txcount", (int64_t)txCount));
 
     return result;
 
@@ -923,17 +1024,21 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            + strAddressPageArgs +
             "}\n"
             "\nResult:\n"
             "[\n"
             "  \"transactionid\"  (string) The transaction id\n"
             "  ,...\n"
             "]\n"
+            + strAddressPageResult +
             "\nExamples:\n"
             + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"MwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
             + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"MwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
+    EnsureIndexBuilt(INDEX_BUILD_ADDRESS, "The address index");
+
     std::vector<std::pair<uint160, int> > addresses;
 
     if (!getAddressesFromParams(params, addresses)) {
@@ -951,41 +1056,31 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
         }
     }
 
+    CAddressIndexKey after;
+    bool fAfter;
+    size_t nLimit;
+    bool fPaged = getAddressPageFromParams(params, after, fAfter, nLimit);
+
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    bool fMore;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
+    if (!(start > 0 && end > 0))
+        start = end = 0;
+    if (!GetAddressIndexPage(addresses, fAfter ? &after : NULL, start, end, nLimit, true, addressIndex, fMore)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
     }
 
-    std::set<std::pair<int, std::string> > txids;
     UniValue result(UniValue::VARR);
 
+    // Entries of one transaction are adjacent in the merged order
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        int height = it->first.blockHeight;
-        std::string txid = it->first.txhash.GetHex();
-
-        if (addresses.size() > 1) {
-            txids.insert(std::make_pair(height, txid));
-        } else {
-            if (txids.insert(std::make_pair(height, txid)).second) {
-                result.push_back(txid);
-            }
+        if (it == addressIndex.begin() || it->first.txhash != (it - 1)->first.txhash) {
+            result.push_back(it->first.txhash.GetHex());
         }
     }
 
-    if (addresses.size() > 1) {
-        for (std::set<std::pair<int, std::string> >::const_iterator it=txids.begin(); it!=txids.end(); it++) {
-            result.push_back(it->second);
-        }
-    }
+    if (fPaged)
+        return addressPageToJSON(result, fMore, addressIndex.empty() ? after : addressIndex.back().first);
 
     return result;
 
@@ -1014,6 +1109,8 @@ UniValue getspentinfo(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getspentinfo", "{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}")
         );
 
+    EnsureIndexBuilt(INDEX_BUILD_SPENT, "The spent index");
+
     UniValue txidValue = find_value(params[0].get_obj(), "txid");
     UniValue indexValue = find_value(params[0].get_obj(), "index");
 
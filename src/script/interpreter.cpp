@@ -1009,6 +1009,29 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
 
 namespace {
 
+/** Serialize the passed scriptCode, skipping OP_CODESEPARATORs */
+template<typename S>
+void SerializeScriptCode(S &s, const CScript &scriptCode) {
+    CScript::const_iterator it = scriptCode.begin();
+    CScript::const_iterator itBegin = it;
+    opcodetype opcode;
+    unsigned int nCodeSeparators = 0;
+    while (scriptCode.GetOp(it, opcode)) {
+        if (opcode == OP_CODESEPARATOR)
+            nCodeSeparators++;
+    }
+    ::WriteCompactSize(s, scriptCode.size() - nCodeSeparators);
+    it = itBegin;
+    while (scriptCode.GetOp(it, opcode)) {
+        if (opcode == OP_CODESEPARATOR) {
+            s.write((char*)&itBegin[0], it-itBegin-1);
+            itBegin = it;
+        }
+    }
+    if (itBegin != scriptCode.end())
+        s.write((char*)&itBegin[0], it-itBegin);
+}
+
 /**
  * Wrapper that serializes like CTransaction, but with the modifications
  *  required for the signature hash done in-place
@@ -1029,29 +1052,6 @@ public:
         fHashSingle((nHashTypeIn & 0x1f) == SIGHASH_SINGLE),
         fHashNone((nHashTypeIn & 0x1f) == SIGHASH_NONE) {}
 
-    /** Serialize the passed scriptCode, skipping OP_CODESEPARATORs */
-    template<typename S>
-    void SerializeScriptCode(S &s, int nType, int nVersion) const {
-        CScript::const_iterator it = scriptCode.begin();
-        CScript::const_iterator itBegin = it;
-        opcodetype opcode;
-        unsigned int nCodeSeparators = 0;
-        while (scriptCode.GetOp(it, opcode)) {
-            if (opcode == OP_CODESEPARATOR)
-                nCodeSeparators++;
-        }
-        ::WriteCompactSize(s, scriptCode.size() - nCodeSeparators);
-        it = itBegin;
-        while (scriptCode.GetOp(it, opcode)) {
-            if (opcode == OP_CODESEPARATOR) {
-                s.write((char*)&itBegin[0], it-itBegin-1);
-                itBegin = it;
-            }
-        }
-        if (itBegin != scriptCode.end())
-            s.write((char*)&itBegin[0], it-itBegin);
-    }
-
     /** Serialize an input of txTo */
     template<typename S>
     void SerializeInput(S &s, unsigned int nInput, int nType, int nVersion) const {
@@ -1065,7 +1065,7 @@ public:
             // Blank out other inputs' signatures
             ::Serialize(s, CScriptBase(), nType, nVersion);
         else
-            SerializeScriptCode(s, nType, nVersion);
+            SerializeScriptCode(s, scriptCode);
         // Serialize the nSequence
         if (nInput != nIn && (fHashSingle || fHashNone))
             // let the others update at will
@@ -1104,9 +1104,68 @@ public:
     }
 };
 
+/** Minimal stream writing into a single SHA256, for resuming from a PrecomputedTransactionData midstate */
+class CSHA256Writer
+{
+private:
+    CSHA256& ctx;
+
+public:
+    CSHA256Writer(CSHA256& ctxIn) : ctx(ctxIn) {}
+
+    CSHA256Writer& write(const char *pch, size_t size) {
+        ctx.Write((const unsigned char*)pch, size);
+        return (*this);
+    }
+};
+
+/** Minimal stream appending serialized data to a byte vector */
+class CVectorSerializer
+{
+private:
+    std::vector<unsigned char>& vch;
+
+public:
+    CVectorSerializer(std::vector<unsigned char>& vchIn) : vch(vchIn) {}
+
+    CVectorSerializer& write(const char *pch, size_t size) {
+        vch.insert(vch.end(), (const unsigned char*)pch, (const unsigned char*)pch + size);
+        return (*this);
+    }
+
+    template<typename T>
+    CVectorSerializer& operator<<(const T& obj) {
+        ::Serialize(*this, obj, SER_GETHASH, 0);
+        return (*this);
+    }
+};
+
 } // anon namespace
 
-uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType)
+PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo)
+{
+    CVectorSerializer s(vchBlanked);
+    s << txTo.nVersion;
+    WriteCompactSize(s, txTo.vin.size());
+    vInputOffset.reserve(txTo.vin.size() + 1);
+    for (unsigned int i = 0; i < txTo.vin.size(); i++) {
+        vInputOffset.push_back(vchBlanked.size());
+        s << txTo.vin[i].prevout << CScriptBase() << txTo.vin[i].nSequence;
+    }
+    vInputOffset.push_back(vchBlanked.size());
+    s << txTo.vout << txTo.nLockTime;
+
+    // One pass over the inputs, snapshotting the hasher in front of each
+    CSHA256 hasher;
+    vMidstate.reserve(txTo.vin.size());
+    hasher.Write(&vchBlanked[0], vInputOffset[0]);
+    for (unsigned int i = 0; i < txTo.vin.size(); i++) {
+        vMidstate.push_back(hasher);
+        hasher.Write(&vchBlanked[vInputOffset[i]], vInputOffset[i + 1] - vInputOffset[i]);
+    }
+}
+
+uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, const PrecomputedTransactionData* cache)
 {
     static const uint256 one(uint256S("0000000000000000000000000000000000000000000000000000000000000001"));
     if (nIn >= txTo.vin.size()) {
@@ -1122,6 +1181,29 @@ uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsig
         }
     }
 
+    // SIGHASH_ALL (any hash type that is not NONE, SINGLE or ANYONECANPAY):
+    // resume from the midstate in front of input nIn, add that input with the
+    // script code, then the pre-serialized remainder of the transaction.
+    if (cache && !(nHashType & SIGHASH_ANYONECANPAY) && (nHashType & 0x1f) != SIGHASH_SINGLE && (nHashType & 0x1f) != SIGHASH_NONE) {
+        assert(cache->vMidstate.size() == txTo.vin.size());
+        const unsigned char* pInput = &cache->vchBlanked[cache->vInputOffset[nIn]];
+        const unsigned char* pNext = &cache->vchBlanked[cache->vInputOffset[nIn + 1]];
+        CSHA256 hasher = cache->vMidstate[nIn];
+        CSHA256Writer s(hasher);
+        hasher.Write(pInput, 32 + 4);
+        SerializeScriptCode(s, scriptCode);
+        hasher.Write(pNext - 4, 4);
+        hasher.Write(pNext, cache->vchBlanked.size() - cache->vInputOffset[nIn + 1]);
+        unsigned char vchHashType[4];
+        WriteLE32(vchHashType, nHashType);
+        hasher.Write(vchHashType, 4);
+
+        uint256 hash;
+        hasher.Finalize(hash.begin());
+        hasher.Reset().Write(hash.begin(), 32).Finalize(hash.begin());
+        return hash;
+    }
+
     // Wrapper to serialize only the necessary parts of the transaction being signed
     CTransactionSignatureSerializer txTmp(txTo, scriptCode, nIn, nHashType);
 
@@ -1149,7 +1231,7 @@ bool TransactionSignatureChecker::CheckSig(const vector<unsigned char>& vchSigIn
     int nHashType = vchSig.back();
     vchSig.pop_back();
 
-    uint256 sighash = SignatureHash(scriptCode, *txTo, nIn, nHashType);
+    uint256 sighash = SignatureHash(scriptCode, *txTo, nIn, nHashType, txdata);
 
     if (!VerifySignature(vchSig, pubkey, sighash))
         return false;
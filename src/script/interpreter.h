@@ -7,6 +7,7 @@
 #define BITCOIN_SCRIPT_INTERPRETER_H
 
 #include "script_error.h"
+#include "crypto/sha256.h"
 #include "primitives/transaction.h"
 
 #include <vector>
@@ -90,7 +91,26 @@ enum
 
 bool CheckSignatureEncoding(const std::vector<unsigned char> &vchSig, unsigned int flags, ScriptError* serror);
 
-uint256 SignatureHash(const CScript &scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType);
+/**
+ * Serialized pieces of a transaction that the signature hash of every input
+ * shares under SIGHASH_ALL, where all other inputs have their scriptSig
+ * blanked. Built once per transaction (linear in its size), it saves
+ * reserializing the whole transaction, and hashing everything before the
+ * signed input, for each input checked.
+ */
+struct PrecomputedTransactionData
+{
+    //! nVersion, vin with all scriptSigs blanked, vout and nLockTime, as serialized for SignatureHash
+    std::vector<unsigned char> vchBlanked;
+    //! Offset of each input in vchBlanked, followed by the offset of the outputs
+    std::vector<uint32_t> vInputOffset;
+    //! SHA256 midstate of vchBlanked up to each input
+    std::vector<CSHA256> vMidstate;
+
+    PrecomputedTransactionData(const CTransaction& tx);
+};
+
+uint256 SignatureHash(const CScript &scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, const PrecomputedTransactionData* cache = NULL);
 
 class BaseSignatureChecker
 {
@@ -118,12 +138,13 @@ class TransactionSignatureChecker : public BaseSignatureChecker
 private:
     const CTransaction* txTo;
     unsigned int nIn;
+    const PrecomputedTransactionData* txdata;
 
 protected:
     virtual bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const;
 
 public:
-    TransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn) : txTo(txToIn), nIn(nInIn) {}
+    TransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const PrecomputedTransactionData* txdataIn = NULL) : txTo(txToIn), nIn(nInIn), txdata(txdataIn) {}
     bool CheckSig(const std::vector<unsigned char>& scriptSig, const std::vector<unsigned char>& vchPubKey, const CScript& scriptCode) const;
     bool CheckLockTime(const CScriptNum& nLockTime) const;
     bool CheckSequence(const CScriptNum& nSequence) const;
@@ -5,29 +5,16 @@
 
 #include "sigcache.h"
 
-#include "memusage.h"
+#include "cuckoocache.h"
 #include "pubkey.h"
 #include "random.h"
 #include "uint256.h"
 #include "util.h"
 
 #include <boost/thread.hpp>
-#include <boost/unordered_set.hpp>
 
 namespace {
 
-/**
- * We're hashing a nonce into the entries themselves, so we don't need extra
- * blinding in the set hash computation.
- */
-class CSignatureCacheHasher
-{
-public:
-    size_t operator()(const uint256& key) const {
-        return key.GetCheapHash();
-    }
-};
-
 /**
  * Valid signature cache, to avoid doing expensive ECDSA signature checking
  * twice for every transaction (once when accepted into memory pool, and
@@ -38,13 +25,15 @@ class CSignatureCache
 private:
      //! Entries are SHA256(nonce || signature hash || public key || signature):
     uint256 nonce;
-    typedef boost::unordered_set<uint256, CSignatureCacheHasher> map_type;
+    typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
     map_type setValid;
+    //! Lookups (including erasing a hit) only need a shared lock; inserts need it exclusively
     boost::shared_mutex cs_sigcache;
-
+    //! False when -maxsigcachesize=0 turned the cache off
+    bool fEnabled;
 
 public:
-    CSignatureCache()
+    CSignatureCache() : fEnabled(true)
     {
         GetRandBytes(nonce.begin(), 32);
     }
@@ -56,52 +45,57 @@ public:
     }
 
     bool
-    Get(const uint256& entry)
+    Get(const uint256& entry, const bool erase)
     {
         boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
-        return setValid.count(entry);
+        return fEnabled && setValid.contains(entry, erase);
     }
 
-    void Erase(const uint256& entry)
+    void Set(const uint256& entry)
     {
         boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
-        setValid.erase(entry);
+        if (fEnabled)
+            setValid.insert(entry);
     }
 
-    void Set(const uint256& entry)
+    uint32_t setup_bytes(size_t n, bool fEnable)
     {
-        size_t nMaxCacheSize = GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
-        if (nMaxCacheSize <= 0) return;
-
         boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
-        while (memusage::DynamicUsage(setValid) > nMaxCacheSize)
-        {
-            map_type::size_type s = GetRand(setValid.bucket_count());
-            map_type::local_iterator it = setValid.begin(s);
-            if (it != setValid.end(s)) {
-                setValid.erase(*it);
-            }
-        }
-
-        setValid.insert(entry);
+        fEnabled = fEnable;
+        return setValid.setup_bytes(n);
     }
 };
 
+/* In previous versions of this code, signatureCache was a local static variable
+ * in CachingTransactionSignatureChecker::VerifySignature. It is global now so
+ * that InitSignatureCache() can size it from -maxsigcachesize at startup. */
+static CSignatureCache signatureCache;
+
 }
 
-bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
+void InitSignatureCache()
 {
-    static CSignatureCache signatureCache;
+    // -maxsigcachesize is shared equally with the script execution cache,
+    // and turns the signature cache off when 0
+    int64_t nMaxSigCacheSize = GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE);
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, nMaxSigCacheSize / 2), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    size_t nElems = signatureCache.setup_bytes(nMaxCacheSize, nMaxSigCacheSize > 0);
+    if (nMaxSigCacheSize <= 0) {
+        LogPrintf("Signature cache disabled\n");
+        return;
+    }
+    LogPrintf("Using %zu MiB out of %zu requested for signature cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+}
 
+bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
+{
     uint256 entry;
     signatureCache.ComputeEntry(entry, sighash, vchSig, pubkey);
 
-    if (signatureCache.Get(entry)) {
-        if (!store) {
-            signatureCache.Erase(entry);
-        }
+    // A signature checked for a block won't be seen again, so let it be evicted
+    if (signatureCache.Get(entry, !store))
         return true;
-    }
 
     if (!TransactionSignatureChecker::VerifySignature(vchSig, pubkey, sighash))
         return false;
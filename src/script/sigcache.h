@@ -8,23 +8,48 @@
 
 #include "script/interpreter.h"
 
+#include <cstring>
 #include <vector>
 
-// DoS prevention: limit cache size to less than 40MB (over 500000
-// entries on 64-bit systems).
-static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 40;
+// DoS prevention: limit the signature and script execution caches to 40MB
+// together (20MB each, over 650000 entries of 32 bytes; the caches allocate
+// all of it at startup).
+static const int64_t DEFAULT_MAX_SIG_CACHE_SIZE = 40;
+// Maximum sig cache size allowed
+static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
 
 class CPubKey;
 
+/**
+ * We're hashing a nonce into the entries themselves, so we don't need extra
+ * blinding in the set hash computation. Each of the 8 hash functions
+ * CuckooCache needs is simply a different 32-bit word of the entry.
+ */
+class SignatureCacheHasher
+{
+public:
+    template <uint8_t hash_select>
+    uint32_t operator()(const uint256& key) const
+    {
+        static_assert(hash_select < 8, "SignatureCacheHasher only has 8 hashes available.");
+        uint32_t u;
+        std::memcpy(&u, key.begin() + 4 * hash_select, 4);
+        return u;
+    }
+};
+
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker
 {
 private:
     bool store;
 
 public:
-    CachingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, bool storeIn=true) : TransactionSignatureChecker(txToIn, nInIn), store(storeIn) {}
+    CachingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, bool storeIn=true, const PrecomputedTransactionData* txdataIn = NULL) : TransactionSignatureChecker(txToIn, nInIn, txdataIn), store(storeIn) {}
 
     bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const;
 };
 
+/** Allocate the signature cache, which gets half of -maxsigcachesize */
+void InitSignatureCache();
+
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
@@ -8,8 +8,54 @@
 
 #include "uint256.h"
 #include "amount.h"
+#include "compressor.h"
 #include "script/script.h"
 
+/**
+ * Unsigned integers in address index keys. Small values take fewer bytes, yet
+ * the bytes sort like the values, which VARINT does not guarantee: the number
+ * of leading one bits in the first byte is the number of bytes that follow,
+ * and the value is stored big-endian in the remaining bits.
+ */
+inline unsigned int GetSizeOfOrderedVarInt(uint32_t n)
+{
+    if (n < 0x80)
+        return 1;
+    if (n < 0x4000)
+        return 2;
+    if (n < 0x200000)
+        return 3;
+    if (n < 0x10000000)
+        return 4;
+    return 5;
+}
+
+template<typename Stream>
+void WriteOrderedVarInt(Stream& s, uint32_t n)
+{
+    unsigned int nSize = GetSizeOfOrderedVarInt(n);
+    uint64_t nValue = ((uint64_t)((0xFF00 >> (nSize - 1)) & 0xFF) << (8 * (nSize - 1))) | n;
+    for (unsigned int i = nSize; i > 0; i--)
+        ser_writedata8(s, (nValue >> (8 * (i - 1))) & 0xFF);
+}
+
+template<typename Stream>
+uint32_t ReadOrderedVarInt(Stream& s)
+{
+    uint8_t chFirst = ser_readdata8(s);
+    unsigned int nSize = 1;
+    while (nSize <= 5 && (chFirst & (0x80 >> (nSize - 1))))
+        nSize++;
+    if (nSize > 5)
+        throw std::ios_base::failure("ReadOrderedVarInt(): invalid size");
+    uint64_t nValue = chFirst & (0xFF >> nSize);
+    for (unsigned int i = 1; i < nSize; i++)
+        nValue = (nValue << 8) | ser_readdata8(s);
+    if (nValue > std::numeric_limits<uint32_t>::max() || GetSizeOfOrderedVarInt(nValue) != nSize)
+        throw std::ios_base::failure("ReadOrderedVarInt(): non-canonical encoding");
+    return nValue;
+}
+
 struct CSpentIndexKey {
     uint256 txid;
     unsigned int outputIndex;
@@ -164,21 +210,21 @@ struct CAddressUnspentKey {
     size_t index;
 
     size_t GetSerializeSize(int nType, int nVersion) const {
-        return 57;
+        return 53 + GetSizeOfOrderedVarInt(index);
     }
     template<typename Stream>
     void Serialize(Stream& s, int nType, int nVersion) const {
         ser_writedata8(s, type);
         hashBytes.Serialize(s, nType, nVersion);
         txhash.Serialize(s, nType, nVersion);
-        ser_writedata32(s, index);
+        WriteOrderedVarInt(s, index);
     }
     template<typename Stream>
     void Unserialize(Stream& s, int nType, int nVersion) {
         type = ser_readdata8(s);
         hashBytes.Unserialize(s, nType, nVersion);
         txhash.Unserialize(s, nType, nVersion);
-        index = ser_readdata32(s);
+        index = ReadOrderedVarInt(s);
     }
 
     CAddressUnspentKey(unsigned int addressType, uint160 addressHash, uint256 txid, size_t indexValue) {
@@ -200,18 +246,28 @@ struct CAddressUnspentKey {
     }
 };
 
+/**
+ * The script is not stored, as it follows from the address type and hash of
+ * the key; the database fills it in when reading.
+ */
 struct CAddressUnspentValue {
     CAmount satoshis;
     CScript script;
     int blockHeight;
 
-    ADD_SERIALIZE_METHODS;
-
-    template <typename Stream, typename Operation>
-    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
-        READWRITE(satoshis);
-        READWRITE(*(CScriptBase*)(&script));
-        READWRITE(blockHeight);
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return GetSizeOfVarInt<uint64_t>(CTxOutCompressor::CompressAmount(satoshis)) + GetSizeOfVarInt<int>(blockHeight);
+    }
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        WriteVarInt<Stream, uint64_t>(s, CTxOutCompressor::CompressAmount(satoshis));
+        WriteVarInt<Stream, int>(s, blockHeight);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        satoshis = CTxOutCompressor::DecompressAmount(ReadVarInt<Stream, uint64_t>(s));
+        script.clear();
+        blockHeight = ReadVarInt<Stream, int>(s);
     }
 
     CAddressUnspentValue(CAmount sats, CScript scriptPubKey, int height) {
@@ -235,6 +291,10 @@ struct CAddressUnspentValue {
     }
 };
 
+/**
+ * The transaction id is not stored: the height and the position in the block
+ * identify the transaction, and the database resolves its id when reading.
+ */
 struct CAddressIndexKey {
     unsigned int type;
     uint160 hashBytes;
@@ -245,17 +305,16 @@ struct CAddressIndexKey {
     bool spending;
 
     size_t GetSerializeSize(int nType, int nVersion) const {
-        return 66;
+        return 22 + GetSizeOfOrderedVarInt(blockHeight) + GetSizeOfOrderedVarInt(txindex) + GetSizeOfOrderedVarInt(index);
     }
     template<typename Stream>
     void Serialize(Stream& s, int nType, int nVersion) const {
         ser_writedata8(s, type);
         hashBytes.Serialize(s, nType, nVersion);
-        // Heights are stored big-endian for key sorting in LevelDB
-        ser_writedata32be(s, blockHeight);
-        ser_writedata32be(s, txindex);
-        txhash.Serialize(s, nType, nVersion);
-        ser_writedata32(s, index);
+        // Heights sort as numbers for range scans in LevelDB
+        WriteOrderedVarInt(s, blockHeight);
+        WriteOrderedVarInt(s, txindex);
+        WriteOrderedVarInt(s, index);
         char f = spending;
         ser_writedata8(s, f);
     }
@@ -263,10 +322,10 @@ struct CAddressIndexKey {
     void Unserialize(Stream& s, int nType, int nVersion) {
         type = ser_readdata8(s);
         hashBytes.Unserialize(s, nType, nVersion);
-        blockHeight = ser_readdata32be(s);
-        txindex = ser_readdata32be(s);
-        txhash.Unserialize(s, nType, nVersion);
-        index = ser_readdata32(s);
+        blockHeight = ReadOrderedVarInt(s);
+        txindex = ReadOrderedVarInt(s);
+        txhash.SetNull();
+        index = ReadOrderedVarInt(s);
         char f = ser_readdata8(s);
         spending = f;
     }
@@ -337,19 +396,19 @@ struct CAddressIndexIteratorHeightKey {
     int blockHeight;
 
     size_t GetSerializeSize(int nType, int nVersion) const {
-        return 25;
+        return 21 + GetSizeOfOrderedVarInt(blockHeight);
     }
     template<typename Stream>
     void Serialize(Stream& s, int nType, int nVersion) const {
         ser_writedata8(s, type);
         hashBytes.Serialize(s, nType, nVersion);
-        ser_writedata32be(s, blockHeight);
+        WriteOrderedVarInt(s, blockHeight);
     }
     template<typename Stream>
     void Unserialize(Stream& s, int nType, int nVersion) {
         type = ser_readdata8(s);
         hashBytes.Unserialize(s, nType, nVersion);
-        blockHeight = ser_readdata32be(s);
+        blockHeight = ReadOrderedVarInt(s);
     }
 
     CAddressIndexIteratorHeightKey(unsigned int addressType, uint160 addressHash, int height) {
@@ -369,5 +428,34 @@ struct CAddressIndexIteratorHeightKey {
     }
 };
 
+struct CAddressBalanceValue {
+    CAmount balance;
+    CAmount received;
+    uint64_t txCount;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(balance);
+        READWRITE(received);
+        READWRITE(VARINT(txCount));
+    }
+
+    CAddressBalanceValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+        txCount = 0;
+    }
+
+    bool IsNull() const {
+        return txCount == 0;
+    }
+};
+
 
 #endif // BITCOIN_SPENTINDEX_H
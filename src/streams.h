@@ -15,6 +15,7 @@
 #include <limits>
 #include <map>
 #include <set>
+#include <stdexcept>
 #include <stdint.h>
 #include <stdio.h>
 #include <string>
@@ -466,6 +467,130 @@ public:
     }
 };
 
+/** Read-only stream over memory owned by someone else, to deserialize from
+ *  without copying the data into a buffer first.
+ */
+class CMemoryReader
+{
+private:
+    int nType;
+    int nVersion;
+
+    const char* pbegin;
+    const char* pend;
+
+public:
+    CMemoryReader(const void* pbeginIn, const void* pendIn, int nTypeIn, int nVersionIn) :
+        nType(nTypeIn), nVersion(nVersionIn), pbegin((const char*)pbeginIn), pend((const char*)pendIn) {}
+
+    int GetType()                { return nType; }
+    int GetVersion()             { return nVersion; }
+
+    size_t size() const          { return pend - pbegin; }
+    bool empty() const           { return pbegin == pend; }
+
+    CMemoryReader& read(char* pch, size_t nSize)
+    {
+        if (nSize > size())
+            throw std::ios_base::failure("CMemoryReader::read: end of data");
+        memcpy(pch, pbegin, nSize);
+        pbegin += nSize;
+        return (*this);
+    }
+
+    CMemoryReader& ignore(size_t nSize)
+    {
+        if (nSize > size())
+            throw std::ios_base::failure("CMemoryReader::ignore: end of data");
+        pbegin += nSize;
+        return (*this);
+    }
+
+    template<typename T>
+    CMemoryReader& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
+/** Reads single bits, most significant bit of every byte first, from a stream */
+template<typename IStream>
+class CBitStreamReader
+{
+private:
+    IStream& istream;
+    uint8_t nBuffer;
+    int nOffset; //!< Bits of nBuffer already read
+
+public:
+    explicit CBitStreamReader(IStream& istreamIn) : istream(istreamIn), nBuffer(0), nOffset(8) {}
+
+    /** Read nBits (at most 64) and return them as the low bits of an integer */
+    uint64_t Read(int nBits)
+    {
+        if (nBits < 0 || nBits > 64)
+            throw std::out_of_range("CBitStreamReader::Read: nBits must be between 0 and 64");
+        uint64_t nData = 0;
+        while (nBits > 0) {
+            if (nOffset == 8) {
+                istream >> nBuffer;
+                nOffset = 0;
+            }
+            int n = std::min(8 - nOffset, nBits);
+            nData <<= n;
+            nData |= static_cast<uint8_t>(nBuffer << nOffset) >> (8 - n);
+            nOffset += n;
+            nBits -= n;
+        }
+        return nData;
+    }
+};
+
+/** Writes single bits, most significant bit of every byte first, to a stream */
+template<typename OStream>
+class CBitStreamWriter
+{
+private:
+    OStream& ostream;
+    uint8_t nBuffer;
+    int nOffset; //!< Bits of nBuffer already written
+
+public:
+    explicit CBitStreamWriter(OStream& ostreamIn) : ostream(ostreamIn), nBuffer(0), nOffset(0) {}
+
+    ~CBitStreamWriter()
+    {
+        Flush();
+    }
+
+    /** Write the low nBits (at most 64) of nData */
+    void Write(uint64_t nData, int nBits)
+    {
+        if (nBits < 0 || nBits > 64)
+            throw std::out_of_range("CBitStreamWriter::Write: nBits must be between 0 and 64");
+        while (nBits > 0) {
+            int n = std::min(8 - nOffset, nBits);
+            nBuffer |= (nData << (64 - nBits)) >> (64 - 8 + nOffset);
+            nOffset += n;
+            nBits -= n;
+            if (nOffset == 8)
+                Flush();
+        }
+    }
+
+    /** Write the buffered bits, padding the last byte with zeros */
+    void Flush()
+    {
+        if (nOffset == 0)
+            return;
+        ostream << nBuffer;
+        nBuffer = 0;
+        nOffset = 0;
+    }
+};
+
 /** Non-refcounted RAII wrapper around a FILE* that implements a ring buffer to
  *  deserialize from. It guarantees the ability to rewind a given number of bytes.
  *
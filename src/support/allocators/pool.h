@@ -0,0 +1,225 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+#define BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+
+#include <array>
+#include <assert.h>
+#include <cstddef>
+#include <list>
+#include <new>
+#include <type_traits>
+
+/**
+ * A memory resource for node-based containers that allocate one small
+ * object per element (std::unordered_map, std::list, ...).
+ *
+ * Memory is taken from the system in chunks of chunk_size_bytes and carved
+ * into blocks that are a multiple of ELEM_ALIGN_BYTES. Freed blocks go onto
+ * a free list per block size and are handed out again before the chunk is
+ * touched, so there is no per-element malloc header and no fragmentation
+ * between equally sized nodes. Requests larger than MAX_BLOCK_SIZE_BYTES
+ * (like a hash table's bucket array) are passed to ::operator new.
+ *
+ * Chunks are only returned to the system when the resource is destroyed, so
+ * the memory used is exactly NumAllocatedChunks() * ChunkSizeBytes() plus
+ * the large allocations, and releasing a whole container is one free() per
+ * chunk. The resource is not thread safe.
+ */
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+class PoolResource
+{
+    static_assert(ALIGN_BYTES > 0, "ALIGN_BYTES must be nonzero");
+    static_assert((ALIGN_BYTES & (ALIGN_BYTES - 1)) == 0, "ALIGN_BYTES must be a power of two");
+
+    /** In-place linked list of free blocks, stored in the blocks themselves. */
+    struct ListNode
+    {
+        ListNode* m_next;
+
+        explicit ListNode(ListNode* next) : m_next(next) {}
+    };
+    static_assert(std::is_trivially_destructible<ListNode>::value, "Make sure we don't need to manually call a destructor");
+
+    //! Block granularity: ALIGN_BYTES, but at least large enough for a ListNode's alignment
+    static constexpr std::size_t ELEM_ALIGN_BYTES = ALIGN_BYTES > alignof(ListNode) ? ALIGN_BYTES : alignof(ListNode);
+    static_assert((ELEM_ALIGN_BYTES % alignof(ListNode)) == 0, "Wrong alignment");
+    static_assert(ELEM_ALIGN_BYTES >= sizeof(ListNode), "Block size must fit a ListNode");
+    static_assert(ELEM_ALIGN_BYTES <= alignof(std::max_align_t), "::operator new does not align chunks that far");
+
+    //! Size of every chunk taken from the system
+    const std::size_t m_chunk_size_bytes;
+
+    //! All chunks taken from the system, freed in the destructor
+    std::list<void*> m_allocated_chunks;
+
+    //! Free lists, indexed by block size in units of ELEM_ALIGN_BYTES
+    std::array<ListNode*, (MAX_BLOCK_SIZE_BYTES + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES + 1> m_free_lists;
+
+    //! Unused part of the most recent chunk
+    char* m_available_memory_it;
+    char* m_available_memory_end;
+
+    /** Number of ELEM_ALIGN_BYTES units needed for bytes (at least one). */
+    static constexpr std::size_t NumElemAlignBytes(std::size_t bytes)
+    {
+        return (bytes + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES + (bytes == 0);
+    }
+
+    /** Whether a request is served from the pool instead of ::operator new. */
+    static constexpr bool IsFreeListUsable(std::size_t bytes, std::size_t alignment)
+    {
+        return alignment <= ELEM_ALIGN_BYTES && bytes <= MAX_BLOCK_SIZE_BYTES;
+    }
+
+    /** Push the block at p onto a free list. */
+    void PlacementAddToList(void* p, ListNode*& node)
+    {
+        node = new (p) ListNode(node);
+    }
+
+    /** Start carving from a new chunk, keeping the rest of the current one on a free list. */
+    void AllocateChunk()
+    {
+        const std::size_t remaining_available_bytes = m_available_memory_end - m_available_memory_it;
+        if (remaining_available_bytes != 0)
+            PlacementAddToList(m_available_memory_it, m_free_lists[remaining_available_bytes / ELEM_ALIGN_BYTES]);
+
+        void* storage = ::operator new(m_chunk_size_bytes);
+        m_available_memory_it = static_cast<char*>(storage);
+        m_available_memory_end = m_available_memory_it + m_chunk_size_bytes;
+        m_allocated_chunks.push_back(storage);
+    }
+
+public:
+    /** Construct a resource with chunks of (at least) chunk_size_bytes. No memory is taken until the first allocation. */
+    explicit PoolResource(std::size_t chunk_size_bytes)
+        : m_chunk_size_bytes(NumElemAlignBytes(chunk_size_bytes) * ELEM_ALIGN_BYTES),
+          m_available_memory_it(NULL), m_available_memory_end(NULL)
+    {
+        assert(m_chunk_size_bytes >= MAX_BLOCK_SIZE_BYTES);
+        m_free_lists.fill(NULL);
+    }
+
+    /** Construct a resource with 256 KiB chunks. */
+    PoolResource() : PoolResource(262144) {}
+
+    PoolResource(const PoolResource&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    ~PoolResource()
+    {
+        for (void* chunk : m_allocated_chunks)
+            ::operator delete(chunk);
+    }
+
+    void* Allocate(std::size_t bytes, std::size_t alignment)
+    {
+        if (IsFreeListUsable(bytes, alignment)) {
+            const std::size_t num_alignments = NumElemAlignBytes(bytes);
+            ListNode*& free_list = m_free_lists[num_alignments];
+            if (free_list != NULL) {
+                // Reuse a freed block of the same size
+                ListNode* node = free_list;
+                free_list = node->m_next;
+                return node;
+            }
+            const std::size_t round_bytes = num_alignments * ELEM_ALIGN_BYTES;
+            if (round_bytes > (std::size_t)(m_available_memory_end - m_available_memory_it))
+                AllocateChunk();
+            void* p = m_available_memory_it;
+            m_available_memory_it += round_bytes;
+            return p;
+        }
+        assert(alignment <= alignof(std::max_align_t));
+        return ::operator new(bytes);
+    }
+
+    void Deallocate(void* p, std::size_t bytes, std::size_t alignment) noexcept
+    {
+        if (IsFreeListUsable(bytes, alignment)) {
+            PlacementAddToList(p, m_free_lists[NumElemAlignBytes(bytes)]);
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    //! Number of chunks taken from the system
+    std::size_t NumAllocatedChunks() const
+    {
+        return m_allocated_chunks.size();
+    }
+
+    //! Size of each chunk
+    std::size_t ChunkSizeBytes() const
+    {
+        return m_chunk_size_bytes;
+    }
+};
+
+/**
+ * Allocator that draws from a PoolResource, for use with standard
+ * containers. Copies (and rebound copies) share the resource, which must
+ * outlive every container using it.
+ */
+template <class T, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES = alignof(T)>
+class PoolAllocator
+{
+    PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>* m_resource;
+
+    template <typename U, std::size_t M, std::size_t A>
+    friend class PoolAllocator;
+
+public:
+    typedef T value_type;
+    typedef PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> ResourceType;
+
+    /** Not explicit, so containers can be constructed from a resource pointer. */
+    PoolAllocator(ResourceType* resource) noexcept : m_resource(resource) {}
+
+    PoolAllocator(const PoolAllocator& other) noexcept = default;
+    PoolAllocator& operator=(const PoolAllocator& other) noexcept = default;
+
+    template <class U>
+    PoolAllocator(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) noexcept : m_resource(other.resource())
+    {
+    }
+
+    template <typename U>
+    struct rebind {
+        typedef PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> other;
+    };
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(m_resource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        m_resource->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    ResourceType* resource() const noexcept
+    {
+        return m_resource;
+    }
+};
+
+template <class T1, class T2, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+bool operator==(const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a,
+                const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b) noexcept
+{
+    return a.resource() == b.resource();
+}
+
+template <class T1, class T2, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+bool operator!=(const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a,
+                const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b) noexcept
+{
+    return !(a == b);
+}
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_POOL_H
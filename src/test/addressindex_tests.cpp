@@ -0,0 +1,298 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+#include "chainparams.h"
+#include "random.h"
+#include "script/standard.h"
+#include "spentindex.h"
+#include "txdb.h"
+#include "util.h"
+#include "validation.h"
+#include "test/test_mano.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(addressindex_tests, TestingSetup)
+
+typedef std::vector<std::pair<CAddressIndexKey, CAmount> > AddressIndexVector;
+
+static void CheckBalance(const uint160& hash, CAmount balance, CAmount received, uint64_t txCount)
+{
+    CAddressBalanceValue value;
+    BOOST_CHECK(pblocktree->ReadAddressBalance(hash, 1, value));
+    BOOST_CHECK_EQUAL(value.balance, balance);
+    BOOST_CHECK_EQUAL(value.received, received);
+    BOOST_CHECK_EQUAL(value.txCount, txCount);
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_balance)
+{
+    uint160 hashA = uint160(ParseHex("0102030405060708090a0b0c0d0e0f1011121314"));
+    uint160 hashB = uint160(ParseHex("1102030405060708090a0b0c0d0e0f1011121314"));
+    uint256 tx1 = GetRandHash(), tx2 = GetRandHash(), tx3 = GetRandHash();
+
+    // Block 1: tx1 pays A twice and B once
+    AddressIndexVector block1;
+    block1.push_back(std::make_pair(CAddressIndexKey(1, hashA, 1, 0, tx1, 0, false), 500));
+    block1.push_back(std::make_pair(CAddressIndexKey(1, hashA, 1, 0, tx1, 1, false), 300));
+    block1.push_back(std::make_pair(CAddressIndexKey(1, hashB, 1, 0, tx1, 2, false), 200));
+    BOOST_CHECK(pblocktree->WriteAddressIndex(block1));
+    CheckBalance(hashA, 800, 800, 1);
+    CheckBalance(hashB, 200, 200, 1);
+
+    // Block 2: tx2 spends A's first output, paying change back to A; tx3 pays B
+    AddressIndexVector block2;
+    block2.push_back(std::make_pair(CAddressIndexKey(1, hashA, 2, 1, tx2, 0, true), -500));
+    block2.push_back(std::make_pair(CAddressIndexKey(1, hashA, 2, 1, tx2, 0, false), 450));
+    block2.push_back(std::make_pair(CAddressIndexKey(1, hashB, 2, 2, tx3, 0, false), 50));
+    BOOST_CHECK(pblocktree->WriteAddressIndex(block2));
+    CheckBalance(hashA, 750, 1250, 2);
+    CheckBalance(hashB, 250, 250, 2);
+
+    // Writing a block again, as after an unclean shutdown, changes nothing
+    BOOST_CHECK(pblocktree->WriteAddressIndex(block2));
+    CheckBalance(hashA, 750, 1250, 2);
+
+    // Building from the index gives the maintained records
+    BOOST_CHECK(pblocktree->BuildAddressBalances());
+    CheckBalance(hashA, 750, 1250, 2);
+    CheckBalance(hashB, 250, 250, 2);
+
+    // Disconnecting restores the earlier records, also when repeated
+    BOOST_CHECK(pblocktree->EraseAddressIndex(block2));
+    BOOST_CHECK(pblocktree->EraseAddressIndex(block2));
+    CheckBalance(hashA, 800, 800, 1);
+    CheckBalance(hashB, 200, 200, 1);
+    BOOST_CHECK(pblocktree->EraseAddressIndex(block1));
+    CheckBalance(hashA, 0, 0, 0);
+    CheckBalance(hashB, 0, 0, 0);
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_pages)
+{
+    uint160 hashA = uint160(ParseHex("0102030405060708090a0b0c0d0e0f1011121314"));
+    uint160 hashB = uint160(ParseHex("1102030405060708090a0b0c0d0e0f1011121314"));
+    uint160 hashC = uint160(ParseHex("2102030405060708090a0b0c0d0e0f1011121314"));
+    std::vector<std::pair<uint160, int> > addresses;
+    addresses.push_back(std::make_pair(hashB, 1));
+    addresses.push_back(std::make_pair(hashA, 1));
+    addresses.push_back(std::make_pair(hashA, 1));
+
+    // Heights interleave between A and B; tx2 touches both, C is not queried
+    uint256 tx1 = GetRandHash(), tx2 = GetRandHash(), tx3 = GetRandHash(), tx4 = GetRandHash();
+    AddressIndexVector entries;
+    entries.push_back(std::make_pair(CAddressIndexKey(1, hashA, 1, 0, tx1, 0, false), 100));
+    entries.push_back(std::make_pair(CAddressIndexKey(1, hashB, 2, 1, tx2, 0, false), 10));
+    entries.push_back(std::make_pair(CAddressIndexKey(1, hashA, 2, 1, tx2, 0, true), -100));
+    entries.push_back(std::make_pair(CAddressIndexKey(1, hashA, 2, 1, tx2, 1, false), 80));
+    entries.push_back(std::make_pair(CAddressIndexKey(1, hashC, 2, 1, tx2, 2, false), 5));
+    entries.push_back(std::make_pair(CAddressIndexKey(1, hashB, 3, 0, tx3, 0, false), 20));
+    entries.push_back(std::make_pair(CAddressIndexKey(1, hashA, 4, 2, tx4, 0, false), 30));
+    BOOST_CHECK(pblocktree->WriteAddressIndex(entries));
+
+    // The whole history, merged by height with duplicate addresses ignored
+    AddressIndexVector all;
+    bool fMore;
+    BOOST_CHECK(pblocktree->ReadAddressIndexPage(addresses, NULL, 0, 0, 0, false, all, fMore));
+    BOOST_CHECK(!fMore);
+    BOOST_CHECK_EQUAL(all.size(), 6U);
+    for (size_t i = 1; i < all.size(); i++)
+        BOOST_CHECK(all[i - 1].first.blockHeight <= all[i].first.blockHeight);
+    BOOST_CHECK(all[1].first.txhash == tx2 && all[1].first.hashBytes == hashB);
+    BOOST_CHECK(all[3].first.txhash == tx2 && all[3].first.hashBytes == hashA && all[3].first.index == 1);
+
+    // Following the last key of each page reads the same entries
+    AddressIndexVector paged;
+    const CAddressIndexKey *pAfter = NULL;
+    CAddressIndexKey after;
+    do {
+        AddressIndexVector page;
+        BOOST_CHECK(pblocktree->ReadAddressIndexPage(addresses, pAfter, 0, 0, 2, false, page, fMore));
+        BOOST_CHECK(page.size() <= 2);
+        paged.insert(paged.end(), page.begin(), page.end());
+        if (!page.empty()) {
+            after = page.back().first;
+            pAfter = &after;
+        }
+    } while (fMore);
+    BOOST_CHECK_EQUAL(paged.size(), all.size());
+    for (size_t i = 0; i < paged.size() && i < all.size(); i++)
+        BOOST_CHECK(paged[i].first.txhash == all[i].first.txhash && paged[i].first.hashBytes == all[i].first.hashBytes &&
+                    paged[i].first.index == all[i].first.index && paged[i].first.spending == all[i].first.spending);
+
+    // Counting transactions keeps all entries of tx2 in one page
+    AddressIndexVector txPage;
+    BOOST_CHECK(pblocktree->ReadAddressIndexPage(addresses, NULL, 0, 0, 2, true, txPage, fMore));
+    BOOST_CHECK(fMore);
+    BOOST_CHECK_EQUAL(txPage.size(), 4U);
+    txPage.clear();
+    BOOST_CHECK(pblocktree->ReadAddressIndexPage(addresses, &all[3].first, 0, 0, 2, true, txPage, fMore));
+    BOOST_CHECK(!fMore);
+    BOOST_CHECK_EQUAL(txPage.size(), 2U);
+
+    // Height ranges apply to every address, also when continuing
+    AddressIndexVector range;
+    BOOST_CHECK(pblocktree->ReadAddressIndexPage(addresses, &all[1].first, 2, 3, 0, false, range, fMore));
+    BOOST_CHECK_EQUAL(range.size(), 3U);
+    range.clear();
+    BOOST_CHECK(pblocktree->ReadAddressIndexPage(addresses, &all[0].first, 3, 4, 0, false, range, fMore));
+    BOOST_CHECK_EQUAL(range.size(), 2U);
+
+    // Unspent outputs page the same way
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspent, unspentPage;
+    unspent.push_back(std::make_pair(CAddressUnspentKey(1, hashA, tx1, 0), CAddressUnspentValue(100, CScript(), 1)));
+    unspent.push_back(std::make_pair(CAddressUnspentKey(1, hashB, tx2, 0), CAddressUnspentValue(10, CScript(), 2)));
+    unspent.push_back(std::make_pair(CAddressUnspentKey(1, hashA, tx4, 0), CAddressUnspentValue(30, CScript(), 4)));
+    BOOST_CHECK(pblocktree->UpdateAddressUnspentIndex(unspent));
+    BOOST_CHECK(pblocktree->ReadAddressUnspentPage(addresses, NULL, 2, unspentPage, fMore));
+    BOOST_CHECK(fMore);
+    BOOST_CHECK_EQUAL(unspentPage.size(), 2U);
+    CAddressUnspentKey afterUnspent = unspentPage.back().first;
+    unspentPage.clear();
+    BOOST_CHECK(pblocktree->ReadAddressUnspentPage(addresses, &afterUnspent, 2, unspentPage, fMore));
+    BOOST_CHECK(!fMore);
+    BOOST_CHECK_EQUAL(unspentPage.size(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_ordered_varint)
+{
+    const uint32_t values[] = {0, 1, 0x7f, 0x80, 0x3fff, 0x4000, 0x1fffff, 0x200000, 0xfffffff, 0x10000000, 0xffffffff};
+    std::vector<unsigned char> last;
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        WriteOrderedVarInt(ss, values[i]);
+        BOOST_CHECK_EQUAL(ss.size(), GetSizeOfOrderedVarInt(values[i]));
+        std::vector<unsigned char> vch(ss.begin(), ss.end());
+        // The encodings sort like the values
+        BOOST_CHECK(i == 0 || last < vch);
+        last = vch;
+        BOOST_CHECK_EQUAL(ReadOrderedVarInt(ss), values[i]);
+        BOOST_CHECK(ss.empty());
+    }
+
+    // Values encoded longer than needed are rejected
+    CDataStream ss(ParseHex("8001"), SER_DISK, CLIENT_VERSION);
+    BOOST_CHECK_THROW(ReadOrderedVarInt(ss), std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_upgrade)
+{
+    uint160 hashA = uint160(ParseHex("0102030405060708090a0b0c0d0e0f1011121314"));
+    uint256 tx1 = GetRandHash(), tx2 = GetRandHash();
+    CScript script = GetScriptForDestination(CKeyID(hashA));
+
+    // Entries in the original format: heights and positions big-endian, the
+    // transaction id in every key and the script in every unspent output
+    std::vector<std::vector<unsigned char> > keys;
+    for (int i = 0; i < 2; i++) {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey << 'a' << (unsigned char)1 << hashA;
+        ser_writedata32be(ssKey, i == 0 ? 300 : 70000);
+        ser_writedata32be(ssKey, i == 0 ? 2 : 1);
+        ssKey << (i == 0 ? tx1 : tx2);
+        ser_writedata32(ssKey, i == 0 ? 1 : 0);
+        ssKey << (unsigned char)(i == 0 ? 0 : 1);
+        keys.push_back(std::vector<unsigned char>(ssKey.begin(), ssKey.end()));
+        BOOST_CHECK(pblocktree->Write(CFlatData(keys.back()), CAmount(i == 0 ? 5000 : -5000)));
+    }
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey << 'u' << (unsigned char)1 << hashA << tx1;
+    ser_writedata32(ssKey, 1);
+    keys.push_back(std::vector<unsigned char>(ssKey.begin(), ssKey.end()));
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    ssValue << CAmount(5000) << *(CScriptBase*)(&script) << 300;
+    std::vector<unsigned char> value(ssValue.begin(), ssValue.end());
+    BOOST_CHECK(pblocktree->Write(CFlatData(keys.back()), CFlatData(value)));
+
+    // Upgrading converts them once and removes the originals
+    for (int i = 0; i < 2; i++) {
+        BOOST_CHECK(pblocktree->UpgradeAddressIndex());
+        for (size_t j = 0; j < keys.size(); j++)
+            BOOST_CHECK(!pblocktree->Exists(CFlatData(keys[j])));
+
+        AddressIndexVector entries;
+        BOOST_CHECK(pblocktree->ReadAddressIndex(hashA, 1, entries));
+        BOOST_CHECK_EQUAL(entries.size(), 2U);
+        BOOST_CHECK(entries[0].first.txhash == tx1 && entries[0].first.blockHeight == 300 && entries[0].first.txindex == 2);
+        BOOST_CHECK(entries[0].first.index == 1 && !entries[0].first.spending && entries[0].second == 5000);
+        BOOST_CHECK(entries[1].first.txhash == tx2 && entries[1].first.blockHeight == 70000 && entries[1].first.spending);
+        BOOST_CHECK_EQUAL(entries[1].second, -5000);
+
+        // Height ranges still select by number
+        entries.clear();
+        BOOST_CHECK(pblocktree->ReadAddressIndex(hashA, 1, entries, 1000, 100000));
+        BOOST_CHECK(entries.size() == 1 && entries[0].first.txhash == tx2);
+
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspent;
+        BOOST_CHECK(pblocktree->ReadAddressUnspentIndex(hashA, 1, unspent));
+        BOOST_CHECK_EQUAL(unspent.size(), 1U);
+        BOOST_CHECK(unspent[0].first.txhash == tx1 && unspent[0].first.index == 1);
+        BOOST_CHECK(unspent[0].second.satoshis == 5000 && unspent[0].second.blockHeight == 300);
+        BOOST_CHECK(unspent[0].second.script == script);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(addressindex_build, RegTestingSetup)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CKeyID keyID = key.GetPubKey().GetID();
+    CScript scriptPubKey = GetScriptForDestination(keyID);
+    for (int i = 0; i < 10; i++)
+        CreateAndProcessBlock(std::vector<CMutableTransaction>(), i < 5 ? CScript() << OP_TRUE : scriptPubKey);
+    FlushStateToDisk();
+
+    // Enable the indexes on the existing chain and build them up to the tip
+    mapArgs["-addressindex"] = "1";
+    mapArgs["-timestampindex"] = "1";
+    mapArgs["-blockfilterindex"] = "1";
+    std::string strError;
+    BOOST_CHECK(LoadIndexBuildState(strError));
+    BOOST_CHECK(IsIndexBuilding(INDEX_BUILD_ADDRESS) && IsIndexBuilding(INDEX_BUILD_TIMESTAMP) && IsIndexBuilding(INDEX_BUILD_BLOCKFILTER));
+    ThreadBuildIndexes();
+    BOOST_CHECK(!IsIndexBuilding(~0));
+
+    const CBlockIndex* pindexTip = chainActive.Tip();
+    AddressIndexVector entries;
+    BOOST_CHECK(pblocktree->ReadAddressIndex(keyID, 1, entries));
+    BOOST_CHECK_EQUAL(entries.size(), 5U);
+    for (size_t i = 0; i < entries.size(); i++)
+        BOOST_CHECK_EQUAL(entries[i].first.blockHeight, pindexTip->nHeight - 4 + (int)i);
+    std::vector<uint256> hashes;
+    BOOST_CHECK(pblocktree->ReadTimestampIndex(pindexTip->nTime, pindexTip->nTime, hashes));
+    BOOST_CHECK(std::find(hashes.begin(), hashes.end(), pindexTip->GetBlockHash()) != hashes.end());
+    uint256 header;
+    for (const CBlockIndex* pindex = pindexTip; pindex; pindex = pindex->pprev) {
+        CBlockFilter filter;
+        uint256 prevHeader, prevFilterHash;
+        BOOST_CHECK(pblocktree->ReadBlockFilter(pindex->GetBlockHash(), filter, header));
+        if (pindex->pprev)
+            BOOST_CHECK(pblocktree->ReadBlockFilterHeader(pindex->pprev->GetBlockHash(), prevHeader, prevFilterHash));
+        BOOST_CHECK(header == filter.ComputeHeader(prevHeader));
+    }
+
+    // Verifying the last blocks neither erases their entries nor steps back
+    // a build that already covers them
+    BOOST_CHECK(pblocktree->WriteIndexBuildState(INDEX_BUILD_ADDRESS, pindexTip->GetBlockHash()));
+    BOOST_CHECK(LoadIndexBuildState(strError));
+    BOOST_CHECK(CVerifyDB().VerifyDB(Params(), pcoinsdbview, 3, 4));
+    int nIndexes, nHeight;
+    GetIndexBuildProgress(nIndexes, nHeight);
+    BOOST_CHECK_EQUAL(nIndexes, INDEX_BUILD_ADDRESS);
+    BOOST_CHECK_EQUAL(nHeight, pindexTip->nHeight);
+    ThreadBuildIndexes();
+    entries.clear();
+    BOOST_CHECK(pblocktree->ReadAddressIndex(keyID, 1, entries));
+    BOOST_CHECK_EQUAL(entries.size(), 5U);
+
+    mapArgs.erase("-addressindex");
+    mapArgs.erase("-timestampindex");
+    mapArgs.erase("-blockfilterindex");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
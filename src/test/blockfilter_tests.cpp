@@ -0,0 +1,241 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+#include "coins.h"
+#include "crypto/common.h"
+#include "key.h"
+#include "primitives/block.h"
+#include "script/script.h"
+#include "script/standard.h"
+#include "streams.h"
+#include "txdb.h"
+#include "undo.h"
+#include "utilstrencodings.h"
+#include "validation.h"
+#include "test/test_mano.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockfilter_tests, TestingSetup)
+
+static CGCSFilter::Element MakeElement(unsigned char c, size_t nSize)
+{
+    return CGCSFilter::Element(nSize, c);
+}
+
+BOOST_AUTO_TEST_CASE(gcsfilter_match)
+{
+    CGCSFilter::ElementSet included, excluded;
+    for (int i = 0; i < 100; i++) {
+        included.insert(MakeElement(i, 32));
+        excluded.insert(MakeElement(i + 100, 32));
+    }
+
+    CGCSFilter::Params params(0, 0, 10, 1 << 10);
+    CGCSFilter filter(params, included);
+    BOOST_CHECK_EQUAL(filter.GetN(), 100U);
+
+    for (CGCSFilter::ElementSet::const_iterator it = included.begin(); it != included.end(); ++it)
+        BOOST_CHECK(filter.Match(*it));
+    BOOST_CHECK(filter.MatchAny(included));
+
+    // With a false positive rate of 1/1024, all 100 other elements should not match
+    int nFalsePositives = 0;
+    for (CGCSFilter::ElementSet::const_iterator it = excluded.begin(); it != excluded.end(); ++it)
+        if (filter.Match(*it))
+            nFalsePositives++;
+    BOOST_CHECK(nFalsePositives < 5);
+
+    // Nothing matches an empty query or an empty filter
+    BOOST_CHECK(!filter.MatchAny(CGCSFilter::ElementSet()));
+    CGCSFilter empty(params, CGCSFilter::ElementSet());
+    BOOST_CHECK_EQUAL(empty.GetN(), 0U);
+    BOOST_CHECK(!empty.MatchAny(included));
+
+    // The encoded filter decodes to the same set
+    CGCSFilter decoded(params, filter.GetEncoded());
+    BOOST_CHECK_EQUAL(decoded.GetN(), 100U);
+    BOOST_CHECK(decoded.GetEncoded() == filter.GetEncoded());
+    for (CGCSFilter::ElementSet::const_iterator it = included.begin(); it != included.end(); ++it)
+        BOOST_CHECK(decoded.Match(*it));
+}
+
+BOOST_AUTO_TEST_CASE(gcsfilter_malformed)
+{
+    CGCSFilter::Params params(0, 0, 10, 1 << 10);
+    CGCSFilter::ElementSet elements;
+    elements.insert(MakeElement(1, 20));
+    elements.insert(MakeElement(2, 20));
+    std::vector<unsigned char> vchEncoded = CGCSFilter(params, elements).GetEncoded();
+
+    // Truncated
+    std::vector<unsigned char> vchTruncated(vchEncoded.begin(), vchEncoded.end() - 1);
+    BOOST_CHECK_THROW(CGCSFilter(params, vchTruncated), std::ios_base::failure);
+
+    // Trailing data
+    std::vector<unsigned char> vchExtended(vchEncoded);
+    vchExtended.push_back(0);
+    BOOST_CHECK_THROW(CGCSFilter(params, vchExtended), std::ios_base::failure);
+
+    // Empty
+    BOOST_CHECK_THROW(CGCSFilter(params, std::vector<unsigned char>()), std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_basic)
+{
+    CScript scriptIncluded1 = CScript() << OP_1;
+    CScript scriptIncluded2 = CScript() << OP_2;
+    CScript scriptSpent = CScript() << OP_3;
+    CScript scriptOpReturn = CScript() << OP_RETURN << std::vector<unsigned char>(4, 1);
+    CScript scriptOther = CScript() << OP_4;
+
+    CMutableTransaction tx;
+    tx.vout.resize(4);
+    tx.vout[0].scriptPubKey = scriptIncluded1;
+    tx.vout[1].scriptPubKey = scriptIncluded2;
+    tx.vout[2].scriptPubKey = scriptOpReturn;
+    tx.vout[3].scriptPubKey = CScript();
+
+    CBlock block;
+    block.vtx.push_back(CTransaction(tx));
+
+    CBlockUndo blockUndo;
+    blockUndo.vtxundo.resize(1);
+    blockUndo.vtxundo[0].vprevout.push_back(Coin(CTxOut(1000, scriptSpent), 1, false));
+    blockUndo.vtxundo[0].vprevout.push_back(Coin(CTxOut(1000, CScript()), 1, false));
+
+    CBlockFilter blockFilter(BLOCK_FILTER_BASIC, block, blockUndo);
+    BOOST_CHECK(blockFilter.GetBlockHash() == block.GetHash());
+
+    const CGCSFilter& filter = blockFilter.GetFilter();
+    BOOST_CHECK_EQUAL(filter.GetN(), 3U);
+    BOOST_CHECK(filter.Match(CGCSFilter::Element(scriptIncluded1.begin(), scriptIncluded1.end())));
+    BOOST_CHECK(filter.Match(CGCSFilter::Element(scriptIncluded2.begin(), scriptIncluded2.end())));
+    BOOST_CHECK(filter.Match(CGCSFilter::Element(scriptSpent.begin(), scriptSpent.end())));
+    BOOST_CHECK(!filter.Match(CGCSFilter::Element(scriptOpReturn.begin(), scriptOpReturn.end())));
+    BOOST_CHECK(!filter.Match(CGCSFilter::Element(scriptOther.begin(), scriptOther.end())));
+
+    // Serialization round trip
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << blockFilter;
+    BOOST_CHECK_EQUAL(ss.size(), blockFilter.GetSerializeSize(SER_NETWORK, PROTOCOL_VERSION));
+    CBlockFilter decoded;
+    ss >> decoded;
+    BOOST_CHECK_EQUAL(decoded.GetFilterType(), BLOCK_FILTER_BASIC);
+    BOOST_CHECK(decoded.GetBlockHash() == blockFilter.GetBlockHash());
+    BOOST_CHECK(decoded.GetEncodedFilter() == blockFilter.GetEncodedFilter());
+
+    CBlockFilter fromEncoded(BLOCK_FILTER_BASIC, block.GetHash(), blockFilter.GetEncodedFilter());
+    BOOST_CHECK(fromEncoded.GetHash() == blockFilter.GetHash());
+
+    // Headers commit to the previous header
+    uint256 header1 = blockFilter.ComputeHeader(uint256());
+    uint256 header2 = blockFilter.ComputeHeader(header1);
+    BOOST_CHECK(header1 != header2);
+    BOOST_CHECK(header1 == fromEncoded.ComputeHeader(uint256()));
+
+    BOOST_CHECK_EQUAL(BlockFilterTypeName(BLOCK_FILTER_BASIC), "basic");
+    BOOST_CHECK_EQUAL(BlockFilterTypeByName("basic"), BLOCK_FILTER_BASIC);
+    BOOST_CHECK_EQUAL(BlockFilterTypeByName("extended"), BLOCK_FILTER_INVALID);
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_multisig)
+{
+    // As in BIP 158, a bare multisig script, paid to or spent, is a single
+    // element like any other script
+    CKey key1, key2, key3;
+    key1.MakeNewKey(true);
+    key2.MakeNewKey(false);
+    key3.MakeNewKey(true);
+    std::vector<CPubKey> keysPaid, keysSpent;
+    keysPaid.push_back(key1.GetPubKey());
+    keysPaid.push_back(key2.GetPubKey());
+    keysSpent.push_back(key3.GetPubKey());
+    const CScript scriptPaid = GetScriptForMultisig(1, keysPaid);
+    const CScript scriptSpent = GetScriptForMultisig(1, keysSpent);
+
+    CMutableTransaction tx;
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = scriptPaid;
+    CBlock block;
+    block.vtx.push_back(CTransaction(tx));
+    CBlockUndo blockUndo;
+    blockUndo.vtxundo.resize(1);
+    blockUndo.vtxundo[0].vprevout.push_back(Coin(CTxOut(1000, scriptSpent), 1, false));
+
+    CBlockFilter blockFilter(BLOCK_FILTER_BASIC, block, blockUndo);
+    const CGCSFilter& filter = blockFilter.GetFilter();
+    BOOST_CHECK_EQUAL(filter.GetN(), 2U);
+    BOOST_CHECK(filter.Match(CGCSFilter::Element(scriptPaid.begin(), scriptPaid.end())));
+    BOOST_CHECK(filter.Match(CGCSFilter::Element(scriptSpent.begin(), scriptSpent.end())));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_known_answers)
+{
+    // BIP 158 test vector of the testnet genesis block, whose only element is
+    // its output script. Filters are keyed by the block hash, which for MANO
+    // blocks is their Lyra2Z hash, so the GCS is built here from the elements.
+    const uint256 hashGenesis = uint256S("000000000933ea01ad0ee984209779baaec3ced90fa3f408719526f8d77f4943");
+    CGCSFilter::ElementSet elements;
+    elements.insert(ParseHex("4104678afdb0fe5548271967f1a67130b7105cd6a828e03909a67962e0ea1f61deb649f6bc3f4cef38c4f35504e51ec112de5c384df7ba0b8d578a4c702b6bf11d5fac"));
+
+    CGCSFilter::Params params(ReadLE64(hashGenesis.begin()), ReadLE64(hashGenesis.begin() + 8), 19, 784931);
+    CGCSFilter gcs(params, elements);
+    BOOST_CHECK_EQUAL(HexStr(gcs.GetEncoded()), "019dfca8");
+
+    CBlockFilter filter(BLOCK_FILTER_BASIC, hashGenesis, gcs.GetEncoded());
+    const uint256 headerGenesis = filter.ComputeHeader(uint256());
+    BOOST_CHECK_EQUAL(headerGenesis.GetHex(), "21584579b7eb08997773e5aeff3a7f932700042d0ed2a6129012b7d7ae81b750");
+
+    // Several elements, one longer than a SipHash block, chained onto the header above
+    const uint256 hashBlock = uint256S("5ec1a0c32a4d9a8f6e5e7cc0d7e1e54c6e4f8b3c2c1a0e9f8d7c6b5a49382716");
+    elements.clear();
+    elements.insert(ParseHex("76a914111111111111111111111111111111111111111188ac"));
+    elements.insert(ParseHex("a914222222222222222222222222222222222222222287"));
+    elements.insert(ParseHex("51"));
+    elements.insert(ParseHex("00143333333333333333333333333333333333333333"));
+    elements.insert(CGCSFilter::Element(200, 0x44));
+
+    params = CGCSFilter::Params(ReadLE64(hashBlock.begin()), ReadLE64(hashBlock.begin() + 8), 19, 784931);
+    gcs = CGCSFilter(params, elements);
+    BOOST_CHECK_EQUAL(HexStr(gcs.GetEncoded()), "051bf49dd8320cd1577088a17f02");
+
+    filter = CBlockFilter(BLOCK_FILTER_BASIC, hashBlock, gcs.GetEncoded());
+    BOOST_CHECK_EQUAL(filter.GetHash().GetHex(), "ac43c42089a69fc1c254df8f6538a79b5d3fbc46770bfd6f7c5e050359bc5276");
+    BOOST_CHECK_EQUAL(filter.ComputeHeader(headerGenesis).GetHex(), "2f4357cf21f6f9054b716e3043a5af7003b0e8ec8b3d431591d62a7818126737");
+    for (CGCSFilter::ElementSet::const_iterator it = elements.begin(); it != elements.end(); ++it)
+        BOOST_CHECK(filter.GetFilter().Match(*it));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_db)
+{
+    CMutableTransaction tx;
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << OP_1;
+    CBlock block;
+    block.vtx.push_back(CTransaction(tx));
+
+    CBlockFilter filter(BLOCK_FILTER_BASIC, block, CBlockUndo());
+    uint256 header = filter.ComputeHeader(uint256());
+    BOOST_CHECK(pblocktree->WriteBlockFilter(filter, header));
+
+    CBlockFilter readFilter;
+    uint256 readHeader, readFilterHash;
+    BOOST_CHECK(pblocktree->ReadBlockFilter(block.GetHash(), readFilter, readHeader));
+    BOOST_CHECK(readHeader == header);
+    BOOST_CHECK(readFilter.GetBlockHash() == block.GetHash());
+    BOOST_CHECK(readFilter.GetEncodedFilter() == filter.GetEncodedFilter());
+
+    readHeader.SetNull();
+    BOOST_CHECK(pblocktree->ReadBlockFilterHeader(block.GetHash(), readHeader, readFilterHash));
+    BOOST_CHECK(readHeader == header);
+    BOOST_CHECK(readFilterHash == filter.GetHash());
+
+    BOOST_CHECK(!pblocktree->ReadBlockFilter(uint256S("01"), readFilter, readHeader));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,130 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockreader.h"
+
+#include "chainparams.h"
+#include "clientversion.h"
+#include "pow.h"
+#include "streams.h"
+#include "validation.h"
+#include "test/test_mano.h"
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockreader_tests, TestingSetup)
+
+static CBlock ReadSpan(const CBlockSpan& span)
+{
+    CBlock block;
+    CMemoryReader(span.begin(), span.end(), SER_DISK, CLIENT_VERSION) >> block;
+    return block;
+}
+
+BOOST_AUTO_TEST_CASE(blockreader_read)
+{
+    boost::filesystem::create_directories(GetDataDir() / "blocks");
+    const CBlock& genesis = Params().GenesisBlock();
+    CBlock block2 = genesis;
+    block2.nNonce++;
+
+    CDiskBlockPos pos1(9999, 0);
+    BOOST_CHECK(WriteBlockToDisk(genesis, pos1, Params().MessageStart()));
+
+    CBlockFileReader reader(1);
+    CBlockSpan span1;
+    BOOST_CHECK(reader.ReadBlock(pos1, span1));
+    BOOST_CHECK_EQUAL(span1.size(), ::GetSerializeSize(genesis, SER_DISK, CLIENT_VERSION));
+    BOOST_CHECK(ReadSpan(span1).GetHash() == genesis.GetHash());
+
+    // A block appended after the file was mapped is found
+    CDiskBlockPos pos2(9999, pos1.nPos + span1.size());
+    BOOST_CHECK(WriteBlockToDisk(block2, pos2, Params().MessageStart()));
+    CBlockSpan span2;
+    BOOST_CHECK(reader.ReadBlock(pos2, span2));
+    BOOST_CHECK(ReadSpan(span2).GetHash() == block2.GetHash());
+    BOOST_CHECK(ReadSpan(span1).GetHash() == genesis.GetHash());
+
+    // Positions past the data or in a missing file fail
+    CBlockSpan span;
+    BOOST_CHECK(!reader.ReadBlock(CDiskBlockPos(9999, pos2.nPos + span2.size() + 8), span));
+    BOOST_CHECK(!reader.ReadBlock(CDiskBlockPos(9998, 8), span));
+    BOOST_CHECK(!reader.ReadBlock(CDiskBlockPos(9999, 4), span));
+
+    // Spans stay readable after their file is dropped, or pushed out of the cache
+    CDiskBlockPos pos3(9997, 0);
+    BOOST_CHECK(WriteBlockToDisk(genesis, pos3, Params().MessageStart()));
+    BOOST_CHECK(reader.ReadBlock(pos3, span));
+    reader.CloseFile(9997);
+    BOOST_CHECK(ReadSpan(span).GetHash() == genesis.GetHash());
+    BOOST_CHECK(ReadSpan(span2).GetHash() == block2.GetHash());
+    BOOST_CHECK(reader.ReadBlock(pos1, span1));
+    BOOST_CHECK(ReadSpan(span1).GetHash() == genesis.GetHash());
+
+    // Reading past the end of a span throws instead of leaving it
+    CMemoryReader stream(span1.begin(), span1.begin() + 10, SER_DISK, CLIENT_VERSION);
+    CBlockHeader header;
+    BOOST_CHECK_THROW(stream >> header, std::ios_base::failure);
+}
+
+/** Index entry for a block stored at pos, with its header validated as if it had been accepted */
+static CBlockIndex IndexEntryAt(const CBlockHeader& header, const uint256& hash, const CDiskBlockPos& pos)
+{
+    CBlockIndex index(header);
+    index.phashBlock = &hash;
+    index.nFile = pos.nFile;
+    index.nDataPos = pos.nPos;
+    index.nStatus = BLOCK_VALID_TREE | BLOCK_HAVE_DATA;
+    return index;
+}
+
+BOOST_AUTO_TEST_CASE(readblockfromdisk_index)
+{
+    boost::filesystem::create_directories(GetDataDir() / "blocks");
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    const CBlock& genesis = Params().GenesisBlock();
+    const uint256 hashGenesis = genesis.GetHash();
+
+    // A header that does not satisfy its proof of work
+    CBlock block2 = genesis;
+    block2.nNonce++;
+    const uint256 hash2 = block2.GetHash();
+    BOOST_CHECK(!CheckProofOfWork(hash2, block2.nBits, consensusParams));
+
+    CDiskBlockPos pos1(9996, 0);
+    BOOST_CHECK(WriteBlockToDisk(genesis, pos1, Params().MessageStart()));
+    CDiskBlockPos pos2(9995, 0);
+    BOOST_CHECK(WriteBlockToDisk(block2, pos2, Params().MessageStart()));
+
+    const bool fCheckBlockReadPoWOld = fCheckBlockReadPoW;
+    fCheckBlockReadPoW = false;
+
+    // The fast path accepts a block whose header is the one in the index
+    CBlock block;
+    CBlockIndex indexGenesis = IndexEntryAt(genesis, hashGenesis, pos1);
+    BOOST_CHECK(ReadBlockFromDisk(block, &indexGenesis, consensusParams));
+    BOOST_CHECK(block.GetHash() == hashGenesis);
+
+    // and rejects one whose header differs from its index entry
+    CBlockIndex indexWrongBlock = IndexEntryAt(genesis, hashGenesis, pos2);
+    BOOST_CHECK(!ReadBlockFromDisk(block, &indexWrongBlock, consensusParams));
+
+    // It relies on the index for the proof of work, which -checkblockreadpow checks again
+    CBlockIndex indexBadPoW = IndexEntryAt(block2, hash2, pos2);
+    BOOST_CHECK(ReadBlockFromDisk(block, &indexBadPoW, consensusParams));
+    fCheckBlockReadPoW = true;
+    BOOST_CHECK(!ReadBlockFromDisk(block, &indexBadPoW, consensusParams));
+    BOOST_CHECK(ReadBlockFromDisk(block, &indexGenesis, consensusParams));
+    BOOST_CHECK(!ReadBlockFromDisk(block, &indexWrongBlock, consensusParams));
+
+    // Index entries whose header was not validated yet always get the full check
+    fCheckBlockReadPoW = false;
+    indexBadPoW.nStatus = BLOCK_VALID_HEADER | BLOCK_HAVE_DATA;
+    BOOST_CHECK(!ReadBlockFromDisk(block, &indexBadPoW, consensusParams));
+
+    fCheckBlockReadPoW = fCheckBlockReadPoWOld;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,100 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "checkqueue.h"
+
+#include "random.h"
+#include "test/test_mano.h"
+
+#include <atomic>
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(checkqueue_tests, BasicTestingSetup)
+
+static std::atomic<unsigned int> nCheckCalls(0);
+
+struct CountingCheck
+{
+    bool fOk;
+    CountingCheck(bool fOkIn = true) : fOk(fOkIn) {}
+    bool operator()()
+    {
+        nCheckCalls++;
+        return fOk;
+    }
+    void swap(CountingCheck& check) { std::swap(fOk, check.fOk); }
+};
+
+static void RunQueue(CCheckQueue<CountingCheck>* queue)
+{
+    queue->Thread();
+}
+
+/** Push nTotal checks in randomly sized batches; the check at nFail (if any) fails. */
+static bool RunChecks(CCheckQueue<CountingCheck>& queue, unsigned int nTotal, unsigned int nFail)
+{
+    CCheckQueueControl<CountingCheck> control(&queue);
+    for (unsigned int i = 0; i < nTotal;) {
+        std::vector<CountingCheck> vChecks;
+        unsigned int nBatch = std::min(nTotal - i, 1 + insecure_rand() % 100);
+        for (unsigned int j = 0; j < nBatch; j++, i++)
+            vChecks.push_back(CountingCheck(i != nFail));
+        control.Add(vChecks);
+    }
+    return control.Wait();
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_all_checks_run)
+{
+    CCheckQueue<CountingCheck> queue(16);
+    boost::thread_group threads;
+    for (int i = 0; i < 4; i++)
+        threads.create_thread(boost::bind(&RunQueue, &queue));
+
+    unsigned int sizes[] = {0, 1, 2, 15, 16, 17, 1000, 20000};
+    for (unsigned int n : sizes) {
+        nCheckCalls = 0;
+        BOOST_CHECK(RunChecks(queue, n, n));
+        BOOST_CHECK_EQUAL(nCheckCalls.load(), n);
+        BOOST_CHECK(queue.IsIdle());
+    }
+
+    threads.interrupt_all();
+    threads.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_failure)
+{
+    // A failure is reported once, and does not leak into the next round
+    CCheckQueue<CountingCheck> queue(16);
+    boost::thread_group threads;
+    for (int i = 0; i < 4; i++)
+        threads.create_thread(boost::bind(&RunQueue, &queue));
+
+    for (int i = 0; i < 20; i++) {
+        unsigned int nTotal = 1 + insecure_rand() % 5000;
+        BOOST_CHECK(!RunChecks(queue, nTotal, insecure_rand() % nTotal));
+        BOOST_CHECK(queue.IsIdle());
+        BOOST_CHECK(RunChecks(queue, nTotal, nTotal));
+    }
+
+    threads.interrupt_all();
+    threads.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_no_workers)
+{
+    // The master alone processes everything
+    CCheckQueue<CountingCheck> queue(16);
+    nCheckCalls = 0;
+    BOOST_CHECK(RunChecks(queue, 500, 500));
+    BOOST_CHECK_EQUAL(nCheckCalls.load(), 500U);
+    BOOST_CHECK(!RunChecks(queue, 500, 0));
+    BOOST_CHECK(queue.IsIdle());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
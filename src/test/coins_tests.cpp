@@ -3,8 +3,11 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "coins.h"
+#include "coinsprefetch.h"
+#include "coinswriter.h"
 #include "random.h"
 #include "script/standard.h"
+#include "txdb.h"
 #include "uint256.h"
 #include "undo.h"
 #include "utilstrencodings.h"
@@ -15,7 +18,10 @@
 #include <vector>
 #include <map>
 
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
 #include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
 
 int ApplyTxInUndo(Coin&& undo, CCoinsViewCache& view, const COutPoint& out);
 void UpdateCoins(const CTransaction& tx, CValidationState &state, CCoinsViewCache& inputs, CTxUndo &txundo, int nHeight);
@@ -591,7 +597,8 @@ void GetCoinsMapEntry(const CCoinsMap& map, CAmount& value, char& flags)
 
 void WriteCoinsViewEntry(CCoinsView& view, CAmount value, char flags)
 {
-    CCoinsMap map;
+    CCoinsMapMemoryResource resource;
+    CCoinsMap map(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), &resource);
     InsertCoinsMapEntry(map, value, flags);
     view.BatchWrite(map, {});
 }
@@ -860,4 +867,303 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+static bool WaitFor(boost::function<bool()> predicate)
+{
+    for (int i = 0; i < 500; i++) {
+        if (predicate())
+            return true;
+        MilliSleep(10);
+    }
+    return false;
+}
+
+BOOST_AUTO_TEST_CASE(coins_prefetch)
+{
+    CCoinsViewTest base;
+    CCoinsViewPrefetch prefetch(&base);
+
+    std::vector<COutPoint> outpoints;
+    {
+        CCoinsViewCacheTest cache(&base);
+        for (int i = 0; i < 100; i++) {
+            outpoints.push_back(COutPoint(GetRandHash(), i));
+            cache.AddCoin(outpoints.back(), Coin(CTxOut(1000 + i, CScript() << OP_TRUE), 1, false), false);
+        }
+        BOOST_CHECK(cache.Flush());
+    }
+    // Unknown outpoints are looked up but not staged
+    std::vector<COutPoint> lookups(outpoints);
+    for (int i = 0; i < 10; i++)
+        lookups.push_back(COutPoint(GetRandHash(), 0));
+
+    // Without a thread, nothing is queued
+    prefetch.PrefetchCoins(lookups);
+    MilliSleep(10);
+    BOOST_CHECK_EQUAL(prefetch.GetStagedCount(), 0U);
+
+    boost::thread_group threads;
+    threads.create_thread(boost::bind(&CCoinsViewPrefetch::ThreadPrefetch, &prefetch));
+    BOOST_CHECK(WaitFor(boost::bind(&CCoinsViewPrefetch::IsActive, &prefetch)));
+    // With one thread, the last lookup is done once everything is staged
+    prefetch.PrefetchCoins(lookups);
+    BOOST_CHECK(WaitFor(boost::bind(&CCoinsViewPrefetch::GetStagedCount, &prefetch) == outpoints.size()));
+
+    // Staged coins are served without asking the base, once: spending one
+    // behind the view's back does not show until it is handed out.
+    {
+        CCoinsViewCacheTest cache(&base);
+        BOOST_CHECK(cache.SpendCoin(outpoints[0]));
+        BOOST_CHECK(cache.Flush());
+    }
+    Coin coin;
+    BOOST_CHECK(prefetch.GetCoin(outpoints[0], coin));
+    BOOST_CHECK(!coin.IsSpent() && coin.out.nValue == 1000);
+    BOOST_CHECK_EQUAL(prefetch.GetStagedCount(), outpoints.size() - 1);
+    BOOST_CHECK(!prefetch.GetCoin(outpoints[0], coin) || coin.IsSpent());
+
+    // A write through the view drops everything staged
+    BOOST_CHECK(prefetch.HaveCoin(outpoints[1]));
+    {
+        CCoinsViewCacheTest cache(&prefetch);
+        BOOST_CHECK(cache.SpendCoin(outpoints[1]));
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK_EQUAL(prefetch.GetStagedCount(), 0U);
+    BOOST_CHECK(!prefetch.GetCoin(outpoints[1], coin) || coin.IsSpent());
+    BOOST_CHECK(prefetch.GetCoin(outpoints[2], coin) && coin.out.nValue == 1002);
+
+    threads.interrupt_all();
+    threads.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(coins_take_changes)
+{
+    CCoinsViewTest base;
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 4; i++)
+        outpoints.push_back(COutPoint(GetRandHash(), i));
+    {
+        CCoinsViewCacheTest cache(&base);
+        cache.AddCoin(outpoints[0], Coin(CTxOut(1000, CScript() << OP_TRUE), 1, false), false);
+        cache.AddCoin(outpoints[1], Coin(CTxOut(1001, CScript() << OP_TRUE), 1, false), false);
+        BOOST_CHECK(cache.Flush());
+    }
+
+    // One clean, one modified, one spent and one new coin
+    CCoinsViewCacheTest cache(&base);
+    BOOST_CHECK(cache.HaveCoin(outpoints[0]));
+    BOOST_CHECK(cache.SpendCoin(outpoints[1]));
+    cache.AddCoin(outpoints[2], Coin(CTxOut(1002, CScript() << OP_TRUE), 2, false), false);
+    cache.AddCoin(outpoints[3], Coin(CTxOut(1003, CScript() << OP_TRUE), 2, false), false);
+    BOOST_CHECK(cache.SpendCoin(outpoints[3]));
+    cache.SelfTest();
+
+    // Everything fits: the spent coin is written and dropped, the new one is
+    // written and stays cached as unmodified
+    CCoinsMapMemoryResource resource;
+    CCoinsMap mapOut(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), &resource);
+    cache.TakeChanges(mapOut, std::numeric_limits<size_t>::max());
+    cache.SelfTest();
+    BOOST_CHECK_EQUAL(mapOut.size(), 2U);
+    BOOST_CHECK(mapOut.count(outpoints[1]) && mapOut[outpoints[1]].coin.IsSpent());
+    BOOST_CHECK(mapOut.count(outpoints[2]) && (mapOut[outpoints[2]].flags & CCoinsCacheEntry::DIRTY));
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 2U);
+    BOOST_CHECK_EQUAL(cache.map()[outpoints[0]].flags, 0);
+    BOOST_CHECK_EQUAL(cache.map()[outpoints[2]].flags, 0);
+    BOOST_CHECK(base.BatchWrite(mapOut, uint256()));
+    Coin coin;
+    BOOST_CHECK(base.GetCoin(outpoints[2], coin) && coin.out.nValue == 1002);
+    BOOST_CHECK(!base.GetCoin(outpoints[1], coin) || coin.IsSpent());
+
+    // Nothing changed since: nothing to take
+    cache.TakeChanges(mapOut, std::numeric_limits<size_t>::max());
+    BOOST_CHECK(mapOut.empty());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 2U);
+
+    // Only room for the modified coins: the clean ones are dropped
+    COutPoint outpointModified(GetRandHash(), 0);
+    cache.AddCoin(outpointModified, Coin(CTxOut(1004, CScript() << OP_TRUE), 3, false), false);
+    size_t nModifiedUsage = memusage::DynamicUsage(cache.map()) / cache.GetCacheSize() + cache.map()[outpointModified].coin.DynamicMemoryUsage();
+    cache.TakeChanges(mapOut, nModifiedUsage);
+    cache.SelfTest();
+    BOOST_CHECK_EQUAL(mapOut.size(), 1U);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 1U);
+    BOOST_CHECK(mapOut.count(outpointModified) && cache.map().count(outpointModified));
+    BOOST_CHECK(base.BatchWrite(mapOut, uint256()));
+
+    // No room at all
+    BOOST_CHECK(cache.SpendCoin(outpoints[0]));
+    cache.TakeChanges(mapOut, 0);
+    cache.SelfTest();
+    BOOST_CHECK_EQUAL(mapOut.size(), 1U);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+    BOOST_CHECK(base.BatchWrite(mapOut, uint256()));
+    BOOST_CHECK(!base.GetCoin(outpoints[0], coin) || coin.IsSpent());
+    BOOST_CHECK(cache.GetCoin(outpoints[2], coin) && coin.out.nValue == 1002);
+}
+
+namespace
+{
+//! View whose writes wait until they are released
+class CCoinsViewGate : public CCoinsViewBacked
+{
+    boost::mutex cs;
+    boost::condition_variable cond;
+    bool fOpen;
+
+public:
+    CCoinsViewGate(CCoinsView* viewIn) : CCoinsViewBacked(viewIn), fOpen(false) {}
+
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock) override
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            while (!fOpen)
+                cond.wait(lock);
+        }
+        return base->BatchWrite(mapCoins, hashBlock);
+    }
+
+    void Open()
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        fOpen = true;
+        cond.notify_all();
+    }
+};
+
+//! View whose writes fail, by returning false or by throwing
+class CCoinsViewFailing : public CCoinsViewBacked
+{
+    bool fThrow;
+
+public:
+    CCoinsViewFailing(CCoinsView* viewIn, bool fThrowIn) : CCoinsViewBacked(viewIn), fThrow(fThrowIn) {}
+
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock) override
+    {
+        if (fThrow)
+            throw std::runtime_error("write failed");
+        return false;
+    }
+};
+}
+
+BOOST_AUTO_TEST_CASE(coins_writer)
+{
+    CCoinsViewTest base;
+    COutPoint outpointSpent(GetRandHash(), 0), outpointNew(GetRandHash(), 1);
+    {
+        CCoinsViewCacheTest cache(&base);
+        cache.AddCoin(outpointSpent, Coin(CTxOut(1000, CScript() << OP_TRUE), 1, false), false);
+        BOOST_CHECK(cache.Flush());
+    }
+
+    CCoinsViewGate gate(&base);
+    CCoinsViewWriter writer(&gate);
+    CCoinsViewCacheTest cache(&writer);
+    uint256 hashBlock = GetRandHash();
+    BOOST_CHECK(cache.SpendCoin(outpointSpent));
+    cache.AddCoin(outpointNew, Coin(CTxOut(1001, CScript() << OP_TRUE), 2, false), false);
+    cache.SetBestBlock(hashBlock);
+    BOOST_CHECK(writer.WriteAsync(cache, 0));
+    BOOST_CHECK(writer.IsWriting());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+
+    // While the write waits, lookups see the batch instead of the base
+    Coin coin;
+    BOOST_CHECK(base.GetCoin(outpointSpent, coin) && !coin.IsSpent());
+    BOOST_CHECK(!cache.HaveCoin(outpointSpent));
+    BOOST_CHECK(!writer.GetCoin(outpointSpent, coin));
+    BOOST_CHECK(cache.GetCoin(outpointNew, coin) && coin.out.nValue == 1001);
+    BOOST_CHECK(writer.GetBestBlock() == hashBlock);
+
+    gate.Open();
+    BOOST_CHECK(writer.WaitForWrite());
+    BOOST_CHECK(!writer.IsWriting());
+    BOOST_CHECK(!base.GetCoin(outpointSpent, coin) || coin.IsSpent());
+    BOOST_CHECK(base.GetCoin(outpointNew, coin) && coin.out.nValue == 1001);
+    BOOST_CHECK(base.GetBestBlock() == hashBlock);
+}
+
+BOOST_FIXTURE_TEST_CASE(coins_writer_db, TestingSetup)
+{
+    // The database writes the batch without consuming it
+    COutPoint outpoint(GetRandHash(), 0);
+    {
+        CCoinsMapMemoryResource resource;
+        CCoinsMap map(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), &resource);
+        CCoinsCacheEntry& entry = map[outpoint];
+        entry.coin = Coin(CTxOut(1000, CScript() << OP_TRUE), 1, false);
+        entry.flags = CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH;
+        BOOST_CHECK(pcoinsdbview->BatchWriteKeep(map, uint256()));
+        BOOST_CHECK_EQUAL(map.size(), 1U);
+        BOOST_CHECK_EQUAL(map[outpoint].coin.out.nValue, 1000);
+    }
+    Coin coin;
+    BOOST_CHECK(pcoinsdbview->GetCoin(outpoint, coin) && coin.out.nValue == 1000);
+
+    CCoinsViewWriter writer(pcoinsdbview);
+    CCoinsViewCacheTest cache(&writer);
+    COutPoint outpointNew(GetRandHash(), 1);
+    uint256 hashBlock = GetRandHash();
+    BOOST_CHECK(cache.SpendCoin(outpoint));
+    cache.AddCoin(outpointNew, Coin(CTxOut(1001, CScript() << OP_TRUE), 2, false), false);
+    cache.SetBestBlock(hashBlock);
+    BOOST_CHECK(writer.WriteAsync(cache, 0));
+    BOOST_CHECK(!writer.GetCoin(outpoint, coin));
+    BOOST_CHECK(writer.WaitForWrite());
+    BOOST_CHECK(!writer.IsWriting());
+    BOOST_CHECK_EQUAL(writer.DynamicMemoryUsage(), 0U);
+    BOOST_CHECK(!pcoinsdbview->HaveCoin(outpoint));
+    BOOST_CHECK(pcoinsdbview->GetCoin(outpointNew, coin) && coin.out.nValue == 1001);
+    BOOST_CHECK(pcoinsdbview->GetBestBlock() == hashBlock);
+}
+
+BOOST_AUTO_TEST_CASE(coins_writer_failure)
+{
+    for (bool fThrow : {false, true}) {
+        CCoinsViewTest base;
+        COutPoint outpointSpent(GetRandHash(), 0), outpointNew(GetRandHash(), 1);
+        {
+            CCoinsViewCacheTest cache(&base);
+            cache.AddCoin(outpointSpent, Coin(CTxOut(1000, CScript() << OP_TRUE), 1, false), false);
+            cache.SetBestBlock(GetRandHash());
+            BOOST_CHECK(cache.Flush());
+        }
+
+        CCoinsViewFailing failing(&base, fThrow);
+        int nFailures = 0;
+        CCoinsViewWriter writer(&failing, [&nFailures]() { nFailures++; });
+        CCoinsViewCacheTest cache(&writer);
+        uint256 hashBlock = GetRandHash();
+        BOOST_CHECK(cache.SpendCoin(outpointSpent));
+        cache.AddCoin(outpointNew, Coin(CTxOut(1001, CScript() << OP_TRUE), 2, false), false);
+        cache.SetBestBlock(hashBlock);
+        BOOST_CHECK(writer.WriteAsync(cache, 0));
+        BOOST_CHECK(!writer.WaitForWrite());
+        BOOST_CHECK_EQUAL(nFailures, 1);
+
+        // The failed batch still answers lookups, so the spent coin does not
+        // come back from the base, which is left as it was
+        Coin coin;
+        BOOST_CHECK(writer.IsWriting());
+        BOOST_CHECK(writer.DynamicMemoryUsage() > 0);
+        BOOST_CHECK(base.GetCoin(outpointSpent, coin) && !coin.IsSpent());
+        BOOST_CHECK(!cache.HaveCoin(outpointSpent));
+        BOOST_CHECK(!writer.GetCoin(outpointSpent, coin));
+        BOOST_CHECK(cache.GetCoin(outpointNew, coin) && coin.out.nValue == 1001);
+        BOOST_CHECK(writer.GetBestBlock() == hashBlock);
+        BOOST_CHECK(base.GetBestBlock() != hashBlock);
+
+        // Later writes fail without reaching the base
+        cache.AddCoin(COutPoint(GetRandHash(), 2), Coin(CTxOut(1002, CScript() << OP_TRUE), 3, false), false);
+        BOOST_CHECK(!writer.WriteAsync(cache, 0));
+        BOOST_CHECK(cache.GetCacheSize() > 0);
+        BOOST_CHECK(!cache.Flush());
+        BOOST_CHECK_EQUAL(nFailures, 1);
+        BOOST_CHECK(!writer.GetCoin(outpointSpent, coin));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -2,19 +2,27 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "crypto/chacha20.h"
+#include "crypto/muhash.h"
 #include "crypto/ripemd160.h"
 #include "crypto/sha1.h"
 #include "crypto/sha256.h"
 #include "crypto/sha512.h"
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "crypto/Lyra2Z/Lyra2Z.h"
+#include "chainparams.h"
+#include "hash.h"
+#include "primitives/block.h"
 #include "random.h"
+#include "streams.h"
 #include "utilstrencodings.h"
 #include "test/test_mano.h"
 
 #include <vector>
 
 #include <boost/assign/list_of.hpp>
+#include <boost/thread.hpp>
 #include <boost/test/unit_test.hpp>
 
 #include <openssl/evp.h>
@@ -133,6 +141,21 @@ BOOST_AUTO_TEST_CASE(sha256_testvectors) {
     TestSHA256(test1, "a316d55510b49662420f49d145d42fb83f31ef8dc016aa4e32df049991a91e26");
 }
 
+BOOST_AUTO_TEST_CASE(sha256d64)
+{
+    // Every batch size exercises a different mix of the 8-way, 4-way and single-input paths
+    for (int i = 0; i <= 32; i++) {
+        std::vector<unsigned char> in(64 * i);
+        std::vector<unsigned char> out1(32 * i), out2(32 * i);
+        for (size_t j = 0; j < in.size(); j++)
+            in[j] = insecure_rand();
+        for (int j = 0; j < i; j++)
+            CHash256().Write(in.data() + 64 * j, 64).Finalize(out1.data() + 32 * j);
+        SHA256D64(out2.data(), in.data(), i);
+        BOOST_CHECK(out1 == out2);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(sha512_testvectors) {
     TestSHA512("",
                "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
@@ -273,4 +296,294 @@ BOOST_AUTO_TEST_CASE(pbkdf2_hmac_sha512_test) {
     BOOST_CHECK(HexStr(k, k + 64) == "8c0511f4c6e597c6ac6315d8f0362e225f3c501495ba23b868c005174dc4ee71115b59f9e60cd9532fa33e0f75aefe30225c583a186cd82bd4daea9724a3d3b8");
 }
 
+BOOST_AUTO_TEST_CASE(lyra2z_ctx_test) {
+    // Known answer: main network genesis block header
+    const CBlockHeader genesis = Params(CBaseChainParams::MAIN).GenesisBlock().GetBlockHeader();
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << genesis;
+    BOOST_CHECK_EQUAL(ss.size(), 80U);
+
+    uint256 hash;
+    lyra2z_hash(&ss[0], (char*)hash.begin());
+    BOOST_CHECK_EQUAL(hash.GetHex(), "00000b268c07975f407c81ea67e8a83295b292b1c740e671d8e03c20aaf7a33e");
+    BOOST_CHECK(genesis.GetHash() == hash);
+
+    // A reused context must give the same result as a fresh one for every input
+    lyra2z_ctx ctx;
+    lyra2z_ctx_init(&ctx);
+    BOOST_CHECK(((uintptr_t)ctx.matrix % LYRA2Z_MATRIX_ALIGN) == 0);
+    for (int i = 0; i < 32; i++) {
+        unsigned char header[80];
+        for (int j = 0; j < 80; j++)
+            header[j] = insecure_rand();
+        uint256 hashFresh, hashReused;
+        lyra2z_hash((const char*)header, (char*)hashFresh.begin());
+        lyra2z_hash_ctx(&ctx, (const char*)header, (char*)hashReused.begin());
+        BOOST_CHECK(hashFresh == hashReused);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(blockheader_hash_cache) {
+    CBlockHeader header = Params(CBaseChainParams::MAIN).GenesisBlock().GetBlockHeader();
+    const uint256 genesisHash = header.GetHash();
+    BOOST_CHECK(header.GetHash() == genesisHash);
+
+    // Any change of a header field must be picked up by the next GetHash()
+    std::vector<uint256> hashes(1, genesisHash);
+    header.nNonce++;
+    hashes.push_back(header.GetHash());
+    header.nTime++;
+    hashes.push_back(header.GetHash());
+    header.nBits ^= 1;
+    hashes.push_back(header.GetHash());
+    header.nVersion++;
+    hashes.push_back(header.GetHash());
+    *header.hashMerkleRoot.begin() ^= 1;
+    hashes.push_back(header.GetHash());
+    *header.hashPrevBlock.begin() ^= 1;
+    hashes.push_back(header.GetHash());
+    for (size_t i = 0; i < hashes.size(); i++) {
+        for (size_t j = i + 1; j < hashes.size(); j++)
+            BOOST_CHECK(hashes[i] != hashes[j]);
+    }
+
+    // Copies get a fresh memo, and reverting the fields gives back the original hash
+    CBlockHeader copy = header;
+    BOOST_CHECK(copy.GetHash() == hashes.back());
+    *copy.hashPrevBlock.begin() ^= 1;
+    *copy.hashMerkleRoot.begin() ^= 1;
+    copy.nVersion--;
+    copy.nBits ^= 1;
+    copy.nTime--;
+    copy.nNonce--;
+    BOOST_CHECK(copy.GetHash() == genesisHash);
+    BOOST_CHECK(header.GetHash() == hashes.back());
+
+    // The miner fast path seeds the cache with a hash it computed itself
+    uint256 hash;
+    header.nNonce++;
+    lyra2z_hash((const char*)&header.nVersion, (char*)hash.begin());
+    header.SetCachedHash(hash);
+    BOOST_CHECK(header.GetHash() == hash);
+    header.SetNull();
+    BOOST_CHECK(header.GetHash() != hash);
+
+    // A copy taken while the memo matches carries it along
+    header.SetCachedHash(hash);
+    CBlockHeader seeded = header;
+    BOOST_CHECK(seeded.GetHash() == hash);
+
+    // Deserializing over a header drops its memo
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << Params(CBaseChainParams::MAIN).GenesisBlock().GetBlockHeader();
+    ss >> seeded;
+    BOOST_CHECK(seeded.GetHash() == genesisHash);
+}
+
+static void HashHeaderRepeatedly(const CBlockHeader* header, const uint256* expected, bool* fOk)
+{
+    for (int i = 0; i < 50; i++)
+        *fOk = *fOk && header->GetHash() == *expected;
+}
+
+BOOST_AUTO_TEST_CASE(blockheader_hash_cache_threads) {
+    // The same const header is hashed from several threads, as with blocks
+    // shared between the net, RPC and validation threads
+    const CBlockHeader header = Params(CBaseChainParams::MAIN).GenesisBlock().GetBlockHeader();
+    const uint256 expected = header.GetHash();
+
+    // Set the fields one by one, so that the threads race to fill in the memo
+    CBlockHeader fresh;
+    fresh.nVersion = header.nVersion;
+    fresh.hashPrevBlock = header.hashPrevBlock;
+    fresh.hashMerkleRoot = header.hashMerkleRoot;
+    fresh.nTime = header.nTime;
+    fresh.nBits = header.nBits;
+    fresh.nNonce = header.nNonce;
+
+    bool fOk[4] = {true, true, true, true};
+    boost::thread_group threads;
+    for (int i = 0; i < 4; i++)
+        threads.create_thread(boost::bind(&HashHeaderRepeatedly, &fresh, &expected, &fOk[i]));
+    threads.join_all();
+    for (int i = 0; i < 4; i++)
+        BOOST_CHECK(fOk[i]);
+}
+
+BOOST_AUTO_TEST_CASE(lyra2z_sponge_impls) {
+    // Every vectorized sponge the CPU supports must match the scalar one bit for bit
+    const sponge_impl* scalar = spongeImpl(0);
+    BOOST_CHECK(scalar != NULL && scalar->supported());
+    lyra2z_ctx ctx;
+    lyra2z_ctx_init(&ctx);
+    std::vector<uint256> pwds;
+    for (int i = 0; i < 64; i++)
+        pwds.push_back(GetRandHash());
+
+    const sponge_impl* impl;
+    for (int n = 1; (impl = spongeImpl(n)) != NULL; n++) {
+        if (!impl->supported()) {
+            BOOST_TEST_MESSAGE("sponge implementation " << impl->name << " not supported on this CPU, skipping");
+            continue;
+        }
+        for (size_t i = 0; i < pwds.size(); i++) {
+            uint256 expected, hash;
+            LYRA2_matrix_impl(scalar, ctx.matrix, expected.begin(), 32, pwds[i].begin(), 32, pwds[i].begin(), 32, LYRA2Z_TIMECOST, LYRA2Z_NROWS, LYRA2Z_NCOLS);
+            LYRA2_matrix_impl(impl, ctx.matrix, hash.begin(), 32, pwds[i].begin(), 32, pwds[i].begin(), 32, LYRA2Z_TIMECOST, LYRA2Z_NROWS, LYRA2Z_NCOLS);
+            BOOST_CHECK_MESSAGE(hash == expected, impl->name);
+        }
+    }
+    BOOST_CHECK(spongeBestImpl()->supported());
+}
+
+BOOST_AUTO_TEST_CASE(lyra2z_hash_nonces_test) {
+    lyra2z_ctx ctx;
+    lyra2z_ctx_init(&ctx);
+
+    // The two-lane sponge must match two single lane runs, including when
+    // both lanes wander into the same rows
+    const sponge_x2_impl* x2 = spongeX2Impl();
+    if (x2) {
+        for (int i = 0; i < 64; i++) {
+            uint256 pwd0 = GetRandHash(), pwd1 = i % 8 ? GetRandHash() : pwd0;
+            uint256 expected0, expected1, hash0, hash1;
+            LYRA2_matrix(ctx.matrix, expected0.begin(), 32, pwd0.begin(), 32, pwd0.begin(), 32, LYRA2Z_TIMECOST, LYRA2Z_NROWS, LYRA2Z_NCOLS);
+            LYRA2_matrix(ctx.matrix, expected1.begin(), 32, pwd1.begin(), 32, pwd1.begin(), 32, LYRA2Z_TIMECOST, LYRA2Z_NROWS, LYRA2Z_NCOLS);
+            LYRA2_matrix_x2(x2, ctx.matrix, hash0.begin(), hash1.begin(), 32, pwd0.begin(), pwd1.begin(), 32, pwd0.begin(), pwd1.begin(), 32, LYRA2Z_TIMECOST, LYRA2Z_NROWS, LYRA2Z_NCOLS);
+            BOOST_CHECK(hash0 == expected0);
+            BOOST_CHECK(hash1 == expected1);
+        }
+    } else {
+        BOOST_TEST_MESSAGE("two-lane sponge not supported on this CPU, skipping");
+    }
+
+    // Batches from a midstate match hashing every header on its own, for odd
+    // counts too; the nonce of the header passed for the midstate is ignored
+    CBlockHeader header = Params(CBaseChainParams::MAIN).GenesisBlock().GetBlockHeader();
+    const uint32_t nNonceStart = header.nNonce - 3;
+    lyra2z_midstate midstate;
+    lyra2z_midstate_init(&midstate, (const char*)&header.nVersion);
+    for (unsigned int count = 1; count <= 8; count++) {
+        std::vector<uint256> hashes(count);
+        lyra2z_hash_nonces(&ctx, &midstate, nNonceStart, count, (char*)hashes[0].begin());
+        for (unsigned int i = 0; i < count; i++) {
+            header.nNonce = nNonceStart + i;
+            BOOST_CHECK(hashes[i] == header.GetHash());
+        }
+    }
+    header.nNonce = nNonceStart + 3;
+    BOOST_CHECK(header.GetHash() == Params(CBaseChainParams::MAIN).GenesisBlock().GetHash());
+}
+
+static void TestChaCha20(const std::string &hexkey, uint64_t nonce, uint64_t seek, const std::string& hexout)
+{
+    std::vector<unsigned char> key = ParseHex(hexkey);
+    ChaCha20 rng(key.data(), key.size());
+    rng.SetIV(nonce);
+    rng.Seek(seek);
+    std::vector<unsigned char> out = ParseHex(hexout);
+    std::vector<unsigned char> outres;
+    outres.resize(out.size());
+    rng.Output(outres.data(), outres.size());
+    BOOST_CHECK(out == outres);
+}
+
+BOOST_AUTO_TEST_CASE(chacha20_testvector)
+{
+    // Test vector from RFC 7539
+    TestChaCha20("000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f", 0x4a000000UL, 1,
+                 "224f51f3401bd9e12fde276fb8631ded8c131f823d2c06e27e4fcaec9ef3cf788a3b0aa372600a92b57974cded2b9334794cba40c63e34cdea212c4cf07d41b7"
+                 "69a6749f3f630f4122cafe28ec4dc47e26d4346d70b98c73f3e9c53ac40c5945398b6eda1a832c89c167eacd901d7e2bf363");
+
+    // Test vectors from https://tools.ietf.org/html/draft-agl-tls-chacha20poly1305-04#section-7
+    TestChaCha20("0000000000000000000000000000000000000000000000000000000000000000", 0, 0,
+                 "76b8e0ada0f13d90405d6ae55386bd28bdd219b8a08ded1aa836efcc8b770dc7da41597c5157488d7724e03fb8d84a376a43b8f41518a11cc387b669b2ee6586");
+    TestChaCha20("0000000000000000000000000000000000000000000000000000000000000001", 0, 0,
+                 "4540f05a9f1fb296d7736e7b208e3c96eb4fe1834688d2604f450952ed432d41bbe2a0b6ea7566d2a5d1e7e20d42af2c53d792b1c43fea817e9ad275ae546963");
+}
+
+static MuHash3072 FromInt(unsigned char i)
+{
+    unsigned char tmp[32] = {i, 0};
+    return MuHash3072(tmp, sizeof(tmp));
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests)
+{
+    uint256 out;
+
+    // The set hash does not depend on the order elements are added in, or on
+    // how the additions are grouped
+    for (int iter = 0; iter < 10; ++iter) {
+        uint256 res;
+        int table[4];
+        for (int i = 0; i < 4; ++i) {
+            table[i] = insecure_rand() & 0xff;
+        }
+        for (int order = 0; order < 4; ++order) {
+            MuHash3072 acc;
+            for (int i = 0; i < 4; ++i) {
+                int t = table[i ^ order];
+                if (t & 4) {
+                    acc /= FromInt(t & 0xf);
+                } else {
+                    acc *= FromInt(t & 0xf);
+                }
+            }
+            acc.Finalize(out);
+            if (order == 0) {
+                res = out;
+            } else {
+                BOOST_CHECK(res == out);
+            }
+        }
+
+        MuHash3072 x = FromInt(insecure_rand() & 0xff); // x=X
+        MuHash3072 y = FromInt(insecure_rand() & 0xff); // x=X, y=Y
+        MuHash3072 z; // x=X, y=Y, z=1
+        z *= x; // x=X, y=Y, z=X
+        z *= y; // x=X, y=Y, z=X*Y
+        y *= x; // x=X, y=X*Y, z=X*Y
+        z /= y; // x=X, y=X*Y, z=1
+        z.Finalize(out);
+
+        uint256 out2;
+        MuHash3072 a;
+        a.Finalize(out2);
+
+        BOOST_CHECK(out == out2);
+    }
+
+    // Known answers, the same as in Bitcoin Core
+    MuHash3072().Finalize(out);
+    BOOST_CHECK_EQUAL(out.GetHex(), "dd5ad2a105c2d29495f577245c357409002329b9f4d6182c0af3dc2f462555c8");
+    MuHash3072 acc = FromInt(0);
+    acc *= FromInt(1);
+    acc /= FromInt(2);
+    acc.Finalize(out);
+    BOOST_CHECK_EQUAL(out.GetHex(), "10d312b100cbd32ada024a6646e40d3482fcff103668d2625f10002a607d5863");
+
+    // Removing an element undoes inserting it
+    unsigned char tmp[32] = {1, 0};
+    MuHash3072 acc2 = FromInt(0);
+    acc2.Insert(tmp, sizeof(tmp));
+    tmp[0] = 2;
+    acc2.Remove(tmp, sizeof(tmp));
+    tmp[0] = 3;
+    acc2.Insert(tmp, sizeof(tmp));
+    acc2.Remove(tmp, sizeof(tmp));
+    uint256 out3;
+    acc2.Finalize(out3);
+    BOOST_CHECK(out == out3);
+
+    // The numerator/denominator state roundtrips through serialization
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    ss << acc;
+    BOOST_CHECK_EQUAL(ss.size(), 2 * Num3072::BYTE_SIZE);
+    MuHash3072 acc3;
+    ss >> acc3;
+    acc3.Finalize(out3);
+    BOOST_CHECK(out == out3);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,99 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "cuckoocache.h"
+#include "script/sigcache.h"
+
+#include "random.h"
+#include "test/test_mano.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(cuckoocache_tests, BasicTestingSetup)
+
+static std::vector<uint256> RandomHashes(size_t n)
+{
+    std::vector<uint256> ret(n);
+    for (size_t i = 0; i < n; i++) {
+        for (int j = 0; j < 8; j++) {
+            uint32_t r = insecure_rand();
+            memcpy(ret[i].begin() + 4 * j, &r, 4);
+        }
+    }
+    return ret;
+}
+
+static double HitRate(const CuckooCache::cache<uint256, SignatureCacheHasher>& set, const std::vector<uint256>& hashes)
+{
+    size_t hits = 0;
+    for (size_t i = 0; i < hashes.size(); i++)
+        hits += set.contains(hashes[i], false);
+    return (double)hits / hashes.size();
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_no_false_positives)
+{
+    CuckooCache::cache<uint256, SignatureCacheHasher> set;
+    set.setup_bytes(32 << 10);
+    std::vector<uint256> hashes = RandomHashes(1000);
+    for (size_t i = 0; i < hashes.size(); i++) {
+        BOOST_CHECK(!set.contains(hashes[i], false));
+        set.insert(hashes[i]);
+    }
+    BOOST_CHECK(!set.contains(RandomHashes(1)[0], false));
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_before_setup)
+{
+    // Lookups may come before the cache is sized, e.g. a script check before InitSignatureCache()
+    CuckooCache::cache<uint256, SignatureCacheHasher> set;
+    std::vector<uint256> hashes = RandomHashes(2);
+    BOOST_CHECK(!set.contains(hashes[0], false));
+    set.insert(hashes[0]);
+    BOOST_CHECK(set.contains(hashes[0], false));
+    set.insert(hashes[1]);
+    BOOST_CHECK(set.contains(hashes[1], false));
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_hit_rate)
+{
+    // At half load nearly everything fits; at twice the capacity the most
+    // recent generation should still mostly be there.
+    CuckooCache::cache<uint256, SignatureCacheHasher> set;
+    uint32_t size = set.setup_bytes(1 << 20);
+    BOOST_CHECK_EQUAL(size, (1 << 20) / sizeof(uint256));
+
+    std::vector<uint256> hashes = RandomHashes(size / 2);
+    for (size_t i = 0; i < hashes.size(); i++)
+        set.insert(hashes[i]);
+    BOOST_CHECK(HitRate(set, hashes) > 0.99);
+
+    hashes = RandomHashes(2 * size);
+    for (size_t i = 0; i < hashes.size(); i++)
+        set.insert(hashes[i]);
+    std::vector<uint256> recent(hashes.end() - size / 4, hashes.end());
+    BOOST_CHECK(HitRate(set, recent) > 0.95);
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_erase)
+{
+    // Entries looked up with erase stay readable until overwritten, and are
+    // the first to go when the table fills up.
+    CuckooCache::cache<uint256, SignatureCacheHasher> set;
+    uint32_t size = set.setup_bytes(1 << 20);
+
+    std::vector<uint256> erased = RandomHashes(size / 2);
+    for (size_t i = 0; i < erased.size(); i++)
+        set.insert(erased[i]);
+    for (size_t i = 0; i < erased.size(); i++)
+        BOOST_CHECK(set.contains(erased[i], true));
+    BOOST_CHECK(HitRate(set, erased) > 0.99);
+
+    std::vector<uint256> kept = RandomHashes(size / 2);
+    for (size_t i = 0; i < kept.size(); i++)
+        set.insert(kept[i]);
+    BOOST_CHECK(HitRate(set, kept) > 0.99);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -64,6 +64,18 @@ BOOST_AUTO_TEST_CASE(siphash)
     hasher.Write(0x2F2E2D2C2B2A2928ULL);
     BOOST_CHECK_EQUAL(hasher.Finalize(),  0xe612a3cb9ecba951ull);
 
+    // Byte writes in any split give the same results as 64-bit writes
+    static const unsigned char data[] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+                                         0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+    CSipHasher hasher2(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL);
+    hasher2.Write(data, 3).Write(data + 3, 5);
+    BOOST_CHECK_EQUAL(hasher2.Finalize(),  0x93f5f5799a932462ull);
+    hasher2.Write(data + 8, 7);
+    // Test vector from the SipHash paper, a 15 byte message
+    BOOST_CHECK_EQUAL(hasher2.Finalize(),  0xa129ca6149be45e5ull);
+    hasher2.Write(data + 15, 1);
+    BOOST_CHECK_EQUAL(hasher2.Finalize(),  0x3f2acc7f57c29bdbull);
+
     BOOST_CHECK_EQUAL(SipHashUint256(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL, uint256S("1f1e1d1c1b1a191817161514131211100f0e0d0c0b0a09080706050403020100")), 0x7127512f72f27cceull);
 
     // Check consistency between CSipHasher and SipHashUint256[Extra].
@@ -11,6 +11,7 @@
 #include "test/test_mano.h"
 
 #include <boost/signals2/signal.hpp>
+#include <boost/thread.hpp>
 #include <boost/test/unit_test.hpp>
 
 BOOST_FIXTURE_TEST_SUITE(main_tests, TestingSetup)
@@ -80,4 +81,34 @@ BOOST_AUTO_TEST_CASE(test_combiner_all)
     Test.disconnect(&ReturnTrue);
     BOOST_CHECK(Test());
 }
+
+BOOST_AUTO_TEST_CASE(precompute_header_hashes)
+{
+    const CBlockHeader genesis = Params(CBaseChainParams::MAIN).GenesisBlock().GetBlockHeader();
+    std::vector<CBlockHeader> headers(64, genesis);
+    for (size_t i = 0; i < headers.size(); i++)
+        headers[i].nNonce += i;
+
+    // Copies taken before any hashing carry no memoized hash.
+    std::vector<CBlockHeader> expected(headers);
+    BOOST_FOREACH(CBlockHeader& header, expected)
+        header.GetHash();
+
+    boost::thread_group workers;
+    for (int i = 0; i < 3; i++)
+        workers.create_thread(&ThreadHeaderHashCheck);
+    int nScriptCheckThreadsSaved = nScriptCheckThreads;
+    nScriptCheckThreads = 4;
+
+    PrecomputeHeaderHashes(headers);
+
+    nScriptCheckThreads = nScriptCheckThreadsSaved;
+    workers.interrupt_all();
+    workers.join_all();
+
+    BOOST_CHECK(headers[0].GetHash() == genesis.GetHash());
+    for (size_t i = 0; i < headers.size(); i++)
+        BOOST_CHECK(headers[i].GetHash() == expected[i].GetHash());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "consensus/merkle.h"
+#include "hash.h"
 #include "test/test_mano.h"
 #include "random.h"
 
@@ -133,4 +134,47 @@ BOOST_AUTO_TEST_CASE(merkle_test)
     }
 }
 
+// Straightforward pairwise computation, one double-SHA256 at a time, flagging
+// any pair of identical siblings.
+static uint256 ComputeMerkleRootPairwise(std::vector<uint256> hashes, bool* mutated)
+{
+    *mutated = false;
+    while (hashes.size() > 1) {
+        std::vector<uint256> next;
+        for (size_t pos = 0; pos < hashes.size(); pos += 2) {
+            const uint256& left = hashes[pos];
+            const uint256& right = pos + 1 < hashes.size() ? hashes[pos + 1] : hashes[pos];
+            if (pos + 1 < hashes.size() && left == right) *mutated = true;
+            next.push_back(Hash(left.begin(), left.end(), right.begin(), right.end()));
+        }
+        hashes.swap(next);
+    }
+    return hashes.empty() ? uint256() : hashes[0];
+}
+
+BOOST_AUTO_TEST_CASE(merkle_root_batched)
+{
+    for (int i = 0; i < 64; i++) {
+        // All sizes from 0 to 40 (covering every mix of 8-way, 4-way and
+        // single hashing on each level), then larger random ones.
+        int ntx = (i <= 40) ? i : 41 + (insecure_rand() % 3000);
+        std::vector<uint256> leaves(ntx);
+        for (int j = 0; j < ntx; j++) {
+            leaves[j] = GetRandHash();
+        }
+        // Every other round, make a random pair of siblings identical.
+        if ((i & 1) && ntx >= 2) {
+            int pos = (insecure_rand() % (ntx / 2)) * 2;
+            leaves[pos + 1] = leaves[pos];
+        }
+        bool mutatedRef = false, mutatedNew = false;
+        uint256 rootRef = ComputeMerkleRootPairwise(leaves, &mutatedRef);
+        uint256 rootNew = ComputeMerkleRoot(leaves, &mutatedNew);
+        BOOST_CHECK(rootRef == rootNew);
+        BOOST_CHECK(mutatedRef == mutatedNew);
+        BOOST_CHECK(mutatedNew == ((i & 1) && ntx >= 2));
+        BOOST_CHECK(ComputeMerkleRoot(leaves) == rootRef);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -388,4 +388,35 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     fCheckpointsEnabled = true;
 }
 
+BOOST_AUTO_TEST_CASE(IncrementExtraNonce_coinbase_branch)
+{
+    const CBlockIndex* pindexPrev = chainActive.Tip();
+    for (int ntx = 1; ntx <= 20; ntx++) {
+        CBlockTemplate tmpl;
+        CBlock& block = tmpl.block;
+        CMutableTransaction coinbase;
+        coinbase.vin.resize(1);
+        coinbase.vin[0].prevout.SetNull();
+        coinbase.vout.resize(1);
+        block.vtx.push_back(coinbase);
+        for (int j = 1; j < ntx; j++) {
+            CMutableTransaction mtx;
+            mtx.nLockTime = j;
+            block.vtx.push_back(mtx);
+        }
+        tmpl.vCoinbaseMerkleBranch = BlockMerkleBranch(block, 0);
+        CBlock blockFull = block;
+
+        // The branch based update must give the same root as rehashing every transaction
+        unsigned int nExtraNonce = 0;
+        IncrementExtraNonce(&tmpl, pindexPrev, nExtraNonce);
+        unsigned int nExtraNonceFull = nExtraNonce - 1;
+        IncrementExtraNonce(&blockFull, pindexPrev, nExtraNonceFull);
+        BOOST_CHECK_EQUAL(nExtraNonce, nExtraNonceFull);
+        BOOST_CHECK(block.vtx[0] == blockFull.vtx[0]);
+        BOOST_CHECK(block.hashMerkleRoot == BlockMerkleRoot(block));
+        BOOST_CHECK(block.hashMerkleRoot == blockFull.hashMerkleRoot);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,96 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "support/allocators/pool.h"
+
+#include "coins.h"
+#include "memusage.h"
+#include "random.h"
+#include "test/test_mano.h"
+
+#include <unordered_map>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(pool_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(pool_basic_allocations)
+{
+    PoolResource<8, 8> resource(16);
+    BOOST_CHECK_EQUAL(resource.ChunkSizeBytes(), 16U);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 0U);
+
+    // Two blocks fill the first chunk, a third needs another one
+    void* a = resource.Allocate(8, 8);
+    void* b = resource.Allocate(8, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    BOOST_CHECK_EQUAL(static_cast<char*>(b) - static_cast<char*>(a), 8);
+    void* c = resource.Allocate(1, 1);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+
+    // Freed blocks are reused before the chunk is touched
+    resource.Deallocate(a, 8, 8);
+    BOOST_CHECK(resource.Allocate(8, 8) == a);
+
+    // Blocks that do not fit are not taken from the pool
+    void* large = resource.Allocate(9, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+    resource.Deallocate(large, 9, 8);
+
+    resource.Deallocate(a, 8, 8);
+    resource.Deallocate(b, 8, 8);
+    resource.Deallocate(c, 1, 1);
+}
+
+BOOST_AUTO_TEST_CASE(pool_unordered_map)
+{
+    typedef PoolAllocator<std::pair<const uint64_t, uint64_t>, sizeof(std::pair<const uint64_t, uint64_t>) + sizeof(void*) * 4> Allocator;
+    typedef std::unordered_map<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>, Allocator> Map;
+
+    Allocator::ResourceType resource(4096);
+    {
+        Map map(0, std::hash<uint64_t>(), std::equal_to<uint64_t>(), &resource);
+        std::unordered_map<uint64_t, uint64_t> reference;
+        for (int i = 0; i < 20000; i++) {
+            uint64_t key = insecure_rand() % 5000;
+            if (insecure_rand() % 3 == 0) {
+                BOOST_CHECK_EQUAL(map.erase(key), reference.erase(key));
+            } else {
+                map[key] = i;
+                reference[key] = i;
+            }
+        }
+        BOOST_CHECK_EQUAL(map.size(), reference.size());
+        for (const auto& entry : reference)
+            BOOST_CHECK(map.count(entry.first) && map[entry.first] == entry.second);
+
+        // Erased nodes are reused, so the pool only grows with the largest size reached
+        size_t nChunks = resource.NumAllocatedChunks();
+        for (int i = 0; i < 10; i++) {
+            map.clear();
+            for (uint64_t key = 0; key < reference.size(); key++)
+                map[key] = key;
+        }
+        BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), nChunks);
+        BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), (memusage::MallocUsage(4096) + memusage::MallocUsage(sizeof(void*) * 3)) * nChunks + memusage::MallocUsage(sizeof(void*) * map.bucket_count()));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(pool_coins_cache_usage)
+{
+    // The coins cache accounts for its pool, and gives it back after a flush
+    CCoinsView root;
+    CCoinsViewCache cache(&root);
+    size_t nEmptyUsage = cache.DynamicMemoryUsage();
+    for (int i = 0; i < 10000; i++)
+        cache.AddCoin(COutPoint(GetRandHash(), 0), Coin(CTxOut(1, CScript()), 1, false), false);
+    BOOST_CHECK(cache.DynamicMemoryUsage() > nEmptyUsage + 10000 * sizeof(CCoinsCacheEntry));
+    cache.SetBestBlock(GetRandHash());
+    cache.Flush();
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), nEmptyUsage);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
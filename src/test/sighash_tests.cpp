@@ -160,6 +160,10 @@ BOOST_AUTO_TEST_CASE(sighash_test)
         std::cout << "\n";
         #endif
         BOOST_CHECK(sh == sho);
+
+        // The precomputed path must agree for every hash type
+        PrecomputedTransactionData txdata(txTo);
+        BOOST_CHECK(SignatureHash(scriptCode, txTo, nIn, nHashType, &txdata) == sho);
     }
     #if defined(PRINT_SIGHASH_JSON)
     std::cout << "]\n";
@@ -212,6 +216,9 @@ BOOST_AUTO_TEST_CASE(sighash_from_data)
 
         sh = SignatureHash(scriptCode, tx, nIn, nHashType);
         BOOST_CHECK_MESSAGE(sh.GetHex() == sigHashHex, strTest);
+        PrecomputedTransactionData txdata(tx);
+        sh = SignatureHash(scriptCode, tx, nIn, nHashType, &txdata);
+        BOOST_CHECK_MESSAGE(sh.GetHex() == sigHashHex, strTest);
     }
 }
 BOOST_AUTO_TEST_SUITE_END()
@@ -9,12 +9,14 @@
 #include "chainparams.h"
 #include "consensus/consensus.h"
 #include "consensus/validation.h"
+#include "crypto/sha256.h"
 #include "key.h"
 #include "validation.h"
 #include "miner.h"
 #include "net_processing.h"
 #include "pubkey.h"
 #include "random.h"
+#include "script/sigcache.h"
 #include "txdb.h"
 #include "txmempool.h"
 #include "ui_interface.h"
@@ -38,9 +40,12 @@ extern void noui_connect();
 
 BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
 {
+        SHA256AutoDetect();
         ECC_Start();
         SetupEnvironment();
         SetupNetworking();
+        InitSignatureCache();
+        InitScriptExecutionCache();
         fPrintToDebugLog = false; // don't want to write to debug.log file
         fCheckBlockIndex = true;
         SelectParams(chainName);
@@ -102,7 +107,11 @@ TestingSetup::~TestingSetup()
         boost::filesystem::remove_all(pathTemp);
 }
 
-TestChain100Setup::TestChain100Setup() : TestingSetup(CBaseChainParams::REGTEST)
+RegTestingSetup::RegTestingSetup() : TestingSetup(CBaseChainParams::REGTEST)
+{
+}
+
+TestChain100Setup::TestChain100Setup()
 {
     // Generate a 100-block chain:
     coinbaseKey.MakeNewKey(true);
@@ -120,7 +129,7 @@ TestChain100Setup::TestChain100Setup() : TestingSetup(CBaseChainParams::REGTEST)
 // scriptPubKey, and try to add it to the current chain.
 //
 CBlock
-TestChain100Setup::CreateAndProcessBlock(const std::vector<CMutableTransaction>& txns, const CScript& scriptPubKey)
+RegTestingSetup::CreateAndProcessBlock(const std::vector<CMutableTransaction>& txns, const CScript& scriptPubKey)
 {
     const CChainParams& chainparams = Params();
     CBlockTemplate *pblocktemplate = CreateNewBlock(chainparams, scriptPubKey);
@@ -134,7 +143,9 @@ TestChain100Setup::CreateAndProcessBlock(const std::vector<CMutableTransaction>&
     unsigned int extraNonce = 0;
     IncrementExtraNonce(&block, chainActive.Tip(), extraNonce);
 
-    while (!CheckProofOfWork(block.GetHash(), block.nBits, chainparams.GetConsensus())) ++block.nNonce;
+    uint256 hash;
+    while (!CheckProofOfWork(hash = block.GetHash(), block.nBits, chainparams.GetConsensus())) ++block.nNonce;
+    block.SetCachedHash(hash);
 
     ProcessNewBlock(chainparams, &block, true, NULL, NULL);
 
@@ -40,16 +40,26 @@ struct CMutableTransaction;
 class CScript;
 
 //
-// Testing fixture that pre-creates a
-// 100-block REGTEST-mode block chain
+// Testing fixture for a REGTEST-mode block chain
+// that starts out with just the genesis block.
+// Blocks are mined at the minimum difficulty until
+// DarkGravityWave starts retargeting at height 25.
 //
-struct TestChain100Setup : public TestingSetup {
-    TestChain100Setup();
+struct RegTestingSetup : public TestingSetup {
+    RegTestingSetup();
 
     // Create a new block with just given transactions, coinbase paying to
     // scriptPubKey, and try to add it to the current chain.
     CBlock CreateAndProcessBlock(const std::vector<CMutableTransaction>& txns,
                                  const CScript& scriptPubKey);
+};
+
+//
+// Testing fixture that pre-creates a
+// 100-block REGTEST-mode block chain
+//
+struct TestChain100Setup : public RegTestingSetup {
+    TestChain100Setup();
 
     ~TestChain100Setup();
 
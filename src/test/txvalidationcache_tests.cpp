@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "coins.h"
 #include "consensus/validation.h"
 #include "key.h"
 #include "validation.h"
@@ -83,4 +84,74 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_block_doublespend, TestChain100Setup)
     BOOST_CHECK_EQUAL(mempool.size(), 0);
 }
 
+// Coins view on top of the tip holding a single output with the given script
+static void AddTestCoin(CCoinsViewCache& view, const COutPoint& outpoint, const CScript& scriptPubKey)
+{
+    view.AddCoin(outpoint, Coin(CTxOut(11*CENT, scriptPubKey), 1, false), false);
+}
+
+BOOST_FIXTURE_TEST_CASE(script_execution_cache, TestingSetup)
+{
+    // Once a transaction passed CheckInputs with cacheFullScriptStore, its
+    // scripts are not executed again for the same flags. To observe this the
+    // spent output is swapped for one that would fail: a cache hit still
+    // succeeds (the cache trusts the txid to commit to its inputs).
+    LOCK(cs_main);
+
+    CKey key;
+    key.MakeNewKey(true);
+    CScript scriptPubKey = CScript() << ToByteVector(key.GetPubKey()) << OP_CHECKSIG;
+    CScript scriptFalse = CScript() << OP_FALSE;
+
+    std::vector<CMutableTransaction> spends(3);
+    for (size_t i = 0; i < spends.size(); i++) {
+        spends[i].vin.resize(1);
+        spends[i].vin[0].prevout = COutPoint(GetRandHash(), 0);
+        spends[i].vout.resize(1);
+        spends[i].vout[0].nValue = 10*CENT;
+        spends[i].vout[0].scriptPubKey = scriptPubKey;
+
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(scriptPubKey, spends[i], 0, SIGHASH_ALL);
+        BOOST_CHECK(key.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        spends[i].vin[0].scriptSig << vchSig;
+    }
+
+    CCoinsViewCache viewValid(pcoinsTip);
+    CCoinsViewCache viewInvalid(pcoinsTip);
+    for (size_t i = 0; i < spends.size(); i++) {
+        AddTestCoin(viewValid, spends[i].vin[0].prevout, scriptPubKey);
+        AddTestCoin(viewInvalid, spends[i].vin[0].prevout, scriptFalse);
+    }
+    const unsigned int flags = SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_DERSIG;
+    CValidationState state;
+
+    // Not cached yet: the failing script is executed
+    CTransaction tx0(spends[0]);
+    BOOST_CHECK(!CheckInputs(tx0, state, viewInvalid, true, flags, true, true));
+
+    // Cached after passing with cacheFullScriptStore, for those flags only
+    BOOST_CHECK(CheckInputs(tx0, state, viewValid, true, flags, true, true));
+    BOOST_CHECK(CheckInputs(tx0, state, viewInvalid, true, flags, true, true));
+    BOOST_CHECK(!CheckInputs(tx0, state, viewInvalid, true, flags | SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY, true, true));
+
+    // A cache hit doesn't queue any script checks either
+    std::vector<CScriptCheck> vChecks;
+    BOOST_CHECK(CheckInputs(tx0, state, viewInvalid, true, flags, false, false, NULL, &vChecks));
+    BOOST_CHECK(vChecks.empty());
+
+    // Without cacheFullScriptStore nothing is stored
+    CTransaction tx1(spends[1]);
+    BOOST_CHECK(CheckInputs(tx1, state, viewValid, true, flags, true, false));
+    BOOST_CHECK(!CheckInputs(tx1, state, viewInvalid, true, flags, true, false));
+
+    // Nor when the checks are deferred to a check queue, as in ConnectBlock
+    CTransaction tx2(spends[2]);
+    vChecks.clear();
+    BOOST_CHECK(CheckInputs(tx2, state, viewValid, true, flags, true, true, NULL, &vChecks));
+    BOOST_CHECK_EQUAL(vChecks.size(), 1);
+    BOOST_CHECK(!CheckInputs(tx2, state, viewInvalid, true, flags, true, true));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
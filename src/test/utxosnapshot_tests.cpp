@@ -0,0 +1,308 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "utxosnapshot.h"
+
+#include "chainparams.h"
+#include "coins.h"
+#include "coinstats.h"
+#include "coinswriter.h"
+#include "consensus/validation.h"
+#include "random.h"
+#include "txdb.h"
+#include "utiltime.h"
+#include "validation.h"
+#include "test/test_mano.h"
+
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(utxosnapshot_tests, TestingSetup)
+
+static void FillCoins(CCoinsView* view, const uint256& hashBlock)
+{
+    CCoinsViewCache cache(view);
+    for (int i = 0; i < 50; i++) {
+        uint256 txid = GetRandHash();
+        for (int n = 0; n < 4; n++) {
+            CScript script = CScript() << OP_DUP << OP_HASH160 << ToByteVector(GetRandHash()) << OP_EQUALVERIFY << OP_CHECKSIG;
+            cache.AddCoin(COutPoint(txid, n * 3), Coin(CTxOut(1000 * i + n, script), i, n == 0), false);
+        }
+    }
+    cache.SetBestBlock(hashBlock);
+    BOOST_CHECK(cache.Flush());
+}
+
+static std::vector<char> ReadFile(const boost::filesystem::path& path)
+{
+    std::ifstream file(path.string().c_str(), std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void WriteFile(const boost::filesystem::path& path, const std::vector<char>& data)
+{
+    std::ofstream file(path.string().c_str(), std::ios::binary | std::ios::trunc);
+    file.write(data.data(), data.size());
+}
+
+static bool AddToCache(CCoinsViewCache* cache, const COutPoint& outpoint, Coin& coin)
+{
+    cache->AddCoin(outpoint, std::move(coin), false);
+    return true;
+}
+
+BOOST_AUTO_TEST_CASE(utxosnapshot_roundtrip)
+{
+    CCoinsViewDB dbSource(1 << 20, true, true);
+    uint256 hashBlock = GetRandHash();
+    FillCoins(&dbSource, hashBlock);
+    CCoinsStats statsSource;
+    BOOST_CHECK(GetUTXOStats(&dbSource, statsSource));
+
+    boost::filesystem::path path = pathTemp / "utxo.dat";
+    CSnapshotMetadata metadata;
+    CCoinsStats stats;
+    std::string strError;
+    BOOST_CHECK(DumpUTXOSnapshot(&dbSource, path, metadata, stats, strError));
+    BOOST_CHECK(metadata.hashBlock == hashBlock);
+    BOOST_CHECK_EQUAL(metadata.nCoinsCount, 200U);
+    BOOST_CHECK(memcmp(metadata.pchMessageStart, Params().MessageStart(), sizeof(metadata.pchMessageStart)) == 0);
+    BOOST_CHECK(stats.hashSerialized == statsSource.hashSerialized);
+    BOOST_CHECK_EQUAL(stats.nTransactions, 50U);
+    BOOST_CHECK_EQUAL(stats.nTotalAmount, statsSource.nTotalAmount);
+    BOOST_CHECK(!boost::filesystem::exists(path.string() + ".incomplete"));
+
+    // An existing file is not overwritten
+    BOOST_CHECK(!DumpUTXOSnapshot(&dbSource, path, metadata, stats, strError));
+
+    // Loading it gives the same set
+    CCoinsViewDB dbTarget(1 << 20, true, true);
+    {
+        CCoinsViewCache cache(&dbTarget);
+        CSnapshotMetadata metadataRead;
+        CCoinsStats statsRead;
+        BOOST_CHECK(ReadUTXOSnapshot(path, metadataRead, statsRead, strError, boost::bind(&AddToCache, &cache, _1, _2)));
+        BOOST_CHECK(metadataRead.hashBlock == hashBlock);
+        BOOST_CHECK_EQUAL(metadataRead.nCoinsCount, 200U);
+        BOOST_CHECK(statsRead.hashSerialized == statsSource.hashSerialized);
+        cache.SetBestBlock(metadataRead.hashBlock);
+        BOOST_CHECK(cache.Flush());
+    }
+    CCoinsStats statsTarget;
+    BOOST_CHECK(GetUTXOStats(&dbTarget, statsTarget));
+    BOOST_CHECK(statsTarget.hashSerialized == statsSource.hashSerialized);
+    BOOST_CHECK_EQUAL(statsTarget.nTransactionOutputs, 200U);
+}
+
+static bool AddToCommitment(CUTXOCommitment* commitment, const COutPoint& outpoint, Coin& coin)
+{
+    commitment->AddCoin(outpoint, coin);
+    return true;
+}
+
+BOOST_AUTO_TEST_CASE(utxosnapshot_commitment)
+{
+    CCoinsViewDB db(1 << 20, true, true);
+    uint256 hashBlock = GetRandHash();
+    FillCoins(&db, hashBlock);
+    CCoinsStats statsScan;
+    BOOST_CHECK(GetUTXOStats(&db, statsScan, true));
+
+    // The commitment built from the snapshot in file order matches the scan
+    boost::filesystem::path path = pathTemp / "utxo.dat";
+    CSnapshotMetadata metadata;
+    CCoinsStats stats;
+    std::string strError;
+    BOOST_CHECK(DumpUTXOSnapshot(&db, path, metadata, stats, strError));
+    CUTXOCommitment commitment;
+    BOOST_CHECK(ReadUTXOSnapshot(path, metadata, stats, strError, boost::bind(&AddToCommitment, &commitment, _1, _2)));
+    CCoinsStats statsCommitment;
+    commitment.GetStats(statsCommitment);
+    BOOST_CHECK(statsCommitment.hashMuHash == statsScan.hashMuHash);
+    BOOST_CHECK_EQUAL(statsCommitment.nTransactionOutputs, statsScan.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(statsCommitment.nBogoSize, statsScan.nBogoSize);
+    BOOST_CHECK_EQUAL(statsCommitment.nTotalAmount, statsScan.nTotalAmount);
+
+    // Spending and creating coins keeps it in step with a rescan
+    {
+        CCoinsViewCache cache(&db);
+        boost::scoped_ptr<CCoinsViewCursor> pcursor(db.Cursor());
+        for (int i = 0; i < 10 && pcursor->Valid(); i++, pcursor->Next()) {
+            COutPoint outpoint;
+            Coin coin;
+            BOOST_CHECK(pcursor->GetKey(outpoint) && pcursor->GetValue(coin));
+            commitment.RemoveCoin(outpoint, coin);
+            cache.SpendCoin(outpoint);
+        }
+        Coin coin(CTxOut(12345, CScript() << OP_TRUE), 100, false);
+        COutPoint outpoint(GetRandHash(), 0);
+        commitment.AddCoin(outpoint, coin);
+        cache.AddCoin(outpoint, std::move(coin), false);
+        BOOST_CHECK(cache.Flush());
+    }
+    CCoinsStats statsRescan;
+    BOOST_CHECK(GetUTXOStats(&db, statsRescan, true));
+    commitment.GetStats(statsCommitment);
+    BOOST_CHECK(statsCommitment.hashMuHash == statsRescan.hashMuHash);
+    BOOST_CHECK_EQUAL(statsCommitment.nTransactionOutputs, 191U);
+    BOOST_CHECK_EQUAL(statsCommitment.nTotalAmount, statsRescan.nTotalAmount);
+
+    // It survives the trip through the block index database
+    pblocktree->WriteCoinStatsIndex(hashBlock, commitment);
+    CUTXOCommitment commitmentRead;
+    BOOST_CHECK(pblocktree->ReadCoinStatsIndex(hashBlock, commitmentRead));
+    commitmentRead.GetStats(statsCommitment);
+    BOOST_CHECK(statsCommitment.hashMuHash == statsRescan.hashMuHash);
+    BOOST_CHECK_EQUAL(statsCommitment.nBogoSize, statsRescan.nBogoSize);
+}
+
+BOOST_AUTO_TEST_CASE(utxosnapshot_corrupt)
+{
+    CCoinsViewDB db(1 << 20, true, true);
+    FillCoins(&db, GetRandHash());
+    boost::filesystem::path path = pathTemp / "utxo.dat";
+    CSnapshotMetadata metadata;
+    CCoinsStats stats;
+    std::string strError;
+    BOOST_CHECK(DumpUTXOSnapshot(&db, path, metadata, stats, strError));
+    BOOST_CHECK(ReadUTXOSnapshot(path, metadata, stats, strError));
+    const std::vector<char> data = ReadFile(path);
+
+    // A changed amount is caught by the checksum
+    std::vector<char> corrupt(data);
+    corrupt[corrupt.size() / 2] ^= 1;
+    WriteFile(path, corrupt);
+    BOOST_CHECK(!ReadUTXOSnapshot(path, metadata, stats, strError));
+
+    // So are a truncated file and trailing data
+    corrupt.assign(data.begin(), data.end() - 1);
+    WriteFile(path, corrupt);
+    BOOST_CHECK(!ReadUTXOSnapshot(path, metadata, stats, strError));
+    corrupt = data;
+    corrupt.push_back(0);
+    WriteFile(path, corrupt);
+    BOOST_CHECK(!ReadUTXOSnapshot(path, metadata, stats, strError));
+
+    // And a wrong magic
+    corrupt = data;
+    corrupt[0] = 'x';
+    WriteFile(path, corrupt);
+    BOOST_CHECK(!ReadUTXOSnapshot(path, metadata, stats, strError));
+
+    WriteFile(path, data);
+    BOOST_CHECK(ReadUTXOSnapshot(path, metadata, stats, strError));
+    BOOST_CHECK_EQUAL(metadata.nCoinsCount, 200U);
+}
+
+//! Fixed time of the blocks the regtest UTXO snapshot in chainparams is taken from
+static const int64_t SNAPSHOT_CHAIN_TIME = 1530000000;
+
+struct SnapshotChainSetup : public RegTestingSetup {
+    ~SnapshotChainSetup()
+    {
+        SetMockTime(0);
+        fTxIndex = true;
+        FlushStateToDisk();
+        if (pcoinswriter) {
+            delete pcoinsTip;
+            delete pcoinswriter;
+            pcoinswriter = NULL;
+            pcoinsTip = new CCoinsViewCache(pcoinsdbview);
+        }
+        ::pcoinsdbview = NULL;
+    }
+
+    //! Start over with empty databases, the way init sets up the chainstate
+    void ResetChainstate()
+    {
+        UnloadBlockIndex();
+        delete pcoinsTip;
+        delete pcoinsdbview;
+        delete pblocktree;
+        pblocktree = new CBlockTreeDB(1 << 20, true);
+        pcoinsdbview = new CCoinsViewDB(1 << 23, true);
+        ::pcoinsdbview = pcoinsdbview;
+        pcoinswriter = new CCoinsViewWriter(pcoinsdbview);
+        pcoinsTip = new CCoinsViewCache(pcoinswriter);
+        BOOST_CHECK(InitBlockIndex(Params()));
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE(utxosnapshot_load_chainstate, SnapshotChainSetup)
+{
+    const CChainParams& chainparams = Params();
+    BOOST_REQUIRE_EQUAL(chainparams.Assumeutxo().size(), 1U);
+    const uint256 hashBase = chainparams.Assumeutxo().begin()->first;
+    const CAssumeutxoData& pinned = chainparams.Assumeutxo().begin()->second;
+
+    // Mine the chain the snapshot is pinned for, then a few blocks on top of it
+    SetMockTime(SNAPSHOT_CHAIN_TIME);
+    boost::filesystem::path path = pathTemp / "utxo.dat";
+    std::vector<CBlock> blocks;
+    while (chainActive.Height() < pinned.nHeight + 5) {
+        blocks.push_back(CreateAndProcessBlock(std::vector<CMutableTransaction>(), CScript() << OP_TRUE));
+        if (chainActive.Height() == pinned.nHeight) {
+            FlushStateToDisk();
+            CSnapshotMetadata metadata;
+            CCoinsStats stats;
+            std::string strError;
+            BOOST_REQUIRE(DumpUTXOSnapshot(pcoinsdbview, path, metadata, stats, strError));
+            BOOST_CHECK_EQUAL(metadata.hashBlock.GetHex(), hashBase.GetHex());
+            BOOST_CHECK_EQUAL(stats.hashSerialized.GetHex(), pinned.hashSerialized.GetHex());
+            BOOST_CHECK_EQUAL(chainActive.Tip()->nChainTx, pinned.nChainTx);
+        }
+    }
+    BOOST_REQUIRE_EQUAL(chainActive.Height(), pinned.nHeight + 5);
+    const uint256 hashTip = chainActive.Tip()->GetBlockHash();
+    FlushStateToDisk();
+    CCoinsStats statsTip;
+    BOOST_CHECK(GetUTXOStats(pcoinsdbview, statsTip));
+
+    // A node that only has the headers loads the snapshot...
+    ResetChainstate();
+    std::vector<CBlockHeader> headers;
+    BOOST_FOREACH(const CBlock& block, blocks)
+        headers.push_back(block.GetBlockHeader());
+    CValidationState state;
+    BOOST_CHECK(ProcessNewBlockHeaders(headers, state, chainparams));
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(GetSnapshotBase() == NULL);
+    }
+
+    CSnapshotMetadata metadata;
+    std::string strError;
+    BOOST_CHECK(fTxIndex);
+    BOOST_CHECK(!LoadSnapshotChainstate(chainparams, path, metadata, strError));
+    fTxIndex = false;
+    BOOST_CHECK_MESSAGE(LoadSnapshotChainstate(chainparams, path, metadata, strError), strError);
+    BOOST_CHECK_EQUAL(metadata.hashBlock.GetHex(), hashBase.GetHex());
+    {
+        LOCK(cs_main);
+        BOOST_CHECK_EQUAL(chainActive.Height(), pinned.nHeight);
+        BOOST_CHECK(GetSnapshotBase() == chainActive.Tip());
+        BOOST_CHECK(!(chainActive[1]->nStatus & BLOCK_HAVE_DATA));
+    }
+
+    // ... and validates the blocks on top of it, ending up with the same coins
+    for (size_t i = pinned.nHeight; i < blocks.size(); i++)
+        BOOST_CHECK(ProcessNewBlock(chainparams, &blocks[i], true, NULL, NULL));
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == hashTip);
+    FlushStateToDisk();
+    CCoinsStats stats;
+    BOOST_CHECK(GetUTXOStats(pcoinsdbview, stats));
+    BOOST_CHECK(stats.hashSerialized == statsTip.hashSerialized);
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(GetSnapshotBase() != NULL);
+        BOOST_CHECK(chainActive.Tip()->nChainTx == pinned.nChainTx + 5);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -14,23 +14,35 @@
 
 #include <stdint.h>
 
+#include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
 
+#include <algorithm>
+#include <functional>
+#include <queue>
+
 using namespace std;
 
 static const char DB_COIN = 'C';
 static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
-static const char DB_ADDRESSINDEX = 'a';
-static const char DB_ADDRESSUNSPENTINDEX = 'u';
+static const char DB_ADDRESSINDEX = 'A';
+static const char DB_ADDRESSUNSPENTINDEX = 'U';
+static const char DB_ADDRESSTXID = 'h';
+static const char DB_ADDRESSINDEX_V1 = 'a';
+static const char DB_ADDRESSUNSPENTINDEX_V1 = 'u';
+static const char DB_ADDRESSBALANCE = 'w';
 static const char DB_TIMESTAMPINDEX = 's';
 static const char DB_SPENTINDEX = 'p';
+static const char DB_COINSTATSINDEX = 'm';
+static const char DB_BLOCKFILTER = 'G';
 static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
+static const char DB_INDEX_BUILD = 'x';
 static const char DB_LAST_BLOCK = 'l';
 
 namespace {
@@ -55,6 +67,18 @@ struct CoinEntry {
     }
 };
 
+//! Add the change in entry to batch, if it has one; returns whether it had
+bool AddCoinToBatch(CDBBatch &batch, const CCoinsMap::value_type &entry) {
+    if (!(entry.second.flags & CCoinsCacheEntry::DIRTY))
+        return false;
+    CoinEntry key(&entry.first);
+    if (entry.second.coin.IsSpent())
+        batch.Erase(key);
+    else
+        batch.Write(key, entry.second.coin);
+    return true;
+}
+
 }
 
 CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
@@ -81,18 +105,26 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     size_t count = 0;
     size_t changed = 0;
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
-        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            CoinEntry entry(&it->first);
-            if (it->second.coin.IsSpent())
-                batch.Erase(entry);
-            else
-                batch.Write(entry, it->second.coin);
+        if (AddCoinToBatch(batch, *it))
             changed++;
-        }
         count++;
         CCoinsMap::iterator itOld = it++;
         mapCoins.erase(itOld);
     }
+    return WriteCoinsBatch(batch, hashBlock, count, changed);
+}
+
+bool CCoinsViewDB::BatchWriteKeep(const CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    CDBBatch batch(db);
+    size_t changed = 0;
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); ++it) {
+        if (AddCoinToBatch(batch, *it))
+            changed++;
+    }
+    return WriteCoinsBatch(batch, hashBlock, mapCoins.size(), changed);
+}
+
+bool CCoinsViewDB::WriteCoinsBatch(CDBBatch &batch, const uint256 &hashBlock, size_t count, size_t changed) {
     if (!hashBlock.IsNull())
         batch.Write(DB_BEST_BLOCK, hashBlock);
 
@@ -222,6 +254,100 @@ bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey,
     return WriteBatch(batch);
 }
 
+namespace {
+
+/** Position of a transaction in the active chain, naming it in the address index */
+struct CAddressTxPosKey {
+    int nHeight;
+    unsigned int nTxIndex;
+
+    CAddressTxPosKey(int nHeightIn, unsigned int nTxIndexIn) : nHeight(nHeightIn), nTxIndex(nTxIndexIn) {}
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return GetSizeOfOrderedVarInt(nHeight) + GetSizeOfOrderedVarInt(nTxIndex);
+    }
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        WriteOrderedVarInt(s, nHeight);
+        WriteOrderedVarInt(s, nTxIndex);
+    }
+};
+
+/** Address index amounts, compressed with the sign in the lowest bit */
+class CAddressAmountCompressor
+{
+private:
+    CAmount &nValue;
+
+public:
+    CAddressAmountCompressor(CAmount &nValueIn) : nValue(nValueIn) {}
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return GetSizeOfVarInt<uint64_t>(Compress());
+    }
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        WriteVarInt<Stream, uint64_t>(s, Compress());
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        uint64_t nVal = ReadVarInt<Stream, uint64_t>(s);
+        nValue = CTxOutCompressor::DecompressAmount(nVal >> 1);
+        if (nVal & 1)
+            nValue = -nValue;
+    }
+
+private:
+    uint64_t Compress() const {
+        return (CTxOutCompressor::CompressAmount(nValue < 0 ? -nValue : nValue) << 1) | (nValue < 0);
+    }
+};
+
+/**
+ * Fills in what the compact address index format leaves out of its entries.
+ * The id of the last transaction looked up is kept, as the entries of one
+ * transaction follow each other.
+ */
+class CAddressEntryReader
+{
+private:
+    CDBWrapper &db;
+    int nLastHeight;
+    unsigned int nLastTxIndex;
+    uint256 lastTxHash;
+
+public:
+    CAddressEntryReader(CDBWrapper &dbIn) : db(dbIn), nLastHeight(-1), nLastTxIndex(0) {}
+
+    bool Read(CDBIterator &iter, CAddressIndexKey &key, CAmount &nValue)
+    {
+        CAddressAmountCompressor value(nValue);
+        if (!iter.GetValue(value))
+            return error("failed to get address index value");
+        if (key.blockHeight != nLastHeight || key.txindex != nLastTxIndex) {
+            if (!db.Read(make_pair(DB_ADDRESSTXID, CAddressTxPosKey(key.blockHeight, key.txindex)), lastTxHash))
+                return error("failed to get address index txid at height %d position %u", key.blockHeight, key.txindex);
+            nLastHeight = key.blockHeight;
+            nLastTxIndex = key.txindex;
+        }
+        key.txhash = lastTxHash;
+        return true;
+    }
+
+    bool Read(CDBIterator &iter, CAddressUnspentKey &key, CAddressUnspentValue &value)
+    {
+        if (!iter.GetValue(value))
+            return error("failed to get address unspent value");
+        if (key.type == 2)
+            value.script = CScript() << OP_HASH160 << ToByteVector(key.hashBytes) << OP_EQUAL;
+        else
+            value.script = CScript() << OP_DUP << OP_HASH160 << ToByteVector(key.hashBytes) << OP_EQUALVERIFY << OP_CHECKSIG;
+        return true;
+    }
+};
+
+}
+
 bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
     CDBBatch batch(*this);
     for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
@@ -238,6 +364,7 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
                                            std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    CAddressEntryReader reader(*this);
 
     pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
 
@@ -246,11 +373,11 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
         std::pair<char,CAddressUnspentKey> key;
         if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
             CAddressUnspentValue nValue;
-            if (pcursor->GetValue(nValue)) {
+            if (reader.Read(*pcursor, key.second, nValue)) {
                 unspentOutputs.push_back(make_pair(key.second, nValue));
                 pcursor->Next();
             } else {
-                return error("failed to get address unspent value");
+                return false;
             }
         } else {
             break;
@@ -260,25 +387,143 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
     return true;
 }
 
+namespace {
+
+/** Sums of address index entries for one address */
+struct CAddressBalanceDelta {
+    CAddressBalanceValue value;
+    int nLastHeight;
+    unsigned int nLastTxIndex;
+
+    CAddressBalanceDelta() : nLastHeight(0), nLastTxIndex(0) {}
+};
+
+typedef std::map<std::pair<unsigned int, uint160>, CAddressBalanceDelta> AddressBalanceDeltaMap;
+
+/** Entries of the same transaction must be passed in a row, as they are stored and built */
+void AddToBalanceDelta(CAddressBalanceDelta& delta, const CAddressIndexKey& key, CAmount nValue)
+{
+    delta.value.balance += nValue;
+    if (nValue > 0)
+        delta.value.received += nValue;
+    if (delta.value.txCount == 0 || key.blockHeight != delta.nLastHeight || key.txindex != delta.nLastTxIndex)
+        delta.value.txCount++;
+    delta.nLastHeight = key.blockHeight;
+    delta.nLastTxIndex = key.txindex;
+}
+
+}
+
+/**
+ * Fold address index entries into the balance records of their addresses in
+ * the batch that writes or erases them. Entries already in (or already gone
+ * from) the database are skipped, so that blocks connected again after an
+ * unclean shutdown are not counted twice.
+ */
+void CBlockTreeDB::UpdateAddressBalances(CDBBatch &batch, const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect, bool fErase) {
+    AddressBalanceDeltaMap mapDeltas;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        if (Exists(make_pair(DB_ADDRESSINDEX, it->first)) != fErase)
+            continue;
+        AddToBalanceDelta(mapDeltas[make_pair(it->first.type, it->first.hashBytes)], it->first, it->second);
+    }
+    for (AddressBalanceDeltaMap::const_iterator it=mapDeltas.begin(); it!=mapDeltas.end(); it++) {
+        std::pair<char, CAddressIndexIteratorKey> key(DB_ADDRESSBALANCE, CAddressIndexIteratorKey(it->first.first, it->first.second));
+        CAddressBalanceValue value;
+        Read(key, value);
+        const CAddressBalanceValue& delta = it->second.value;
+        if (fErase) {
+            value.balance -= delta.balance;
+            value.received -= delta.received;
+            value.txCount -= std::min(value.txCount, delta.txCount);
+        } else {
+            value.balance += delta.balance;
+            value.received += delta.received;
+            value.txCount += delta.txCount;
+        }
+        if (value.IsNull())
+            batch.Erase(key);
+        else
+            batch.Write(key, value);
+    }
+}
+
+/** The transaction ids of the entries are kept once per transaction */
 bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
     CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
+    UpdateAddressBalances(batch, vect, false);
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        CAmount nValue = it->second;
+        batch.Write(make_pair(DB_ADDRESSINDEX, it->first), CAddressAmountCompressor(nValue));
+        if (it == vect.begin() || it->first.txhash != (it - 1)->first.txhash)
+            batch.Write(make_pair(DB_ADDRESSTXID, CAddressTxPosKey(it->first.blockHeight, it->first.txindex)), it->first.txhash);
+    }
     return WriteBatch(batch);
 }
 
 bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
     CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+    UpdateAddressBalances(batch, vect, true);
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
         batch.Erase(make_pair(DB_ADDRESSINDEX, it->first));
+        if (it == vect.begin() || it->first.txhash != (it - 1)->first.txhash)
+            batch.Erase(make_pair(DB_ADDRESSTXID, CAddressTxPosKey(it->first.blockHeight, it->first.txindex)));
+    }
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::ReadAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value) {
+    // Addresses without any entries have no record
+    if (!Read(make_pair(DB_ADDRESSBALANCE, CAddressIndexIteratorKey(type, addressHash)), value))
+        value.SetNull();
+    return true;
+}
+
+bool CBlockTreeDB::BuildAddressBalances() {
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    CDBBatch batch(*this);
+    std::pair<unsigned int, uint160> address;
+    CAddressBalanceDelta delta;
+    uint64_t nAddresses = 0;
+
+    // Address index keys are ordered by address, then by height and
+    // transaction, so each address is summed in a single pass
+    pcursor->Seek(DB_ADDRESSINDEX);
+    while (true) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexKey> key;
+        bool fValid = pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX;
+        if (!delta.value.IsNull() && (!fValid || make_pair(key.second.type, key.second.hashBytes) != address)) {
+            batch.Write(make_pair(DB_ADDRESSBALANCE, CAddressIndexIteratorKey(address.first, address.second)), delta.value);
+            delta = CAddressBalanceDelta();
+            if (++nAddresses % 100000 == 0)
+                LogPrintf("%s: %u addresses\n", __func__, nAddresses);
+            if (batch.SizeEstimate() > (1 << 24)) {
+                if (!WriteBatch(batch))
+                    return error("%s: failed to write address balances", __func__);
+                batch.Clear();
+            }
+        }
+        if (!fValid)
+            break;
+        CAmount nValue;
+        CAddressAmountCompressor value(nValue);
+        if (!pcursor->GetValue(value))
+            return error("%s: failed to get address index value", __func__);
+        address = make_pair(key.second.type, key.second.hashBytes);
+        AddToBalanceDelta(delta, key.second, nValue);
+        pcursor->Next();
+    }
+    LogPrintf("%s: %u addresses\n", __func__, nAddresses);
+    return WriteBatch(batch, true);
+}
+
 bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                                     int start, int end) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    CAddressEntryReader reader(*this);
 
     if (start > 0 && end > 0) {
         pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
@@ -294,11 +539,11 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                 break;
             }
             CAmount nValue;
-            if (pcursor->GetValue(nValue)) {
+            if (reader.Read(*pcursor, key.second, nValue)) {
                 addressIndex.push_back(make_pair(key.second, nValue));
                 pcursor->Next();
             } else {
-                return error("failed to get address index value");
+                return false;
             }
         } else {
             break;
@@ -308,6 +553,315 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
     return true;
 }
 
+namespace {
+
+/** Address keys start with the type byte and the 20 byte address hash */
+static const size_t ADDRESS_KEY_PREFIX_SIZE = 21;
+
+int AddressKeyHeight(const CAddressIndexKey& key) { return key.blockHeight; }
+int AddressKeyHeight(const CAddressUnspentKey& key) { return 0; }
+
+/**
+ * Order in which entries of several addresses are merged: the per-address part
+ * of the key as the database sorts it, then the address. Each address iterator
+ * then already yields its entries in merge order.
+ */
+template<typename K>
+std::vector<unsigned char> AddressMergeOrder(const K& key)
+{
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey << key;
+    std::vector<unsigned char> vch(ssKey.begin() + ADDRESS_KEY_PREFIX_SIZE, ssKey.end());
+    vch.insert(vch.end(), ssKey.begin(), ssKey.begin() + ADDRESS_KEY_PREFIX_SIZE);
+    return vch;
+}
+
+/**
+ * K-way merge over one database iterator per address. Only the current entry
+ * of every address is held in memory.
+ */
+template<typename K, typename V>
+class CAddressMergeCursor
+{
+private:
+    struct Head {
+        std::vector<unsigned char> order;
+        size_t nStream;
+        K key;
+        V value;
+        bool operator>(const Head& other) const { return order > other.order; }
+    };
+
+    CDBWrapper &db;
+    CAddressEntryReader reader;
+    char chPrefix;
+    int nStart, nEnd;
+    std::vector<std::pair<uint160, int> > vAddresses;
+    std::vector<boost::shared_ptr<CDBIterator> > vIterators;
+    std::vector<unsigned char> afterOrder;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head> > heads;
+
+    bool Fetch(size_t nStream)
+    {
+        CDBIterator& iter = *vIterators[nStream];
+        const std::pair<uint160, int>& address = vAddresses[nStream];
+        while (iter.Valid()) {
+            boost::this_thread::interruption_point();
+            std::pair<char, K> key;
+            if (!iter.GetKey(key) || key.first != chPrefix || key.second.type != (unsigned int)address.second || key.second.hashBytes != address.first)
+                break;
+            if (nEnd > 0 && AddressKeyHeight(key.second) > nEnd)
+                break;
+            Head head;
+            head.order = AddressMergeOrder(key.second);
+            if (!afterOrder.empty() && head.order <= afterOrder) {
+                iter.Next();
+                continue;
+            }
+            if (!reader.Read(iter, key.second, head.value))
+                return false;
+            head.nStream = nStream;
+            head.key = key.second;
+            heads.push(head);
+            iter.Next();
+            break;
+        }
+        return true;
+    }
+
+public:
+    CAddressMergeCursor(CDBWrapper &dbIn, char chPrefixIn, int nStartIn, int nEndIn) :
+        db(dbIn), reader(dbIn), chPrefix(chPrefixIn), nStart(nStartIn), nEnd(nEndIn) {}
+
+    bool Init(const std::vector<std::pair<uint160, int> > &addresses, const K *pAfter)
+    {
+        vAddresses = addresses;
+        std::sort(vAddresses.begin(), vAddresses.end());
+        vAddresses.erase(std::unique(vAddresses.begin(), vAddresses.end()), vAddresses.end());
+        if (pAfter)
+            afterOrder = AddressMergeOrder(*pAfter);
+
+        for (size_t i = 0; i < vAddresses.size(); i++) {
+            const uint160& hash = vAddresses[i].first;
+            const int type = vAddresses[i].second;
+            vIterators.push_back(boost::shared_ptr<CDBIterator>(db.NewIterator()));
+            if (pAfter && AddressKeyHeight(*pAfter) >= nStart) {
+                // Position at the cursor as if it belonged to this address
+                K seek = *pAfter;
+                seek.type = type;
+                seek.hashBytes = hash;
+                vIterators[i]->Seek(make_pair(chPrefix, seek));
+            } else if (nStart > 0) {
+                vIterators[i]->Seek(make_pair(chPrefix, CAddressIndexIteratorHeightKey(type, hash, nStart)));
+            } else {
+                vIterators[i]->Seek(make_pair(chPrefix, CAddressIndexIteratorKey(type, hash)));
+            }
+            if (!Fetch(i))
+                return false;
+        }
+        return true;
+    }
+
+    bool Valid() const { return !heads.empty(); }
+    const K& GetKey() const { return heads.top().key; }
+    const V& GetValue() const { return heads.top().value; }
+
+    bool Next()
+    {
+        size_t nStream = heads.top().nStream;
+        heads.pop();
+        return Fetch(nStream);
+    }
+};
+
+/**
+ * Read up to nLimit merged entries following pAfter. With fWholeTx the limit
+ * counts transactions instead, and a transaction is never split across pages.
+ */
+template<typename K, typename V>
+bool ReadAddressPage(CDBWrapper &db, char chPrefix, const std::vector<std::pair<uint160, int> > &addresses,
+                     const K *pAfter, int start, int end, size_t nLimit, bool fWholeTx,
+                     std::vector<std::pair<K, V> > &vect, bool &fMore)
+{
+    CAddressMergeCursor<K, V> cursor(db, chPrefix, start, end);
+    if (!cursor.Init(addresses, pAfter))
+        return false;
+
+    fMore = false;
+    size_t nCount = 0;
+    uint256 lastTxHash;
+    while (cursor.Valid()) {
+        const K& key = cursor.GetKey();
+        if (!fWholeTx || nCount == 0 || key.txhash != lastTxHash) {
+            if (nLimit > 0 && nCount == nLimit) {
+                fMore = true;
+                break;
+            }
+            nCount++;
+            lastTxHash = key.txhash;
+        }
+        vect.push_back(make_pair(key, cursor.GetValue()));
+        if (!cursor.Next())
+            return false;
+    }
+    return true;
+}
+
+}
+
+bool CBlockTreeDB::ReadAddressIndexPage(const std::vector<std::pair<uint160, int> > &addresses,
+                                        const CAddressIndexKey *pAfter, int start, int end,
+                                        size_t nLimit, bool fWholeTx,
+                                        std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, bool &fMore) {
+    return ReadAddressPage(*this, DB_ADDRESSINDEX, addresses, pAfter, start, end, nLimit, fWholeTx, addressIndex, fMore);
+}
+
+bool CBlockTreeDB::ReadAddressUnspentPage(const std::vector<std::pair<uint160, int> > &addresses,
+                                          const CAddressUnspentKey *pAfter, size_t nLimit,
+                                          std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs, bool &fMore) {
+    return ReadAddressPage(*this, DB_ADDRESSUNSPENTINDEX, addresses, pAfter, 0, 0, nLimit, false, unspentOutputs, fMore);
+}
+
+namespace {
+
+/** Address index key as written in the original format, with the transaction id */
+struct CAddressIndexKeyV1 {
+    CAddressIndexKey key;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 66;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        ser_writedata8(s, key.type);
+        key.hashBytes.Serialize(s, nType, nVersion);
+        ser_writedata32be(s, key.blockHeight);
+        ser_writedata32be(s, key.txindex);
+        key.txhash.Serialize(s, nType, nVersion);
+        ser_writedata32(s, key.index);
+        char f = key.spending;
+        ser_writedata8(s, f);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        key.type = ser_readdata8(s);
+        key.hashBytes.Unserialize(s, nType, nVersion);
+        key.blockHeight = ser_readdata32be(s);
+        key.txindex = ser_readdata32be(s);
+        key.txhash.Unserialize(s, nType, nVersion);
+        key.index = ser_readdata32(s);
+        char f = ser_readdata8(s);
+        key.spending = f;
+    }
+};
+
+/** Address unspent index key as written in the original format */
+struct CAddressUnspentKeyV1 {
+    CAddressUnspentKey key;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 57;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        ser_writedata8(s, key.type);
+        key.hashBytes.Serialize(s, nType, nVersion);
+        key.txhash.Serialize(s, nType, nVersion);
+        ser_writedata32(s, key.index);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        key.type = ser_readdata8(s);
+        key.hashBytes.Unserialize(s, nType, nVersion);
+        key.txhash.Unserialize(s, nType, nVersion);
+        key.index = ser_readdata32(s);
+    }
+};
+
+/** Address unspent index value as written in the original format, with the script */
+struct CAddressUnspentValueV1 {
+    CAddressUnspentValue value;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(value.satoshis);
+        READWRITE(*(CScriptBase*)(&value.script));
+        READWRITE(value.blockHeight);
+    }
+};
+
+}
+
+/**
+ * Every batch writes the converted entries and erases their originals, so an
+ * interrupted upgrade carries on where it stopped at the next start.
+ */
+bool CBlockTreeDB::UpgradeAddressIndex() {
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    CDBBatch batch(*this);
+    uint64_t nEntries = 0;
+
+    pcursor->Seek(DB_ADDRESSINDEX_V1);
+    while (true) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexKeyV1> key;
+        if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_ADDRESSINDEX_V1)
+            break;
+        CAmount nValue;
+        if (!pcursor->GetValue(nValue))
+            return error("%s: failed to get address index value", __func__);
+        if (nEntries == 0)
+            LogPrintf("%s: converting the address index to the compact format\n", __func__);
+        const CAddressIndexKey& entry = key.second.key;
+        batch.Write(make_pair(DB_ADDRESSINDEX, entry), CAddressAmountCompressor(nValue));
+        batch.Write(make_pair(DB_ADDRESSTXID, CAddressTxPosKey(entry.blockHeight, entry.txindex)), entry.txhash);
+        batch.Erase(key);
+        if (++nEntries % 1000000 == 0)
+            LogPrintf("%s: %u entries\n", __func__, nEntries);
+        if (batch.SizeEstimate() > (1 << 24)) {
+            if (!WriteBatch(batch))
+                return error("%s: failed to write address index", __func__);
+            batch.Clear();
+        }
+        pcursor->Next();
+    }
+
+    pcursor->Seek(DB_ADDRESSUNSPENTINDEX_V1);
+    while (true) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressUnspentKeyV1> key;
+        if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_ADDRESSUNSPENTINDEX_V1)
+            break;
+        CAddressUnspentValueV1 value;
+        if (!pcursor->GetValue(value))
+            return error("%s: failed to get address unspent value", __func__);
+        if (nEntries == 0)
+            LogPrintf("%s: converting the address index to the compact format\n", __func__);
+        batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, key.second.key), value.value);
+        batch.Erase(key);
+        if (++nEntries % 1000000 == 0)
+            LogPrintf("%s: %u entries\n", __func__, nEntries);
+        if (batch.SizeEstimate() > (1 << 24)) {
+            if (!WriteBatch(batch))
+                return error("%s: failed to write address index", __func__);
+            batch.Clear();
+        }
+        pcursor->Next();
+    }
+
+    if (nEntries == 0)
+        return true;
+    if (!WriteBatch(batch, true))
+        return error("%s: failed to write address index", __func__);
+    LogPrintf("%s: converted %u entries\n", __func__, nEntries);
+    // Reclaim the space of the original entries
+    CompactRange(DB_ADDRESSINDEX_V1, (char)(DB_ADDRESSINDEX_V1 + 1));
+    CompactRange(DB_ADDRESSUNSPENTINDEX_V1, (char)(DB_ADDRESSUNSPENTINDEX_V1 + 1));
+    return true;
+}
+
 bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
     CDBBatch batch(*this);
     batch.Write(make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
@@ -334,6 +888,44 @@ bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned i
     return true;
 }
 
+bool CBlockTreeDB::WriteCoinStatsIndex(const uint256 &hash, const CUTXOCommitment &commitment) {
+    return Write(make_pair(DB_COINSTATSINDEX, hash), commitment);
+}
+
+bool CBlockTreeDB::ReadCoinStatsIndex(const uint256 &hash, CUTXOCommitment &commitment) {
+    return Read(make_pair(DB_COINSTATSINDEX, hash), commitment);
+}
+
+/**
+ * Filters are kept by block hash, after their header and their hash so that
+ * these can be read without the filter.
+ */
+bool CBlockTreeDB::WriteBlockFilter(const CBlockFilter &filter, const uint256 &header) {
+    return Write(make_pair(DB_BLOCKFILTER, filter.GetBlockHash()), make_pair(make_pair(header, filter.GetHash()), filter.GetEncodedFilter()));
+}
+
+bool CBlockTreeDB::ReadBlockFilter(const uint256 &hash, CBlockFilter &filter, uint256 &header) {
+    std::pair<std::pair<uint256, uint256>, std::vector<unsigned char> > value;
+    if (!Read(make_pair(DB_BLOCKFILTER, hash), value))
+        return false;
+    try {
+        filter = CBlockFilter(BLOCK_FILTER_BASIC, hash, value.second);
+    } catch (const std::exception&) {
+        return error("%s: invalid filter for block %s", __func__, hash.ToString());
+    }
+    header = value.first.first;
+    return true;
+}
+
+bool CBlockTreeDB::ReadBlockFilterHeader(const uint256 &hash, uint256 &header, uint256 &filterHash) {
+    std::pair<uint256, uint256> value;
+    if (!Read(make_pair(DB_BLOCKFILTER, hash), value))
+        return false;
+    header = value.first;
+    filterHash = value.second;
+    return true;
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
@@ -346,6 +938,23 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
+bool CBlockTreeDB::WriteIndexBuildState(int nIndexes, const uint256 &hashBlock) {
+    return Write(DB_INDEX_BUILD, std::make_pair(nIndexes, hashBlock));
+}
+
+bool CBlockTreeDB::ReadIndexBuildState(int &nIndexes, uint256 &hashBlock) {
+    std::pair<int, uint256> state;
+    if (!Read(DB_INDEX_BUILD, state))
+        return false;
+    nIndexes = state.first;
+    hashBlock = state.second;
+    return true;
+}
+
+bool CBlockTreeDB::EraseIndexBuildState() {
+    return Erase(DB_INDEX_BUILD);
+}
+
 bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex)
 {
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
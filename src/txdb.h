@@ -6,9 +6,11 @@
 #ifndef BITCOIN_TXDB_H
 #define BITCOIN_TXDB_H
 
+#include "blockfilter.h"
 #include "coins.h"
 #include "dbwrapper.h"
 #include "chain.h"
+#include "coinstats.h"
 #include "spentindex.h"
 
 #include <map>
@@ -71,6 +73,9 @@ class CCoinsViewDB : public CCoinsView
 {
 protected:
     CDBWrapper db;
+
+    //! Write batch (with the best block, if not null) and log the number of changes
+    bool WriteCoinsBatch(CDBBatch &batch, const uint256 &hashBlock, size_t count, size_t changed);
 public:
     CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
@@ -78,6 +83,7 @@ public:
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool BatchWriteKeep(const CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
 
     //! Attempt to update from an older database format. Returns whether an error occurred.
@@ -115,6 +121,7 @@ public:
 private:
     CBlockTreeDB(const CBlockTreeDB&);
     void operator=(const CBlockTreeDB&);
+    void UpdateAddressBalances(CDBBatch &batch, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fErase);
 public:
     bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo);
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo &fileinfo);
@@ -133,10 +140,34 @@ public:
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                           int start = 0, int end = 0);
+    //! Read the entries of several addresses merged by height, after the key pAfter if given. A zero limit reads all.
+    bool ReadAddressIndexPage(const std::vector<std::pair<uint160, int> > &addresses,
+                              const CAddressIndexKey *pAfter, int start, int end,
+                              size_t nLimit, bool fWholeTx,
+                              std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, bool &fMore);
+    //! Read the unspent outputs of several addresses merged by outpoint, after the key pAfter if given
+    bool ReadAddressUnspentPage(const std::vector<std::pair<uint160, int> > &addresses,
+                                const CAddressUnspentKey *pAfter, size_t nLimit,
+                                std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs, bool &fMore);
+    bool ReadAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value);
+    //! Compute the balance records from the address index, for databases written before they existed
+    bool BuildAddressBalances();
+    //! Convert address index entries written in the original format to the compact one
+    bool UpgradeAddressIndex();
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
+    bool WriteCoinStatsIndex(const uint256 &hash, const CUTXOCommitment &commitment);
+    bool ReadCoinStatsIndex(const uint256 &hash, CUTXOCommitment &commitment);
+    bool WriteBlockFilter(const CBlockFilter &filter, const uint256 &header);
+    bool ReadBlockFilter(const uint256 &hash, CBlockFilter &filter, uint256 &header);
+    //! Read the filter header and the filter hash, without the filter
+    bool ReadBlockFilterHeader(const uint256 &hash, uint256 &header, uint256 &filterHash);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
+    //! Indexes being built in the background (INDEX_BUILD_*) and the last block they cover
+    bool WriteIndexBuildState(int nIndexes, const uint256 &hashBlock);
+    bool ReadIndexBuildState(int &nIndexes, uint256 &hashBlock);
+    bool EraseIndexBuildState();
     bool LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex);
 };
 
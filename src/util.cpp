@@ -797,6 +797,13 @@ void AllocateFileRange(FILE *file, unsigned int offset, unsigned int length) {
 #endif
 }
 
+void FileAdviseSequential(FILE *file) {
+#if defined(POSIX_FADV_SEQUENTIAL)
+    // Let the kernel read further ahead than it would for random access
+    posix_fadvise(fileno(file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
 void ShrinkDebugFile()
 {
     // Amount of debug.log to save at end when shrinking (must fit in memory)
@@ -0,0 +1,145 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "utxosnapshot.h"
+
+#include "chainparams.h"
+#include "clientversion.h"
+#include "streams.h"
+#include "tinyformat.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp> // boost::this_thread::interruption_point
+
+/** Write the unspent outputs of one transaction. */
+static void WriteOutputs(CAutoFile& fileout, const uint256& txid, std::vector<std::pair<uint32_t, Coin> >& outputs)
+{
+    fileout << txid;
+    WriteCompactSize(fileout, outputs.size());
+    for (size_t i = 0; i < outputs.size(); i++)
+        fileout << VARINT(outputs[i].first) << outputs[i].second;
+    outputs.clear();
+}
+
+bool DumpUTXOSnapshot(CCoinsView* view, const boost::filesystem::path& path, CSnapshotMetadata& metadata, CCoinsStats& stats, std::string& strError)
+{
+    if (boost::filesystem::exists(path)) {
+        strError = strprintf("%s already exists", path.string());
+        return false;
+    }
+    boost::filesystem::path pathTmp = path.string() + ".incomplete";
+    CAutoFile fileout(fopen(pathTmp.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull()) {
+        strError = strprintf("Could not open %s for writing", pathTmp.string());
+        return false;
+    }
+
+    boost::scoped_ptr<CCoinsViewCursor> pcursor(view->Cursor());
+    memcpy(metadata.pchMessageStart, Params().MessageStart(), sizeof(metadata.pchMessageStart));
+    metadata.hashBlock = pcursor->GetBestBlock();
+    metadata.nCoinsCount = 0;
+    stats = CCoinsStats();
+    try {
+        fileout << metadata;
+        CCoinsStatsBuilder builder(stats, metadata.hashBlock);
+        uint256 txidPrev;
+        std::vector<std::pair<uint32_t, Coin> > outputs;
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            COutPoint key;
+            Coin coin;
+            if (!pcursor->GetKey(key) || !pcursor->GetValue(coin))
+                throw std::runtime_error("unable to read coins database");
+            if (!outputs.empty() && key.hash != txidPrev)
+                WriteOutputs(fileout, txidPrev, outputs);
+            txidPrev = key.hash;
+            builder.Add(key, coin);
+            outputs.push_back(std::make_pair(key.n, std::move(coin)));
+            metadata.nCoinsCount++;
+            pcursor->Next();
+        }
+        if (!outputs.empty())
+            WriteOutputs(fileout, txidPrev, outputs);
+        builder.Finalize();
+        fileout << stats.hashSerialized;
+
+        // Now that the number of coins is known, write the header again
+        if (fseek(fileout.Get(), 0, SEEK_SET) != 0)
+            throw std::runtime_error("unable to seek");
+        fileout << metadata;
+        FileCommit(fileout.Get());
+    } catch (const std::exception& e) {
+        fileout.fclose();
+        boost::filesystem::remove(pathTmp);
+        strError = strprintf("Error writing %s: %s", pathTmp.string(), e.what());
+        return false;
+    }
+    fileout.fclose();
+
+    if (!RenameOver(pathTmp, path)) {
+        strError = strprintf("Could not rename %s to %s", pathTmp.string(), path.string());
+        return false;
+    }
+    return true;
+}
+
+bool ReadUTXOSnapshot(const boost::filesystem::path& path, CSnapshotMetadata& metadata, CCoinsStats& stats, std::string& strError,
+                      const boost::function<bool(const COutPoint&, Coin&)>& fnCoin)
+{
+    CAutoFile filein(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        strError = strprintf("Could not open %s", path.string());
+        return false;
+    }
+
+    stats = CCoinsStats();
+    try {
+        filein >> metadata;
+        CCoinsStatsBuilder builder(stats, metadata.hashBlock);
+        uint64_t nRead = 0;
+        while (nRead < metadata.nCoinsCount) {
+            boost::this_thread::interruption_point();
+            uint256 txid;
+            filein >> txid;
+            uint64_t nOutputs = ReadCompactSize(filein);
+            if (nOutputs == 0 || nOutputs > metadata.nCoinsCount - nRead)
+                throw std::ios_base::failure("bad number of outputs");
+            for (uint64_t i = 0; i < nOutputs; i++) {
+                uint32_t n;
+                Coin coin;
+                filein >> VARINT(n) >> coin;
+                if (coin.IsSpent())
+                    throw std::ios_base::failure("spent coin");
+                COutPoint outpoint(txid, n);
+                builder.Add(outpoint, coin);
+                if (fnCoin && !fnCoin(outpoint, coin)) {
+                    strError = strprintf("Reading %s was aborted", path.string());
+                    return false;
+                }
+                nRead++;
+            }
+        }
+        builder.Finalize();
+
+        uint256 hashChecksum;
+        filein >> hashChecksum;
+        if (hashChecksum != stats.hashSerialized)
+            throw std::ios_base::failure("checksum mismatch");
+        // Outputs of a transaction that appear twice are only counted once
+        if (stats.nTransactionOutputs != metadata.nCoinsCount)
+            throw std::ios_base::failure("duplicate coins");
+        char c;
+        if (fread(&c, 1, 1, filein.Get()) == 1)
+            throw std::ios_base::failure("data after the checksum");
+    } catch (const std::exception& e) {
+        strError = strprintf("Error reading %s: %s", path.string(), e.what());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,93 @@
+// Copyright (c) 2018 The MANO Coin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTXOSNAPSHOT_H
+#define BITCOIN_UTXOSNAPSHOT_H
+
+#include "coins.h"
+#include "coinstats.h"
+#include "protocol.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <ios>
+#include <string.h>
+#include <string>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/function.hpp>
+
+//! Bytes every UTXO snapshot file starts with
+static const unsigned char SNAPSHOT_MAGIC_BYTES[5] = {'u', 't', 'x', 'o', 0xff};
+//! Current UTXO snapshot file format
+static const uint16_t SNAPSHOT_VERSION = 1;
+
+/**
+ * Header of a UTXO snapshot file.
+ *
+ * The file format is:
+ * - this header (magic bytes, format version, network magic, block hash, coin count),
+ * - for every transaction with unspent outputs, in coins database order:
+ *   the txid, the number of outputs and each output as VARINT(n) and Coin,
+ * - the hash_serialized of gettxoutsetinfo at that block, as a checksum.
+ */
+class CSnapshotMetadata
+{
+public:
+    CMessageHeader::MessageStartChars pchMessageStart;
+    //! Block the coins are the UTXO set at
+    uint256 hashBlock;
+    //! Number of coins in the file
+    uint64_t nCoinsCount;
+
+    CSnapshotMetadata() : nCoinsCount(0)
+    {
+        memset(pchMessageStart, 0, sizeof(pchMessageStart));
+    }
+
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        s.write((const char*)SNAPSHOT_MAGIC_BYTES, sizeof(SNAPSHOT_MAGIC_BYTES));
+        ::Serialize(s, SNAPSHOT_VERSION, nType, nVersion);
+        s.write((const char*)pchMessageStart, sizeof(pchMessageStart));
+        ::Serialize(s, hashBlock, nType, nVersion);
+        ::Serialize(s, nCoinsCount, nType, nVersion);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        unsigned char magic[sizeof(SNAPSHOT_MAGIC_BYTES)];
+        s.read((char*)magic, sizeof(magic));
+        if (memcmp(magic, SNAPSHOT_MAGIC_BYTES, sizeof(magic)) != 0)
+            throw std::ios_base::failure("not a UTXO snapshot");
+        uint16_t nSnapshotVersion;
+        ::Unserialize(s, nSnapshotVersion, nType, nVersion);
+        if (nSnapshotVersion != SNAPSHOT_VERSION)
+            throw std::ios_base::failure("unsupported UTXO snapshot version");
+        s.read((char*)pchMessageStart, sizeof(pchMessageStart));
+        ::Unserialize(s, hashBlock, nType, nVersion);
+        ::Unserialize(s, nCoinsCount, nType, nVersion);
+    }
+};
+
+/**
+ * Write the coins in view to a snapshot file at path, which must not exist
+ * yet. The file only appears once it is complete. On success, metadata and
+ * stats describe what was written.
+ */
+bool DumpUTXOSnapshot(CCoinsView* view, const boost::filesystem::path& path, CSnapshotMetadata& metadata, CCoinsStats& stats, std::string& strError);
+
+/**
+ * Read a snapshot file, passing every coin to fnCoin (if set) as it is read;
+ * reading stops if fnCoin returns false. Succeeds only if the file is well
+ * formed and its checksum matches, in which case metadata and stats describe
+ * it (stats.hashSerialized can be compared to gettxoutsetinfo). fnCoin sees
+ * the coins before the checksum is verified.
+ */
+bool ReadUTXOSnapshot(const boost::filesystem::path& path, CSnapshotMetadata& metadata, CCoinsStats& stats, std::string& strError,
+                      const boost::function<bool(const COutPoint&, Coin&)>& fnCoin = boost::function<bool(const COutPoint&, Coin&)>());
+
+#endif // BITCOIN_UTXOSNAPSHOT_H
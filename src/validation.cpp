@@ -9,9 +9,14 @@
 
 #include "alert.h"
 #include "arith_uint256.h"
+#include "blockfilter.h"
+#include "blockreader.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
+#include "coinsprefetch.h"
+#include "coinswriter.h"
+#include "cuckoocache.h"
 #include "consensus/consensus.h"
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
@@ -30,6 +35,7 @@
 #include "txmempool.h"
 #include "ui_interface.h"
 #include "undo.h"
+#include "utxosnapshot.h"
 #include "util.h"
 #include "spork.h"
 #include "utilmoneystr.h"
@@ -48,6 +54,7 @@
 #include <boost/filesystem/fstream.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/math/distributions/poisson.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
 
 using namespace std;
@@ -74,12 +81,20 @@ bool fTxIndex = true;
 bool fAddressIndex = false;
 bool fTimestampIndex = false;
 bool fSpentIndex = false;
+bool fCoinStatsIndex = false;
+bool fBlockFilterIndex = false;
+
+/** Indexes being built in the background (INDEX_BUILD_*) */
+static std::atomic<int> nIndexesBuilding{0};
+/** The last block whose entries the indexes being built have, NULL before genesis. Guarded by cs_main. */
+static const CBlockIndex *pindexIndexBuilt = NULL;
 bool fHavePruned = false;
 bool fPruneMode = false;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 bool fRequireStandard = true;
 unsigned int nBytesPerSigOp = DEFAULT_BYTES_PER_SIGOP;
 bool fCheckBlockIndex = false;
+bool fCheckBlockReadPoW = DEFAULT_CHECK_BLOCK_READ_POW;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
 size_t nCoinCacheUsage = 5000 * 300;
 uint64_t nPruneTarget = 0;
@@ -102,6 +117,7 @@ map<uint256, int64_t> mapRejectedBlocks GUARDED_BY(cs_main);
  * in the last Consensus::Params::nMajorityWindow blocks, starting at pstart and going backwards.
  */
 static bool IsSuperMajority(int minVersion, const CBlockIndex* pstart, unsigned nRequired, const Consensus::Params& consensusParams);
+static unsigned int GetBlockScriptFlags(const CBlockIndex* pindex, const Consensus::Params& consensusparams);
 static void CheckBlockIndex(const Consensus::Params& consensusParams);
 
 /** Constant stuff for coinbase transactions we create: */
@@ -186,8 +202,11 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 }
 
 CCoinsViewDB *pcoinsdbview = NULL;
+CCoinsViewPrefetch *pcoinsprefetch = NULL;
+CCoinsViewWriter *pcoinswriter = NULL;
 CCoinsViewCache *pcoinsTip = NULL;
 CBlockTreeDB *pblocktree = NULL;
+CBlockFileReader *pblockreader = NULL;
 
 enum FlushStateMode {
     FLUSH_STATE_NONE,
@@ -961,11 +980,17 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
 
         // Check against previous transactions
         // This is done last to help prevent CPU exhaustion denial-of-service attacks.
-        if (!CheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true))
+        PrecomputedTransactionData txdata(tx);
+        if (!CheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true, false, &txdata))
             return false;
 
-        // Check again against just the consensus-critical mandatory script
-        // verification flags, in case of bugs in the standard flags that cause
+        // Check again against the script verification flags of the current
+        // tip, and remember the result in the script execution cache so that
+        // ConnectBlock can skip these scripts entirely. If the next block has
+        // different flags (a soft fork activating), the cache entries simply
+        // miss for it.
+        //
+        // This is also useful in case of bugs in the standard flags that cause
         // transactions to pass as valid when they're actually invalid. For
         // instance the STRICTENC flag was incorrectly allowing certain
         // CHECKSIG NOT scripts to pass, even though they were invalid.
@@ -973,9 +998,10 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
         // There is a similar check in CreateNewBlock() to prevent creating
         // invalid blocks, however allowing such transactions into the mempool
         // can be exploited as a DoS attack.
-        if (!CheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true))
+        unsigned int currentBlockScriptVerifyFlags = GetBlockScriptFlags(chainActive.Tip(), Params().GetConsensus());
+        if (!CheckInputs(tx, state, view, true, currentBlockScriptVerifyFlags, true, true, &txdata))
         {
-            return error("%s: BUG! PLEASE REPORT THIS! ConnectInputs failed against MANDATORY but not STANDARD flags %s, %s",
+            return error("%s: BUG! PLEASE REPORT THIS! ConnectInputs failed against latest-block but not STANDARD flags %s, %s",
                 __func__, hash.ToString(), FormatStateMessage(state));
         }
 
@@ -1037,6 +1063,8 @@ bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::v
 {
     if (!fTimestampIndex)
         return error("Timestamp index not enabled");
+    if (IsIndexBuilding(INDEX_BUILD_TIMESTAMP))
+        return error("Timestamp index is being built");
 
     if (!pblocktree->ReadTimestampIndex(high, low, hashes))
         return error("Unable to get hashes for timestamps");
@@ -1044,9 +1072,20 @@ bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::v
     return true;
 }
 
+bool GetBlockFilter(const CBlockIndex* pindex, CBlockFilter &filter, uint256 &header)
+{
+    // Filters only depend on the block and its ancestors, so any stored filter is valid
+    return fBlockFilterIndex && pblocktree->ReadBlockFilter(pindex->GetBlockHash(), filter, header);
+}
+
+bool GetBlockFilterHeader(const CBlockIndex* pindex, uint256 &header, uint256 &filterHash)
+{
+    return fBlockFilterIndex && pblocktree->ReadBlockFilterHeader(pindex->GetBlockHash(), header, filterHash);
+}
+
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
 {
-    if (!fSpentIndex)
+    if (!fSpentIndex || IsIndexBuilding(INDEX_BUILD_SPENT))
         return false;
 
     if (mempool.getSpentIndex(key, value))
@@ -1063,6 +1102,8 @@ bool GetAddressIndex(uint160 addressHash, int type,
 {
     if (!fAddressIndex)
         return error("address index not enabled");
+    if (IsIndexBuilding(INDEX_BUILD_ADDRESS))
+        return error("address index is being built");
 
     if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end))
         return error("unable to get txids for address");
@@ -1070,11 +1111,26 @@ bool GetAddressIndex(uint160 addressHash, int type,
     return true;
 }
 
+bool GetAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+    if (IsIndexBuilding(INDEX_BUILD_ADDRESS))
+        return error("address index is being built");
+
+    if (!pblocktree->ReadAddressBalance(addressHash, type, value))
+        return error("unable to get balance for address");
+
+    return true;
+}
+
 bool GetAddressUnspent(uint160 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
+    if (IsIndexBuilding(INDEX_BUILD_ADDRESS))
+        return error("address index is being built");
 
     if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
         return error("unable to get txids for address");
@@ -1082,6 +1138,36 @@ bool GetAddressUnspent(uint160 addressHash, int type,
     return true;
 }
 
+bool GetAddressIndexPage(const std::vector<std::pair<uint160, int> > &addresses, const CAddressIndexKey *pAfter,
+                         int start, int end, size_t nLimit, bool fWholeTx,
+                         std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, bool &fMore)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+    if (IsIndexBuilding(INDEX_BUILD_ADDRESS))
+        return error("address index is being built");
+
+    if (!pblocktree->ReadAddressIndexPage(addresses, pAfter, start, end, nLimit, fWholeTx, addressIndex, fMore))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
+bool GetAddressUnspentPage(const std::vector<std::pair<uint160, int> > &addresses, const CAddressUnspentKey *pAfter,
+                           size_t nLimit, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                           bool &fMore)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+    if (IsIndexBuilding(INDEX_BUILD_ADDRESS))
+        return error("address index is being built");
+
+    if (!pblocktree->ReadAddressUnspentPage(addresses, pAfter, nLimit, unspentOutputs, fMore))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
 /** Return transaction in tx, and if it was found inside a block, its hash is placed in hashBlock */
 bool GetTransaction(const uint256 &hash, CTransaction &txOut, const Consensus::Params& consensusParams, uint256 &hashBlock, bool fAllowSlow)
 {
@@ -1097,16 +1183,29 @@ bool GetTransaction(const uint256 &hash, CTransaction &txOut, const Consensus::P
     if (fTxIndex) {
         CDiskTxPos postx;
         if (pblocktree->ReadTxIndex(hash, postx)) {
-            CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-            if (file.IsNull())
-                return error("%s: OpenBlockFile failed", __func__);
             CBlockHeader header;
-            try {
-                file >> header;
-                fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                file >> txOut;
-            } catch (const std::exception& e) {
-                return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+            CBlockSpan span;
+            // Fall back to the file if the block file cannot be mapped
+            if (pblockreader && pblockreader->ReadBlock(postx, span)) {
+                CMemoryReader reader(span.begin(), span.end(), SER_DISK, CLIENT_VERSION);
+                try {
+                    reader >> header;
+                    reader.ignore(postx.nTxOffset);
+                    reader >> txOut;
+                } catch (const std::exception& e) {
+                    return error("%s: Deserialize error - %s", __func__, e.what());
+                }
+            } else {
+                CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+                if (file.IsNull())
+                    return error("%s: OpenBlockFile failed", __func__);
+                try {
+                    file >> header;
+                    fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+                    file >> txOut;
+                } catch (const std::exception& e) {
+                    return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+                }
             }
             hashBlock = header.GetHash();
             if (txOut.GetHash() != hash)
@@ -1170,10 +1269,23 @@ bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHea
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+/** Deserialize the block at pos without any check of its contents */
+static bool ReadBlockFromDiskUnchecked(CBlock& block, const CDiskBlockPos& pos)
 {
     block.SetNull();
 
+    // Fall back to the file if the block file cannot be mapped
+    CBlockSpan span;
+    if (pblockreader && pblockreader->ReadBlock(pos, span)) {
+        try {
+            CMemoryReader(span.begin(), span.end(), SER_DISK, CLIENT_VERSION) >> block;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize error - %s at %s", __func__, e.what(), pos.ToString());
+        }
+        return true;
+    }
+
     // Open history file to read
     CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull())
@@ -1187,6 +1299,14 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus:
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
     }
 
+    return true;
+}
+
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+{
+    if (!ReadBlockFromDiskUnchecked(block, pos))
+        return false;
+
     // Check the header
     if (!CheckProofOfWork(block.GetHash(), block.nBits, consensusParams))
         return error("ReadBlockFromDisk: Errors in block header at %s", pos.ToString());
@@ -1194,12 +1314,54 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus:
     return true;
 }
 
+/** Whether a header read from disk has the same fields, and so the same hash, as the index entry */
+static bool HeaderMatchesIndex(const CBlockHeader& block, const CBlockIndex* pindex)
+{
+    const CBlockHeader header = pindex->GetBlockHeader();
+    return block.nVersion == header.nVersion && block.hashPrevBlock == header.hashPrevBlock &&
+        block.hashMerkleRoot == header.hashMerkleRoot && block.nTime == header.nTime &&
+        block.nBits == header.nBits && block.nNonce == header.nNonce;
+}
+
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
 {
-    if (!ReadBlockFromDisk(block, pindex->GetBlockPos(), consensusParams))
+    if (fCheckBlockReadPoW || !pindex->IsValid(BLOCK_VALID_TREE)) {
+        if (!ReadBlockFromDisk(block, pindex->GetBlockPos(), consensusParams))
+            return false;
+        if (block.GetHash() != pindex->GetBlockHash())
+            return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
+                    pindex->ToString(), pindex->GetBlockPos().ToString());
+        return true;
+    }
+
+    // The header of this block, including its proof of work, was already checked
+    // when it was added to the index. Rather than recomputing the Lyra2Z hash, make
+    // sure the header on disk is the one in the index: if all of its fields match,
+    // so does the hash.
+    if (!ReadBlockFromDiskUnchecked(block, pindex->GetBlockPos()))
         return false;
-    if (block.GetHash() != pindex->GetBlockHash())
-        return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
+    if (!HeaderMatchesIndex(block, pindex))
+        return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): block header doesn't match index for %s at %s",
+                pindex->ToString(), pindex->GetBlockPos().ToString());
+    return true;
+}
+
+bool ReadRawBlockFromDisk(CBlockSpan& span, const CBlockIndex* pindex)
+{
+    // The reader logs why it failed; callers read the block from the file instead
+    if (!pblockreader || !pblockreader->ReadBlock(pindex->GetBlockPos(), span))
+        return false;
+
+    // The block is passed on without being parsed, so only its header is checked
+    CBlockHeader header;
+    try {
+        CMemoryReader(span.begin(), span.end(), SER_DISK, CLIENT_VERSION) >> header;
+    }
+    catch (const std::exception& e) {
+        return error("%s: Deserialize error - %s at %s", __func__, e.what(), pindex->GetBlockPos().ToString());
+    }
+    if (!HeaderMatchesIndex(header, pindex))
+        return error("%s: block header doesn't match index for %s at %s", __func__,
                 pindex->ToString(), pindex->GetBlockPos().ToString());
     return true;
 }
@@ -1431,7 +1593,7 @@ void UpdateCoins(const CTransaction& tx, CValidationState &state, CCoinsViewCach
 
 bool CScriptCheck::operator()() {
     const CScript &scriptSig = ptxTo->vin[nIn].scriptSig;
-    if (!VerifyScript(scriptSig, scriptPubKey, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, cacheStore), &error)) {
+    if (!VerifyScript(scriptSig, scriptPubKey, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, cacheStore, txdata), &error)) {
         return false;
     }
     return true;
@@ -1490,7 +1652,28 @@ bool CheckTxInputs(const CTransaction& tx, CValidationState& state, const CCoins
 }
 }// namespace Consensus
 
-bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheStore, std::vector<CScriptCheck> *pvChecks)
+namespace {
+
+/**
+ * Transactions whose scripts were all executed successfully with a given set
+ * of flags, so that connecting a block does not have to run them again.
+ * Entries are SHA256(nonce || txid || flags). Only accessed under cs_main.
+ */
+CuckooCache::cache<uint256, SignatureCacheHasher> scriptExecutionCache;
+uint256 scriptExecutionCacheNonce(GetRandHash());
+
+}
+
+void InitScriptExecutionCache()
+{
+    // -maxsigcachesize is shared equally with the signature cache
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) / 2), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    size_t nElems = scriptExecutionCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu requested for script execution cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+}
+
+bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, const PrecomputedTransactionData* txdata, std::vector<CScriptCheck> *pvChecks)
 {
     if (!tx.IsCoinBase())
     {
@@ -1510,6 +1693,20 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
         // Of course, if an assumed valid block is invalid due to false scriptSigs
         // this optimization would allow an invalid chain to be accepted.
         if (fScriptChecks) {
+            // First check if the scripts were already executed with the same
+            // flags. This relies on the inputs being correct, i.e. on the
+            // txid committing to the prevouts and so to the scriptPubKeys in
+            // the view. Using 19 bytes of nonce keeps the entry hash to a
+            // single SHA256 block (19 + 32 + 4 = 55 bytes, + 1 + 8 padding = 64).
+            uint256 hashCacheEntry;
+            static_assert(55 - 32 - sizeof(flags) >= 128/8, "Want at least 128 bits of nonce for script execution cache");
+            CSHA256().Write(scriptExecutionCacheNonce.begin(), 55 - 32 - sizeof(flags)).Write(tx.GetHash().begin(), 32).Write((unsigned char*)&flags, sizeof(flags)).Finalize(hashCacheEntry.begin());
+            AssertLockHeld(cs_main);
+            // A block's transactions are not seen again, so let their entries be evicted
+            if (scriptExecutionCache.contains(hashCacheEntry, !cacheFullScriptStore)) {
+                return true;
+            }
+
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
                 const COutPoint &prevout = tx.vin[i].prevout;
                 const Coin& coin = inputs.AccessCoin(prevout);
@@ -1524,7 +1721,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                 const CAmount amount = coin.out.nValue;
 
                 // Verify signature
-                CScriptCheck check(scriptPubKey, amount, tx, i, flags, cacheStore);
+                CScriptCheck check(scriptPubKey, amount, tx, i, flags, cacheSigStore, txdata);
                 if (pvChecks) {
                     pvChecks->push_back(CScriptCheck());
                     check.swap(pvChecks->back());
@@ -1537,7 +1734,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                         // avoid splitting the network between upgraded and
                         // non-upgraded nodes.
                         CScriptCheck check2(scriptPubKey, amount, tx, i,
-                                flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheStore);
+                                flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheSigStore, txdata);
                         if (check2())
                             return state.Invalid(false, REJECT_NONSTANDARD, strprintf("non-mandatory-script-verify-flag (%s)", ScriptErrorString(check.GetScriptError())));
                     }
@@ -1551,6 +1748,12 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                     return state.DoS(100,false, REJECT_INVALID, strprintf("mandatory-script-verify-flag-failed (%s)", ScriptErrorString(check.GetScriptError())));
                 }
             }
+
+            if (cacheFullScriptStore && !pvChecks) {
+                // All scripts were executed (not deferred to a check queue)
+                // and passed, so the result may be cached.
+                scriptExecutionCache.insert(hashCacheEntry);
+            }
         }
     }
 
@@ -1669,14 +1872,106 @@ int ApplyTxInUndo(Coin&& undo, CCoinsViewCache& view, const COutPoint& out)
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
 
+/** The address type (1 for P2PKH, 2 for P2SH) and hash an output is indexed under, 0 if it is not */
+static int GetIndexAddress(const CScript& scriptPubKey, uint160& hashBytes)
+{
+    if (scriptPubKey.IsPayToScriptHash()) {
+        hashBytes = uint160(vector<unsigned char>(scriptPubKey.begin()+2, scriptPubKey.begin()+22));
+        return 2;
+    } else if (scriptPubKey.IsPayToPublicKeyHash()) {
+        hashBytes = uint160(vector<unsigned char>(scriptPubKey.begin()+3, scriptPubKey.begin()+23));
+        return 1;
+    }
+    hashBytes.SetNull();
+    return 0;
+}
+
+/**
+ * Collect the address and spent index entries of a block. The outputs it
+ * spends are taken from its undo data, so that the background index builder
+ * can use this as well as ConnectBlock.
+ */
+static void GetBlockIndexEntries(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex,
+                                 bool fAddress, bool fSpent,
+                                 std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &addressUnspentIndex,
+                                 std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > &spentIndex)
+{
+    for (unsigned int i = 0; i < block.vtx.size(); i++) {
+        const CTransaction &tx = block.vtx[i];
+        const uint256 txhash = tx.GetHash();
+
+        if (i > 0) {
+            const CTxUndo &txundo = blockundo.vtxundo[i - 1];
+            for (size_t j = 0; j < tx.vin.size(); j++) {
+                const CTxIn &input = tx.vin[j];
+                const CTxOut &prevout = txundo.vprevout[j].out;
+                uint160 hashBytes;
+                int addressType = GetIndexAddress(prevout.scriptPubKey, hashBytes);
+
+                if (fAddress && addressType > 0) {
+                    // record spending activity
+                    addressIndex.push_back(make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, j, true), prevout.nValue * -1));
+
+                    // remove address from unspent index
+                    addressUnspentIndex.push_back(make_pair(CAddressUnspentKey(addressType, hashBytes, input.prevout.hash, input.prevout.n), CAddressUnspentValue()));
+                }
+
+                if (fSpent) {
+                    // add the spent index to determine the txid and input that spent an output
+                    // and to find the amount and address from an input
+                    spentIndex.push_back(make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue(txhash, j, pindex->nHeight, prevout.nValue, addressType, hashBytes)));
+                }
+            }
+        }
+
+        if (fAddress) {
+            for (unsigned int k = 0; k < tx.vout.size(); k++) {
+                const CTxOut &out = tx.vout[k];
+                uint160 hashBytes;
+                int addressType = GetIndexAddress(out.scriptPubKey, hashBytes);
+                if (addressType == 0)
+                    continue;
+
+                // record receiving activity
+                addressIndex.push_back(make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, k, false), out.nValue));
+
+                // record unspent output
+                addressUnspentIndex.push_back(make_pair(CAddressUnspentKey(addressType, hashBytes, txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
+            }
+        }
+    }
+}
+
+/** Store the filter of a block, chained to the filter header of its parent */
+static bool WriteBlockFilterIndex(const CBlockFilter& filter, const CBlockIndex* pindex)
+{
+    uint256 prevHeader, prevFilterHash;
+    if (pindex->pprev && !pblocktree->ReadBlockFilterHeader(pindex->pprev->GetBlockHash(), prevHeader, prevFilterHash))
+        return error("%s: block filter index is missing the parent of block %s", __func__, pindex->GetBlockHash().ToString());
+    return pblocktree->WriteBlockFilter(filter, filter.ComputeHeader(prevHeader));
+}
+
+/** Whether the index entries of a block on the active chain were written by the background builder */
+static bool IndexBuildCovers(const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+    return pindexIndexBuilt && pindexIndexBuilt->GetAncestor(pindex->nHeight) == pindex;
+}
+
 /** Undo the effects of this block (with given index) on the UTXO set represented by coins.
- *  When UNCLEAN or FAILED is returned, view is left in an indeterminate state. */
-static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockIndex* pindex, CCoinsViewCache& view)
+ *  When UNCLEAN or FAILED is returned, view is left in an indeterminate state.
+ *  With fJustCheck (as in VerifyDB), the block stays connected, so the indexes
+ *  and a background build of them are left alone. */
+static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockIndex* pindex, CCoinsViewCache& view, bool fJustCheck = false)
 {
     assert(pindex->GetBlockHash() == view.GetBestBlock());
 
     bool fClean = true;
 
+    // Blocks a background build of the address index has not reached yet have no entries to erase
+    bool fEraseAddressIndex = !fJustCheck && fAddressIndex && (!IsIndexBuilding(INDEX_BUILD_ADDRESS) || IndexBuildCovers(pindex));
+
     CBlockUndo blockUndo;
     CDiskBlockPos pos = pindex->GetUndoPos();
     if (pos.IsNull()) {
@@ -1703,7 +1998,7 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
         uint256 hash = tx.GetHash();
         bool is_coinbase = tx.IsCoinBase();
 
-        if (fAddressIndex) {
+        if (fEraseAddressIndex) {
 
             for (unsigned int k = tx.vout.size(); k-- > 0;) {
                 const CTxOut &out = tx.vout[k];
@@ -1768,7 +2063,7 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
                     spentIndex.push_back(make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue()));
                 }
 
-                if (fAddressIndex) {
+                if (fEraseAddressIndex) {
                     const Coin &coin = view.AccessCoin(tx.vin[j].prevout);
                     const CTxOut &prevout = coin.out;
                     if (prevout.scriptPubKey.IsPayToScriptHash()) {
@@ -1804,7 +2099,16 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 
-    if (fAddressIndex) {
+    // Step a background build back first, so that a crash cannot leave it past erased entries
+    if (!fJustCheck && IsIndexBuilding(~0) && IndexBuildCovers(pindex)) {
+        pindexIndexBuilt = pindex->pprev;
+        if (!pblocktree->WriteIndexBuildState(nIndexesBuilding, pindexIndexBuilt->GetBlockHash())) {
+            AbortNode(state, "Failed to write index build state");
+            return DISCONNECT_FAILED;
+        }
+    }
+
+    if (fEraseAddressIndex) {
         if (!pblocktree->EraseAddressIndex(addressIndex)) {
             AbortNode(state, "Failed to delete address index");
             return DISCONNECT_FAILED;
@@ -1826,8 +2130,12 @@ void static FlushBlockFile(bool fFinalize = false)
 
     FILE *fileOld = OpenBlockFile(posOld);
     if (fileOld) {
-        if (fFinalize)
+        if (fFinalize) {
+            // Parts of a mapping past the end of the file must not be touched
+            if (pblockreader)
+                pblockreader->CloseFile(nLastBlockFile);
             TruncateFile(fileOld, vinfoBlockFile[nLastBlockFile].nSize);
+        }
         FileCommit(fileOld);
         fclose(fileOld);
     }
@@ -1850,6 +2158,36 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+static CCheckQueue<CHeaderHashCheck> headerhashqueue(16);
+static CCriticalSection cs_headerhashqueue;
+
+void ThreadHeaderHashCheck() {
+    RenameThread("mano-hdrhash");
+    headerhashqueue.Thread();
+}
+
+bool CHeaderHashCheck::operator()() {
+    pheader->GetHash();
+    return true;
+}
+
+void PrecomputeHeaderHashes(const std::vector<CBlockHeader>& headers)
+{
+    // Without worker threads the hashes are simply computed on demand.
+    if (!nScriptCheckThreads || headers.size() < 2)
+        return;
+
+    std::vector<CHeaderHashCheck> vChecks;
+    vChecks.reserve(headers.size());
+    BOOST_FOREACH(const CBlockHeader& header, headers)
+        vChecks.push_back(CHeaderHashCheck(header));
+
+    LOCK(cs_headerhashqueue);
+    CCheckQueueControl<CHeaderHashCheck> control(&headerhashqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -1931,6 +2269,37 @@ static int64_t nTimeIndex = 0;
 static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 
+/** Script verification flags in effect for the block at pindex (whose nVersion and time must be set). */
+static unsigned int GetBlockScriptFlags(const CBlockIndex* pindex, const Consensus::Params& consensusparams)
+{
+    AssertLockHeld(cs_main);
+
+    // BIP16 didn't become active until Apr 1 2012
+    int64_t nBIP16SwitchTime = 1333238400;
+    bool fStrictPayToScriptHash = (pindex->GetBlockTime() >= nBIP16SwitchTime);
+
+    unsigned int flags = fStrictPayToScriptHash ? SCRIPT_VERIFY_P2SH : SCRIPT_VERIFY_NONE;
+
+    // Start enforcing the DERSIG (BIP66) rules, for block.nVersion=3 blocks,
+    // when 75% of the network has upgraded:
+    if (pindex->nVersion >= 3 && IsSuperMajority(3, pindex->pprev, consensusparams.nMajorityEnforceBlockUpgrade, consensusparams)) {
+        flags |= SCRIPT_VERIFY_DERSIG;
+    }
+
+    // Start enforcing CHECKLOCKTIMEVERIFY, (BIP65) for block.nVersion=4
+    // blocks, when 75% of the network has upgraded:
+    if (pindex->nVersion >= 4 && IsSuperMajority(4, pindex->pprev, consensusparams.nMajorityEnforceBlockUpgrade, consensusparams)) {
+        flags |= SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
+    }
+
+    // Start enforcing BIP112 (CHECKSEQUENCEVERIFY) using versionbits logic.
+    if (VersionBitsState(pindex->pprev, consensusparams, Consensus::DEPLOYMENT_CSV, versionbitscache) == THRESHOLD_ACTIVE) {
+        flags |= SCRIPT_VERIFY_CHECKSEQUENCEVERIFY;
+    }
+
+    return flags;
+}
+
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins.
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
  *  can fail if those validity checks fail (among other reasons). */
@@ -1952,8 +2321,14 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     // Special case for the genesis block, skipping connection of its transactions
     // (its coinbase is unspendable)
     if (block.GetHash() == chainparams.GetConsensus().hashGenesisBlock) {
-        if (!fJustCheck)
+        if (!fJustCheck) {
+            if (fCoinStatsIndex && !pblocktree->WriteCoinStatsIndex(pindex->GetBlockHash(), CUTXOCommitment()))
+                return AbortNode(state, "Failed to write coin stats index");
+            if (fBlockFilterIndex && !IsIndexBuilding(INDEX_BUILD_BLOCKFILTER) &&
+                !WriteBlockFilterIndex(CBlockFilter(BLOCK_FILTER_BASIC, block, CBlockUndo()), pindex))
+                return AbortNode(state, "Failed to write block filter index");
             view.SetBestBlock(pindex->GetBlockHash());
+        }
         return true;
     }
 
@@ -2023,28 +2398,12 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         }
     }
 
-    // BIP16 didn't become active until Apr 1 2012
-    int64_t nBIP16SwitchTime = 1333238400;
-    bool fStrictPayToScriptHash = (pindex->GetBlockTime() >= nBIP16SwitchTime);
-
-    unsigned int flags = fStrictPayToScriptHash ? SCRIPT_VERIFY_P2SH : SCRIPT_VERIFY_NONE;
+    unsigned int flags = GetBlockScriptFlags(pindex, chainparams.GetConsensus());
+    bool fStrictPayToScriptHash = (flags & SCRIPT_VERIFY_P2SH) != 0;
 
-    // Start enforcing the DERSIG (BIP66) rules, for block.nVersion=3 blocks,
-    // when 75% of the network has upgraded:
-    if (block.nVersion >= 3 && IsSuperMajority(3, pindex->pprev, chainparams.GetConsensus().nMajorityEnforceBlockUpgrade, chainparams.GetConsensus())) {
-        flags |= SCRIPT_VERIFY_DERSIG;
-    }
-
-    // Start enforcing CHECKLOCKTIMEVERIFY, (BIP65) for block.nVersion=4
-    // blocks, when 75% of the network has upgraded:
-    if (block.nVersion >= 4 && IsSuperMajority(4, pindex->pprev, chainparams.GetConsensus().nMajorityEnforceBlockUpgrade, chainparams.GetConsensus())) {
-        flags |= SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
-    }
-
-    // Start enforcing BIP68 (sequence locks) and BIP112 (CHECKSEQUENCEVERIFY) using versionbits logic.
+    // Start enforcing BIP68 (sequence locks) using versionbits logic, together with BIP112.
     int nLockTimeFlags = 0;
-    if (VersionBitsState(pindex->pprev, chainparams.GetConsensus(), Consensus::DEPLOYMENT_CSV, versionbitscache) == THRESHOLD_ACTIVE) {
-        flags |= SCRIPT_VERIFY_CHECKSEQUENCEVERIFY;
+    if (flags & SCRIPT_VERIFY_CHECKSEQUENCEVERIFY) {
         nLockTimeFlags |= LOCKTIME_VERIFY_SEQUENCE;
     }
 
@@ -2053,6 +2412,11 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
 
     CBlockUndo blockundo;
 
+    // Per-transaction signature hash data, shared by all its script checks.
+    // Declared before control so that it outlives the queued checks.
+    std::vector<PrecomputedTransactionData> txdata;
+    txdata.reserve(block.vtx.size());
+
     CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : NULL);
 
     std::vector<int> prevheights;
@@ -2063,16 +2427,12 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     std::vector<std::pair<uint256, CDiskTxPos> > vPos;
     vPos.reserve(block.vtx.size());
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
-    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
 
     bool fDIP0001Active_context = (VersionBitsState(pindex->pprev, chainparams.GetConsensus(), Consensus::DEPLOYMENT_DIP0001, versionbitscache) == THRESHOLD_ACTIVE);
 
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
         const CTransaction &tx = block.vtx[i];
-        const uint256 txhash = tx.GetHash();
 
         nInputs += tx.vin.size();
         nSigOps += GetLegacySigOpCount(tx);
@@ -2099,43 +2459,6 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
                                  REJECT_INVALID, "bad-txns-nonfinal");
             }
 
-            if (fAddressIndex || fSpentIndex)
-            {
-                for (size_t j = 0; j < tx.vin.size(); j++) {
-                    const CTxIn input = tx.vin[j];
-                    const Coin& coin = view.AccessCoin(tx.vin[j].prevout);
-                    const CTxOut &prevout = coin.out;
-                    uint160 hashBytes;
-                    int addressType;
-
-                    if (prevout.scriptPubKey.IsPayToScriptHash()) {
-                        hashBytes = uint160(vector <unsigned char>(prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22));
-                        addressType = 2;
-                    } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
-                        hashBytes = uint160(vector <unsigned char>(prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23));
-                        addressType = 1;
-                    } else {
-                        hashBytes.SetNull();
-                        addressType = 0;
-                    }
-
-                    if (fAddressIndex && addressType > 0) {
-                        // record spending activity
-                        addressIndex.push_back(make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, j, true), prevout.nValue * -1));
-
-                        // remove address from unspent index
-                        addressUnspentIndex.push_back(make_pair(CAddressUnspentKey(addressType, hashBytes, input.prevout.hash, input.prevout.n), CAddressUnspentValue()));
-                    }
-
-                    if (fSpentIndex) {
-                        // add the spent index to determine the txid and input that spent an output
-                        // and to find the amount and address from an input
-                        spentIndex.push_back(make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue(txhash, j, pindex->nHeight, prevout.nValue, addressType, hashBytes)));
-                    }
-                }
-
-            }
-
             if (fStrictPayToScriptHash)
             {
                 // Add in sigops done by pay-to-script-hash inputs;
@@ -2151,41 +2474,19 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
 
             std::vector<CScriptCheck> vChecks;
             bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
-            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, nScriptCheckThreads ? &vChecks : NULL))
+            // Queued checks point into txdata until control.Wait(); it was
+            // reserved for every transaction so it never reallocates
+            const PrecomputedTransactionData* ptxdata = NULL;
+            if (fScriptChecks) {
+                txdata.emplace_back(tx);
+                ptxdata = &txdata.back();
+            }
+            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, ptxdata, nScriptCheckThreads ? &vChecks : NULL))
                 return error("ConnectBlock(): CheckInputs on %s failed with %s",
                     tx.GetHash().ToString(), FormatStateMessage(state));
             control.Add(vChecks);
         }
 
-        if (fAddressIndex) {
-            for (unsigned int k = 0; k < tx.vout.size(); k++) {
-                const CTxOut &out = tx.vout[k];
-
-                if (out.scriptPubKey.IsPayToScriptHash()) {
-                    vector<unsigned char> hashBytes(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22);
-
-                    // record receiving activity
-                    addressIndex.push_back(make_pair(CAddressIndexKey(2, uint160(hashBytes), pindex->nHeight, i, txhash, k, false), out.nValue));
-
-                    // record unspent output
-                    addressUnspentIndex.push_back(make_pair(CAddressUnspentKey(2, uint160(hashBytes), txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
-
-                } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
-                    vector<unsigned char> hashBytes(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23);
-
-                    // record receiving activity
-                    addressIndex.push_back(make_pair(CAddressIndexKey(1, uint160(hashBytes), pindex->nHeight, i, txhash, k, false), out.nValue));
-
-                    // record unspent output
-                    addressUnspentIndex.push_back(make_pair(CAddressUnspentKey(1, uint160(hashBytes), txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
-
-                } else {
-                    continue;
-                }
-
-            }
-        }
-
         CTxUndo undoDummy;
         if (i > 0) {
             blockundo.vtxundo.push_back(CTxUndo());
@@ -2250,7 +2551,15 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         if (!pblocktree->WriteTxIndex(vPos))
             return AbortNode(state, "Failed to write transaction index");
 
-    if (fAddressIndex) {
+    // Indexes still being built in the background get this block from the builder
+    bool fWriteAddressIndex = fAddressIndex && !IsIndexBuilding(INDEX_BUILD_ADDRESS);
+    bool fWriteSpentIndex = fSpentIndex && !IsIndexBuilding(INDEX_BUILD_SPENT);
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
+    GetBlockIndexEntries(block, blockundo, pindex, fWriteAddressIndex, fWriteSpentIndex, addressIndex, addressUnspentIndex, spentIndex);
+
+    if (fWriteAddressIndex) {
         if (!pblocktree->WriteAddressIndex(addressIndex)) {
             return AbortNode(state, "Failed to write address index");
         }
@@ -2260,14 +2569,41 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         }
     }
 
-    if (fSpentIndex)
+    if (fWriteSpentIndex)
         if (!pblocktree->UpdateSpentIndex(spentIndex))
             return AbortNode(state, "Failed to write transaction index");
 
-    if (fTimestampIndex)
+    if (fTimestampIndex && !IsIndexBuilding(INDEX_BUILD_TIMESTAMP))
         if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())))
             return AbortNode(state, "Failed to write timestamp index");
 
+    // Filters are kept by block hash as well, so DisconnectBlock leaves them alone
+    if (fBlockFilterIndex && !IsIndexBuilding(INDEX_BUILD_BLOCKFILTER))
+        if (!WriteBlockFilterIndex(CBlockFilter(BLOCK_FILTER_BASIC, block, blockundo), pindex))
+            return AbortNode(state, "Failed to write block filter index");
+
+    // Carry the UTXO set commitment of the previous block forward. Records are
+    // keyed by block hash, so DisconnectBlock leaves them alone.
+    if (fCoinStatsIndex) {
+        CUTXOCommitment commitment;
+        if (!pblocktree->ReadCoinStatsIndex(hashPrevBlock, commitment))
+            return AbortNode(state, "Coin stats index is missing the previous block, restart with -reindex-chainstate");
+        for (unsigned int i = 0; i < block.vtx.size(); i++) {
+            const CTransaction &tx = block.vtx[i];
+            if (i > 0) {
+                const CTxUndo &txundo = blockundo.vtxundo[i - 1];
+                for (unsigned int j = 0; j < tx.vin.size(); j++)
+                    commitment.RemoveCoin(tx.vin[j].prevout, txundo.vprevout[j]);
+            }
+            for (unsigned int k = 0; k < tx.vout.size(); k++) {
+                if (!tx.vout[k].scriptPubKey.IsUnspendable())
+                    commitment.AddCoin(COutPoint(tx.GetHash(), k), Coin(tx.vout[k], pindex->nHeight, i == 0));
+            }
+        }
+        if (!pblocktree->WriteCoinStatsIndex(pindex->GetBlockHash(), commitment))
+            return AbortNode(state, "Failed to write coin stats index");
+    }
+
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
@@ -2285,6 +2621,9 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     return true;
 }
 
+static CCriticalSection cs_flushstats;
+static CChainstateFlushStats flushStats = {};
+
 /**
  * Update the on-disk chain state.
  * The caches and indexes are flushed depending on the mode we're called with
@@ -2325,6 +2664,9 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
     }
     int64_t nMempoolSizeMax = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     int64_t cacheSize = pcoinsTip->DynamicMemoryUsage() * DB_PEAK_USAGE_FACTOR;
+    // The batch a background write still holds counts against the limit too
+    if (pcoinswriter)
+        cacheSize += pcoinswriter->DynamicMemoryUsage();
     int64_t nTotalSpace = nCoinCacheUsage + std::max<int64_t>(nMempoolSizeMax - nMempoolUsage, 0);
     // The cache is large and we're within 10% and 10 MiB of the limit, but we have time now (not in the middle of a block processing).
     bool fCacheLarge = mode == FLUSH_STATE_PERIODIC && cacheSize > std::max((9 * nTotalSpace) / 10, nTotalSpace - MAX_BLOCK_COINSDB_USAGE * 1024 * 1024);
@@ -2361,9 +2703,13 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
                 return AbortNode(state, "Files to write to block index database");
             }
         }
-        // Finally remove any pruned files
-        if (fFlushForPrune)
+        // Finally remove any pruned files, once no chainstate that may still
+        // need them for a replay is being written
+        if (fFlushForPrune) {
+            if (pcoinswriter && !pcoinswriter->WaitForWrite())
+                return AbortNode(state, "Failed to write to coin database");
             UnlinkPrunedFiles(setFilesToPrune);
+        }
         nLastWrite = nNow;
     }
     // Flush best chain related state. This can only be done if the blocks / block index write was also done.
@@ -2376,8 +2722,32 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
         if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
             return state.Error("out of disk space");
         // Flush the chainstate (which may refer to block index entries).
-        if (!pcoinsTip->Flush())
-            return AbortNode(state, "Failed to write to coin database");
+        // Unless we are shutting down or pruning, write it in the background
+        // and keep what fits of the cache, so the next blocks still find
+        // their inputs in memory.
+        int64_t nFlushStart = GetTimeMicros();
+        bool fBackground = pcoinswriter && mode != FLUSH_STATE_ALWAYS && !fFlushForPrune && GetBoolArg("-backgroundflush", DEFAULT_BACKGROUND_FLUSH);
+        if (fBackground) {
+            // Keep half of the cache limit at most when flushing because it is full
+            size_t nKeepUsage = (fCacheLarge || fCacheCritical) ? nCoinCacheUsage / (2 * DB_PEAK_USAGE_FACTOR) : std::numeric_limits<size_t>::max();
+            if (!pcoinswriter->WriteAsync(*pcoinsTip, nKeepUsage))
+                return AbortNode(state, "Failed to write to coin database");
+        } else {
+            if (!pcoinsTip->Flush())
+                return AbortNode(state, "Failed to write to coin database");
+        }
+        int64_t nStall = GetTimeMicros() - nFlushStart;
+        int64_t nTotalStall;
+        {
+            LOCK(cs_flushstats);
+            flushStats.nFlushes++;
+            flushStats.nLastStall = nStall;
+            flushStats.nTotalStall += nStall;
+            flushStats.fBackground = fBackground;
+            nTotalStall = flushStats.nTotalStall;
+        }
+        LogPrint("bench", "  - Chainstate flush: %.2fms stall (%s), %.2fms total stall [%u coins cached]\n", nStall * 0.001,
+            fBackground ? "background" : "foreground", nTotalStall * 0.001, (unsigned int)pcoinsTip->GetCacheSize());
         nLastFlush = nNow;
     }
     if (fDoFullFlush || ((mode == FLUSH_STATE_ALWAYS || mode == FLUSH_STATE_PERIODIC) && nNow > nLastSetChain + (int64_t)DATABASE_WRITE_INTERVAL * 1000000)) {
@@ -2396,6 +2766,20 @@ void FlushStateToDisk() {
     FlushStateToDisk(state, FLUSH_STATE_ALWAYS);
 }
 
+CChainstateFlushStats GetChainstateFlushStats() {
+    CChainstateFlushStats stats;
+    {
+        LOCK(cs_flushstats);
+        stats = flushStats;
+    }
+    stats.fInProgress = pcoinswriter && pcoinswriter->IsWriting();
+    if (stats.fBackground && pcoinswriter)
+        stats.nLastDuration = pcoinswriter->GetLastWriteTime();
+    else
+        stats.nLastDuration = stats.nLastStall;
+    return stats;
+}
+
 void PruneAndFlush() {
     CValidationState state;
     fCheckForPruning = true;
@@ -2723,6 +3107,14 @@ static bool ActivateBestChainStep(CValidationState& state, const CChainParams& c
         }
         nHeight = nTargetHeight;
 
+        // Start loading the inputs of the blocks ahead while connecting the first ones.
+        if (pcoinsprefetch && IsInitialBlockDownload()) {
+            BOOST_REVERSE_FOREACH(CBlockIndex *pindexPrefetch, vpindexToConnect) {
+                if (pindexPrefetch->nStatus & BLOCK_HAVE_DATA)
+                    pcoinsprefetch->PrefetchBlock(pindexPrefetch->GetBlockPos());
+            }
+        }
+
         // Connect new blocks.
         BOOST_REVERSE_FOREACH(CBlockIndex *pindexConnect, vpindexToConnect) {
             if (!ConnectTip(state, chainparams, pindexConnect, pindexConnect == pindexMostWork ? pblock : NULL)) {
@@ -2953,6 +3345,55 @@ CBlockIndex* AddToBlockIndex(const CBlockHeader& block)
     return pindexNew;
 }
 
+/**
+ * Whether pindex is the base of a loaded UTXO snapshot: the only blocks that
+ * are valid up to BLOCK_VALID_SCRIPTS without their transactions having been
+ * received.
+ */
+static bool IsSnapshotBase(const CBlockIndex* pindex)
+{
+    return pindex->nTx == 0 && pindex->IsValid(BLOCK_VALID_SCRIPTS);
+}
+
+CBlockIndex* GetSnapshotBase()
+{
+    AssertLockHeld(cs_main);
+    BOOST_FOREACH(const MapAssumeutxo::value_type& snapshot, Params().Assumeutxo()) {
+        BlockMap::iterator it = mapBlockIndex.find(snapshot.first);
+        if (it != mapBlockIndex.end() && IsSnapshotBase(it->second))
+            return it->second;
+    }
+    return NULL;
+}
+
+/**
+ * Set nChainTx of the blocks in queue, whose parents all have their
+ * transactions, and of their descendants that were waiting for them in
+ * mapBlocksUnlinked, and make them candidates for the tip.
+ */
+static void LinkBlocks(deque<CBlockIndex*>& queue)
+{
+    while (!queue.empty()) {
+        CBlockIndex *pindex = queue.front();
+        queue.pop_front();
+        pindex->nChainTx = (pindex->pprev ? pindex->pprev->nChainTx : 0) + pindex->nTx;
+        {
+            LOCK(cs_nBlockSequenceId);
+            pindex->nSequenceId = nBlockSequenceId++;
+        }
+        if (chainActive.Tip() == NULL || !setBlockIndexCandidates.value_comp()(pindex, chainActive.Tip())) {
+            setBlockIndexCandidates.insert(pindex);
+        }
+        std::pair<std::multimap<CBlockIndex*, CBlockIndex*>::iterator, std::multimap<CBlockIndex*, CBlockIndex*>::iterator> range = mapBlocksUnlinked.equal_range(pindex);
+        while (range.first != range.second) {
+            std::multimap<CBlockIndex*, CBlockIndex*>::iterator it = range.first;
+            queue.push_back(it->second);
+            range.first++;
+            mapBlocksUnlinked.erase(it);
+        }
+    }
+}
+
 /** Mark a block as having its data received and checked (up to BLOCK_VALID_TRANSACTIONS). */
 bool ReceivedBlockTransactions(const CBlock &block, CValidationState& state, CBlockIndex *pindexNew, const CDiskBlockPos& pos)
 {
@@ -2967,29 +3408,10 @@ bool ReceivedBlockTransactions(const CBlock &block, CValidationState& state, CBl
 
     if (pindexNew->pprev == NULL || pindexNew->pprev->nChainTx) {
         // If pindexNew is the genesis block or all parents are BLOCK_VALID_TRANSACTIONS.
+        // Recursively process any descendant blocks that now may be eligible to be connected.
         deque<CBlockIndex*> queue;
         queue.push_back(pindexNew);
-
-        // Recursively process any descendant blocks that now may be eligible to be connected.
-        while (!queue.empty()) {
-            CBlockIndex *pindex = queue.front();
-            queue.pop_front();
-            pindex->nChainTx = (pindex->pprev ? pindex->pprev->nChainTx : 0) + pindex->nTx;
-            {
-                LOCK(cs_nBlockSequenceId);
-                pindex->nSequenceId = nBlockSequenceId++;
-            }
-            if (chainActive.Tip() == NULL || !setBlockIndexCandidates.value_comp()(pindex, chainActive.Tip())) {
-                setBlockIndexCandidates.insert(pindex);
-            }
-            std::pair<std::multimap<CBlockIndex*, CBlockIndex*>::iterator, std::multimap<CBlockIndex*, CBlockIndex*>::iterator> range = mapBlocksUnlinked.equal_range(pindex);
-            while (range.first != range.second) {
-                std::multimap<CBlockIndex*, CBlockIndex*>::iterator it = range.first;
-                queue.push_back(it->second);
-                range.first++;
-                mapBlocksUnlinked.erase(it);
-            }
-        }
+        LinkBlocks(queue);
     } else {
         if (pindexNew->pprev && pindexNew->pprev->IsValid(BLOCK_VALID_TREE)) {
             mapBlocksUnlinked.insert(std::make_pair(pindexNew->pprev, pindexNew));
@@ -3562,6 +3984,8 @@ void UnlinkPrunedFiles(std::set<int>& setFilesToPrune)
 {
     for (set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        if (pblockreader)
+            pblockreader->CloseFile(*it);
         boost::filesystem::remove(GetBlockPosFilename(pos, "blk"));
         boost::filesystem::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -3717,6 +4141,10 @@ bool static LoadBlockIndexDB()
             } else {
                 pindex->nChainTx = pindex->nTx;
             }
+        } else if (IsSnapshotBase(pindex)) {
+            MapAssumeutxo::const_iterator it = chainparams.Assumeutxo().find(pindex->GetBlockHash());
+            if (it != chainparams.Assumeutxo().end())
+                pindex->nChainTx = it->second.nChainTx;
         }
         if (pindex->IsValid(BLOCK_VALID_TRANSACTIONS) && (pindex->nChainTx || pindex->pprev == NULL))
             setBlockIndexCandidates.insert(pindex);
@@ -3781,6 +4209,23 @@ bool static LoadBlockIndexDB()
     pblocktree->ReadFlag("addressindex", fAddressIndex);
     LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
 
+    // Address indexes written in the original format are converted once
+    if (fAddressIndex && !pblocktree->UpgradeAddressIndex())
+        return error("%s: failed to upgrade the address index", __func__);
+
+    // Address indexes written before balance records were kept get them once
+    bool fAddressBalances = false;
+    pblocktree->ReadFlag("addressbalances", fAddressBalances);
+    if (fAddressIndex && !fAddressBalances) {
+        LogPrintf("%s: building address balances from the address index\n", __func__);
+        if (!pblocktree->BuildAddressBalances() || !pblocktree->WriteFlag("addressbalances", true))
+            return error("%s: failed to build address balances", __func__);
+    }
+
+    // Check whether we have a block filter index
+    pblocktree->ReadFlag("blockfilterindex", fBlockFilterIndex);
+    LogPrintf("%s: block filter index %s\n", __func__, fBlockFilterIndex ? "enabled" : "disabled");
+
     // Check whether we have a timestamp index
     pblocktree->ReadFlag("timestampindex", fTimestampIndex);
     LogPrintf("%s: timestamp index %s\n", __func__, fTimestampIndex ? "enabled" : "disabled");
@@ -3789,6 +4234,10 @@ bool static LoadBlockIndexDB()
     pblocktree->ReadFlag("spentindex", fSpentIndex);
     LogPrintf("%s: spent index %s\n", __func__, fSpentIndex ? "enabled" : "disabled");
 
+    // Check whether we have a coin stats index
+    pblocktree->ReadFlag("coinstatsindex", fCoinStatsIndex);
+    LogPrintf("%s: coin stats index %s\n", __func__, fCoinStatsIndex ? "enabled" : "disabled");
+
     // Load pointer to end of best chain
     BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
     if (it == mapBlockIndex.end())
@@ -3839,6 +4288,9 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
         uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100)))));
         if (pindex->nHeight < chainActive.Height()-nCheckDepth)
             break;
+        // Pruned, or below a UTXO snapshot
+        if (!(pindex->nStatus & BLOCK_HAVE_DATA))
+            break;
         CBlock block;
         // check level 0: read from disk
         if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
@@ -3857,7 +4309,7 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
         }
         // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
         if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
-            DisconnectResult res = DisconnectBlock(block, state, pindex, coins);
+            DisconnectResult res = DisconnectBlock(block, state, pindex, coins, true);
             if (res == DISCONNECT_FAILED) {
                 return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
             }
@@ -3922,6 +4374,8 @@ void UnloadBlockIndex()
     }
     mapBlockIndex.clear();
     fHavePruned = false;
+    nIndexesBuilding = 0;
+    pindexIndexBuilt = NULL;
 }
 
 bool LoadBlockIndex()
@@ -3947,6 +4401,7 @@ bool InitBlockIndex(const CChainParams& chainparams)
     // Use the provided setting for -addressindex in the new database
     fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
     pblocktree->WriteFlag("addressindex", fAddressIndex);
+    pblocktree->WriteFlag("addressbalances", true);
 
     // Use the provided setting for -timestampindex in the new database
     fTimestampIndex = GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
@@ -3955,6 +4410,14 @@ bool InitBlockIndex(const CChainParams& chainparams)
     fSpentIndex = GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
     pblocktree->WriteFlag("spentindex", fSpentIndex);
 
+    // Use the provided setting for -coinstatsindex in the new database
+    fCoinStatsIndex = GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX);
+    pblocktree->WriteFlag("coinstatsindex", fCoinStatsIndex);
+
+    // Use the provided setting for -blockfilterindex in the new database
+    fBlockFilterIndex = GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX);
+    pblocktree->WriteFlag("blockfilterindex", fBlockFilterIndex);
+
     LogPrintf("Initializing databases...\n");
 
     // Only add the genesis block if not reindexing (in which case we reuse the one already on disk)
@@ -3984,6 +4447,208 @@ bool InitBlockIndex(const CChainParams& chainparams)
     return true;
 }
 
+bool LoadIndexBuildState(std::string &strError)
+{
+    LOCK(cs_main);
+
+    int nIndexes = 0;
+    uint256 hashBuilt;
+    pblocktree->ReadIndexBuildState(nIndexes, hashBuilt);
+
+    // Only indexes that are still enabled keep building
+    int nEnabled = (fAddressIndex ? INDEX_BUILD_ADDRESS : 0) | (fSpentIndex ? INDEX_BUILD_SPENT : 0) |
+                   (fTimestampIndex ? INDEX_BUILD_TIMESTAMP : 0) | (fBlockFilterIndex ? INDEX_BUILD_BLOCKFILTER : 0);
+    nIndexes &= nEnabled;
+
+    int nNew = 0;
+    if (!fAddressIndex && GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX))
+        nNew |= INDEX_BUILD_ADDRESS;
+    if (!fSpentIndex && GetBoolArg("-spentindex", DEFAULT_SPENTINDEX))
+        nNew |= INDEX_BUILD_SPENT;
+    if (!fTimestampIndex && GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX))
+        nNew |= INDEX_BUILD_TIMESTAMP;
+    if (!fBlockFilterIndex && GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX))
+        nNew |= INDEX_BUILD_BLOCKFILTER;
+
+    if (nNew) {
+        if (fHavePruned) {
+            strError = _("Building a new index needs the block and undo files of the whole chain. You need to rebuild the database using -reindex to add an index to a pruned node");
+            return false;
+        }
+        if (GetSnapshotBase()) {
+            strError = _("Building a new index needs the block and undo files of the whole chain, which a node started from a UTXO snapshot does not have");
+            return false;
+        }
+        // Index entries can be written again, so a build in progress simply starts over
+        nIndexes |= nNew;
+        hashBuilt.SetNull();
+    }
+
+    if (!nIndexes) {
+        nIndexesBuilding = 0;
+        pindexIndexBuilt = NULL;
+        if (!pblocktree->EraseIndexBuildState()) {
+            strError = _("Failed to write to the block index database");
+            return error("%s: failed to erase index build state", __func__);
+        }
+        return true;
+    }
+
+    // Entries past a fork that was left during a crash are overwritten as the build moves on
+    pindexIndexBuilt = NULL;
+    BlockMap::iterator it = mapBlockIndex.find(hashBuilt);
+    if (!hashBuilt.IsNull() && it != mapBlockIndex.end())
+        pindexIndexBuilt = chainActive.FindFork(it->second);
+
+    // Record the build before enabling the new indexes, so that they are never taken as complete
+    if (!pblocktree->WriteIndexBuildState(nIndexes, pindexIndexBuilt ? pindexIndexBuilt->GetBlockHash() : uint256())) {
+        strError = _("Failed to write to the block index database");
+        return error("%s: failed to write index build state", __func__);
+    }
+    if (nNew & INDEX_BUILD_ADDRESS) {
+        fAddressIndex = true;
+        if (!pblocktree->WriteFlag("addressindex", true) || !pblocktree->WriteFlag("addressbalances", true)) {
+            strError = _("Failed to write to the block index database");
+            return error("%s: failed to write address index flag", __func__);
+        }
+    }
+    if (nNew & INDEX_BUILD_SPENT) {
+        fSpentIndex = true;
+        if (!pblocktree->WriteFlag("spentindex", true)) {
+            strError = _("Failed to write to the block index database");
+            return error("%s: failed to write spent index flag", __func__);
+        }
+    }
+    if (nNew & INDEX_BUILD_TIMESTAMP) {
+        fTimestampIndex = true;
+        if (!pblocktree->WriteFlag("timestampindex", true)) {
+            strError = _("Failed to write to the block index database");
+            return error("%s: failed to write timestamp index flag", __func__);
+        }
+    }
+    if (nNew & INDEX_BUILD_BLOCKFILTER) {
+        fBlockFilterIndex = true;
+        if (!pblocktree->WriteFlag("blockfilterindex", true)) {
+            strError = _("Failed to write to the block index database");
+            return error("%s: failed to write block filter index flag", __func__);
+        }
+    }
+    nIndexesBuilding = nIndexes;
+
+    LogPrintf("%s: building%s%s%s%s in the background, from height %d\n", __func__,
+        (nIndexes & INDEX_BUILD_ADDRESS) ? " addressindex" : "",
+        (nIndexes & INDEX_BUILD_SPENT) ? " spentindex" : "",
+        (nIndexes & INDEX_BUILD_TIMESTAMP) ? " timestampindex" : "",
+        (nIndexes & INDEX_BUILD_BLOCKFILTER) ? " blockfilterindex" : "",
+        pindexIndexBuilt ? pindexIndexBuilt->nHeight + 1 : 0);
+    return true;
+}
+
+bool IsIndexBuilding(int nIndexes)
+{
+    return (nIndexesBuilding & nIndexes) != 0;
+}
+
+void GetIndexBuildProgress(int &nIndexes, int &nHeight)
+{
+    LOCK(cs_main);
+    nIndexes = nIndexesBuilding;
+    nHeight = pindexIndexBuilt ? pindexIndexBuilt->nHeight : -1;
+}
+
+void ThreadBuildIndexes()
+{
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    int64_t nLastProgress = GetTime();
+
+    while (true) {
+        boost::this_thread::interruption_point();
+
+        // Find the next block to index. Once there is none, ConnectBlock
+        // takes over in the same cs_main section, so no block is missed.
+        int nIndexes;
+        const CBlockIndex* pindex;
+        CDiskBlockPos undoPos;
+        {
+            LOCK(cs_main);
+            nIndexes = nIndexesBuilding;
+            if (!nIndexes)
+                return;
+            if (chainActive.Tip() == NULL) {
+                // Still waiting for the genesis block, during a reindex
+                pindex = NULL;
+            } else {
+                pindex = pindexIndexBuilt ? chainActive.Next(pindexIndexBuilt) : chainActive.Genesis();
+                if (!pindex) {
+                    if (!pblocktree->EraseIndexBuildState()) {
+                        AbortNode("Failed to write index build state");
+                        return;
+                    }
+                    nIndexesBuilding = 0;
+                    pindexIndexBuilt = NULL;
+                    LogPrintf("%s: indexes are built up to height %d and now follow the chain\n", __func__, chainActive.Height());
+                    return;
+                }
+                undoPos = pindex->GetUndoPos();
+            }
+        }
+        if (!pindex) {
+            MilliSleep(100);
+            continue;
+        }
+
+        // Read and index the block without holding cs_main. Like in ConnectBlock
+        // the genesis block has no entries, but it does have a filter.
+        std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+        std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
+        CBlockFilter filter;
+        if (pindex->pprev || (nIndexes & INDEX_BUILD_BLOCKFILTER)) {
+            CBlock block;
+            CBlockUndo blockundo;
+            if (!ReadBlockFromDisk(block, pindex, consensusParams) ||
+                (pindex->pprev && !UndoReadFromDisk(blockundo, undoPos, pindex->pprev->GetBlockHash())) ||
+                (pindex->pprev && blockundo.vtxundo.size() + 1 != block.vtx.size())) {
+                AbortNode(strprintf("Failed to read block %s for the index build", pindex->GetBlockHash().ToString()));
+                return;
+            }
+            if (pindex->pprev)
+                GetBlockIndexEntries(block, blockundo, pindex, nIndexes & INDEX_BUILD_ADDRESS, nIndexes & INDEX_BUILD_SPENT,
+                                     addressIndex, addressUnspentIndex, spentIndex);
+            if (nIndexes & INDEX_BUILD_BLOCKFILTER)
+                filter = CBlockFilter(BLOCK_FILTER_BASIC, block, blockundo);
+        }
+
+        {
+            LOCK(cs_main);
+            // The block may have been disconnected while it was read
+            if (nIndexesBuilding != nIndexes || pindexIndexBuilt != pindex->pprev || !chainActive.Contains(pindex))
+                continue;
+
+            bool fOk = true;
+            if (nIndexes & INDEX_BUILD_ADDRESS)
+                fOk = fOk && pblocktree->WriteAddressIndex(addressIndex) && pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex);
+            if (nIndexes & INDEX_BUILD_SPENT)
+                fOk = fOk && pblocktree->UpdateSpentIndex(spentIndex);
+            if ((nIndexes & INDEX_BUILD_TIMESTAMP) && pindex->pprev)
+                fOk = fOk && pblocktree->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash()));
+            if (nIndexes & INDEX_BUILD_BLOCKFILTER)
+                fOk = fOk && WriteBlockFilterIndex(filter, pindex);
+            fOk = fOk && pblocktree->WriteIndexBuildState(nIndexes, pindex->GetBlockHash());
+            if (!fOk) {
+                AbortNode("Failed to write index being built");
+                return;
+            }
+            pindexIndexBuilt = pindex;
+
+            if (GetTime() - nLastProgress >= 10) {
+                LogPrintf("%s: building indexes, at height %d of %d\n", __func__, pindex->nHeight, chainActive.Height());
+                nLastProgress = GetTime();
+            }
+        }
+    }
+}
+
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
 {
     // Map of disk positions for blocks with unknown parent (only used for reindex)
@@ -3993,6 +4658,7 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
     int nLoaded = 0;
     try {
         unsigned int nMaxBlockSize = MaxBlockSize(true);
+        FileAdviseSequential(fileIn);
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         CBufferedFile blkdat(fileIn, 2*nMaxBlockSize, nMaxBlockSize+8, SER_DISK, CLIENT_VERSION);
         uint64_t nRewind = blkdat.GetPos();
@@ -4100,6 +4766,120 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
     return nLoaded > 0;
 }
 
+bool LoadSnapshotChainstate(const CChainParams& chainparams, const boost::filesystem::path& path, CSnapshotMetadata& metadata, std::string& strError)
+{
+    // Check the whole file before touching the chainstate
+    CCoinsStats stats;
+    if (!ReadUTXOSnapshot(path, metadata, stats, strError))
+        return false;
+    if (memcmp(metadata.pchMessageStart, chainparams.MessageStart(), sizeof(metadata.pchMessageStart)) != 0) {
+        strError = "The UTXO snapshot is for a different network";
+        return false;
+    }
+    // Indexes of every block can not be built without the blocks below the snapshot
+    if (fTxIndex || fAddressIndex || fSpentIndex || fTimestampIndex || fBlockFilterIndex) {
+        strError = "A UTXO snapshot can not be loaded with -txindex, -addressindex, -spentindex, -timestampindex or -blockfilterindex enabled";
+        return false;
+    }
+    MapAssumeutxo::const_iterator itPinned = chainparams.Assumeutxo().find(metadata.hashBlock);
+    if (itPinned == chainparams.Assumeutxo().end()) {
+        strError = strprintf("No UTXO snapshot is accepted at block %s", metadata.hashBlock.ToString());
+        return false;
+    }
+    const CAssumeutxoData& pinned = itPinned->second;
+    if (stats.hashSerialized != pinned.hashSerialized) {
+        strError = strprintf("The UTXO snapshot hash %s does not match the expected %s", stats.hashSerialized.ToString(), pinned.hashSerialized.ToString());
+        return false;
+    }
+
+    LOCK(cs_main);
+    BlockMap::iterator mi = mapBlockIndex.find(metadata.hashBlock);
+    if (mi == mapBlockIndex.end()) {
+        strError = strprintf("The header of block %s is not known yet, wait for the headers to sync", metadata.hashBlock.ToString());
+        return false;
+    }
+    CBlockIndex* pindexBase = mi->second;
+    if (pindexBase->nHeight != pinned.nHeight || (pindexBase->nStatus & BLOCK_FAILED_MASK)) {
+        strError = strprintf("Block %s is not a valid UTXO snapshot base", metadata.hashBlock.ToString());
+        return false;
+    }
+    if (chainActive.Height() >= pindexBase->nHeight) {
+        strError = "The active chain is already at the UTXO snapshot height";
+        return false;
+    }
+
+    LogPrintf("Loading UTXO snapshot at block %s (height %d, %u coins)\n", metadata.hashBlock.ToString(), pindexBase->nHeight, metadata.nCoinsCount);
+    int64_t nStart = GetTimeMillis();
+    CValidationState state;
+    if (!FlushStateToDisk(state, FLUSH_STATE_ALWAYS)) {
+        strError = "Failed to flush the chainstate";
+        return false;
+    }
+    mempool.clear();
+
+    // From here on the chainstate matches no block until the load completes
+    if (!pblocktree->WriteFlag("loadingsnapshot", true))
+        return AbortNode("Failed to write to block index database");
+
+    // Replace all coins, in batches of half the coins cache size
+    size_t nBatchUsage = nCoinCacheUsage / 2;
+    CCoinsViewCache cache(pcoinswriter);
+    {
+        boost::scoped_ptr<CCoinsViewCursor> pcursor(pcoinsdbview->Cursor());
+        for (; pcursor->Valid(); pcursor->Next()) {
+            COutPoint key;
+            if (!pcursor->GetKey(key))
+                return AbortNode("Failed to read coin database");
+            cache.SpendCoin(key);
+            if (cache.DynamicMemoryUsage() > nBatchUsage && !cache.Flush())
+                return AbortNode("Failed to write to coin database");
+        }
+    }
+    CUTXOCommitment commitment;
+    bool fOk = ReadUTXOSnapshot(path, metadata, stats, strError, [&cache, &commitment, nBatchUsage](const COutPoint& outpoint, Coin& coin) {
+        if (fCoinStatsIndex)
+            commitment.AddCoin(outpoint, coin);
+        cache.AddCoin(outpoint, std::move(coin), false);
+        return cache.DynamicMemoryUsage() <= nBatchUsage || cache.Flush();
+    });
+    // The file was checked above, so it must have changed since
+    if (!fOk || metadata.hashBlock != pindexBase->GetBlockHash() || stats.hashSerialized != pinned.hashSerialized)
+        return AbortNode("Failed to load UTXO snapshot: " + (fOk ? "the file changed while loading" : strError));
+    if (fCoinStatsIndex && !pblocktree->WriteCoinStatsIndex(pindexBase->GetBlockHash(), commitment))
+        return AbortNode("Failed to write coin stats index");
+    cache.SetBestBlock(pindexBase->GetBlockHash());
+    if (!cache.Flush())
+        return AbortNode("Failed to write to coin database");
+    pcoinsTip->SetBestBlock(pindexBase->GetBlockHash());
+
+    // Make the snapshot base the tip. Its ancestors stay without data.
+    pindexBase->nChainTx = pinned.nChainTx;
+    pindexBase->RaiseValidity(BLOCK_VALID_SCRIPTS);
+    setDirtyBlockIndex.insert(pindexBase);
+    {
+        LOCK(cs_nBlockSequenceId);
+        pindexBase->nSequenceId = nBlockSequenceId++;
+    }
+    chainActive.SetTip(pindexBase);
+    setBlockIndexCandidates.insert(pindexBase);
+    deque<CBlockIndex*> queue;
+    std::pair<std::multimap<CBlockIndex*, CBlockIndex*>::iterator, std::multimap<CBlockIndex*, CBlockIndex*>::iterator> range = mapBlocksUnlinked.equal_range(pindexBase);
+    while (range.first != range.second) {
+        std::multimap<CBlockIndex*, CBlockIndex*>::iterator it = range.first;
+        queue.push_back(it->second);
+        range.first++;
+        mapBlocksUnlinked.erase(it);
+    }
+    LinkBlocks(queue);
+    PruneBlockIndexCandidates();
+
+    if (!FlushStateToDisk(state, FLUSH_STATE_ALWAYS) || !pblocktree->WriteFlag("loadingsnapshot", false))
+        return AbortNode("Failed to write to block index database");
+    LogPrintf("Loaded UTXO snapshot: %u coins in %dms, new tip %s\n", metadata.nCoinsCount, GetTimeMillis() - nStart, pindexBase->GetBlockHash().ToString());
+    CheckBlockIndex(chainparams.GetConsensus());
+    return true;
+}
+
 void static CheckBlockIndex(const Consensus::Params& consensusParams)
 {
     if (!fCheckBlockIndex) {
@@ -4108,6 +4888,11 @@ void static CheckBlockIndex(const Consensus::Params& consensusParams)
 
     LOCK(cs_main);
 
+    // The checks below assume that all blocks up to the tip were received,
+    // which is not the case below a UTXO snapshot
+    if (GetSnapshotBase())
+        return;
+
     // During a reindex, we read the genesis block and call CheckBlockIndex before ActivateBestChain,
     // so we have the genesis block in mapBlockIndex but no active chain.  (A few of the tests when
     // iterating the block tree require that chainActive has been initialized.)
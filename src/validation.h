@@ -35,19 +35,26 @@
 #include <boost/unordered_map.hpp>
 #include <boost/filesystem/path.hpp>
 
+class CBlockFileReader;
+class CBlockFilter;
 class CBlockIndex;
+class CBlockSpan;
 class CBlockTreeDB;
 class CBloomFilter;
 class CChainParams;
 class CCoinsViewDB;
+class CCoinsViewPrefetch;
+class CCoinsViewWriter;
 class CInv;
 class CConnman;
 class CScriptCheck;
+class CSnapshotMetadata;
 class CTxMemPool;
 class CValidationInterface;
 class CValidationState;
 
 struct LockPoints;
+struct PrecomputedTransactionData;
 
 /** Default for accepting alerts from the P2P network. */
 static const bool DEFAULT_ALERTS = true;
@@ -117,10 +124,15 @@ static const bool DEFAULT_RELAYPRIORITY = true;
 static const bool DEFAULT_PERMIT_BAREMULTISIG = true;
 static const unsigned int DEFAULT_BYTES_PER_SIGOP = 20;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
+/** Default for -checkblockreadpow */
+static const bool DEFAULT_CHECK_BLOCK_READ_POW = false;
 static const bool DEFAULT_TXINDEX = true;
 static const bool DEFAULT_ADDRESSINDEX = false;
 static const bool DEFAULT_TIMESTAMPINDEX = false;
 static const bool DEFAULT_SPENTINDEX = false;
+static const bool DEFAULT_COINSTATSINDEX = false;
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
+static const bool DEFAULT_PEERBLOCKFILTERS = false;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 
 static const bool DEFAULT_TESTSAFEMODE = false;
@@ -149,10 +161,14 @@ extern bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
+extern bool fCoinStatsIndex;
+extern bool fBlockFilterIndex;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern unsigned int nBytesPerSigOp;
 extern bool fCheckBlockIndex;
+/** Recompute the proof of work of every block read from disk, even when its header is already validated in the index */
+extern bool fCheckBlockReadPoW;
 extern bool fCheckpointsEnabled;
 extern size_t nCoinCacheUsage;
 extern CFeeRate minRelayTxFee;
@@ -247,6 +263,14 @@ bool LoadBlockIndex();
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the header hashing thread */
+void ThreadHeaderHashCheck();
+/**
+ * Compute the proof-of-work hashes of a batch of headers on the header hashing
+ * threads. Must be called without holding cs_main; the results are memoized in
+ * the headers themselves.
+ */
+void PrecomputeHeaderHashes(const std::vector<CBlockHeader>& headers);
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Format a string that describes several potential problems detected by the core.
@@ -292,6 +316,25 @@ void UnlinkPrunedFiles(std::set<int>& setFilesToPrune);
 CBlockIndex * InsertBlockIndex(uint256 hash);
 /** Flush all state, indexes and buffers to disk. */
 void FlushStateToDisk();
+
+/** Timing of the chainstate flushes done by FlushStateToDisk (times in microseconds) */
+struct CChainstateFlushStats
+{
+    //! Number of chainstate flushes since startup
+    int64_t nFlushes;
+    //! Time the last flush took to write (in the background, if fBackground)
+    int64_t nLastDuration;
+    //! Time validation waited for the last flush
+    int64_t nLastStall;
+    //! Time validation waited for all flushes since startup
+    int64_t nTotalStall;
+    //! Whether the last flush was written in the background
+    bool fBackground;
+    //! Whether a background flush is being written now
+    bool fInProgress;
+};
+/** Get the chainstate flush timings */
+CChainstateFlushStats GetChainstateFlushStats();
 /** Prune block files and flush state to disk. */
 void PruneAndFlush();
 
@@ -330,9 +373,17 @@ unsigned int GetP2SHSigOpCount(const CTransaction& tx, const CCoinsViewCache& ma
  * Check whether all inputs of this transaction are valid (no double spends, scripts & sigs, amounts)
  * This does not modify the UTXO set. If pvChecks is not NULL, script checks are pushed onto it
  * instead of being performed inline.
+ * cacheSigStore stores verified signatures in the signature cache; cacheFullScriptStore stores
+ * the transaction in the script execution cache when all its scripts were run inline and passed.
+ * A transaction found in the script execution cache skips script execution entirely.
+ * txdata, if not NULL, must have been built from tx and outlive any checks pushed onto pvChecks.
  */
 bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &view, bool fScriptChecks,
-                 unsigned int flags, bool cacheStore, std::vector<CScriptCheck> *pvChecks = NULL);
+                 unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore,
+                 const PrecomputedTransactionData* txdata = NULL, std::vector<CScriptCheck> *pvChecks = NULL);
+
+/** Allocate the script execution cache, which gets half of -maxsigcachesize */
+void InitScriptExecutionCache();
 
 /** Apply the effects of this transaction on the UTXO set represented by view */
 void UpdateCoins(const CTransaction& tx, CValidationState &state, CCoinsViewCache &inputs, int nHeight);
@@ -392,12 +443,13 @@ private:
     unsigned int nFlags;
     bool cacheStore;
     ScriptError error;
+    const PrecomputedTransactionData *txdata;
 
 public:
-    CScriptCheck(): ptxTo(0), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR) {}
-    CScriptCheck(const CScript& scriptPubKeyIn, const CAmount amountIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn) :
+    CScriptCheck(): ptxTo(0), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(NULL) {}
+    CScriptCheck(const CScript& scriptPubKeyIn, const CAmount amountIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn, const PrecomputedTransactionData* txdataIn = NULL) :
         scriptPubKey(scriptPubKeyIn),
-        ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR) { }
+        ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn) { }
 
     bool operator()();
 
@@ -408,23 +460,84 @@ public:
         std::swap(nFlags, check.nFlags);
         std::swap(cacheStore, check.cacheStore);
         std::swap(error, check.error);
+        std::swap(txdata, check.txdata);
     }
 
     ScriptError GetScriptError() const { return error; }
 };
 
+/**
+ * Closure representing the proof-of-work hash of one block header. Running it
+ * memoizes the Lyra2Z hash inside the header, so that the acceptance path
+ * under cs_main finds it already computed.
+ */
+class CHeaderHashCheck
+{
+private:
+    const CBlockHeader *pheader;
+
+public:
+    CHeaderHashCheck(): pheader(NULL) {}
+    CHeaderHashCheck(const CBlockHeader& headerIn) : pheader(&headerIn) {}
+
+    bool operator()();
+
+    void swap(CHeaderHashCheck &check) {
+        std::swap(pheader, check.pheader);
+    }
+};
+
+/** Indexes that can be added to an existing database by building them in the background */
+enum IndexBuildFlags {
+    INDEX_BUILD_ADDRESS = (1U << 0),
+    INDEX_BUILD_SPENT = (1U << 1),
+    INDEX_BUILD_TIMESTAMP = (1U << 2),
+    INDEX_BUILD_BLOCKFILTER = (1U << 3),
+};
+
+/**
+ * Turn on the indexes requested by -addressindex, -spentindex,
+ * -timestampindex and -blockfilterindex that the database does not have yet,
+ * and resume a build interrupted by shutdown. Returns false if they cannot be
+ * built.
+ */
+bool LoadIndexBuildState(std::string &strError);
+/** Whether any of the given indexes is enabled but still being built */
+bool IsIndexBuilding(int nIndexes);
+/** The indexes being built and the height of the last block they cover (-1 if none) */
+void GetIndexBuildProgress(int &nIndexes, int &nHeight);
+/** Build the indexes from the block and undo files of the active chain until they catch up with it */
+void ThreadBuildIndexes();
+
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes);
+/** Read the filter of a block and its filter header. Blocks the index has not reached yet have none. */
+bool GetBlockFilter(const CBlockIndex* pindex, CBlockFilter &filter, uint256 &header);
+bool GetBlockFilterHeader(const CBlockIndex* pindex, uint256 &header, uint256 &filterHash);
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
 bool GetAddressIndex(uint160 addressHash, int type,
                      std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                      int start = 0, int end = 0);
+bool GetAddressBalance(uint160 addressHash, int type, CAddressBalanceValue &value);
 bool GetAddressUnspent(uint160 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+/** Read one page of address index entries, merged across addresses; fMore is set if entries remain past nLimit */
+bool GetAddressIndexPage(const std::vector<std::pair<uint160, int> > &addresses, const CAddressIndexKey *pAfter,
+                         int start, int end, size_t nLimit, bool fWholeTx,
+                         std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, bool &fMore);
+bool GetAddressUnspentPage(const std::vector<std::pair<uint160, int> > &addresses, const CAddressUnspentKey *pAfter,
+                           size_t nLimit, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                           bool &fMore);
 
 /** Functions for disk access for blocks */
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/**
+ * Get the serialized bytes of a block without parsing it, checking only its header.
+ * Needs pblockreader; returns false if the block file cannot be mapped, in which
+ * case ReadBlockFromDisk still reads the block from the file.
+ */
+bool ReadRawBlockFromDisk(CBlockSpan& span, const CBlockIndex* pindex);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -460,18 +573,42 @@ bool InvalidateBlock(CValidationState& state, const Consensus::Params& consensus
 /** Remove invalidity status from a block and its descendants. */
 bool ReconsiderBlock(CValidationState& state, CBlockIndex *pindex);
 
+/**
+ * Replace the chainstate with the UTXO snapshot at path (see dumptxoutset) and
+ * make the block it was taken at the tip, if its hash matches the one pinned
+ * in chainparams, the block's header is known and the active chain is below
+ * it. Blocks below the snapshot are not downloaded or validated. On
+ * success, metadata describes the loaded snapshot.
+ */
+bool LoadSnapshotChainstate(const CChainParams& chainparams, const boost::filesystem::path& path, CSnapshotMetadata& metadata, std::string& strError);
+
+/**
+ * The block a UTXO snapshot was loaded at, if any: its ancestors were never
+ * downloaded, so the node has to behave as if they were pruned (requires cs_main).
+ */
+CBlockIndex* GetSnapshotBase();
+
 /** The currently-connected chain of blocks (protected by cs_main). */
 extern CChain chainActive;
 
 /** Global variable that points to the coins database (protected by cs_main) */
 extern CCoinsViewDB *pcoinsdbview;
 
+/** Global variable that points to the view loading coins ahead of ConnectBlock, between pcoinsTip and the coins database */
+extern CCoinsViewPrefetch *pcoinsprefetch;
+
+/** Global variable that points to the view writing chainstate flushes in the background, right below pcoinsTip */
+extern CCoinsViewWriter *pcoinswriter;
+
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB *pblocktree;
 
+/** Global variable that points to the memory-mapped block file reader, if -blockmmap is set */
+extern CBlockFileReader *pblockreader;
+
 /**
  * Return the spend height, which is one more than the inputs.GetBestBlock().
  * While checking, GetBestBlock() refers to the parent block. (protected by cs_main)
@@ -4,6 +4,10 @@
 
 #include "wallet/wallet.h"
 
+#include "script/standard.h"
+#include "util.h"
+#include "validation.h"
+
 #include <set>
 #include <stdint.h>
 #include <utility>
@@ -361,4 +365,54 @@ BOOST_AUTO_TEST_CASE(ApproximateBestSubset)
     BOOST_CHECK_EQUAL(setCoinsRet.size(), 101);
 }
 
+
+BOOST_FIXTURE_TEST_CASE(rescan_block_filters, RegTestingSetup)
+{
+    CKey key, keyMultisig1, keyMultisig2;
+    key.MakeNewKey(true);
+    keyMultisig1.MakeNewKey(true);
+    keyMultisig2.MakeNewKey(true);
+    std::vector<CPubKey> vMultisigKeys;
+    vMultisigKeys.push_back(keyMultisig1.GetPubKey());
+    vMultisigKeys.push_back(keyMultisig2.GetPubKey());
+
+    // Blocks paying to a key, to a bare multisig of two other keys, and to neither
+    CBlock blockKey = CreateAndProcessBlock(std::vector<CMutableTransaction>(), GetScriptForDestination(key.GetPubKey().GetID()));
+    CBlock blockMultisig = CreateAndProcessBlock(std::vector<CMutableTransaction>(), GetScriptForMultisig(1, vMultisigKeys));
+    CreateAndProcessBlock(std::vector<CMutableTransaction>(), CScript() << OP_TRUE);
+
+    mapArgs["-blockfilterindex"] = "1";
+    std::string strError;
+    BOOST_CHECK(LoadIndexBuildState(strError));
+    ThreadBuildIndexes();
+    BOOST_CHECK(fBlockFilterIndex);
+    BOOST_CHECK(!IsIndexBuilding(INDEX_BUILD_BLOCKFILTER));
+
+    // A rescan that skips blocks by their filter finds the payment to the key,
+    // but not the bare multisig one that a full rescan finds. The wallet has no
+    // file to write to, so what it found is read from mapWallet.
+    std::set<uint256> setFound[2];
+    for (int i = 0; i < 2; i++) {
+        fBlockFilterIndex = (i == 1);
+        CWallet wallet;
+        {
+            LOCK(wallet.cs_wallet);
+            BOOST_CHECK(wallet.AddKey(key));
+            BOOST_CHECK(wallet.AddKey(keyMultisig1));
+            BOOST_CHECK(wallet.AddKey(keyMultisig2));
+        }
+        wallet.ScanForWalletTransactions(chainActive.Genesis(), true);
+        LOCK(wallet.cs_wallet);
+        for (std::map<uint256, CWalletTx>::const_iterator it = wallet.mapWallet.begin(); it != wallet.mapWallet.end(); ++it)
+            setFound[i].insert(it->first);
+    }
+    BOOST_CHECK_EQUAL(setFound[0].size(), 2U);
+    BOOST_CHECK(setFound[0].count(blockKey.vtx[0].GetHash()));
+    BOOST_CHECK(setFound[0].count(blockMultisig.vtx[0].GetHash()));
+    BOOST_CHECK_EQUAL(setFound[1].size(), 1U);
+    BOOST_CHECK(setFound[1].count(blockKey.vtx[0].GetHash()));
+
+    mapArgs.erase("-blockfilterindex");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
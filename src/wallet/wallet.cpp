@@ -8,6 +8,7 @@
 #include "wallet/wallet.h"
 
 #include "base58.h"
+#include "blockfilter.h"
 #include "checkpoints.h"
 #include "chain.h"
 #include "coincontrol.h"
@@ -1672,6 +1673,48 @@ bool CWalletTx::WriteToDisk(CWalletDB *pwalletdb)
     return pwalletdb->WriteTx(GetHash(), *this);
 }
 
+static void AddBlockFilterKey(CGCSFilter::ElementSet& elements, const CPubKey& pubkey)
+{
+    CScript scriptPubKey = GetScriptForDestination(pubkey.GetID());
+    elements.insert(CGCSFilter::Element(scriptPubKey.begin(), scriptPubKey.end()));
+    scriptPubKey = GetScriptForRawPubKey(pubkey);
+    elements.insert(CGCSFilter::Element(scriptPubKey.begin(), scriptPubKey.end()));
+}
+
+/**
+ * A block involves the wallet only if it pays to or spends from one of these
+ * scripts: pay-to-pubkey(-hash) of every key, every redeem script and its
+ * pay-to-script-hash, and every watch-only script. Bare multisig outputs are
+ * not standard enough to be covered, as in the bloom filters of SPV peers: the
+ * wallet does not know their scripts, so a rescan that skips blocks by their
+ * filter does not find them or their spends.
+ */
+void CWallet::GetBlockFilterElements(CGCSFilter::ElementSet& elements) const
+{
+    AssertLockHeld(cs_wallet);
+
+    std::set<CKeyID> setKeyIds;
+    GetKeys(setKeyIds);
+    BOOST_FOREACH(const CKeyID& keyid, setKeyIds) {
+        CPubKey pubkey;
+        if (GetPubKey(keyid, pubkey))
+            AddBlockFilterKey(elements, pubkey);
+    }
+    for (std::map<CKeyID, CHDPubKey>::const_iterator it = mapHdPubKeys.begin(); it != mapHdPubKeys.end(); ++it)
+        AddBlockFilterKey(elements, it->second.extPubKey.pubkey);
+    for (WatchKeyMap::const_iterator it = mapWatchKeys.begin(); it != mapWatchKeys.end(); ++it)
+        AddBlockFilterKey(elements, it->second);
+
+    for (ScriptMap::const_iterator it = mapScripts.begin(); it != mapScripts.end(); ++it) {
+        const CScript scriptP2SH = GetScriptForDestination(it->first);
+        elements.insert(CGCSFilter::Element(scriptP2SH.begin(), scriptP2SH.end()));
+        elements.insert(CGCSFilter::Element(it->second.begin(), it->second.end()));
+    }
+
+    BOOST_FOREACH(const CScript& script, setWatchOnly)
+        elements.insert(CGCSFilter::Element(script.begin(), script.end()));
+}
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
@@ -1695,17 +1738,36 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
         ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
         double dProgressStart = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false);
         double dProgressTip = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), chainActive.Tip(), false);
+
+        // With -blockfilterindex, blocks whose filter matches none of our scripts are not read
+        CGCSFilter::ElementSet setFilterElements;
+        if (fBlockFilterIndex)
+            GetBlockFilterElements(setFilterElements);
+        int nBlocksSkipped = 0;
+
         while (pindex)
         {
             if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
                 ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
 
-            CBlock block;
-            ReadBlockFromDisk(block, pindex, Params().GetConsensus());
-            BOOST_FOREACH(CTransaction& tx, block.vtx)
-            {
-                if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
-                    ret++;
+            CBlockFilter filter;
+            uint256 filterHeader;
+            if (fBlockFilterIndex && GetBlockFilter(pindex, filter, filterHeader) &&
+                !filter.GetFilter().MatchAny(setFilterElements)) {
+                nBlocksSkipped++;
+            } else {
+                CBlock block;
+                ReadBlockFromDisk(block, pindex, Params().GetConsensus());
+                int nAdded = 0;
+                BOOST_FOREACH(CTransaction& tx, block.vtx)
+                {
+                    if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
+                        nAdded++;
+                }
+                // New transactions may have used up and topped up the keypool
+                if (nAdded > 0 && fBlockFilterIndex)
+                    GetBlockFilterElements(setFilterElements);
+                ret += nAdded;
             }
             pindex = chainActive.Next(pindex);
             if (GetTime() >= nNow + 60) {
@@ -1713,6 +1775,8 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
                 LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex));
             }
         }
+        if (nBlocksSkipped > 0)
+            LogPrintf("Rescan skipped %d blocks by their block filter\n", nBlocksSkipped);
         ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
     }
     return ret;
@@ -10,6 +10,7 @@
 
 #include "amount.h"
 #include "base58.h"
+#include "blockfilter.h"
 #include "streams.h"
 #include "tinyformat.h"
 #include "ui_interface.h"
@@ -858,6 +859,8 @@ public:
     bool AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletDB* pwalletdb);
     void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
+    //! Scripts a block filter must match for a block to involve this wallet
+    void GetBlockFilterElements(CGCSFilter::ElementSet& elements) const;
     int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman);